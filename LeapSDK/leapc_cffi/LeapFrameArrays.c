@@ -0,0 +1,63 @@
+/* Structure-of-arrays packing of tracking frames for the Python bindings.
+ *
+ */
+
+#include "LeapFrameArrays.h"
+#include <string.h>
+
+static void copyVector(float out[3], const LEAP_VECTOR *v){
+  memcpy(out, v->v, 3 * sizeof(float));
+}
+
+static void copyQuaternion(float out[4], const LEAP_QUATERNION *q){
+  memcpy(out, q->v, 4 * sizeof(float));
+}
+
+void LeapPackFrameArrays(const void *frame, LEAP_FRAME_ARRAYS *arrays){
+  const LEAP_TRACKING_EVENT *event = frame;
+  uint32_t nHands = event->nHands < LEAP_ARRAYS_MAX_HANDS ? event->nHands : LEAP_ARRAYS_MAX_HANDS;
+
+  arrays->frame_id = event->info.frame_id;
+  arrays->timestamp = event->info.timestamp;
+  arrays->tracking_frame_id = event->tracking_frame_id;
+  arrays->framerate = event->framerate;
+  arrays->nHands = nHands;
+
+  for(uint32_t h = 0; h < nHands; h++){
+    const LEAP_HAND *hand = &event->pHands[h];
+    arrays->hand_id[h] = hand->id;
+    arrays->hand_type[h] = (uint32_t)hand->type;
+    arrays->visible_time[h] = hand->visible_time;
+    arrays->confidence[h] = hand->confidence;
+    arrays->pinch_distance[h] = hand->pinch_distance;
+    arrays->grab_angle[h] = hand->grab_angle;
+    arrays->pinch_strength[h] = hand->pinch_strength;
+    arrays->grab_strength[h] = hand->grab_strength;
+
+    copyVector(arrays->palm_position[h], &hand->palm.position);
+    copyVector(arrays->palm_stabilized_position[h], &hand->palm.stabilized_position);
+    copyVector(arrays->palm_velocity[h], &hand->palm.velocity);
+    copyVector(arrays->palm_normal[h], &hand->palm.normal);
+    copyVector(arrays->palm_direction[h], &hand->palm.direction);
+    copyQuaternion(arrays->palm_orientation[h], &hand->palm.orientation);
+    arrays->palm_width[h] = hand->palm.width;
+
+    for(int f = 0; f < 5; f++){
+      const LEAP_DIGIT *digit = &hand->digits[f];
+      arrays->extended[h][f] = (uint8_t)(digit->is_extended != 0);
+      for(int b = 0; b < 4; b++){
+        const LEAP_BONE *bone = &digit->bones[b];
+        copyVector(arrays->joints[h][f][b][0], &bone->prev_joint);
+        copyVector(arrays->joints[h][f][b][1], &bone->next_joint);
+        copyQuaternion(arrays->rotations[h][f][b], &bone->rotation);
+        arrays->widths[h][f][b] = bone->width;
+      }
+    }
+
+    copyVector(arrays->arm_joints[h][0], &hand->arm.prev_joint);
+    copyVector(arrays->arm_joints[h][1], &hand->arm.next_joint);
+    copyQuaternion(arrays->arm_rotation[h], &hand->arm.rotation);
+    arrays->arm_width[h] = hand->arm.width;
+  }
+}
+//End-of-LeapFrameArrays.c
@@ -0,0 +1,57 @@
+/* Structure-of-arrays copy of a tracking frame for the Python bindings.
+ *
+ * Walking pHands[i].digits[f].bones[b] from Python crosses the FFI once per
+ * float. LeapPackFrameArrays() flattens a whole frame into one fixed-layout
+ * block instead, which leapc_cffi.arrays exposes as NumPy views with no
+ * per-element work. Every array has room for LEAP_ARRAYS_MAX_HANDS hands;
+ * only the first nHands entries are meaningful.
+ *
+ * Keep this struct in step with the cdef in build_native.py.
+ *
+ */
+
+#ifndef LeapFrameArrays_h
+#define LeapFrameArrays_h
+
+#include "LeapC.h"
+
+#define LEAP_ARRAYS_MAX_HANDS 2
+
+typedef struct _LEAP_FRAME_ARRAYS {
+  int64_t  frame_id;
+  int64_t  timestamp;
+  int64_t  tracking_frame_id;
+  float    framerate;
+  uint32_t nHands;
+
+  uint32_t hand_id[LEAP_ARRAYS_MAX_HANDS];
+  uint32_t hand_type[LEAP_ARRAYS_MAX_HANDS];          //eLeapHandType
+  uint64_t visible_time[LEAP_ARRAYS_MAX_HANDS];
+  float    confidence[LEAP_ARRAYS_MAX_HANDS];
+  float    pinch_distance[LEAP_ARRAYS_MAX_HANDS];
+  float    grab_angle[LEAP_ARRAYS_MAX_HANDS];
+  float    pinch_strength[LEAP_ARRAYS_MAX_HANDS];
+  float    grab_strength[LEAP_ARRAYS_MAX_HANDS];
+
+  float    palm_position[LEAP_ARRAYS_MAX_HANDS][3];
+  float    palm_stabilized_position[LEAP_ARRAYS_MAX_HANDS][3];
+  float    palm_velocity[LEAP_ARRAYS_MAX_HANDS][3];
+  float    palm_normal[LEAP_ARRAYS_MAX_HANDS][3];
+  float    palm_direction[LEAP_ARRAYS_MAX_HANDS][3];
+  float    palm_orientation[LEAP_ARRAYS_MAX_HANDS][4];  //x, y, z, w
+  float    palm_width[LEAP_ARRAYS_MAX_HANDS];
+
+  float    joints[LEAP_ARRAYS_MAX_HANDS][5][4][2][3];   //[hand][digit][bone][prev, next][xyz]
+  float    rotations[LEAP_ARRAYS_MAX_HANDS][5][4][4];   //[hand][digit][bone][xyzw]
+  float    widths[LEAP_ARRAYS_MAX_HANDS][5][4];
+  uint8_t  extended[LEAP_ARRAYS_MAX_HANDS][5];
+
+  float    arm_joints[LEAP_ARRAYS_MAX_HANDS][2][3];     //[hand][elbow, wrist][xyz]
+  float    arm_rotation[LEAP_ARRAYS_MAX_HANDS][4];
+  float    arm_width[LEAP_ARRAYS_MAX_HANDS];
+} LEAP_FRAME_ARRAYS;
+
+/* frame is a LEAP_TRACKING_EVENT*; it is untyped so pointers from the main leapc_cffi module can be passed directly. */
+void LeapPackFrameArrays(const void *frame, LEAP_FRAME_ARRAYS *arrays);
+
+#endif /* LeapFrameArrays_h */
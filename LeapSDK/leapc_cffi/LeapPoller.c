@@ -0,0 +1,235 @@
+/* Native background poller for the Python bindings.
+ *
+ * The ring has a single writer (the poll thread) and a single reader (the
+ * Python side). The writer never waits: each slot is guarded by a seqlock, as
+ * in the samples' shared-memory frame ring, and the reader detects slots that
+ * were overwritten while it copied them.
+ *
+ */
+
+#include "LeapPoller.h"
+#include "LeapThreads.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+  #include <sys/eventfd.h>
+  #include <unistd.h>
+#endif
+
+#define POLLER_READ_RETRIES 4
+
+typedef struct _PollerSlot {
+  atomic_uint       sequence;         //Odd while the poll thread writes the slot
+  uint64_t          index;
+  LEAP_FRAME_ARRAYS frame;
+} PollerSlot;
+
+struct _LEAP_POLLER {
+  LEAP_CONNECTION connection;
+  uint32_t        pollTimeout;
+  uint32_t        capacity;          //Power of two
+  PollerSlot     *slots;
+  int             eventFd;
+
+  atomic_uint_fast64_t count;        //Frames written so far
+  uint64_t        next;              //Reader's next frame index
+
+  atomic_uint_fast64_t missed;
+  atomic_uint_fast64_t events;
+  atomic_uint_fast64_t errors;
+  atomic_uint     connected;
+
+  atomic_int      running;
+  atomic_int      waiting;
+  LockType        waitLock;
+  CondType        waitCond;
+  ThreadType      thread;
+};
+
+static void publishFrame(LEAP_POLLER *poller, const LEAP_TRACKING_EVENT *event){
+  uint64_t index = atomic_load_explicit(&poller->count, memory_order_relaxed);
+  PollerSlot *slot = &poller->slots[index & (poller->capacity - 1)];
+  unsigned int sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+  atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  slot->index = index;
+  LeapPackFrameArrays(event, &slot->frame);
+  atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+  atomic_store_explicit(&poller->count, index + 1, memory_order_release);
+
+#if defined(__linux__)
+  if(poller->eventFd >= 0){
+    uint64_t one = 1;
+    ssize_t written = write(poller->eventFd, &one, sizeof(one));
+    (void)written; //Only fails once the counter saturates, which still wakes the reader
+  }
+#endif
+  WakeWaiter(&poller->waiting, &poller->waitLock, &poller->waitCond);
+}
+
+static ThreadReturnType pollThread(void *arg){
+  LEAP_POLLER *poller = arg;
+  LEAP_CONNECTION_MESSAGE msg;
+  while(atomic_load(&poller->running)){
+    eLeapRS result = LeapPollConnection(poller->connection, poller->pollTimeout, &msg);
+    if(result != eLeapRS_Success){
+      if(result != eLeapRS_Timeout){
+        atomic_fetch_add_explicit(&poller->errors, 1, memory_order_relaxed);
+      }
+      continue;
+    }
+    switch(msg.type){
+      case eLeapEventType_Tracking:
+        publishFrame(poller, msg.tracking_event);
+        break;
+      case eLeapEventType_Connection:
+        atomic_store(&poller->connected, 1);
+        atomic_fetch_add_explicit(&poller->events, 1, memory_order_relaxed);
+        break;
+      case eLeapEventType_ConnectionLost:
+        atomic_store(&poller->connected, 0);
+        atomic_fetch_add_explicit(&poller->events, 1, memory_order_relaxed);
+        break;
+      default:
+        atomic_fetch_add_explicit(&poller->events, 1, memory_order_relaxed);
+        break;
+    }
+  }
+  return ThreadReturnValue;
+}
+
+/**
+ * Starts polling an opened connection. capacity is rounded up to a power of
+ * two. With use_eventfd, an eventfd (Linux only) is signalled for each frame;
+ * see LeapGetPollerEventFd().
+ */
+LEAP_POLLER* LeapCreatePoller(void *connection, uint32_t capacity, uint32_t poll_timeout_ms, bool use_eventfd){
+  LEAP_POLLER *poller = calloc(1, sizeof(LEAP_POLLER));
+  if(!poller){
+    return NULL;
+  }
+  poller->connection = (LEAP_CONNECTION)connection;
+  poller->pollTimeout = poll_timeout_ms;
+  poller->eventFd = -1;
+  poller->capacity = 2;
+  while(poller->capacity < capacity){
+    poller->capacity <<= 1;
+  }
+  poller->slots = calloc(poller->capacity, sizeof(PollerSlot));
+  if(!poller->slots){
+    free(poller);
+    return NULL;
+  }
+#if defined(__linux__)
+  if(use_eventfd){
+    poller->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  }
+#endif
+
+  InitLock(&poller->waitLock);
+  InitCond(&poller->waitCond);
+  atomic_store(&poller->running, 1);
+  if(!StartThread(&poller->thread, pollThread, poller)){
+    atomic_store(&poller->running, 0);
+    LeapDestroyPoller(poller);
+    return NULL;
+  }
+  return poller;
+}
+
+/** Stops the poll thread; the connection stays open and belongs to the caller again. */
+void LeapDestroyPoller(LEAP_POLLER *poller){
+  if(!poller){
+    return;
+  }
+  if(atomic_exchange(&poller->running, 0)){
+    JoinThread(poller->thread);
+  }
+  DestroyCond(&poller->waitCond);
+  DestroyLock(&poller->waitLock);
+#if defined(__linux__)
+  if(poller->eventFd >= 0){
+    close(poller->eventFd);
+  }
+#endif
+  free(poller->slots);
+  free(poller);
+}
+
+static bool readSlot(LEAP_POLLER *poller, uint64_t index, LEAP_FRAME_ARRAYS *frame){
+  PollerSlot *slot = &poller->slots[index & (poller->capacity - 1)];
+  for(int attempt = 0; attempt < POLLER_READ_RETRIES; attempt++){
+    unsigned int before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if(before & 1u){
+      continue;
+    }
+    uint64_t slotIndex = slot->index;
+    memcpy(frame, &slot->frame, sizeof(LEAP_FRAME_ARRAYS));
+    atomic_thread_fence(memory_order_acquire);
+    if(atomic_load_explicit(&slot->sequence, memory_order_relaxed) != before){
+      continue;
+    }
+    return slotIndex == index;
+  }
+  return false;
+}
+
+/**
+ * Copies every frame received since the previous call, oldest first, up to
+ * max_frames; the rest are returned by the next call. Frames the ring
+ * overwrote in between are counted in the stats as missed. Single reader only.
+ */
+uint32_t LeapReadPoller(LEAP_POLLER *poller, LEAP_FRAME_ARRAYS *frames, uint32_t max_frames){
+  uint64_t count = atomic_load_explicit(&poller->count, memory_order_acquire);
+  uint64_t oldest = count > poller->capacity ? count - poller->capacity : 0;
+  uint64_t lost = 0;
+  if(poller->next < oldest){
+    lost += oldest - poller->next;
+    poller->next = oldest;
+  }
+  uint32_t n = 0;
+  while(poller->next < count && n < max_frames){
+    if(readSlot(poller, poller->next++, &frames[n])){
+      n++;
+    } else {
+      lost++;
+    }
+  }
+  if(lost){
+    atomic_fetch_add_explicit(&poller->missed, lost, memory_order_relaxed);
+  }
+  return n;
+}
+
+/** Sleeps until a frame newer than the last one read arrives. Returns false on timeout. */
+bool LeapWaitPoller(LEAP_POLLER *poller, uint32_t timeout_ms){
+  if(atomic_load_explicit(&poller->count, memory_order_acquire) > poller->next){
+    return true;
+  }
+  LockMutex(&poller->waitLock);
+  BeginWait(&poller->waiting);
+  if(atomic_load(&poller->count) <= poller->next){
+    WaitCond(&poller->waitCond, &poller->waitLock, timeout_ms);
+  }
+  EndWait(&poller->waiting);
+  UnlockMutex(&poller->waitLock);
+  return atomic_load_explicit(&poller->count, memory_order_acquire) > poller->next;
+}
+
+/**
+ * Returns a non-blocking eventfd that becomes readable when frames arrive, for
+ * asyncio's add_reader(); read it to re-arm. -1 if not requested or not on Linux.
+ */
+int LeapGetPollerEventFd(const LEAP_POLLER *poller){
+  return poller->eventFd;
+}
+
+void LeapGetPollerStats(const LEAP_POLLER *poller, LEAP_POLLER_STATS *stats){
+  stats->frames = atomic_load_explicit(&poller->count, memory_order_relaxed);
+  stats->missed = atomic_load_explicit(&poller->missed, memory_order_relaxed);
+  stats->events = atomic_load_explicit(&poller->events, memory_order_relaxed);
+  stats->errors = atomic_load_explicit(&poller->errors, memory_order_relaxed);
+  stats->connected = atomic_load(&poller->connected);
+}
+//End-of-LeapPoller.c
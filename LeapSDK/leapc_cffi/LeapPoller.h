@@ -0,0 +1,42 @@
+/* Native background poller for the Python bindings.
+ *
+ * A Python thread calling LeapPollConnection() through cffi only drains the
+ * connection while the interpreter lets it run, so frames are lost whenever
+ * Python is busy elsewhere. The poller services the connection on its own
+ * native thread, never touching the interpreter, and keeps the most recent
+ * frames in a ring as LEAP_FRAME_ARRAYS. Python collects everything since its
+ * last call with one LeapReadPoller() call.
+ *
+ * The poller takes over the connection: nothing else may poll it while the
+ * poller runs. Messages other than tracking frames are only counted.
+ *
+ * Keep in step with the cdef in build_native.py.
+ *
+ */
+
+#ifndef LeapPoller_h
+#define LeapPoller_h
+
+#include "LeapFrameArrays.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct _LEAP_POLLER LEAP_POLLER;
+
+typedef struct _LEAP_POLLER_STATS {
+  uint64_t frames;     //Tracking frames stored in the ring
+  uint64_t missed;     //Frames overwritten before a read collected them
+  uint64_t events;     //Other messages received
+  uint64_t errors;     //LeapPollConnection() failures other than timeouts
+  uint32_t connected;  //Whether the service connection is up
+} LEAP_POLLER_STATS;
+
+/* connection is a LEAP_CONNECTION, untyped for the same reason as in LeapPackFrameArrays(). */
+LEAP_POLLER* LeapCreatePoller(void *connection, uint32_t capacity, uint32_t poll_timeout_ms, bool use_eventfd);
+void LeapDestroyPoller(LEAP_POLLER *poller);
+uint32_t LeapReadPoller(LEAP_POLLER *poller, LEAP_FRAME_ARRAYS *frames, uint32_t max_frames);
+bool LeapWaitPoller(LEAP_POLLER *poller, uint32_t timeout_ms);
+int LeapGetPollerEventFd(const LEAP_POLLER *poller);
+void LeapGetPollerStats(const LEAP_POLLER *poller, LEAP_POLLER_STATS *stats);
+
+#endif /* LeapPoller_h */
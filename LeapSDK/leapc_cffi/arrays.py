@@ -0,0 +1,129 @@
+"""NumPy views of LeapC tracking frames.
+
+    from leapc_cffi import ffi, libleapc
+    from leapc_cffi.arrays import FrameArrays
+
+    arrays = FrameArrays()
+    ...
+    if msg.type == libleapc.eLeapEventType_Tracking:
+        arrays.update(msg.tracking_event)
+        tips = arrays.joints[:, :, 3, 1]    # [hands, 5, xyz] fingertips
+
+update() packs the frame into a C-side structure-of-arrays block in one call;
+every attribute is a NumPy view over that block created once up front, so
+reading the data crosses the FFI zero times per element. The views are
+refilled in place by the next update(): copy() anything that must outlive it.
+
+Requires the _leapc_native extension, built by build_native.py.
+"""
+
+import numpy as np
+
+from ._leapc_native import ffi, lib
+
+MAX_HANDS = lib.LEAP_ARRAYS_MAX_HANDS
+
+# Field name, dtype, per-hand shape
+_HAND_FIELDS = (
+    ("hand_id", np.uint32, ()),
+    ("hand_type", np.uint32, ()),
+    ("visible_time", np.uint64, ()),
+    ("confidence", np.float32, ()),
+    ("pinch_distance", np.float32, ()),
+    ("grab_angle", np.float32, ()),
+    ("pinch_strength", np.float32, ()),
+    ("grab_strength", np.float32, ()),
+    ("palm_position", np.float32, (3,)),
+    ("palm_stabilized_position", np.float32, (3,)),
+    ("palm_velocity", np.float32, (3,)),
+    ("palm_normal", np.float32, (3,)),
+    ("palm_direction", np.float32, (3,)),
+    ("palm_orientation", np.float32, (4,)),
+    ("palm_width", np.float32, ()),
+    ("joints", np.float32, (5, 4, 2, 3)),
+    ("rotations", np.float32, (5, 4, 4)),
+    ("widths", np.float32, (5, 4)),
+    ("extended", np.uint8, (5,)),
+    ("arm_joints", np.float32, (2, 3)),
+    ("arm_rotation", np.float32, (4,)),
+    ("arm_width", np.float32, ()),
+)
+
+
+def _address(pointer):
+    """Reinterprets a pointer from any cffi module as an untyped one of ours."""
+    return ffi.cast("const void *", pointer)
+
+
+def array_views(block, cdata_type, count=1):
+    """Returns {field: ndarray} viewing count consecutive cdata_type blocks.
+
+    Every array gets a leading axis of length count followed by the
+    per-hand axes, so FrameArrays and batched readers share one layout.
+    """
+    buffer = ffi.buffer(block)
+    stride = ffi.sizeof(cdata_type)
+    views = {}
+    for name, dtype, shape in _HAND_FIELDS:
+        offset = ffi.offsetof(cdata_type, name)
+        views[name] = np.ndarray(
+            shape=(count, MAX_HANDS) + shape,
+            dtype=dtype,
+            buffer=buffer,
+            offset=offset,
+            strides=(stride,) + _contiguous_strides((MAX_HANDS,) + shape, np.dtype(dtype).itemsize),
+        )
+    for name, dtype in (("frame_id", np.int64), ("timestamp", np.int64),
+                        ("tracking_frame_id", np.int64), ("framerate", np.float32),
+                        ("nHands", np.uint32)):
+        views[name] = np.ndarray(shape=(count,), dtype=dtype, buffer=buffer,
+                                 offset=ffi.offsetof(cdata_type, name), strides=(stride,))
+    return views
+
+
+def _contiguous_strides(shape, itemsize):
+    strides = []
+    step = itemsize
+    for extent in reversed(shape):
+        strides.append(step)
+        step *= extent
+    return tuple(reversed(strides))
+
+
+class FrameArrays:
+    """One tracking frame as NumPy arrays; hand arrays have a leading [hands] axis."""
+
+    def __init__(self):
+        self._block = ffi.new("LEAP_FRAME_ARRAYS *")
+        views = array_views(self._block, "LEAP_FRAME_ARRAYS")
+        self._views = {name: views[name][0] for name, _, _ in _HAND_FIELDS}
+        self.nHands = 0
+
+    def update(self, tracking_event):
+        """Packs a LEAP_TRACKING_EVENT* (from leapc_cffi or any cffi module) and returns nHands."""
+        lib.LeapPackFrameArrays(_address(tracking_event), self._block)
+        self.nHands = self._block.nHands
+        return self.nHands
+
+    @property
+    def frame_id(self):
+        return self._block.frame_id
+
+    @property
+    def timestamp(self):
+        return self._block.timestamp
+
+    @property
+    def tracking_frame_id(self):
+        return self._block.tracking_frame_id
+
+    @property
+    def framerate(self):
+        return self._block.framerate
+
+    def __getattr__(self, name):
+        # Only reached for names not found normally, i.e. the hand arrays
+        views = self.__dict__.get("_views")
+        if views is None or name not in views:
+            raise AttributeError(name)
+        return views[name][:self.nHands]
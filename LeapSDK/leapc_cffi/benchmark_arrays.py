@@ -0,0 +1,83 @@
+"""Compares reading tracking frames field by field through cffi with
+FrameArrays.update() and NumPy views.
+
+Both paths read every joint, bone rotation and the palm of a synthetic
+two-hand frame and produce the same [hands, 5, 4, 2, 3] joint array. No
+device is required. Run from LeapSDK:
+
+    python -m leapc_cffi.benchmark_arrays
+"""
+
+import time
+
+import numpy as np
+
+from leapc_cffi import ffi
+from leapc_cffi.arrays import FrameArrays
+
+FRAMES = 5000
+
+
+def synthesize_frame():
+    hands = ffi.new("LEAP_HAND[2]")
+    event = ffi.new("LEAP_TRACKING_EVENT *")
+    for h in range(2):
+        hand = hands[h]
+        hand.id = h + 1
+        hand.palm.position.y = 200.0
+        for f in range(5):
+            for b in range(4):
+                bone = hand.digits[f].bones[b]
+                bone.prev_joint.x, bone.prev_joint.y, bone.prev_joint.z = f, b, h
+                bone.next_joint.x, bone.next_joint.y, bone.next_joint.z = f, b + 1, h
+                bone.rotation.w = 1.0
+    event.nHands = 2
+    event.pHands = hands
+    return event, hands
+
+
+def walk_fields(event):
+    """The per-element approach: one FFI access per float."""
+    joints = np.empty((event.nHands, 5, 4, 2, 3), np.float32)
+    rotations = np.empty((event.nHands, 5, 4, 4), np.float32)
+    palms = np.empty((event.nHands, 3), np.float32)
+    for h in range(event.nHands):
+        hand = event.pHands[h]
+        palms[h] = (hand.palm.position.x, hand.palm.position.y, hand.palm.position.z)
+        for f in range(5):
+            digit = hand.digits[f]
+            for b in range(4):
+                bone = digit.bones[b]
+                joints[h, f, b, 0] = (bone.prev_joint.x, bone.prev_joint.y, bone.prev_joint.z)
+                joints[h, f, b, 1] = (bone.next_joint.x, bone.next_joint.y, bone.next_joint.z)
+                rotations[h, f, b] = (bone.rotation.x, bone.rotation.y, bone.rotation.z, bone.rotation.w)
+    return joints, rotations, palms
+
+
+def read_arrays(arrays, event):
+    arrays.update(event)
+    return arrays.joints, arrays.rotations, arrays.palm_position
+
+
+def measure(name, function):
+    start = time.perf_counter()
+    for _ in range(FRAMES):
+        result = function()
+    elapsed = time.perf_counter() - start
+    print("%-14s %10.1f us/frame %10.0f frames/s" % (name, elapsed * 1e6 / FRAMES, FRAMES / elapsed))
+    return result, elapsed
+
+
+def main():
+    event, _hands = synthesize_frame()
+    arrays = FrameArrays()
+
+    walked, walk_time = measure("field walk", lambda: walk_fields(event))
+    viewed, view_time = measure("numpy views", lambda: read_arrays(arrays, event))
+
+    same = all(np.array_equal(a, b) for a, b in zip(walked, viewed))
+    print("Results %s; views are %.0fx faster." % ("match" if same else "DIFFER", walk_time / view_time))
+
+
+if __name__ == "__main__":
+    main()
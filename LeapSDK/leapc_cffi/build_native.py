@@ -0,0 +1,102 @@
+"""Builds leapc_cffi._leapc_native, the C helpers behind leapc_cffi.arrays
+and leapc_cffi.poller.
+
+Run from anywhere with cffi installed:
+
+    python LeapSDK/leapc_cffi/build_native.py
+
+The extension is written next to this file. It is separate from the
+prebuilt _leapc_cffi module, so LeapC pointers are passed to it untyped.
+It links LeapC; set LEAPC_LIB_DIR if the library is not on the default
+search path (LeapSDK/lib/x64 is used on Windows).
+"""
+
+import os
+import sys
+
+from cffi import FFI
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SAMPLES = os.path.join(HERE, "..", "samples")
+
+# Mirrors LeapFrameArrays.h and LeapPoller.h.
+CDEF = """
+#define LEAP_ARRAYS_MAX_HANDS 2
+
+typedef struct _LEAP_FRAME_ARRAYS {
+  int64_t  frame_id;
+  int64_t  timestamp;
+  int64_t  tracking_frame_id;
+  float    framerate;
+  uint32_t nHands;
+
+  uint32_t hand_id[2];
+  uint32_t hand_type[2];
+  uint64_t visible_time[2];
+  float    confidence[2];
+  float    pinch_distance[2];
+  float    grab_angle[2];
+  float    pinch_strength[2];
+  float    grab_strength[2];
+
+  float    palm_position[2][3];
+  float    palm_stabilized_position[2][3];
+  float    palm_velocity[2][3];
+  float    palm_normal[2][3];
+  float    palm_direction[2][3];
+  float    palm_orientation[2][4];
+  float    palm_width[2];
+
+  float    joints[2][5][4][2][3];
+  float    rotations[2][5][4][4];
+  float    widths[2][5][4];
+  uint8_t  extended[2][5];
+
+  float    arm_joints[2][2][3];
+  float    arm_rotation[2][4];
+  float    arm_width[2];
+} LEAP_FRAME_ARRAYS;
+
+void LeapPackFrameArrays(const void *frame, LEAP_FRAME_ARRAYS *arrays);
+
+typedef struct _LEAP_POLLER LEAP_POLLER;
+
+typedef struct _LEAP_POLLER_STATS {
+  uint64_t frames;
+  uint64_t missed;
+  uint64_t events;
+  uint64_t errors;
+  uint32_t connected;
+} LEAP_POLLER_STATS;
+
+LEAP_POLLER* LeapCreatePoller(void *connection, uint32_t capacity, uint32_t poll_timeout_ms, bool use_eventfd);
+void LeapDestroyPoller(LEAP_POLLER *poller);
+uint32_t LeapReadPoller(LEAP_POLLER *poller, LEAP_FRAME_ARRAYS *frames, uint32_t max_frames);
+bool LeapWaitPoller(LEAP_POLLER *poller, uint32_t timeout_ms);
+int LeapGetPollerEventFd(const LEAP_POLLER *poller);
+void LeapGetPollerStats(const LEAP_POLLER *poller, LEAP_POLLER_STATS *stats);
+"""
+
+library_dirs = []
+if os.environ.get("LEAPC_LIB_DIR"):
+    library_dirs.append(os.environ["LEAPC_LIB_DIR"])
+elif sys.platform == "win32":
+    library_dirs.append(os.path.join(HERE, "..", "lib", "x64"))
+
+# The poller's ring uses C11 <stdatomic.h>, as the samples do.
+extra_compile_args = ["/std:c11", "/experimental:c11atomics"] if sys.platform == "win32" else ["-std=gnu11"]
+
+ffibuilder = FFI()
+ffibuilder.cdef(CDEF)
+ffibuilder.set_source(
+    "_leapc_native",
+    '#include "LeapFrameArrays.h"\n#include "LeapPoller.h"',
+    sources=[os.path.join(HERE, "LeapFrameArrays.c"), os.path.join(HERE, "LeapPoller.c")],
+    include_dirs=[HERE, SAMPLES],
+    libraries=["LeapC"],
+    library_dirs=library_dirs,
+    extra_compile_args=extra_compile_args,
+)
+
+if __name__ == "__main__":
+    ffibuilder.compile(tmpdir=HERE, verbose=True)
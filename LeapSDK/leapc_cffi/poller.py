@@ -0,0 +1,123 @@
+"""Native background polling of a LeapC connection.
+
+    from leapc_cffi import ffi, libleapc
+    from leapc_cffi.poller import BackgroundPoller
+
+    connection = ffi.new("LEAP_CONNECTION *")
+    libleapc.LeapCreateConnection(ffi.NULL, connection)
+    libleapc.LeapOpenConnection(connection[0])
+
+    with BackgroundPoller(connection[0]) as poller:
+        while True:
+            poller.wait(1000)
+            batch = poller.read()
+            tips = batch.joints[:, :, :, 3, 1]    # [frames, hands, 5, xyz]
+
+A native thread services the connection and keeps recent frames in a ring,
+whatever the interpreter is doing; read() returns every frame since the
+previous call as one FrameBatch of NumPy arrays. The C calls release the GIL,
+so wait() does not stall other Python threads.
+
+Requires the _leapc_native extension, built by build_native.py.
+"""
+
+import asyncio
+import os
+
+import numpy as np
+
+from ._leapc_native import ffi, lib
+from .arrays import MAX_HANDS, array_views
+
+
+class FrameBatch:
+    """Frames returned by one BackgroundPoller.read().
+
+    Per-frame arrays (frame_id, timestamp, tracking_frame_id, framerate,
+    nHands) have shape [frames]; hand arrays have shape [frames, MAX_HANDS, ...]
+    and rows at or beyond nHands hold stale data, see valid. The arrays are
+    views that the next read() overwrites.
+    """
+
+    def __init__(self, views, count):
+        self.count = count
+        for name, view in views.items():
+            setattr(self, name, view[:count])
+
+    @property
+    def valid(self):
+        """Boolean [frames, MAX_HANDS] mask of the hands present in each frame."""
+        return np.arange(MAX_HANDS) < self.nHands[:, None]
+
+    def __len__(self):
+        return self.count
+
+
+class BackgroundPoller:
+    """Polls an opened LEAP_CONNECTION on a native thread until closed.
+
+    Nothing else may poll the connection meanwhile. capacity is the number of
+    frames kept for a slow reader; batch_size the most one read() returns.
+    With use_eventfd (Linux), fileno() can be registered with a selector.
+    """
+
+    def __init__(self, connection, capacity=512, batch_size=128, poll_timeout_ms=100, use_eventfd=False):
+        self._poller = lib.LeapCreatePoller(ffi.cast("void *", connection), capacity, poll_timeout_ms, use_eventfd)
+        if self._poller == ffi.NULL:
+            raise MemoryError("LeapCreatePoller failed")
+        self._batch_size = batch_size
+        self._block = ffi.new("LEAP_FRAME_ARRAYS[]", batch_size)
+        self._views = array_views(self._block, "LEAP_FRAME_ARRAYS", batch_size)
+        self._stats = ffi.new("LEAP_POLLER_STATS *")
+
+    def read(self):
+        """Returns the frames received since the previous read(), oldest first."""
+        count = lib.LeapReadPoller(self._poller, self._block, self._batch_size)
+        return FrameBatch(self._views, count)
+
+    def wait(self, timeout_ms):
+        """Sleeps until a frame is ready for read(); False on timeout."""
+        return lib.LeapWaitPoller(self._poller, timeout_ms)
+
+    def fileno(self):
+        """The eventfd signalled for each frame, or -1 without use_eventfd or off Linux."""
+        return lib.LeapGetPollerEventFd(self._poller)
+
+    async def read_async(self):
+        """Waits without blocking the event loop, then returns read()."""
+        loop = asyncio.get_running_loop()
+        fd = self.fileno()
+        while not self.wait(0):
+            if fd < 0:
+                await loop.run_in_executor(None, self.wait, 100)
+                continue
+            ready = loop.create_future()
+            loop.add_reader(fd, lambda: ready.done() or ready.set_result(None))
+            try:
+                await ready
+            finally:
+                loop.remove_reader(fd)
+            try:
+                os.read(fd, 8)
+            except BlockingIOError:
+                pass
+        return self.read()
+
+    def stats(self):
+        lib.LeapGetPollerStats(self._poller, self._stats)
+        return {name: getattr(self._stats, name) for name in ("frames", "missed", "events", "errors", "connected")}
+
+    def close(self):
+        """Stops the thread; the connection is the caller's to poll or close again."""
+        if getattr(self, "_poller", ffi.NULL) != ffi.NULL:
+            lib.LeapDestroyPoller(self._poller)
+            self._poller = ffi.NULL
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
@@ -0,0 +1,357 @@
+/* Asynchronous logging for the poll thread and LeapC callbacks.
+ *
+ * Every logging thread gets its own single-producer ring on first use; rings
+ * are linked into a list the writer thread walks and are kept for the life
+ * of the process, so a thread that logs while the logger stops never touches
+ * freed memory. Counters live in the rings too, so logging threads share no
+ * cache lines with each other.
+ *
+ */
+
+#include "AsyncLog.h"
+#include "LeapC.h"
+#include "LeapThreads.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+  #define ThreadLocal __declspec(thread)
+#else
+  #define ThreadLocal _Thread_local
+#endif
+
+#define ASYNC_LOG_LINE 512
+#define ASYNC_LOG_TYPE_BITS 3
+#define ASYNC_LOG_WINDOW_US 1000000
+
+typedef struct _AsyncLogRecord {
+  int64_t       time;
+  AsyncLogSite *site;
+  uint32_t      count;
+  uint32_t      types;                //ASYNC_LOG_TYPE_BITS per argument
+  uint32_t      suppressed;           //Messages from this site dropped by the rate limit since the last one
+  uint64_t      values[ASYNC_LOG_MAX_ARGS];
+} AsyncLogRecord;
+
+typedef struct _AsyncLogRing {
+  struct _AsyncLogRing *next;
+  uint32_t              capacity;      //Power of two
+  AsyncLogRecord       *records;
+  atomic_uint_fast64_t  head;          //Written by the owning thread
+  atomic_uint_fast64_t  tail;          //Written by the writer thread
+  atomic_uint_fast64_t  dropped;       //Owner only; read by stats and the writer
+  atomic_uint_fast64_t  suppressed;
+  uint64_t              reportedDrops; //Writer only
+} AsyncLogRing;
+
+static const AsyncLogConfig defaultConfig = { 1024, 10, 10, false };
+
+static _Atomic(AsyncLogRing *) rings = NULL;
+static atomic_uint ringCount;
+static atomic_int running;
+static atomic_uint_fast64_t written;
+static atomic_int_fast64_t coarseNow;   //LeapGetNow() as of the writer's last pass; enough for the rate limit
+static AsyncLogConfig config;
+static FILE *output;
+static ThreadType writerThread;
+static LockType writerLock;
+static CondType writerCond;
+static ThreadLocal AsyncLogRing *threadRing = NULL;
+
+static AsyncLogRing* createRing(void){
+  AsyncLogRing *ring = calloc(1, sizeof(AsyncLogRing));
+  if(!ring){
+    return NULL;
+  }
+  ring->capacity = 2;
+  while(ring->capacity < config.ring_capacity){
+    ring->capacity <<= 1;
+  }
+  ring->records = malloc(ring->capacity * sizeof(AsyncLogRecord));
+  if(!ring->records){
+    free(ring);
+    return NULL;
+  }
+  AsyncLogRing *first = atomic_load(&rings);
+  do {
+    ring->next = first;
+  } while(!atomic_compare_exchange_weak(&rings, &first, ring));
+  atomic_fetch_add(&ringCount, 1);
+  return ring;
+}
+
+/**
+ * printf for the stored values: each conversion is re-issued with one argument
+ * of the width the conversion expects, so the caller's length modifiers and
+ * argument types do not need to agree exactly.
+ */
+static size_t formatMessage(char *out, size_t size, const char *format, const uint64_t *values, uint32_t types, uint32_t count){
+  size_t length = 0;
+  uint32_t next = 0;
+  const char *p = format;
+  while(*p && length + 1 < size){
+    if(*p != '%'){
+      out[length++] = *p++;
+      continue;
+    }
+    if(p[1] == '%'){
+      out[length++] = '%';
+      p += 2;
+      continue;
+    }
+
+    char spec[32];
+    size_t specLength = 0;
+    const char *start = p;
+    spec[specLength++] = *p++;
+    while(*p && strchr("-+ #0123456789.", *p) && specLength < sizeof(spec) - 4){
+      spec[specLength++] = *p++;
+    }
+    while(*p && strchr("hljztL", *p)){
+      p++;
+    }
+    char conversion = *p ? *p++ : '\0';
+    if(conversion == '\0' || next >= count){
+      //Malformed, or more conversions than arguments: copy the text through
+      size_t n = (size_t)(p - start);
+      n = n < size - 1 - length ? n : size - 1 - length;
+      memcpy(out + length, start, n);
+      length += n;
+      continue;
+    }
+
+    uint64_t value = values[next];
+    uint32_t type = (types >> (ASYNC_LOG_TYPE_BITS * next)) & ((1u << ASYNC_LOG_TYPE_BITS) - 1);
+    next++;
+    double number;
+    if(type == AsyncLogArg_Double){
+      memcpy(&number, &value, sizeof(number));
+    } else {
+      number = type == AsyncLogArg_Signed ? (double)(int64_t)value : (double)value;
+    }
+
+    int n;
+    size_t room = size - length;
+    switch(conversion){
+      case 'd': case 'i':
+      case 'u': case 'o': case 'x': case 'X':
+        spec[specLength++] = 'l';
+        spec[specLength++] = 'l';
+        spec[specLength++] = conversion;
+        spec[specLength] = '\0';
+        if(type == AsyncLogArg_Double){
+          value = (uint64_t)(int64_t)number;
+        }
+        if(conversion == 'd' || conversion == 'i'){
+          n = snprintf(out + length, room, spec, (long long)value);
+        } else {
+          n = snprintf(out + length, room, spec, (unsigned long long)value);
+        }
+        break;
+      case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        spec[specLength++] = conversion;
+        spec[specLength] = '\0';
+        n = snprintf(out + length, room, spec, number);
+        break;
+      case 'c':
+        spec[specLength++] = 'c';
+        spec[specLength] = '\0';
+        n = snprintf(out + length, room, spec, (int)value);
+        break;
+      case 's':
+        spec[specLength++] = 's';
+        spec[specLength] = '\0';
+        n = snprintf(out + length, room, spec,
+                     type == AsyncLogArg_String && value ? (const char *)(uintptr_t)value : "(null)");
+        break;
+      case 'p':
+        n = snprintf(out + length, room, "%p", (void *)(uintptr_t)value);
+        break;
+      default:
+        n = 0;
+        break;
+    }
+    if(n > 0){
+      length += (size_t)n < room ? (size_t)n : room - 1;
+    }
+  }
+  out[length] = '\0';
+  return length;
+}
+
+static void writeRecord(const AsyncLogRecord *record){
+  char line[ASYNC_LOG_LINE];
+  size_t length = 0;
+  if(config.timestamps){
+    length = (size_t)snprintf(line, sizeof(line), "[%lld.%06lld] ",
+                              (long long)(record->time / 1000000), (long long)(record->time % 1000000));
+  }
+  length += formatMessage(line + length, sizeof(line) - length, record->site->format,
+                          record->values, record->types, record->count);
+  if(record->suppressed){
+    bool newline = length > 0 && line[length - 1] == '\n';
+    if(newline){
+      length--;
+    }
+    snprintf(line + length, sizeof(line) - length, " (%u similar suppressed)%s",
+             record->suppressed, newline ? "\n" : "");
+  }
+  fputs(line, output);
+}
+
+/** Writes everything queued in one ring. Returns the number of messages written. */
+static uint64_t drainRing(AsyncLogRing *ring){
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  for(uint64_t i = tail; i < head; i++){
+    writeRecord(&ring->records[i & (ring->capacity - 1)]);
+  }
+  atomic_store_explicit(&ring->tail, head, memory_order_release);
+
+  uint64_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+  if(dropped != ring->reportedDrops){
+    fprintf(output, "[async log] %llu messages dropped, ring full\n",
+            (unsigned long long)(dropped - ring->reportedDrops));
+    ring->reportedDrops = dropped;
+  }
+  return head - tail;
+}
+
+static ThreadReturnType writerLoop(void *unused){
+  (void)unused;
+  for(;;){
+    bool stopping = !atomic_load(&running);
+    atomic_store_explicit(&coarseNow, LeapGetNow(), memory_order_relaxed);
+    uint64_t count = 0;
+    for(AsyncLogRing *ring = atomic_load(&rings); ring; ring = ring->next){
+      count += drainRing(ring);
+    }
+    if(count){
+      fflush(output);
+      atomic_fetch_add_explicit(&written, count, memory_order_relaxed);
+      continue;
+    }
+    if(stopping){
+      break;
+    }
+    LockMutex(&writerLock);
+    if(atomic_load(&running)){
+      WaitCond(&writerCond, &writerLock, config.flush_interval_ms);
+    }
+    UnlockMutex(&writerLock);
+  }
+  return ThreadReturnValue;
+}
+
+/**
+ * Starts the writer thread; messages go to out (stdout if NULL). config may be
+ * NULL for 1024 messages per thread, 10 per second per call site, and a 10 ms
+ * flush interval.
+ */
+bool StartAsyncLog(FILE *out, const AsyncLogConfig *logConfig){
+  if(atomic_load(&running)){
+    return false;
+  }
+  config = logConfig ? *logConfig : defaultConfig;
+  if(config.flush_interval_ms == 0){
+    config.flush_interval_ms = defaultConfig.flush_interval_ms;
+  }
+  output = out ? out : stdout;
+  atomic_store(&coarseNow, LeapGetNow());
+  InitLock(&writerLock);
+  InitCond(&writerCond);
+  atomic_store(&running, 1);
+  if(!StartThread(&writerThread, writerLoop, NULL)){
+    atomic_store(&running, 0);
+    DestroyCond(&writerCond);
+    DestroyLock(&writerLock);
+    return false;
+  }
+  return true;
+}
+
+/** Writes whatever is still queued and stops the writer thread. */
+void StopAsyncLog(void){
+  if(!atomic_exchange(&running, 0)){
+    return;
+  }
+  LockMutex(&writerLock);
+  SignalCond(&writerCond);
+  UnlockMutex(&writerLock);
+  JoinThread(writerThread);
+  DestroyCond(&writerCond);
+  DestroyLock(&writerLock);
+  fflush(output);
+}
+
+void GetAsyncLogStats(AsyncLogStats *stats){
+  memset(stats, 0, sizeof(*stats));
+  for(AsyncLogRing *ring = atomic_load(&rings); ring; ring = ring->next){
+    stats->logged += atomic_load_explicit(&ring->head, memory_order_relaxed);
+    stats->dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    stats->suppressed += atomic_load_explicit(&ring->suppressed, memory_order_relaxed);
+  }
+  stats->written = atomic_load_explicit(&written, memory_order_relaxed);
+  stats->threads = atomic_load(&ringCount);
+}
+
+/** Called by ASYNC_LOG. */
+void AsyncLogWrite(AsyncLogSite *site, const AsyncLogArg *args, uint32_t count){
+  uint32_t types = 0;
+  uint64_t values[ASYNC_LOG_MAX_ARGS];
+  for(uint32_t i = 0; i < count; i++){
+    values[i] = args[i].value;
+    types |= args[i].type << (ASYNC_LOG_TYPE_BITS * i);
+  }
+
+  if(!atomic_load_explicit(&running, memory_order_acquire)){
+    char line[ASYNC_LOG_LINE];
+    formatMessage(line, sizeof(line), site->format, values, types, count);
+    fputs(line, stdout);
+    return;
+  }
+
+  AsyncLogRing *ring = threadRing;
+  if(!ring){
+    ring = threadRing = createRing();
+    if(!ring){
+      return;
+    }
+  }
+
+  //Reading the clock costs as much as the rest of the call, so only for timestamps
+  int64_t now = config.timestamps ? LeapGetNow() : atomic_load_explicit(&coarseNow, memory_order_relaxed);
+  uint32_t suppressed = 0;
+  if(config.rate_limit){
+    int_fast64_t start = atomic_load_explicit(&site->windowStart, memory_order_relaxed);
+    if(now - start >= ASYNC_LOG_WINDOW_US &&
+       atomic_compare_exchange_strong(&site->windowStart, &start, now)){
+      atomic_store_explicit(&site->windowCount, 0, memory_order_relaxed);
+    }
+    if(atomic_fetch_add_explicit(&site->windowCount, 1, memory_order_relaxed) >= config.rate_limit){
+      atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+      atomic_store_explicit(&ring->suppressed, atomic_load_explicit(&ring->suppressed, memory_order_relaxed) + 1,
+                            memory_order_relaxed);
+      return;
+    }
+    if(atomic_load_explicit(&site->suppressed, memory_order_relaxed)){
+      suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+    }
+  }
+
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  if(head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= ring->capacity){
+    atomic_store_explicit(&ring->dropped, atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    return;
+  }
+  AsyncLogRecord *record = &ring->records[head & (ring->capacity - 1)];
+  record->time = now;
+  record->site = site;
+  record->count = count;
+  record->types = types;
+  record->suppressed = suppressed;
+  memcpy(record->values, values, count * sizeof(uint64_t));
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+//End-of-AsyncLog.c
@@ -0,0 +1,134 @@
+/* Asynchronous logging for the poll thread and LeapC callbacks.
+ *
+ * ASYNC_LOG(format, ...) takes printf-style arguments but does not format
+ * them. It copies the call site and up to ASYNC_LOG_MAX_ARGS raw argument
+ * values into a ring owned by the calling thread, and a background thread
+ * formats and writes them. The caller never takes a lock or touches the
+ * output stream, and if its ring is full the message is dropped and counted.
+ *
+ *   StartAsyncLog(stdout, NULL);
+ *   ASYNC_LOG("Frame %lli with %i hands.\n", (long long)frame->info.frame_id, frame->nHands);
+ *   ...
+ *   StopAsyncLog();   //Writes what is still queued
+ *
+ * String arguments are stored as pointers, so they must outlive the write:
+ * literals and ResultString() are fine, a stack buffer is not. Each call site
+ * writes at most rate_limit messages per second; the rest are counted, and
+ * the next message that site writes reports how many were suppressed.
+ *
+ * Before StartAsyncLog() and after StopAsyncLog(), ASYNC_LOG formats and
+ * writes to stdout on the calling thread, like printf.
+ *
+ */
+
+#ifndef AsyncLog_h
+#define AsyncLog_h
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ASYNC_LOG_MAX_ARGS 8
+
+typedef enum _AsyncLogArgType {
+  AsyncLogArg_Signed,
+  AsyncLogArg_Unsigned,
+  AsyncLogArg_Double,
+  AsyncLogArg_String,
+  AsyncLogArg_Pointer
+} AsyncLogArgType;
+
+typedef struct _AsyncLogArg {
+  uint64_t value;
+  uint32_t type;                       //AsyncLogArgType
+} AsyncLogArg;
+
+/* One per ASYNC_LOG call site; its address identifies the format. */
+typedef struct _AsyncLogSite {
+  const char          *format;
+  atomic_int_fast64_t  windowStart;    //Rate limit window, LeapGetNow() time
+  atomic_uint          windowCount;
+  atomic_uint          suppressed;
+} AsyncLogSite;
+
+typedef struct _AsyncLogConfig {
+  uint32_t ring_capacity;              //Messages per thread, rounded up to a power of two
+  uint32_t rate_limit;                 //Messages per second per call site, 0 for no limit
+  uint32_t flush_interval_ms;          //How long the writer sleeps when all rings are empty
+  bool     timestamps;                 //Prefix lines with the LeapGetNow() time of the call
+} AsyncLogConfig;
+
+typedef struct _AsyncLogStats {
+  uint64_t logged;                     //Messages queued
+  uint64_t written;
+  uint64_t dropped;                    //Ring full
+  uint64_t suppressed;                 //Over the rate limit
+  uint32_t threads;                    //Rings created
+} AsyncLogStats;
+
+bool StartAsyncLog(FILE *out, const AsyncLogConfig *config);
+void StopAsyncLog(void);
+void GetAsyncLogStats(AsyncLogStats *stats);
+void AsyncLogWrite(AsyncLogSite *site, const AsyncLogArg *args, uint32_t count);
+
+static inline AsyncLogArg asyncLogSigned(long long value){
+  AsyncLogArg arg = { (uint64_t)value, AsyncLogArg_Signed };
+  return arg;
+}
+
+static inline AsyncLogArg asyncLogUnsigned(unsigned long long value){
+  AsyncLogArg arg = { (uint64_t)value, AsyncLogArg_Unsigned };
+  return arg;
+}
+
+static inline AsyncLogArg asyncLogDouble(double value){
+  union { double d; uint64_t u; } bits = { value };
+  AsyncLogArg arg = { bits.u, AsyncLogArg_Double };
+  return arg;
+}
+
+static inline AsyncLogArg asyncLogString(const char *value){
+  AsyncLogArg arg = { (uint64_t)(uintptr_t)value, AsyncLogArg_String };
+  return arg;
+}
+
+static inline AsyncLogArg asyncLogPointer(const void *value){
+  AsyncLogArg arg = { (uint64_t)(uintptr_t)value, AsyncLogArg_Pointer };
+  return arg;
+}
+
+#define ASYNC_LOG_ARG(x) _Generic((x), \
+  _Bool: asyncLogUnsigned, char: asyncLogSigned, signed char: asyncLogSigned, unsigned char: asyncLogUnsigned, \
+  short: asyncLogSigned, unsigned short: asyncLogUnsigned, int: asyncLogSigned, unsigned int: asyncLogUnsigned, \
+  long: asyncLogSigned, unsigned long: asyncLogUnsigned, long long: asyncLogSigned, unsigned long long: asyncLogUnsigned, \
+  float: asyncLogDouble, double: asyncLogDouble, \
+  char *: asyncLogString, const char *: asyncLogString, \
+  default: asyncLogPointer)(x)
+
+//Argument counting; the extra EXPAND keeps MSVC's preprocessor from passing __VA_ARGS__ as one argument
+#define ASYNC_LOG_EXPAND(x) x
+#define ASYNC_LOG_COUNT(...) ASYNC_LOG_EXPAND(ASYNC_LOG_COUNT_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0, _))
+#define ASYNC_LOG_COUNT_(f, a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+#define ASYNC_LOG_CAT(a, b) ASYNC_LOG_CAT_(a, b)
+#define ASYNC_LOG_CAT_(a, b) a##b
+#define ASYNC_LOG_FORMAT(f, ...) f
+
+#define ASYNC_LOG_ARGS_0(f) { 0, 0 }
+#define ASYNC_LOG_ARGS_1(f, a) ASYNC_LOG_ARG(a)
+#define ASYNC_LOG_ARGS_2(f, a, b) ASYNC_LOG_ARG(a), ASYNC_LOG_ARG(b)
+#define ASYNC_LOG_ARGS_3(f, a, b, c) ASYNC_LOG_ARG(a), ASYNC_LOG_ARG(b), ASYNC_LOG_ARG(c)
+#define ASYNC_LOG_ARGS_4(f, a, b, c, d) ASYNC_LOG_ARGS_3(f, a, b, c), ASYNC_LOG_ARG(d)
+#define ASYNC_LOG_ARGS_5(f, a, b, c, d, e) ASYNC_LOG_ARGS_4(f, a, b, c, d), ASYNC_LOG_ARG(e)
+#define ASYNC_LOG_ARGS_6(f, a, b, c, d, e, g) ASYNC_LOG_ARGS_5(f, a, b, c, d, e), ASYNC_LOG_ARG(g)
+#define ASYNC_LOG_ARGS_7(f, a, b, c, d, e, g, h) ASYNC_LOG_ARGS_6(f, a, b, c, d, e, g), ASYNC_LOG_ARG(h)
+#define ASYNC_LOG_ARGS_8(f, a, b, c, d, e, g, h, i) ASYNC_LOG_ARGS_7(f, a, b, c, d, e, g, h), ASYNC_LOG_ARG(i)
+
+/** ASYNC_LOG(format, ...): printf-style, at most ASYNC_LOG_MAX_ARGS arguments, format a literal. */
+#define ASYNC_LOG(...) do { \
+    static AsyncLogSite asyncLogSite_ = { ASYNC_LOG_EXPAND(ASYNC_LOG_FORMAT(__VA_ARGS__, _)), 0, 0, 0 }; \
+    const AsyncLogArg asyncLogArgs_[] = { ASYNC_LOG_EXPAND(ASYNC_LOG_CAT(ASYNC_LOG_ARGS_, ASYNC_LOG_COUNT(__VA_ARGS__))(__VA_ARGS__)) }; \
+    AsyncLogWrite(&asyncLogSite_, asyncLogArgs_, ASYNC_LOG_COUNT(__VA_ARGS__)); \
+  } while(0)
+
+#endif /* AsyncLog_h */
@@ -0,0 +1,123 @@
+/* Measures what a log call costs the calling thread: fprintf() against
+ * ASYNC_LOG, with and without another thread writing to the same stream,
+ * and ASYNC_LOG calls that the rate limit suppresses.
+ *
+ * Calls are made in bursts, one burst per millisecond like a poll thread
+ * logging per frame, and timed per burst; the worst burst shows how far a
+ * contended stream can stall the caller. Output goes to a temporary file. No
+ * device is required.
+ *
+ */
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "LeapC.h"
+#include "AsyncLog.h"
+#include "LeapThreads.h"
+
+#define BURSTS 1000
+#define CALLS_PER_BURST 64
+#define BURST_INTERVAL_US 1000
+
+typedef struct _BenchmarkResult {
+  double meanNs;
+  double worstBurstNs;   //Per call, in the slowest burst
+} BenchmarkResult;
+
+static FILE *sink;
+static atomic_int contending;
+
+/** Another thread hammering the same stream, as the console sees from other printing threads. */
+static ThreadReturnType contender(void *unused){
+  (void)unused;
+  char block[4096];
+  memset(block, 'x', sizeof(block) - 1);
+  block[sizeof(block) - 1] = '\0';
+  while(atomic_load(&contending)){
+    fputs(block, sink);
+  }
+  return ThreadReturnValue;
+}
+
+static void waitUntil(int64_t time){
+  while(LeapGetNow() < time){
+    YieldThread();
+  }
+}
+
+static void logPrintf(int i){
+  fprintf(sink, "Hand id %i is a %s hand with position (%f, %f, %f).\n", i, "left", 1.0f * i, 200.0f, -3.5f);
+}
+
+static void logAsync(int i){
+  ASYNC_LOG("Hand id %i is a %s hand with position (%f, %f, %f).\n", i, "left", 1.0f * i, 200.0f, -3.5f);
+}
+
+static BenchmarkResult measure(void (*logCall)(int), bool contended){
+  ThreadType thread;
+  if(contended){
+    atomic_store(&contending, 1);
+    StartThread(&thread, contender, NULL);
+  }
+  BenchmarkResult result = { 0.0, 0.0 };
+  int64_t total = 0;
+  int64_t next = LeapGetNow();
+  for(int b = 0; b < BURSTS; b++){
+    next += BURST_INTERVAL_US;
+    int64_t start = LeapGetNow();
+    for(int i = 0; i < CALLS_PER_BURST; i++){
+      logCall(b * CALLS_PER_BURST + i);
+    }
+    int64_t elapsed = LeapGetNow() - start;
+    total += elapsed;
+    double perCall = elapsed * 1000.0 / CALLS_PER_BURST;
+    result.worstBurstNs = perCall > result.worstBurstNs ? perCall : result.worstBurstNs;
+    waitUntil(next);
+  }
+  if(contended){
+    atomic_store(&contending, 0);
+    JoinThread(thread);
+  }
+  result.meanNs = total * 1000.0 / ((double)BURSTS * CALLS_PER_BURST);
+  return result;
+}
+
+static void report(const char *name, BenchmarkResult result){
+  printf("%-34s %10.1f %14.1f\n", name, result.meanNs, result.worstBurstNs);
+}
+
+int main(int argc, char** argv) {
+  sink = tmpfile();
+  if(!sink){
+    printf("Failed to open a temporary file.\n");
+    return 1;
+  }
+
+  printf("%d bursts of %d calls, one burst per %d us\n", BURSTS, CALLS_PER_BURST, BURST_INTERVAL_US);
+  printf("%-34s %10s %14s\n", "ns per call", "mean", "worst burst");
+  report("fprintf", measure(logPrintf, false));
+  report("fprintf, contended stream", measure(logPrintf, true));
+
+  AsyncLogConfig config = { 4096, 0, 1, false };
+  StartAsyncLog(sink, &config);
+  report("ASYNC_LOG", measure(logAsync, false));
+  report("ASYNC_LOG, contended stream", measure(logAsync, true));
+  StopAsyncLog();
+
+  AsyncLogStats stats;
+  GetAsyncLogStats(&stats);
+  printf("Queued %llu, written %llu, dropped %llu\n", (unsigned long long)stats.logged,
+         (unsigned long long)stats.written, (unsigned long long)stats.dropped);
+
+  config.rate_limit = 10;
+  StartAsyncLog(sink, &config);
+  report("ASYNC_LOG, rate limited", measure(logAsync, false));
+  StopAsyncLog();
+  GetAsyncLogStats(&stats);
+  printf("Suppressed %llu\n", (unsigned long long)stats.suppressed);
+
+  fclose(sink);
+  return 0;
+}
+//End-of-Sample
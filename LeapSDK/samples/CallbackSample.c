@@ -7,12 +7,18 @@
  *
  */
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "LeapC.h"
 #include "ExampleConnection.h"
+#include "AsyncLog.h"
+#include "ImagePool.h"
+#include "LeapThreads.h"
 
 static LEAP_CONNECTION* connectionHandle;
+static ImagePool* imagePool;
+static atomic_bool consuming = true;
 
 /** Callback for when the connection opens. */
 static void OnConnect(void){
@@ -24,14 +30,14 @@ static void OnDevice(const LEAP_DEVICE_INFO *props){
   printf("Found device %s.\n", props->serial);
 }
 
-/** Callback for when a frame of tracking data is available. */
+/** Callback for when a frame of tracking data is available. Runs on the poll thread, so it logs asynchronously. */
 static void OnFrame(const LEAP_TRACKING_EVENT *frame){
   if (frame->info.frame_id % 60 == 0)
-    printf("Frame %lli with %i hands.\n", (long long int)frame->info.frame_id, frame->nHands);
+    ASYNC_LOG("Frame %lli with %i hands.\n", (long long int)frame->info.frame_id, frame->nHands);
 
   for(uint32_t h = 0; h < frame->nHands; h++){
     LEAP_HAND* hand = &frame->pHands[h];
-    printf("    Hand id %i is a %s hand with position (%f, %f, %f).\n",
+    ASYNC_LOG("    Hand id %i is a %s hand with position (%f, %f, %f).\n",
                 hand->id,
                 (hand->type == eLeapHandType_Left ? "left" : "right"),
                 hand->palm.position.x,
@@ -40,25 +46,34 @@ static void OnFrame(const LEAP_TRACKING_EVENT *frame){
   }
 }
 
+/** Callback for when an image is available. Hands the pooled buffer to the consumer thread. */
 static void OnImage(const LEAP_IMAGE_EVENT *image){
-  printf("Image %lli  => Left: %d x %d (bpp=%d), Right: %d x %d (bpp=%d)\n",
-      (long long int)image->info.frame_id,
-      image->image[0].properties.width,image->image[0].properties.height,image->image[0].properties.bpp*8,
-      image->image[1].properties.width,image->image[1].properties.height,image->image[1].properties.bpp*8);
+  PublishPooledImage(imagePool, image);
 }
 
-static void* allocate(uint32_t size, eLeapAllocatorType typeHint, void* state) {
-  void* ptr = malloc(size);
-  return ptr;
-}
-
-static void deallocate(void* ptr, void* state) {
-  if (!ptr)
-    return;
-  free(ptr);
+/** Takes images off the pool; however slow it is, the pool keeps memory bounded. */
+static ThreadReturnType consumeImages(void *arg){
+  (void)arg;
+  while(atomic_load(&consuming)){
+    const PooledImage *pooled = AcquirePooledImage(imagePool, 100);
+    if(!pooled){
+      continue;
+    }
+    const LEAP_IMAGE_EVENT *image = &pooled->event;
+    ASYNC_LOG("Image %lli  => Left: %d x %d (bpp=%d), Right: %d x %d (bpp=%d)\n",
+        (long long int)image->info.frame_id,
+        image->image[0].properties.width,image->image[0].properties.height,image->image[0].properties.bpp*8,
+        image->image[1].properties.width,image->image[1].properties.height,image->image[1].properties.bpp*8);
+    ReleasePooledImage(imagePool, pooled);
+  }
+  return ThreadReturnValue;
 }
 
 int main(int argc, char** argv) {
+  //Every hand of every frame is logged, far past the default per-call-site rate limit
+  AsyncLogConfig logConfig = { 1024, 0, 10, false };
+  StartAsyncLog(stdout, &logConfig);
+
   //Set callback function pointers
   ConnectionCallbacks.on_connection          = &OnConnect;
   ConnectionCallbacks.on_device_found        = &OnDevice;
@@ -66,17 +81,35 @@ int main(int argc, char** argv) {
   ConnectionCallbacks.on_image               = &OnImage;
 
   connectionHandle = OpenConnection();
-  {
-    LEAP_ALLOCATOR allocator = { allocate, deallocate, NULL };
-    LeapSetAllocator(*connectionHandle, &allocator);
+  ImagePoolConfig poolConfig;
+  GetDefaultImagePoolConfig(&poolConfig);
+  imagePool = CreateImagePool(&poolConfig, *connectionHandle);
+  if(!imagePool){
+    printf("Failed to create the image pool.\n");
+    CloseConnection();
+    DestroyConnection();
+    StopAsyncLog();
+    return 1;
   }
+  InstallImagePool(imagePool, *connectionHandle);
+  ThreadType consumer;
+  StartThread(&consumer, consumeImages, NULL);
   LeapSetPolicyFlags(*connectionHandle, eLeapPolicyFlag_Images | eLeapPolicyFlag_MapPoints, 0);
 
   printf("Press Enter to exit program.\n");
   getchar();
   
   CloseConnection();
+  atomic_store(&consuming, false);
+  JoinThread(consumer);
+  ImagePoolStats stats;
+  GetImagePoolStats(imagePool, &stats);
+  printf("Images: %llu published, %llu dropped, %llu rejected, peak %u of %u buffers in use.\n",
+         (unsigned long long)stats.published, (unsigned long long)stats.dropped,
+         (unsigned long long)stats.rejected, stats.peakInUse, poolConfig.capacity);
   DestroyConnection();
+  DestroyImagePool(imagePool);
+  StopAsyncLog();
 
   return 0;
 }
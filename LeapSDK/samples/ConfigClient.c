@@ -0,0 +1,461 @@
+/* Asynchronous access to the service's configuration values.
+ *
+ * One lock guards the request table and the cache. A request is sent with the
+ * lock held so that its response, which the polling thread handles under the
+ * same lock, can never be processed before the request is in the table.
+ * Callbacks run after the lock is released.
+ *
+ */
+
+#include "ConfigClient.h"
+#include "LeapThreads.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PENDING_MASK (CONFIG_MAX_PENDING - 1)
+
+typedef struct _ConfigWaiter {
+  ConfigFuture   *future;
+  config_callback callback;
+  void           *user;
+} ConfigWaiter;
+
+typedef struct _PendingRequest {
+  bool         used;
+  bool         save;
+  uint32_t     requestID;
+  int64_t      issued;
+  char         key[CONFIG_MAX_KEY];
+  ConfigValue  value;                          //Value being saved
+  uint32_t     nWaiters;
+  ConfigWaiter waiters[CONFIG_MAX_WAITERS];
+} PendingRequest;
+
+typedef struct _CachedValue {
+  bool        valid;
+  int64_t     fetched;
+  char        key[CONFIG_MAX_KEY];
+  ConfigValue value;
+} CachedValue;
+
+struct _ConfigClient {
+  LEAP_CONNECTION   connection;
+  int64_t           maxAge;                    //Microseconds, 0 to keep values until invalidated
+  LockType          lock;
+  CondType          completed;
+  PendingRequest    pending[CONFIG_MAX_PENDING];  //Open addressing on requestID
+  uint32_t          pendingCount;
+  CachedValue       cache[CONFIG_CACHE_SIZE];
+  uint32_t          nextEviction;
+  ConfigClientStats stats;
+};
+
+static int findPending(ConfigClient *client, uint32_t requestID){
+  for(uint32_t i = requestID & PENDING_MASK, n = 0; n < CONFIG_MAX_PENDING; i = (i + 1) & PENDING_MASK, n++){
+    if(!client->pending[i].used){
+      return -1;
+    }
+    if(client->pending[i].requestID == requestID){
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/** Returns a cleared slot for requestID, or NULL when the table is full. */
+static PendingRequest* insertPending(ConfigClient *client, uint32_t requestID){
+  if(client->pendingCount >= CONFIG_MAX_PENDING - 1){
+    return NULL;
+  }
+  uint32_t i = requestID & PENDING_MASK;
+  while(client->pending[i].used){
+    i = (i + 1) & PENDING_MASK;
+  }
+  PendingRequest *request = &client->pending[i];
+  memset(request, 0, sizeof(*request));
+  request->used = true;
+  request->requestID = requestID;
+  client->pendingCount++;
+  return request;
+}
+
+/** Removes slot index, shifting later entries of the same probe run back so lookups need no tombstones. */
+static void removePending(ConfigClient *client, uint32_t index){
+  uint32_t hole = index;
+  client->pending[hole].used = false;
+  client->pendingCount--;
+  for(uint32_t i = (hole + 1) & PENDING_MASK; client->pending[i].used; i = (i + 1) & PENDING_MASK){
+    uint32_t home = client->pending[i].requestID & PENDING_MASK;
+    //Move the entry into the hole unless its home lies cyclically in (hole, i]
+    bool stays = hole <= i ? (home > hole && home <= i) : (home > hole || home <= i);
+    if(!stays){
+      client->pending[hole] = client->pending[i];
+      client->pending[i].used = false;
+      hole = i;
+    }
+  }
+}
+
+static CachedValue* findCached(ConfigClient *client, const char *key){
+  for(uint32_t i = 0; i < CONFIG_CACHE_SIZE; i++){
+    if(client->cache[i].valid && strcmp(client->cache[i].key, key) == 0){
+      return &client->cache[i];
+    }
+  }
+  return NULL;
+}
+
+static void putCached(ConfigClient *client, const char *key, const ConfigValue *value){
+  CachedValue *entry = findCached(client, key);
+  for(uint32_t i = 0; !entry && i < CONFIG_CACHE_SIZE; i++){
+    if(!client->cache[i].valid){
+      entry = &client->cache[i];
+    }
+  }
+  if(!entry){
+    entry = &client->cache[client->nextEviction];
+    client->nextEviction = (client->nextEviction + 1) % CONFIG_CACHE_SIZE;
+  }
+  entry->valid = true;
+  entry->fetched = LeapGetNow();
+  strncpy(entry->key, key, CONFIG_MAX_KEY - 1);
+  entry->key[CONFIG_MAX_KEY - 1] = '\0';
+  entry->value = *value;
+}
+
+static bool dropCached(ConfigClient *client, const char *key){
+  CachedValue *entry = findCached(client, key);
+  if(entry){
+    entry->valid = false;
+    client->stats.invalidations++;
+  }
+  return entry != NULL;
+}
+
+static void addWaiter(PendingRequest *request, ConfigFuture *future, config_callback callback, void *user){
+  ConfigWaiter *waiter = &request->waiters[request->nWaiters++];
+  waiter->future = future;
+  waiter->callback = callback;
+  waiter->user = user;
+}
+
+/**
+ * Completes the request in slot index: fills its futures, removes it and
+ * releases the lock, then runs its callbacks. Call with the lock held.
+ */
+static void finishRequest(ConfigClient *client, uint32_t index, bool ok, const ConfigValue *value){
+  PendingRequest request = client->pending[index];
+  removePending(client, index);
+  for(uint32_t w = 0; w < request.nWaiters; w++){
+    ConfigFuture *future = request.waiters[w].future;
+    if(future){
+      future->value = *value;
+      future->ok = ok;
+      future->done = true;
+    }
+  }
+  BroadcastCond(&client->completed);
+  UnlockMutex(&client->lock);
+  for(uint32_t w = 0; w < request.nWaiters; w++){
+    if(request.waiters[w].callback){
+      request.waiters[w].callback(request.key, ok, value, request.waiters[w].user);
+    }
+  }
+}
+
+/**
+ * Fails requests the service has not answered within CONFIG_REQUEST_EXPIRY_MS.
+ * Run on every request and response, so a lost answer cannot leave a key's
+ * readers joined to a dead request.
+ */
+static void expireRequests(ConfigClient *client){
+  int64_t cutoff = LeapGetNow() - (int64_t)CONFIG_REQUEST_EXPIRY_MS * 1000;
+  ConfigValue none = { 0 };
+  for(;;){
+    LockMutex(&client->lock);
+    uint32_t i = 0;
+    while(i < CONFIG_MAX_PENDING && !(client->pending[i].used && client->pending[i].issued < cutoff)){
+      i++;
+    }
+    if(i == CONFIG_MAX_PENDING){
+      UnlockMutex(&client->lock);
+      return;
+    }
+    client->stats.expired++;
+    finishRequest(client, i, false, &none);
+  }
+}
+
+static void completeNow(const char *key, const ConfigValue *value, ConfigFuture *future, config_callback callback, void *user){
+  if(future){
+    future->value = *value;
+    future->ok = true;
+    future->done = true;
+  }
+  if(callback){
+    callback(key, true, value, user);
+  }
+}
+
+static bool validKey(const char *key){
+  return key && strlen(key) < CONFIG_MAX_KEY;
+}
+
+/**
+ * Creates a client for an open connection. Hand it the connection's config
+ * events with HandleConfigResponse() and HandleConfigChange().
+ */
+ConfigClient* CreateConfigClient(LEAP_CONNECTION connection, uint32_t max_age_ms){
+  ConfigClient *client = calloc(1, sizeof(ConfigClient));
+  if(!client){
+    return NULL;
+  }
+  client->connection = connection;
+  client->maxAge = (int64_t)max_age_ms * 1000;
+  InitLock(&client->lock);
+  InitCond(&client->completed);
+  return client;
+}
+
+/** Outstanding requests are failed first, so every future and callback completes. */
+void DestroyConfigClient(ConfigClient *client){
+  if(!client){
+    return;
+  }
+  FailPendingConfigRequests(client);
+  DestroyCond(&client->completed);
+  DestroyLock(&client->lock);
+  free(client);
+}
+
+/**
+ * Reads key. A fresh cached value completes future and callback before this
+ * returns; otherwise they complete when the service answers. Either may be
+ * NULL. Returns false if the request could not be sent.
+ */
+bool RequestConfigValue(ConfigClient *client, const char *key, ConfigFuture *future, config_callback callback, void *user){
+  if(!validKey(key)){
+    return false;
+  }
+  if(future){
+    future->done = false;
+  }
+  expireRequests(client);
+
+  LockMutex(&client->lock);
+  CachedValue *cached = findCached(client, key);
+  if(cached && client->maxAge && LeapGetNow() - cached->fetched > client->maxAge){
+    cached->valid = false;
+    cached = NULL;
+  }
+  if(cached){
+    ConfigValue value = cached->value;
+    client->stats.cacheHits++;
+    UnlockMutex(&client->lock);
+    completeNow(key, &value, future, callback, user);
+    return true;
+  }
+
+  for(uint32_t i = 0; i < CONFIG_MAX_PENDING; i++){
+    PendingRequest *request = &client->pending[i];
+    if(request->used && !request->save && request->nWaiters < CONFIG_MAX_WAITERS && strcmp(request->key, key) == 0){
+      addWaiter(request, future, callback, user);
+      client->stats.joined++;
+      UnlockMutex(&client->lock);
+      return true;
+    }
+  }
+
+  uint32_t requestID;
+  PendingRequest *request = NULL;
+  if(client->pendingCount < CONFIG_MAX_PENDING - 1 &&
+     LeapRequestConfigValue(client->connection, key, &requestID) == eLeapRS_Success){
+    request = insertPending(client, requestID);
+  }
+  if(request){
+    request->issued = LeapGetNow();
+    strcpy(request->key, key);
+    addWaiter(request, future, callback, user);
+    client->stats.requests++;
+  }
+  UnlockMutex(&client->lock);
+  return request != NULL;
+}
+
+/**
+ * Writes key. The cached value is dropped at once and replaced by value if
+ * the service reports success. future->value holds the value saved.
+ */
+bool SaveConfigValue(ConfigClient *client, const char *key, const ConfigValue *value, ConfigFuture *future, config_callback callback, void *user){
+  if(!validKey(key)){
+    return false;
+  }
+  if(future){
+    future->done = false;
+  }
+  expireRequests(client);
+
+  LEAP_VARIANT variant;
+  memset(&variant, 0, sizeof(variant));
+  variant.type = value->type;
+  switch(value->type){
+    case eLeapValueType_Boolean: variant.boolValue = value->boolValue; break;
+    case eLeapValueType_Int32:   variant.iValue = value->iValue; break;
+    case eLeapValueType_Float:   variant.fValue = value->fValue; break;
+    case eLeapValueType_String:  variant.strValue = value->strValue; break;
+    default: return false;
+  }
+
+  LockMutex(&client->lock);
+  dropCached(client, key);
+  uint32_t requestID;
+  PendingRequest *request = NULL;
+  if(client->pendingCount < CONFIG_MAX_PENDING - 1 &&
+     LeapSaveConfigValue(client->connection, key, &variant, &requestID) == eLeapRS_Success){
+    request = insertPending(client, requestID);
+  }
+  if(request){
+    request->save = true;
+    request->issued = LeapGetNow();
+    strcpy(request->key, key);
+    request->value = *value;
+    addWaiter(request, future, callback, user);
+    client->stats.requests++;
+  }
+  UnlockMutex(&client->lock);
+  return request != NULL;
+}
+
+static void detachFuture(ConfigClient *client, ConfigFuture *future){
+  for(uint32_t i = 0; i < CONFIG_MAX_PENDING; i++){
+    PendingRequest *request = &client->pending[i];
+    for(uint32_t w = 0; request->used && w < request->nWaiters; w++){
+      if(request->waiters[w].future == future){
+        request->waiters[w] = request->waiters[--request->nWaiters];
+        w--;
+      }
+    }
+  }
+}
+
+/**
+ * Sleeps until future completes; true if the request succeeded. On timeout
+ * the future is detached from its request, so it may then go out of scope;
+ * the response, if it comes, still updates the cache.
+ */
+bool WaitConfigFuture(ConfigClient *client, ConfigFuture *future, uint32_t timeout_ms){
+  int64_t deadline = LeapGetNow() + (int64_t)timeout_ms * 1000;
+  LockMutex(&client->lock);
+  while(!future->done){
+    int64_t remaining = deadline - LeapGetNow();
+    if(remaining <= 0){
+      detachFuture(client, future);
+      break;
+    }
+    WaitCond(&client->completed, &client->lock, (uint32_t)((remaining + 999) / 1000));
+  }
+  bool ok = future->done && future->ok;
+  UnlockMutex(&client->lock);
+  return ok;
+}
+
+/** Detaches a future that will not be waited on. */
+void CancelConfigFuture(ConfigClient *client, ConfigFuture *future){
+  LockMutex(&client->lock);
+  detachFuture(client, future);
+  UnlockMutex(&client->lock);
+}
+
+/** Blocking read: the cached value if fresh, else one service round trip of at most timeout_ms. */
+bool GetConfigValue(ConfigClient *client, const char *key, ConfigValue *value, uint32_t timeout_ms){
+  ConfigFuture future;
+  if(!RequestConfigValue(client, key, &future, NULL, NULL) || !WaitConfigFuture(client, &future, timeout_ms)){
+    return false;
+  }
+  *value = future.value;
+  return true;
+}
+
+/** Forces the next read of key to ask the service. */
+void InvalidateConfigValue(ConfigClient *client, const char *key){
+  LockMutex(&client->lock);
+  dropCached(client, key);
+  UnlockMutex(&client->lock);
+}
+
+/** Called on the polling thread for eLeapEventType_ConfigResponse. */
+void HandleConfigResponse(ConfigClient *client, const LEAP_CONFIG_RESPONSE_EVENT *response){
+  expireRequests(client);
+  //The string, if any, is only valid until the next poll
+  ConfigValue value;
+  memset(&value, 0, sizeof(value));
+  value.type = response->value.type;
+  switch(response->value.type){
+    case eLeapValueType_Boolean: value.boolValue = response->value.boolValue; break;
+    case eLeapValueType_Int32:   value.iValue = response->value.iValue; break;
+    case eLeapValueType_Float:   value.fValue = response->value.fValue; break;
+    case eLeapValueType_String:
+      if(response->value.strValue){
+        strncpy(value.strValue, response->value.strValue, CONFIG_MAX_STRING - 1);
+      }
+      break;
+    default: break;
+  }
+  bool ok = value.type != eLeapValueType_Unknown;
+
+  LockMutex(&client->lock);
+  int index = findPending(client, response->requestID);
+  if(index < 0 || client->pending[index].save){
+    UnlockMutex(&client->lock);
+    return;
+  }
+  client->stats.responses++;
+  if(ok){
+    putCached(client, client->pending[index].key, &value);
+  }
+  finishRequest(client, (uint32_t)index, ok, &value);
+}
+
+/** Called on the polling thread for eLeapEventType_ConfigChange, the result of a save. */
+void HandleConfigChange(ConfigClient *client, const LEAP_CONFIG_CHANGE_EVENT *change){
+  expireRequests(client);
+  LockMutex(&client->lock);
+  int index = findPending(client, change->requestID);
+  if(index < 0 || !client->pending[index].save){
+    UnlockMutex(&client->lock);
+    return;
+  }
+  PendingRequest *request = &client->pending[index];
+  ConfigValue value = request->value;
+  client->stats.responses++;
+  if(change->status){
+    putCached(client, request->key, &value);
+  } else {
+    dropCached(client, request->key);
+  }
+  finishRequest(client, (uint32_t)index, change->status, &value);
+}
+
+/** Fails every outstanding request, e.g. when the connection is lost. */
+void FailPendingConfigRequests(ConfigClient *client){
+  ConfigValue none = { 0 };
+  for(;;){
+    LockMutex(&client->lock);
+    uint32_t i = 0;
+    while(i < CONFIG_MAX_PENDING && !client->pending[i].used){
+      i++;
+    }
+    if(i == CONFIG_MAX_PENDING){
+      UnlockMutex(&client->lock);
+      return;
+    }
+    finishRequest(client, i, false, &none);
+  }
+}
+
+void GetConfigClientStats(ConfigClient *client, ConfigClientStats *stats){
+  LockMutex(&client->lock);
+  *stats = client->stats;
+  UnlockMutex(&client->lock);
+}
+//End-of-ConfigClient.c
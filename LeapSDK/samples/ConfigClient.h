@@ -0,0 +1,89 @@
+/* Asynchronous access to the service's configuration values.
+ *
+ * LeapRequestConfigValue() and LeapSaveConfigValue() only return a request
+ * ID; the result arrives later on the polling thread as a
+ * LEAP_CONFIG_RESPONSE_EVENT or LEAP_CONFIG_CHANGE_EVENT. ConfigClient keeps
+ * the outstanding requests in a table keyed by request ID and, when the
+ * polling thread hands it the response, completes the request's futures and
+ * calls its callbacks.
+ *
+ * Values read are cached per key, so repeated reads are answered without a
+ * service round trip, and a read for a key that is already being fetched
+ * joins that request. A successful save updates the cache, a failed one drops
+ * the key; max_age_ms bounds how stale a value changed by another client can
+ * get.
+ *
+ * Issue several requests, then wait for them all, rather than waiting on each:
+ *
+ *   ConfigFuture a, b;
+ *   RequestConfigValue(client, "robust_mode_enabled", &a, NULL, NULL);
+ *   RequestConfigValue(client, "low_resource_mode_enabled", &b, NULL, NULL);
+ *   WaitConfigFuture(client, &a, 1000);
+ *   WaitConfigFuture(client, &b, 1000);
+ *
+ * A future must be waited on (or cancelled) before it goes out of scope.
+ *
+ */
+
+#ifndef ConfigClient_h
+#define ConfigClient_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CONFIG_MAX_KEY 64
+#define CONFIG_MAX_STRING 128
+#define CONFIG_MAX_PENDING 64      //Outstanding LeapC requests, power of two
+#define CONFIG_MAX_WAITERS 4       //Futures and callbacks sharing one request
+#define CONFIG_CACHE_SIZE 64
+#define CONFIG_REQUEST_EXPIRY_MS 5000
+
+typedef struct _ConfigClient ConfigClient;
+
+typedef struct _ConfigValue {
+  eLeapValueType type;
+  union {
+    bool    boolValue;
+    int32_t iValue;
+    float   fValue;
+  };
+  char strValue[CONFIG_MAX_STRING];
+} ConfigValue;
+
+/** Called on the polling thread (or the caller's, for cached values). ok is false if the request failed. */
+typedef void (*config_callback)(const char *key, bool ok, const ConfigValue *value, void *user);
+
+typedef struct _ConfigFuture {
+  volatile bool done;
+  bool          ok;
+  ConfigValue   value;             //The value read, or the value saved
+} ConfigFuture;
+
+typedef struct _ConfigClientStats {
+  uint64_t requests;               //Sent to the service
+  uint64_t cacheHits;
+  uint64_t joined;                 //Reads that shared a request already in flight
+  uint64_t responses;
+  uint64_t expired;                //Requests abandoned without a response
+  uint64_t invalidations;
+} ConfigClientStats;
+
+ConfigClient* CreateConfigClient(LEAP_CONNECTION connection, uint32_t max_age_ms);
+void DestroyConfigClient(ConfigClient *client);
+
+bool RequestConfigValue(ConfigClient *client, const char *key, ConfigFuture *future, config_callback callback, void *user);
+bool SaveConfigValue(ConfigClient *client, const char *key, const ConfigValue *value, ConfigFuture *future, config_callback callback, void *user);
+bool WaitConfigFuture(ConfigClient *client, ConfigFuture *future, uint32_t timeout_ms);
+void CancelConfigFuture(ConfigClient *client, ConfigFuture *future);
+bool GetConfigValue(ConfigClient *client, const char *key, ConfigValue *value, uint32_t timeout_ms);
+void InvalidateConfigValue(ConfigClient *client, const char *key);
+
+/* For the polling thread */
+void HandleConfigResponse(ConfigClient *client, const LEAP_CONFIG_RESPONSE_EVENT *response);
+void HandleConfigChange(ConfigClient *client, const LEAP_CONFIG_CHANGE_EVENT *change);
+void FailPendingConfigRequests(ConfigClient *client);
+
+void GetConfigClientStats(ConfigClient *client, ConfigClientStats *stats);
+
+#endif /* ConfigClient_h */
@@ -0,0 +1,97 @@
+/* Reads service configuration values three ways and times each: one blocking
+ * round trip per key, all keys requested at once through ConfigClient
+ * futures, and again from ConfigClient's cache.
+ *
+ * Keys are taken from the command line; a few general ones are used if none
+ * are given. Keys the service does not know are reported as failed.
+ *
+ */
+
+#include <stdio.h>
+#include "LeapC.h"
+#include "ExampleConnection.h"
+#include "ConfigClient.h"
+
+#define MAX_KEYS 16
+#define TIMEOUT_MS 1000
+
+static const char *defaultKeys[] = { "robust_mode_enabled", "low_resource_mode_enabled", "image_processing_auto_flip" };
+
+static void printValue(const char *key, bool ok, const ConfigValue *value){
+  if(!ok){
+    printf("  %-32s (failed)\n", key);
+    return;
+  }
+  switch(value->type){
+    case eLeapValueType_Boolean: printf("  %-32s %s\n", key, value->boolValue ? "true" : "false"); break;
+    case eLeapValueType_Int32:   printf("  %-32s %d\n", key, value->iValue); break;
+    case eLeapValueType_Float:   printf("  %-32s %f\n", key, value->fValue); break;
+    case eLeapValueType_String:  printf("  %-32s \"%s\"\n", key, value->strValue); break;
+    default:                     printf("  %-32s (unknown type)\n", key); break;
+  }
+}
+
+int main(int argc, char** argv) {
+  const char **keys = defaultKeys;
+  int nKeys = (int)(sizeof(defaultKeys) / sizeof(defaultKeys[0]));
+  if(argc > 1){
+    keys = (const char **)&argv[1];
+    nKeys = argc - 1 < MAX_KEYS ? argc - 1 : MAX_KEYS;
+  }
+
+  LEAP_CONNECTION *connection = OpenConnection();
+  if(!WaitForConnection(5000)){
+    printf("No connection to the service.\n");
+    return 1;
+  }
+  ConfigClient *client = CreateConfigClient(*connection, 0);
+  SetConnectionConfigClient(client);
+
+  //One blocking round trip per key
+  ConfigValue value;
+  int64_t start = LeapGetNow();
+  for(int k = 0; k < nKeys; k++){
+    InvalidateConfigValue(client, keys[k]);
+    GetConfigValue(client, keys[k], &value, TIMEOUT_MS);
+  }
+  int64_t serialTime = LeapGetNow() - start;
+
+  //All requests in flight at once
+  ConfigFuture futures[MAX_KEYS];
+  start = LeapGetNow();
+  for(int k = 0; k < nKeys; k++){
+    InvalidateConfigValue(client, keys[k]);
+    RequestConfigValue(client, keys[k], &futures[k], NULL, NULL);
+  }
+  for(int k = 0; k < nKeys; k++){
+    WaitConfigFuture(client, &futures[k], TIMEOUT_MS);
+  }
+  int64_t parallelTime = LeapGetNow() - start;
+
+  //Served from the cache
+  start = LeapGetNow();
+  for(int k = 0; k < nKeys; k++){
+    GetConfigValue(client, keys[k], &value, TIMEOUT_MS);
+  }
+  int64_t cachedTime = LeapGetNow() - start;
+
+  printf("Values:\n");
+  for(int k = 0; k < nKeys; k++){
+    printValue(keys[k], futures[k].done && futures[k].ok, &futures[k].value);
+  }
+  printf("%d keys: serial %lld us, parallel %lld us, cached %lld us\n", nKeys,
+         (long long)serialTime, (long long)parallelTime, (long long)cachedTime);
+
+  ConfigClientStats stats;
+  GetConfigClientStats(client, &stats);
+  printf("Requests %llu, responses %llu, cache hits %llu, expired %llu\n",
+         (unsigned long long)stats.requests, (unsigned long long)stats.responses,
+         (unsigned long long)stats.cacheHits, (unsigned long long)stats.expired);
+
+  SetConnectionConfigClient(NULL);
+  CloseConnection();
+  DestroyConfigClient(client);
+  DestroyConnection();
+  return 0;
+}
+//End-of-Sample
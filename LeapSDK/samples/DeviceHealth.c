@@ -0,0 +1,513 @@
+/* Background sampler of device temperatures, framerates and status.
+ *
+ * The sampler thread calls LeapC without holding the lock, records the pass
+ * under it, and raises alerts after releasing it, so neither a slow service
+ * nor a slow callback holds up a query. Passes run on a fixed schedule; a
+ * pass that overruns delays the next one rather than causing a burst.
+ *
+ * The polling thread closes the registry's device handles when devices go,
+ * so the sampler opens a handle of its own for each attached device and
+ * closes it once the device is no longer listed.
+ *
+ */
+
+#include "DeviceHealth.h"
+#include "LeapThreads.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { AlertTemperature, AlertFramerate, AlertStatus, DeviceAlertKinds };
+
+typedef struct _AlertState {
+  uint32_t streak;
+  bool     raised;
+} AlertState;
+
+typedef struct _DeviceTrack {
+  uint32_t            device_id;      //0 while unused
+  DeviceHealthSample *ring;
+  uint64_t            count;
+  float               bestFramerate;
+  AlertState          alerts[DeviceAlertKinds];
+} DeviceTrack;
+
+//A device handle opened by the sampler thread, for that thread only
+typedef struct _SamplerDevice {
+  uint32_t    device_id;              //0 while unused
+  void       *ref;                    //LEAP_DEVICE_REF handle the device was opened from
+  LEAP_DEVICE handle;
+} SamplerDevice;
+
+struct _DeviceHealth {
+  DeviceHealthConfig    config;
+  LEAP_CONNECTION       connection;
+  const DeviceRegistry *registry;
+  SamplerDevice         opened[DEVICE_REGISTRY_SLOTS];
+  LockType              lock;
+  CondType              wake;
+  bool                  running;
+  ThreadType            thread;
+  DeviceTrack           tracks[DEVICE_REGISTRY_SLOTS];
+  AlertState            server;
+  DeviceHealthStats     stats;
+};
+
+void GetDefaultDeviceHealthConfig(DeviceHealthConfig *config){
+  memset(config, 0, sizeof(DeviceHealthConfig));
+  config->period_ms = 1000;
+  config->history = 3600;
+  config->server_status_every = 10;
+  config->server_timeout_ms = 500;
+  config->temperature_warning = 55.0f;
+  config->temperature_recover = 52.0f;
+  config->framerate_warning = 0.8f;
+  config->framerate_recover = 0.9f;
+  config->status_alert_mask = eLeapDeviceStatus_LowResource | eLeapDeviceStatus_Smudged;
+  config->alert_after = 3;
+  config->lower_priority = true;
+}
+
+/** Advances one alert by a sample; true when it is raised or cleared. */
+static bool updateAlert(const DeviceHealthConfig *config, AlertState *state, bool beyond, bool recovered){
+  if(!state->raised){
+    state->streak = beyond ? state->streak + 1 : 0;
+    if(state->streak >= config->alert_after){
+      state->raised = true;
+      return true;
+    }
+    return false;
+  }
+  if(recovered){
+    state->raised = false;
+    state->streak = 0;
+    return true;
+  }
+  return false;
+}
+
+static DeviceTrack* findTrack(DeviceHealth *health, uint32_t device_id){
+  for(int i = 0; i < DEVICE_REGISTRY_SLOTS; i++){
+    if(health->tracks[i].device_id == device_id){
+      return &health->tracks[i];
+    }
+  }
+  return NULL;
+}
+
+/** The track for device_id, taking an unused one or that of a device no longer attached. Call with lock held. */
+static DeviceTrack* claimTrack(DeviceHealth *health, uint32_t device_id, const uint32_t *attached, uint32_t attachedCount){
+  DeviceTrack *track = findTrack(health, device_id);
+  if(track){
+    return track;
+  }
+  DeviceTrack *reuse = NULL;
+  for(int i = 0; i < DEVICE_REGISTRY_SLOTS && !reuse; i++){
+    DeviceTrack *candidate = &health->tracks[i];
+    bool stillAttached = false;
+    for(uint32_t a = 0; a < attachedCount; a++){
+      stillAttached |= candidate->device_id == attached[a];
+    }
+    if(!candidate->device_id || !stillAttached){
+      reuse = candidate;
+    }
+  }
+  if(!reuse){
+    return NULL;
+  }
+  if(!reuse->ring){
+    reuse->ring = malloc((size_t)health->config.history * sizeof(DeviceHealthSample));
+    if(!reuse->ring){
+      return NULL;
+    }
+  }
+  DeviceHealthSample *ring = reuse->ring;
+  memset(reuse, 0, sizeof(DeviceTrack));
+  reuse->ring = ring;
+  reuse->device_id = device_id;
+  return reuse;
+}
+
+static const DeviceHealthSample* sampleAt(const DeviceHealth *health, const DeviceTrack *track, uint64_t index){
+  return &track->ring[index % health->config.history];
+}
+
+/** Adds a sample to its track and appends any alert it changes. Call with lock held. */
+static void recordSample(DeviceHealth *health, const DeviceHealthSample *sample, const uint32_t *attached,
+                         uint32_t attachedCount, DeviceHealthAlert *alerts, uint32_t *alertCount){
+  const DeviceHealthConfig *config = &health->config;
+  DeviceTrack *track = claimTrack(health, sample->device_id, attached, attachedCount);
+  if(!track){
+    return;
+  }
+  track->ring[track->count % config->history] = *sample;
+  track->count++;
+  health->stats.samples++;
+
+  float values[DeviceAlertKinds], thresholds[DeviceAlertKinds];
+  bool beyond[DeviceAlertKinds] = { false }, recovered[DeviceAlertKinds] = { false };
+  if(sample->temperature_count){
+    float hottest = sample->temperatures[0];
+    for(uint32_t t = 1; t < sample->temperature_count; t++){
+      hottest = sample->temperatures[t] > hottest ? sample->temperatures[t] : hottest;
+    }
+    values[AlertTemperature] = hottest;
+    thresholds[AlertTemperature] = config->temperature_warning;
+    beyond[AlertTemperature] = hottest > config->temperature_warning;
+    recovered[AlertTemperature] = hottest < config->temperature_recover;
+  } else {
+    //No reading: a raised alert stays raised.
+    values[AlertTemperature] = thresholds[AlertTemperature] = 0.0f;
+  }
+  //Devices that do not report a framerate are judged by their tracking framerate.
+  float framerate = sample->framerate > 0.0f ? sample->framerate : sample->tracking_framerate;
+  track->bestFramerate = framerate > track->bestFramerate ? framerate : track->bestFramerate;
+  values[AlertFramerate] = framerate;
+  thresholds[AlertFramerate] = config->framerate_warning * track->bestFramerate;
+  if(framerate > 0.0f){
+    beyond[AlertFramerate] = framerate < thresholds[AlertFramerate];
+    recovered[AlertFramerate] = framerate >= config->framerate_recover * track->bestFramerate;
+  }
+  //Failure codes are values from eLeapDeviceStatus_UnknownFailure up, not bits.
+  bool failed = (sample->status & config->status_alert_mask) != 0 || sample->status >= (uint32_t)eLeapDeviceStatus_UnknownFailure;
+  values[AlertStatus] = (float)sample->status;
+  thresholds[AlertStatus] = (float)config->status_alert_mask;
+  beyond[AlertStatus] = failed;
+  recovered[AlertStatus] = !failed;
+
+  static const eDeviceHealthAlert types[DeviceAlertKinds] = {
+    eDeviceHealthAlert_Temperature, eDeviceHealthAlert_Framerate, eDeviceHealthAlert_Status
+  };
+  for(int k = 0; k < DeviceAlertKinds; k++){
+    if(updateAlert(config, &track->alerts[k], beyond[k], recovered[k])){
+      DeviceHealthAlert *alert = &alerts[(*alertCount)++];
+      alert->timestamp = sample->timestamp;
+      alert->device_id = sample->device_id;
+      alert->type = types[k];
+      alert->raised = track->alerts[k].raised;
+      alert->value = values[k];
+      alert->threshold = thresholds[k];
+      if(alert->raised){
+        health->stats.alertsRaised++;
+      } else {
+        health->stats.alertsCleared++;
+      }
+    }
+  }
+}
+
+/** Closes the sampler's handles of devices no longer attached. */
+static void closeDetached(DeviceHealth *health, const uint32_t *attached, uint32_t attachedCount){
+  for(int i = 0; i < DEVICE_REGISTRY_SLOTS; i++){
+    SamplerDevice *device = &health->opened[i];
+    bool stillAttached = false;
+    for(uint32_t a = 0; a < attachedCount; a++){
+      stillAttached |= device->device_id == attached[a];
+    }
+    if(device->device_id && !stillAttached){
+      LeapCloseDevice(device->handle);
+      memset(device, 0, sizeof(SamplerDevice));
+    }
+  }
+}
+
+/** The sampler's own handle of the device, opened on first use and again if the device was replaced; NULL on failure. */
+static LEAP_DEVICE openedHandle(DeviceHealth *health, const DeviceSnapshot *snapshot){
+  SamplerDevice *spare = NULL;
+  for(int i = 0; i < DEVICE_REGISTRY_SLOTS; i++){
+    SamplerDevice *device = &health->opened[i];
+    if(device->device_id == snapshot->id){
+      if(device->ref == snapshot->ref.handle){
+        return device->handle;
+      }
+      LeapCloseDevice(device->handle);
+      memset(device, 0, sizeof(SamplerDevice));
+      spare = device;
+      break;
+    }
+    if(!device->device_id && !spare){
+      spare = device;
+    }
+  }
+  LEAP_DEVICE handle;
+  if(!spare || LeapOpenDevice(snapshot->ref, &handle) != eLeapRS_Success){
+    return NULL;
+  }
+  spare->device_id = snapshot->id;
+  spare->ref = snapshot->ref.handle;
+  spare->handle = handle;
+  return handle;
+}
+
+static void samplePass(DeviceHealth *health, uint64_t pass){
+  const DeviceHealthConfig *config = &health->config;
+  uint32_t attached[DEVICE_REGISTRY_SLOTS];
+  uint32_t attachedCount = GetAttachedDeviceIds(health->registry, attached, DEVICE_REGISTRY_SLOTS);
+  if(attachedCount > DEVICE_REGISTRY_SLOTS){
+    attachedCount = DEVICE_REGISTRY_SLOTS;
+  }
+  closeDetached(health, attached, attachedCount);
+  DeviceHealthSample samples[DEVICE_REGISTRY_SLOTS];
+  uint32_t sampleCount = 0;
+  uint64_t temperatureUnavailable = 0, framerateFailures = 0;
+  int64_t start = LeapGetNow();
+
+  for(uint32_t d = 0; d < attachedCount; d++){
+    DeviceSnapshot snapshot;
+    if(!GetDeviceSnapshot(health->registry, attached[d], &snapshot) || !snapshot.attached){
+      continue;
+    }
+    DeviceHealthSample *sample = &samples[sampleCount++];
+    memset(sample, 0, sizeof(DeviceHealthSample));
+    sample->device_id = snapshot.id;
+    sample->status = snapshot.info.status;
+    sample->tracking_framerate = snapshot.framerate;
+    LEAP_DEVICE handle = openedHandle(health, &snapshot);
+    //LeapC keeps the array only until the next call, so it is copied straight away.
+    const float *temperatures = NULL;
+    int found = 0;
+    if(handle && LeapGetDeviceTemperaturesEx(health->connection, handle, &temperatures, &found) == eLeapRS_Success && temperatures){
+      sample->temperature_count = found < DEVICE_HEALTH_MAX_TEMPERATURES ? (uint32_t)(found > 0 ? found : 0) : DEVICE_HEALTH_MAX_TEMPERATURES;
+      memcpy(sample->temperatures, temperatures, sample->temperature_count * sizeof(float));
+    } else {
+      temperatureUnavailable++;
+    }
+    if(!handle || LeapGetDeviceFrameRateEx(health->connection, handle, &sample->framerate) != eLeapRS_Success){
+      sample->framerate = 0.0f;
+      framerateFailures++;
+    }
+    sample->timestamp = LeapGetNow();
+  }
+
+  bool askedServer = config->server_status_every && pass % config->server_status_every == 0;
+  bool serverAnswered = false;
+  uint32_t serverDevices = 0;
+  char version[sizeof(health->stats.serverVersion)] = { 0 };
+  if(askedServer){
+    const LEAP_SERVER_STATUS *status = NULL;
+    if(LeapGetServerStatus(config->server_timeout_ms, &status) == eLeapRS_Success && status){
+      serverAnswered = true;
+      serverDevices = status->device_count;
+      if(status->version){
+        strncpy(version, status->version, sizeof(version) - 1);
+      }
+      LeapReleaseServerStatus(status);
+    }
+  }
+  int64_t elapsed = LeapGetNow() - start;
+
+  DeviceHealthAlert alerts[DEVICE_REGISTRY_SLOTS * DeviceAlertKinds + 1];
+  uint32_t alertCount = 0;
+  LockMutex(&health->lock);
+  for(uint32_t s = 0; s < sampleCount; s++){
+    recordSample(health, &samples[s], attached, attachedCount, alerts, &alertCount);
+  }
+  health->stats.passes++;
+  health->stats.temperatureUnavailable += temperatureUnavailable;
+  health->stats.framerateFailures += framerateFailures;
+  health->stats.sampleTime += elapsed;
+  health->stats.worstPass = elapsed > health->stats.worstPass ? elapsed : health->stats.worstPass;
+  if(askedServer){
+    health->stats.serverStatusCalls++;
+    if(!serverAnswered){
+      health->stats.serverStatusFailures++;
+    } else {
+      health->stats.serverDevices = serverDevices;
+      memcpy(health->stats.serverVersion, version, sizeof(version));
+      bool mismatch = serverDevices != attachedCount;
+      if(updateAlert(config, &health->server, mismatch, !mismatch)){
+        DeviceHealthAlert *alert = &alerts[alertCount++];
+        alert->timestamp = LeapGetNow();
+        alert->device_id = 0;
+        alert->type = eDeviceHealthAlert_ServerDevices;
+        alert->raised = health->server.raised;
+        alert->value = (float)serverDevices;
+        alert->threshold = (float)attachedCount;
+        if(alert->raised){
+          health->stats.alertsRaised++;
+        } else {
+          health->stats.alertsCleared++;
+        }
+      }
+    }
+  }
+  UnlockMutex(&health->lock);
+
+  if(config->callback){
+    for(uint32_t a = 0; a < alertCount; a++){
+      config->callback(&alerts[a], config->context);
+    }
+  }
+}
+
+static ThreadReturnType sampleLoop(void *arg){
+  DeviceHealth *health = (DeviceHealth*)arg;
+  if(health->config.lower_priority){
+    LowerThreadPriority();
+  }
+  int64_t next = LeapGetNow();
+  uint64_t pass = 0;
+  LockMutex(&health->lock);
+  while(health->running){
+    UnlockMutex(&health->lock);
+    samplePass(health, pass++);
+    LockMutex(&health->lock);
+    int64_t now = LeapGetNow();
+    next += (int64_t)health->config.period_ms * 1000;
+    if(next < now){
+      next = now;
+    }
+    while(health->running && now < next){
+      WaitCond(&health->wake, &health->lock, (uint32_t)((next - now + 999) / 1000));
+      now = LeapGetNow();
+    }
+  }
+  UnlockMutex(&health->lock);
+  closeDetached(health, NULL, 0);
+  return ThreadReturnValue;
+}
+
+DeviceHealth* CreateDeviceHealth(const DeviceHealthConfig *config, LEAP_CONNECTION connection,
+                                 const DeviceRegistry *registry){
+  DeviceHealthConfig defaults;
+  if(!config){
+    GetDefaultDeviceHealthConfig(&defaults);
+    config = &defaults;
+  }
+  if(config->period_ms == 0 || config->history < 2){
+    return NULL;
+  }
+  DeviceHealth *health = calloc(1, sizeof(DeviceHealth));
+  if(!health){
+    return NULL;
+  }
+  health->config = *config;
+  health->connection = connection;
+  health->registry = registry;
+  health->running = true;
+  InitLock(&health->lock);
+  InitCond(&health->wake);
+  if(registry && !StartThread(&health->thread, sampleLoop, health)){
+    DestroyCond(&health->wake);
+    DestroyLock(&health->lock);
+    free(health);
+    return NULL;
+  }
+  return health;
+}
+
+void DestroyDeviceHealth(DeviceHealth *health){
+  if(!health){
+    return;
+  }
+  if(health->registry){
+    LockMutex(&health->lock);
+    health->running = false;
+    SignalCond(&health->wake);
+    UnlockMutex(&health->lock);
+    JoinThread(health->thread);
+  }
+  for(int i = 0; i < DEVICE_REGISTRY_SLOTS; i++){
+    free(health->tracks[i].ring);
+  }
+  DestroyCond(&health->wake);
+  DestroyLock(&health->lock);
+  free(health);
+}
+
+void FeedDeviceHealth(DeviceHealth *health, const DeviceHealthSample *samples, uint32_t count){
+  uint32_t attached[DEVICE_REGISTRY_SLOTS];
+  uint32_t attachedCount = count < DEVICE_REGISTRY_SLOTS ? count : DEVICE_REGISTRY_SLOTS;
+  for(uint32_t s = 0; s < attachedCount; s++){
+    attached[s] = samples[s].device_id;
+  }
+  DeviceHealthAlert alerts[DEVICE_REGISTRY_SLOTS * DeviceAlertKinds];
+  uint32_t alertCount = 0;
+  LockMutex(&health->lock);
+  for(uint32_t s = 0; s < attachedCount; s++){
+    recordSample(health, &samples[s], attached, attachedCount, alerts, &alertCount);
+  }
+  health->stats.passes++;
+  UnlockMutex(&health->lock);
+
+  if(health->config.callback){
+    for(uint32_t a = 0; a < alertCount; a++){
+      health->config.callback(&alerts[a], health->config.context);
+    }
+  }
+}
+
+bool GetLatestDeviceHealth(DeviceHealth *health, uint32_t device_id, DeviceHealthSample *sample){
+  LockMutex(&health->lock);
+  const DeviceTrack *track = device_id ? findTrack(health, device_id) : NULL;
+  bool found = track && track->count;
+  if(found){
+    *sample = *sampleAt(health, track, track->count - 1);
+  }
+  UnlockMutex(&health->lock);
+  return found;
+}
+
+/** Index of the first sample newer than since. Call with lock held. */
+static uint64_t firstSince(const DeviceHealth *health, const DeviceTrack *track, int64_t since){
+  uint64_t lo = track->count > health->config.history ? track->count - health->config.history : 0, hi = track->count;
+  while(lo < hi){
+    uint64_t mid = lo + (hi - lo) / 2;
+    if(sampleAt(health, track, mid)->timestamp <= since){
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+uint32_t GetDeviceHealthHistory(DeviceHealth *health, uint32_t device_id, int64_t since,
+                                DeviceHealthSample *samples, uint32_t max){
+  LockMutex(&health->lock);
+  const DeviceTrack *track = device_id ? findTrack(health, device_id) : NULL;
+  uint32_t count = 0;
+  if(track){
+    for(uint64_t i = firstSince(health, track, since); i < track->count && count < max; i++){
+      samples[count++] = *sampleAt(health, track, i);
+    }
+  }
+  UnlockMutex(&health->lock);
+  return count;
+}
+
+bool CorrelateDeviceHealth(DeviceHealth *health, uint32_t device_id, int64_t since, float *correlation){
+  double n = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, syy = 0.0, sxy = 0.0;
+  LockMutex(&health->lock);
+  const DeviceTrack *track = device_id ? findTrack(health, device_id) : NULL;
+  for(uint64_t i = track ? firstSince(health, track, since) : 0; track && i < track->count; i++){
+    const DeviceHealthSample *sample = sampleAt(health, track, i);
+    if(!sample->temperature_count || sample->tracking_framerate <= 0.0f){
+      continue;
+    }
+    double x = sample->temperatures[0], y = sample->tracking_framerate;
+    for(uint32_t t = 1; t < sample->temperature_count; t++){
+      x = sample->temperatures[t] > x ? sample->temperatures[t] : x;
+    }
+    n += 1.0;
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    syy += y * y;
+    sxy += x * y;
+  }
+  UnlockMutex(&health->lock);
+  double vx = n * sxx - sx * sx, vy = n * syy - sy * sy;
+  if(n < 3.0 || vx <= 0.0 || vy <= 0.0){
+    return false;
+  }
+  *correlation = (float)((n * sxy - sx * sy) / sqrt(vx * vy));
+  return true;
+}
+
+void GetDeviceHealthStats(DeviceHealth *health, DeviceHealthStats *stats){
+  LockMutex(&health->lock);
+  *stats = health->stats;
+  UnlockMutex(&health->lock);
+}
+//End-of-DeviceHealth.c
@@ -0,0 +1,120 @@
+/* Background sampler of device temperatures, framerates and status.
+ *
+ * LeapGetDeviceTemperaturesEx(), LeapGetDeviceFrameRateEx() and
+ * LeapGetServerStatus() each ask the service, so calling them from the
+ * polling or render thread adds jitter there. CreateDeviceHealth() starts a
+ * thread that, every period_ms and below normal priority, samples each
+ * device the DeviceRegistry lists as attached:
+ *
+ *   - the temperatures and device framerate from LeapC;
+ *   - the status bits, as last set by eLeapEventType_DeviceStatusChange, and
+ *     the framerate of the latest tracking frame, from the registry without
+ *     asking the service.
+ *
+ * Every server_status_every samples it also calls LeapGetServerStatus() and
+ * checks that the service sees as many devices as are attached.
+ *
+ * Each device gets a ring of the last history samples. A threshold alert is
+ * raised after alert_after consecutive samples beyond it, and cleared once
+ * the value is back past the recover level, so a reading near the threshold
+ * does not flap. Alerts go to the callback on the sampler thread.
+ * CorrelateDeviceHealth() relates a device's temperature to its tracking
+ * framerate over its history, to show whether tracking slows as it heats.
+ *
+ * Queries may be called from any thread.
+ *
+ */
+
+#ifndef DeviceHealth_h
+#define DeviceHealth_h
+
+#include "LeapC.h"
+#include "DeviceRegistry.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEVICE_HEALTH_MAX_TEMPERATURES 4
+
+typedef enum _eDeviceHealthAlert {
+  eDeviceHealthAlert_Temperature,     //Hottest sensor above temperature_warning
+  eDeviceHealthAlert_Framerate,       //Device, or else tracking, framerate below framerate_warning of its best so far
+  eDeviceHealthAlert_Status,          //A status_alert_mask bit or a failure code in the status
+  eDeviceHealthAlert_ServerDevices    //The service reports a different number of devices than are attached
+} eDeviceHealthAlert;
+
+typedef struct _DeviceHealthAlert {
+  int64_t            timestamp;       //LeapGetNow() microseconds
+  uint32_t           device_id;       //0 for ServerDevices
+  eDeviceHealthAlert type;
+  bool               raised;          //False when the alert clears
+  float              value;           //Temperature, framerate, status or device count
+  float              threshold;
+} DeviceHealthAlert;
+
+typedef void (*device_health_callback)(const DeviceHealthAlert *alert, void *context);
+
+typedef struct _DeviceHealthConfig {
+  uint32_t period_ms;
+  uint32_t history;                   //Samples kept per device
+  uint32_t server_status_every;       //Samples between LeapGetServerStatus() calls; 0 for never
+  uint32_t server_timeout_ms;
+  float    temperature_warning;       //Degrees Celsius
+  float    temperature_recover;
+  float    framerate_warning;         //Fraction of the best framerate seen
+  float    framerate_recover;
+  uint32_t status_alert_mask;         //eLeapDeviceStatus bits that raise an alert
+  uint32_t alert_after;               //Consecutive samples beyond a threshold before it is raised
+  bool     lower_priority;            //Run the sampler below normal priority
+  device_health_callback callback;    //May be NULL
+  void    *context;
+} DeviceHealthConfig;
+
+typedef struct _DeviceHealthSample {
+  int64_t  timestamp;                 //LeapGetNow() microseconds
+  uint32_t device_id;
+  uint32_t status;                    //eLeapDeviceStatus
+  float    framerate;                 //From LeapGetDeviceFrameRateEx(); 0 if the device does not report it
+  float    tracking_framerate;        //Of the latest tracking frame
+  uint32_t temperature_count;         //0 when the service sends none
+  float    temperatures[DEVICE_HEALTH_MAX_TEMPERATURES];
+} DeviceHealthSample;
+
+typedef struct _DeviceHealthStats {
+  uint64_t samples;                   //Per device
+  uint64_t passes;
+  uint64_t temperatureUnavailable;
+  uint64_t framerateFailures;
+  uint64_t serverStatusCalls;
+  uint64_t serverStatusFailures;
+  uint64_t alertsRaised;
+  uint64_t alertsCleared;
+  int64_t  sampleTime;                //Microseconds spent in LeapC
+  int64_t  worstPass;                 //Microseconds, longest single pass
+  uint32_t serverDevices;             //As of the last LeapGetServerStatus()
+  char     serverVersion[32];
+} DeviceHealthStats;
+
+typedef struct _DeviceHealth DeviceHealth;
+
+void GetDefaultDeviceHealthConfig(DeviceHealthConfig *config);
+/*
+ * Starts sampling. registry must outlive the sampler, e.g. GetDeviceRegistry()
+ * after OpenConnection(); NULL for no sampler thread, only FeedDeviceHealth().
+ */
+DeviceHealth* CreateDeviceHealth(const DeviceHealthConfig *config, LEAP_CONNECTION connection,
+                                 const DeviceRegistry *registry);
+/* Stops the thread; call before the connection is closed. */
+void DestroyDeviceHealth(DeviceHealth *health);
+/* Records one pass of samples from elsewhere, such as a recording; its devices are taken as the attached ones.
+   Alerts go to the callback on the calling thread. */
+void FeedDeviceHealth(DeviceHealth *health, const DeviceHealthSample *samples, uint32_t count);
+
+bool GetLatestDeviceHealth(DeviceHealth *health, uint32_t device_id, DeviceHealthSample *sample);
+/* Copies up to max samples newer than since, oldest first. Returns the count. */
+uint32_t GetDeviceHealthHistory(DeviceHealth *health, uint32_t device_id, int64_t since,
+                                DeviceHealthSample *samples, uint32_t max);
+/* Pearson correlation of the hottest temperature with the tracking framerate since a time; false without enough samples. */
+bool CorrelateDeviceHealth(DeviceHealth *health, uint32_t device_id, int64_t since, float *correlation);
+void GetDeviceHealthStats(DeviceHealth *health, DeviceHealthStats *stats);
+
+#endif /* DeviceHealth_h */
@@ -0,0 +1,156 @@
+/* Feeds a DeviceHealth tracker ten minutes of synthetic samples, one a second.
+ *
+ * Device 1 heats from 40 to 60 degrees over five minutes and cools back, with
+ * half a degree of noise, and its tracking framerate falls 3 fps for every
+ * degree above 50. Device 2 stays at 45 degrees and 90 fps, apart from two
+ * readings of 70 degrees at 200 s, too few to raise an alert, and 5 s of
+ * Smudged status at 100 s. At 400 s device 2 is lost and devices 3 to 17
+ * appear, so one of them must take over its track. The alerts and totals are
+ * printed and checked, then the cost per sample.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "DeviceHealth.h"
+
+#define SECONDS 600
+#define LOST_AT 400
+#define LAST_NEW_DEVICE 17
+#define TIMING_ROUNDS 5
+
+static uint32_t seed = 4242;
+static float uniform(void){
+  seed = seed * 1664525u + 1013904223u;
+  return (float)(seed >> 8) / 16777216.0f;
+}
+
+typedef struct _AlertCounts {
+  uint32_t raised[LAST_NEW_DEVICE + 1][eDeviceHealthAlert_ServerDevices + 1];
+  uint32_t cleared[LAST_NEW_DEVICE + 1][eDeviceHealthAlert_ServerDevices + 1];
+} AlertCounts;
+
+static void onAlert(const DeviceHealthAlert *alert, void *context){
+  AlertCounts *counts = (AlertCounts*)context;
+  if(alert->device_id > LAST_NEW_DEVICE){
+    return;
+  }
+  if(alert->raised){
+    counts->raised[alert->device_id][alert->type]++;
+  } else {
+    counts->cleared[alert->device_id][alert->type]++;
+  }
+  if(alert->device_id <= 2){
+    printf("%3lld s: device %u %s alert %s at %.1f (threshold %.1f)\n", (long long)(alert->timestamp / 1000000),
+           alert->device_id, alert->type == eDeviceHealthAlert_Temperature ? "temperature" :
+           alert->type == eDeviceHealthAlert_Framerate ? "framerate" : "status",
+           alert->raised ? "raised" : "cleared", alert->value, alert->threshold);
+  }
+}
+
+static void fillSample(DeviceHealthSample *sample, int64_t timestamp, uint32_t device_id, float temperature,
+                       float tracking_framerate, uint32_t status){
+  memset(sample, 0, sizeof(DeviceHealthSample));
+  sample->timestamp = timestamp;
+  sample->device_id = device_id;
+  sample->status = status;
+  sample->tracking_framerate = tracking_framerate;
+  sample->temperature_count = 1;
+  sample->temperatures[0] = temperature;
+}
+
+/* Runs the ten minutes through health; returns the samples fed. */
+static uint64_t run(DeviceHealth *health){
+  DeviceHealthSample samples[LAST_NEW_DEVICE];
+  uint64_t fed = 0;
+  for(int second = 0; second < SECONDS; second++){
+    int64_t now = (int64_t)second * 1000000;
+    uint32_t count = 0;
+
+    float heat = second < SECONDS / 2 ? (float)second / (SECONDS / 2) : (float)(SECONDS - second) / (SECONDS / 2);
+    float temperature = 40.0f + 20.0f * heat + uniform() - 0.5f;
+    float framerate = 90.0f - 3.0f * (temperature > 50.0f ? temperature - 50.0f : 0.0f);
+    fillSample(&samples[count++], now, 1, temperature, framerate, eLeapDeviceStatus_Streaming);
+
+    if(second < LOST_AT){
+      float steady = second == 200 || second == 201 ? 70.0f : 45.0f + uniform() - 0.5f;
+      uint32_t status = eLeapDeviceStatus_Streaming;
+      if(second >= 100 && second < 105){
+        status |= eLeapDeviceStatus_Smudged;
+      }
+      fillSample(&samples[count++], now, 2, steady, 90.0f, status);
+    } else {
+      for(uint32_t id = 3; id <= LAST_NEW_DEVICE; id++){
+        fillSample(&samples[count++], now, id, 45.0f, 90.0f, eLeapDeviceStatus_Streaming);
+      }
+    }
+    FeedDeviceHealth(health, samples, count);
+    fed += count;
+  }
+  return fed;
+}
+
+static int check(bool passed, const char *what){
+  printf("%s: %s\n", passed ? "ok" : "FAILED", what);
+  return passed ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  AlertCounts counts;
+  memset(&counts, 0, sizeof(counts));
+  DeviceHealthConfig config;
+  GetDefaultDeviceHealthConfig(&config);
+  config.callback = onAlert;
+  config.context = &counts;
+  DeviceHealth *health = CreateDeviceHealth(&config, NULL, NULL);
+  if(!health){
+    printf("Failed to create the tracker.\n");
+    return 1;
+  }
+  run(health);
+
+  DeviceHealthStats stats;
+  GetDeviceHealthStats(health, &stats);
+  printf("%llu passes, %llu samples, %llu alerts raised, %llu cleared\n",
+         (unsigned long long)stats.passes, (unsigned long long)stats.samples,
+         (unsigned long long)stats.alertsRaised, (unsigned long long)stats.alertsCleared);
+  float correlation = 0.0f;
+  bool correlated = CorrelateDeviceHealth(health, 1, -1, &correlation);
+  printf("Device 1 temperature against tracking framerate: %.3f\n", correlation);
+  DeviceHealthSample latest;
+
+  int failures = 0;
+  failures += check(counts.raised[1][eDeviceHealthAlert_Temperature] == 1 &&
+                    counts.cleared[1][eDeviceHealthAlert_Temperature] == 1,
+                    "device 1 temperature alert raised and cleared once despite noise");
+  failures += check(counts.raised[1][eDeviceHealthAlert_Framerate] == 1 &&
+                    counts.cleared[1][eDeviceHealthAlert_Framerate] == 1,
+                    "device 1 framerate alert raised and cleared once");
+  failures += check(counts.raised[2][eDeviceHealthAlert_Temperature] == 0,
+                    "two hot readings on device 2 raise no alert");
+  failures += check(counts.raised[2][eDeviceHealthAlert_Status] == 1 &&
+                    counts.cleared[2][eDeviceHealthAlert_Status] == 1,
+                    "device 2 status alert raised and cleared once");
+  failures += check(!GetLatestDeviceHealth(health, 2, &latest), "lost device 2 gave up its track");
+  failures += check(GetLatestDeviceHealth(health, LAST_NEW_DEVICE, &latest) &&
+                    latest.timestamp == (SECONDS - 1) * 1000000LL, "device 17 took it over");
+  failures += check(correlated && correlation < -0.8f, "device 1 slows as it heats");
+  DestroyDeviceHealth(health);
+
+  config.callback = NULL;
+  int64_t best = INT64_MAX;
+  uint64_t fed = 0;
+  for(int round = 0; round < TIMING_ROUNDS; round++){
+    health = CreateDeviceHealth(&config, NULL, NULL);
+    int64_t start = LeapGetNow();
+    fed = run(health);
+    int64_t elapsed = LeapGetNow() - start;
+    best = elapsed < best ? elapsed : best;
+    DestroyDeviceHealth(health);
+  }
+  printf("%.1f ns per sample, including the synthetic source\n", best * 1000.0 / fed);
+  return failures ? 1 : 0;
+}
+//End-of-Sample
@@ -0,0 +1,79 @@
+/* Watches device temperatures, framerates and status in the background.
+ *
+ * Alerts are printed as they are raised and cleared. Every ten seconds the
+ * latest sample of each attached device is printed with how its temperature
+ * has related to its tracking framerate so far. Temperatures are only sent
+ * by the service when "temperature_query_interval_ms" is set in
+ * hand_tracker_config.json.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "LeapC.h"
+#include "ExampleConnection.h"
+#include "DeviceHealth.h"
+#include "DeviceRegistry.h"
+
+static const char* alertName(eDeviceHealthAlert type){
+  switch(type){
+    case eDeviceHealthAlert_Temperature:   return "temperature";
+    case eDeviceHealthAlert_Framerate:     return "framerate";
+    case eDeviceHealthAlert_Status:        return "status";
+    case eDeviceHealthAlert_ServerDevices: return "service device count";
+    default:                               return "unknown";
+  }
+}
+
+static void onAlert(const DeviceHealthAlert *alert, void *context){
+  (void)context;
+  printf("Device %u %s alert %s: %.1f against %.1f\n", alert->device_id, alertName(alert->type),
+         alert->raised ? "raised" : "cleared", alert->value, alert->threshold);
+}
+
+int main(int argc, char** argv) {
+  LEAP_CONNECTION *connection = OpenConnection();
+  if(!WaitForConnection(5000)){
+    printf("No connection to the service.\n");
+    return 1;
+  }
+  WaitForDevice(2000);
+
+  DeviceHealthConfig config;
+  GetDefaultDeviceHealthConfig(&config);
+  config.callback = onAlert;
+  DeviceHealth *health = CreateDeviceHealth(&config, *connection, GetDeviceRegistry());
+  if(!health){
+    printf("Failed to start the health sampler.\n");
+    return 1;
+  }
+
+  for(;;){
+    millisleep(10000);
+    uint32_t ids[DEVICE_REGISTRY_SLOTS];
+    uint32_t count = GetAttachedDeviceIds(GetDeviceRegistry(), ids, DEVICE_REGISTRY_SLOTS);
+    for(uint32_t d = 0; d < count; d++){
+      DeviceHealthSample sample;
+      if(!GetLatestDeviceHealth(health, ids[d], &sample)){
+        continue;
+      }
+      printf("Device %u: status 0x%08x, %.1f fps from the device, %.1f fps tracking", sample.device_id,
+             sample.status, sample.framerate, sample.tracking_framerate);
+      for(uint32_t t = 0; t < sample.temperature_count; t++){
+        printf(", %.1f C", sample.temperatures[t]);
+      }
+      float correlation;
+      if(CorrelateDeviceHealth(health, ids[d], 0, &correlation)){
+        printf(", temperature to framerate correlation %.2f", correlation);
+      }
+      printf("\n");
+    }
+    DeviceHealthStats stats;
+    GetDeviceHealthStats(health, &stats);
+    printf("%llu passes, %.2f ms each in LeapC on average, %.2f ms worst; service %s with %u devices\n",
+           (unsigned long long)stats.passes, stats.passes ? stats.sampleTime / 1000.0 / stats.passes : 0.0,
+           stats.worstPass / 1000.0, stats.serverVersion[0] ? stats.serverVersion : "unknown", stats.serverDevices);
+  } //ctrl-c to exit
+  return 0;
+}
+//End-of-Sample
@@ -0,0 +1,353 @@
+/* Registry of the devices attached to a connection, keyed by device ID.
+ *
+ * A slot is claimed for a device ID by writing its key and then setting used.
+ * Removing a device clears used only at the end of a run of used slots, and
+ * then for any lost devices just before it, or everywhere once no device is
+ * attached, so a probe sequence is never cut short and lookups need no
+ * tombstones. A lost device elsewhere keeps its slot and key until a new
+ * device reuses it, which a reader notices because the snapshot's id then
+ * differs.
+ *
+ */
+
+#include "DeviceRegistry.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOT_MASK (DEVICE_REGISTRY_SLOTS - 1)
+#define SERIAL_STACK_BYTES 64
+
+typedef struct _DeviceSlot {
+  atomic_uint    sequence;                  //Odd while the polling thread writes the record
+  atomic_uint    key;
+  atomic_bool    used;
+  DeviceSnapshot record;
+} DeviceSlot;
+
+struct _DeviceRegistry {
+  DeviceSlot slots[DEVICE_REGISTRY_SLOTS];
+  char       serials[DEVICE_REGISTRY_SERIAL_BYTES];
+  size_t     serialBytesUsed;
+};
+
+static DeviceSlot* findSlot(const DeviceRegistry *registry, uint32_t device_id){
+  DeviceSlot *slots = (DeviceSlot*)registry->slots;
+  for(uint32_t probe = 0; probe < DEVICE_REGISTRY_SLOTS; probe++){
+    DeviceSlot *slot = &slots[(device_id + probe) & SLOT_MASK];
+    if(!atomic_load_explicit(&slot->used, memory_order_acquire)){
+      return NULL;
+    }
+    if(atomic_load_explicit(&slot->key, memory_order_relaxed) == device_id){
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+/** The first slot on device_id's probe sequence that is empty or holds a lost device. */
+static DeviceSlot* freeSlot(DeviceRegistry *registry, uint32_t device_id){
+  for(uint32_t probe = 0; probe < DEVICE_REGISTRY_SLOTS; probe++){
+    DeviceSlot *slot = &registry->slots[(device_id + probe) & SLOT_MASK];
+    if(!atomic_load_explicit(&slot->used, memory_order_relaxed) || !slot->record.attached){
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+static void beginWrite(DeviceSlot *slot){
+  unsigned int sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+  atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static void endWrite(DeviceSlot *slot){
+  unsigned int sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+  atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_release);
+}
+
+static void readSlot(const DeviceSlot *slot, DeviceSnapshot *snapshot){
+  DeviceSlot *s = (DeviceSlot*)slot;
+  for(;;){
+    unsigned int before = atomic_load_explicit(&s->sequence, memory_order_acquire);
+    if(before & 1u){
+      continue;
+    }
+    memcpy(snapshot, &s->record, sizeof(*snapshot));
+    atomic_thread_fence(memory_order_acquire);
+    if(atomic_load_explicit(&s->sequence, memory_order_relaxed) == before){
+      return;
+    }
+  }
+}
+
+static bool readTransform(LEAP_DEVICE handle, float transform[16]){
+  return LeapDeviceTransformAvailable(handle) && LeapGetDeviceTransform(handle, transform) == eLeapRS_Success;
+}
+
+/**
+ * Returns the registry's copy of serial, or NULL once the space for serials
+ * is spent. Copies are never freed, so a device seen again reuses its earlier
+ * copy, even after its slot has gone to another device.
+ */
+static char* internSerial(DeviceRegistry *registry, const char *serial){
+  for(size_t offset = 0; offset < registry->serialBytesUsed; offset += strlen(registry->serials + offset) + 1){
+    if(strcmp(registry->serials + offset, serial) == 0){
+      return registry->serials + offset;
+    }
+  }
+  size_t length = strlen(serial) + 1;
+  if(registry->serialBytesUsed + length > DEVICE_REGISTRY_SERIAL_BYTES){
+    return NULL;
+  }
+  char *copy = registry->serials + registry->serialBytesUsed;
+  memcpy(copy, serial, length);
+  registry->serialBytesUsed += length;
+  return copy;
+}
+
+DeviceRegistry* CreateDeviceRegistry(void){
+  return calloc(1, sizeof(DeviceRegistry));
+}
+
+/** Closes the devices still attached. */
+void DestroyDeviceRegistry(DeviceRegistry *registry){
+  if(!registry){
+    return;
+  }
+  for(uint32_t i = 0; i < DEVICE_REGISTRY_SLOTS; i++){
+    if(registry->slots[i].record.attached){
+      LeapCloseDevice(registry->slots[i].record.handle);
+    }
+  }
+  free(registry);
+}
+
+/**
+ * Opens the device of a device event and records its info and transform.
+ * The device stays open until RemoveDevice(). snapshot, if not NULL,
+ * receives the new record.
+ */
+eLeapRS RegisterDevice(DeviceRegistry *registry, const LEAP_DEVICE_EVENT *event, DeviceSnapshot *snapshot){
+  LEAP_DEVICE handle;
+  eLeapRS result = LeapOpenDevice(event->device, &handle);
+  if(result != eLeapRS_Success){
+    return result;
+  }
+
+  //Serial numbers are short; the heap is only needed if one ever outgrows the stack buffer
+  char serial[SERIAL_STACK_BYTES];
+  char *longSerial = NULL;
+  LEAP_DEVICE_INFO info;
+  memset(&info, 0, sizeof(info));
+  info.size = sizeof(info);
+  info.serial = serial;
+  info.serial_length = sizeof(serial);
+  result = LeapGetDeviceInfo(handle, &info);
+  if(result == eLeapRS_InsufficientBuffer){
+    longSerial = malloc(info.serial_length);
+    if(!longSerial){
+      LeapCloseDevice(handle);
+      return eLeapRS_InsufficientResources;
+    }
+    info.serial = longSerial;
+    result = LeapGetDeviceInfo(handle, &info);
+  }
+
+  uint32_t id = event->device.id;
+  DeviceSlot *slot = findSlot(registry, id);
+  if(!slot){
+    slot = freeSlot(registry, id);
+  }
+  char *interned = NULL;
+  if(result == eLeapRS_Success && (!slot || !(interned = internSerial(registry, info.serial)))){
+    result = eLeapRS_InsufficientResources;
+  }
+  if(result != eLeapRS_Success){
+    free(longSerial);
+    LeapCloseDevice(handle);
+    return result;
+  }
+  info.serial = interned;
+  info.serial_length = (uint32_t)strlen(info.serial) + 1;
+  free(longSerial);
+
+  float transform[16];
+  bool hasTransform = readTransform(handle, transform);
+
+  //A repeated device event for an attached device replaces its handle
+  if(slot->record.attached && atomic_load_explicit(&slot->key, memory_order_relaxed) == id){
+    LeapCloseDevice(slot->record.handle);
+  }
+  beginWrite(slot);
+  atomic_store_explicit(&slot->key, id, memory_order_relaxed);
+  slot->record.id = id;
+  slot->record.attached = true;
+  slot->record.ref = event->device;
+  slot->record.handle = handle;
+  slot->record.info = info;
+  slot->record.info.status = event->status;
+  slot->record.framerate = 0;
+  slot->record.hasTransform = hasTransform;
+  if(hasTransform){
+    memcpy(slot->record.transform, transform, sizeof(transform));
+  }
+  endWrite(slot);
+  atomic_store_explicit(&slot->used, true, memory_order_release);
+
+  if(snapshot){
+    *snapshot = slot->record;
+  }
+  return eLeapRS_Success;
+}
+
+/** Frees the lost device's slot at index, and those of lost devices before it, while each ends a run of used slots. */
+static void releaseSlots(DeviceRegistry *registry, uint32_t index){
+  //A table with every slot used has no run end; once all its devices are lost it can be emptied
+  bool anyAttached = false;
+  for(uint32_t i = 0; i < DEVICE_REGISTRY_SLOTS && !anyAttached; i++){
+    anyAttached = registry->slots[i].record.attached;
+  }
+  if(!anyAttached){
+    for(uint32_t i = 0; i < DEVICE_REGISTRY_SLOTS; i++){
+      atomic_store_explicit(&registry->slots[i].used, false, memory_order_release);
+    }
+    return;
+  }
+  for(uint32_t n = 0; n < DEVICE_REGISTRY_SLOTS; n++, index = (index - 1) & SLOT_MASK){
+    DeviceSlot *slot = &registry->slots[index];
+    const DeviceSlot *next = &registry->slots[(index + 1) & SLOT_MASK];
+    if(!atomic_load_explicit(&slot->used, memory_order_relaxed) || slot->record.attached ||
+       atomic_load_explicit(&next->used, memory_order_relaxed)){
+      return;
+    }
+    atomic_store_explicit(&slot->used, false, memory_order_release);
+  }
+}
+
+/**
+ * Closes a lost device and frees its slot where the probe sequences allow.
+ * Otherwise its record stays readable, with attached false, until the slot is
+ * reused.
+ */
+void RemoveDevice(DeviceRegistry *registry, uint32_t device_id){
+  DeviceSlot *slot = findSlot(registry, device_id);
+  if(!slot || !slot->record.attached){
+    return;
+  }
+  LeapCloseDevice(slot->record.handle);
+  beginWrite(slot);
+  slot->record.attached = false;
+  slot->record.handle = NULL;
+  endWrite(slot);
+  releaseSlots(registry, (uint32_t)(slot - registry->slots));
+}
+
+void UpdateDeviceStatus(DeviceRegistry *registry, const LEAP_DEVICE_STATUS_CHANGE_EVENT *event){
+  DeviceSlot *slot = findSlot(registry, event->device.id);
+  if(!slot || !slot->record.attached){
+    return;
+  }
+  beginWrite(slot);
+  slot->record.info.status = event->status;
+  endWrite(slot);
+}
+
+/** Called for every tracking frame; only writes the record when the framerate changes. */
+void UpdateDeviceFramerate(DeviceRegistry *registry, uint32_t device_id, float framerate){
+  DeviceSlot *slot = findSlot(registry, device_id);
+  if(!slot || !slot->record.attached || slot->record.framerate == framerate){
+    return;
+  }
+  beginWrite(slot);
+  slot->record.framerate = framerate;
+  endWrite(slot);
+}
+
+static void refreshSlotTransform(DeviceSlot *slot){
+  float transform[16];
+  bool hasTransform = readTransform(slot->record.handle, transform);
+  beginWrite(slot);
+  slot->record.hasTransform = hasTransform;
+  if(hasTransform){
+    memcpy(slot->record.transform, transform, sizeof(transform));
+  }
+  endWrite(slot);
+}
+
+/**
+ * Rereads the transform after eLeapEventType_NewDeviceTransform. A device_id
+ * of 0, a system-wide message, refreshes every attached device.
+ */
+void RefreshDeviceTransform(DeviceRegistry *registry, uint32_t device_id){
+  if(device_id){
+    DeviceSlot *slot = findSlot(registry, device_id);
+    if(slot && slot->record.attached){
+      refreshSlotTransform(slot);
+    }
+    return;
+  }
+  for(uint32_t i = 0; i < DEVICE_REGISTRY_SLOTS; i++){
+    DeviceSlot *slot = &registry->slots[i];
+    if(atomic_load_explicit(&slot->used, memory_order_relaxed) && slot->record.attached){
+      refreshSlotTransform(slot);
+    }
+  }
+}
+
+/**
+ * Copies the cached transform of an attached device, without a lock or a
+ * LeapC call. Returns false if the device is unknown, lost or has none.
+ */
+bool GetCachedDeviceTransform(const DeviceRegistry *registry, uint32_t device_id, float transform[16]){
+  DeviceSlot *slot = findSlot(registry, device_id);
+  if(!slot){
+    return false;
+  }
+  for(;;){
+    unsigned int before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if(before & 1u){
+      continue;
+    }
+    bool valid = slot->record.id == device_id && slot->record.attached && slot->record.hasTransform;
+    if(valid){
+      memcpy(transform, slot->record.transform, sizeof(slot->record.transform));
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if(atomic_load_explicit(&slot->sequence, memory_order_relaxed) == before){
+      return valid;
+    }
+  }
+}
+
+/** Copies the record of device_id, attached or lost. Returns false for an unknown device or a freed slot. */
+bool GetDeviceSnapshot(const DeviceRegistry *registry, uint32_t device_id, DeviceSnapshot *snapshot){
+  const DeviceSlot *slot = findSlot(registry, device_id);
+  if(!slot){
+    return false;
+  }
+  readSlot(slot, snapshot);
+  return snapshot->id == device_id;
+}
+
+/** Fills device_ids with up to max_ids attached devices and returns how many there are. */
+uint32_t GetAttachedDeviceIds(const DeviceRegistry *registry, uint32_t *device_ids, uint32_t max_ids){
+  uint32_t count = 0;
+  DeviceSnapshot snapshot;
+  for(uint32_t i = 0; i < DEVICE_REGISTRY_SLOTS; i++){
+    const DeviceSlot *slot = &registry->slots[i];
+    if(!atomic_load_explicit((atomic_bool*)&slot->used, memory_order_acquire)){
+      continue;
+    }
+    readSlot(slot, &snapshot);
+    if(snapshot.attached){
+      if(count < max_ids){
+        device_ids[count] = snapshot.id;
+      }
+      count++;
+    }
+  }
+  return count;
+}
+//End-of-DeviceRegistry.c
@@ -0,0 +1,61 @@
+/* Registry of the devices attached to a connection, keyed by device ID.
+ *
+ * The polling thread registers a device when its eLeapEventType_Device
+ * arrives: the device is opened once and kept open, and its LEAP_DEVICE_INFO
+ * is read once into the registry together with the transform. Status changes
+ * and the tracking framerate are written into the same record as their
+ * messages arrive, and the transform is read again only when LeapC reports
+ * eLeapEventType_NewDeviceTransform, so nothing has to ask LeapC for device
+ * properties per frame.
+ *
+ * Records live in a fixed open-addressed table indexed by device ID. Each
+ * record is guarded by a seqlock with the polling thread as its only writer:
+ * any thread can take a consistent snapshot of a device, or look one up per
+ * message, without a lock or an allocation. Serial numbers are interned in
+ * the registry, so info.serial in a snapshot stays valid until the registry
+ * is destroyed, even after the device is lost. Once DEVICE_REGISTRY_SERIAL_BYTES
+ * of distinct serials have been seen, registering a new one fails with
+ * eLeapRS_InsufficientResources.
+ *
+ */
+
+#ifndef DeviceRegistry_h
+#define DeviceRegistry_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEVICE_REGISTRY_SLOTS 16            //Power of two; lost devices' slots are reused
+#define DEVICE_REGISTRY_SERIAL_BYTES 1024
+
+typedef struct _DeviceRegistry DeviceRegistry;
+
+/** A consistent copy of one device's record. */
+typedef struct _DeviceSnapshot {
+  uint32_t         id;
+  bool             attached;                //False once the device has been lost
+  LEAP_DEVICE_REF  ref;                     //For other threads to open a handle of their own
+  LEAP_DEVICE      handle;                  //Open while attached; polling thread only, as it closes it
+  LEAP_DEVICE_INFO info;                    //info.status follows DeviceStatusChange events
+  float            framerate;               //Of the device's latest tracking frame
+  bool             hasTransform;
+  float            transform[16];
+} DeviceSnapshot;
+
+DeviceRegistry* CreateDeviceRegistry(void);
+void DestroyDeviceRegistry(DeviceRegistry *registry);
+
+/* For the polling thread */
+eLeapRS RegisterDevice(DeviceRegistry *registry, const LEAP_DEVICE_EVENT *event, DeviceSnapshot *snapshot);
+void RemoveDevice(DeviceRegistry *registry, uint32_t device_id);
+void UpdateDeviceStatus(DeviceRegistry *registry, const LEAP_DEVICE_STATUS_CHANGE_EVENT *event);
+void UpdateDeviceFramerate(DeviceRegistry *registry, uint32_t device_id, float framerate);
+void RefreshDeviceTransform(DeviceRegistry *registry, uint32_t device_id);
+
+/* For any thread */
+bool GetDeviceSnapshot(const DeviceRegistry *registry, uint32_t device_id, DeviceSnapshot *snapshot);
+bool GetCachedDeviceTransform(const DeviceRegistry *registry, uint32_t device_id, float transform[16]);
+uint32_t GetAttachedDeviceIds(const DeviceRegistry *registry, uint32_t *device_ids, uint32_t max_ids);
+
+#endif /* DeviceRegistry_h */
@@ -59,10 +59,10 @@ static void OnFrame(const LEAP_TRACKING_EVENT* frame)
    * The device transform may not be available if no default is detected,
    * and a custom one has not been set.
    *
-   * Note: If the result of LeapGetDeviceTransform() needs to be cached
-   * for any reason, the developer can poll for events of type
-   * 'eLeapEventType_NewDeviceTransform' to be aware of when to update
-   * their cache.
+   * Note: GetDeviceTransform() returns a cached copy of the result of
+   * LeapGetDeviceTransform(). ExampleConnection refreshes it when it polls
+   * an event of type 'eLeapEventType_NewDeviceTransform', so calling it
+   * for every frame is cheap.
    */
   if (GetDeviceTransform(buffer))
   {
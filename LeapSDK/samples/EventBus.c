@@ -0,0 +1,384 @@
+/* Publish/subscribe bus for LeapC events.
+ *
+ * Queues are bounded MPMC rings with per-cell sequence numbers. Only the
+ * publisher enqueues, but it also dequeues when it has to discard the oldest
+ * event, so both ends use the multi-consumer protocol. Coalescing subscribers
+ * get one seqlock-protected mailbox per event type instead of a ring.
+ *
+ */
+
+#include "EventBus.h"
+#include "LeapThreads.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _BusCell {
+  atomic_size_t sequence;
+  BusEvent      event;
+} BusCell;
+
+typedef struct _BusMailbox {
+  atomic_uint   version;   //Odd while the publisher is writing
+  BusEvent      event;
+} BusMailbox;
+
+struct _BusSubscriber {
+  uint32_t           mask;
+  eBusOverflowPolicy policy;
+
+  //Ring queue, used by DropOldest and DropNewest
+  BusCell           *cells;
+  size_t             cellMask;
+  atomic_size_t      enqueuePos;
+  atomic_size_t      dequeuePos;
+
+  //Mailboxes, used by CoalesceLatest
+  BusMailbox        *mailboxes;
+  atomic_uint        pending;
+  uint64_t           delivered[BUS_EVENT_BITS];
+
+  //Wakeup for WaitBusEvent(); the publisher only takes the lock when someone waits
+  atomic_int         waiting;
+  LockType           waitLock;
+  CondType           waitCond;
+
+  atomic_uint_fast64_t published;
+  atomic_uint_fast64_t dropped;
+  atomic_uint_fast64_t received;
+};
+
+struct _EventBus {
+  _Atomic(BusSubscriber*) subscribers[BUS_MAX_SUBSCRIBERS];
+  atomic_uint             publishEpoch; //Odd while PublishBusMessage() walks the list
+  uint64_t                sequence;
+};
+
+static uint32_t eventBitIndex(uint32_t bit){
+  uint32_t index = 0;
+  while(!(bit & 1u)){
+    bit >>= 1;
+    index++;
+  }
+  return index;
+}
+
+static void copyMessage(BusEvent *dst, const LEAP_CONNECTION_MESSAGE *msg, uint64_t sequence){
+  dst->type = msg->type;
+  dst->device_id = msg->device_id;
+  dst->sequence = sequence;
+  switch(msg->type){
+    case eLeapEventType_Tracking: {
+      const LEAP_TRACKING_EVENT *src = msg->tracking_event;
+      uint32_t nHands = src->nHands < BUS_MAX_HANDS ? src->nHands : BUS_MAX_HANDS;
+      dst->tracking.event.info = src->info;
+      dst->tracking.event.tracking_frame_id = src->tracking_frame_id;
+      dst->tracking.event.nHands = nHands;
+      dst->tracking.event.framerate = src->framerate;
+      dst->tracking.event.pHands = NULL;
+      memcpy(dst->tracking.hands, src->pHands, nHands * sizeof(LEAP_HAND));
+      break;
+    }
+    case eLeapEventType_Connection:         dst->connection = *msg->connection_event; break;
+    case eLeapEventType_ConnectionLost:     dst->connection_lost = *msg->connection_lost_event; break;
+    case eLeapEventType_Device:
+    case eLeapEventType_DeviceLost:         dst->device = *msg->device_event; break;
+    case eLeapEventType_DeviceFailure:      dst->device_failure = *msg->device_failure_event; break;
+    case eLeapEventType_DeviceStatusChange: dst->device_status_change = *msg->device_status_change_event; break;
+    case eLeapEventType_Policy:             dst->policy = *msg->policy_event; break;
+    case eLeapEventType_TrackingMode:       dst->tracking_mode = *msg->tracking_mode_event; break;
+    case eLeapEventType_DroppedFrame:       dst->dropped_frame = *msg->dropped_frame_event; break;
+    case eLeapEventType_HeadPose:           dst->head_pose = *msg->head_pose_event; break;
+    case eLeapEventType_Eyes:               dst->eye = *msg->eye_event; break;
+    case eLeapEventType_IMU:                dst->imu = *msg->imu_event; break;
+    case eLeapEventType_NewDeviceTransform: dst->new_device_transform = *msg->new_device_transform_event; break;
+    case eLeapEventType_Fiducial:
+      dst->fiducial_pose = *msg->fiducial_pose_event;
+      dst->fiducial_pose.family = NULL;
+      break;
+    default:
+      break;
+  }
+}
+
+/** Copies a queued event out, re-pointing the tracking hands at the destination. */
+static void copyEvent(BusEvent *dst, const BusEvent *src){
+  if(src->type == eLeapEventType_Tracking){
+    uint32_t nHands = src->tracking.event.nHands < BUS_MAX_HANDS ? src->tracking.event.nHands : BUS_MAX_HANDS;
+    dst->type = src->type;
+    dst->device_id = src->device_id;
+    dst->sequence = src->sequence;
+    dst->tracking.event = src->tracking.event;
+    memcpy(dst->tracking.hands, src->tracking.hands, nHands * sizeof(LEAP_HAND));
+    dst->tracking.event.nHands = nHands;
+    dst->tracking.event.pHands = dst->tracking.hands;
+  } else {
+    *dst = *src;
+  }
+}
+
+EventBus* CreateEventBus(void){
+  EventBus *bus = calloc(1, sizeof(EventBus));
+  if(!bus){
+    return NULL;
+  }
+  for(int i = 0; i < BUS_MAX_SUBSCRIBERS; i++){
+    atomic_init(&bus->subscribers[i], NULL);
+  }
+  atomic_init(&bus->publishEpoch, 0);
+  return bus;
+}
+
+static void freeSubscriber(BusSubscriber *subscriber){
+  DestroyCond(&subscriber->waitCond);
+  DestroyLock(&subscriber->waitLock);
+  free(subscriber->cells);
+  free(subscriber->mailboxes);
+  free(subscriber);
+}
+
+void DestroyEventBus(EventBus *bus){
+  if(!bus){
+    return;
+  }
+  for(int i = 0; i < BUS_MAX_SUBSCRIBERS; i++){
+    BusSubscriber *subscriber = atomic_load(&bus->subscribers[i]);
+    if(subscriber){
+      freeSubscriber(subscriber);
+    }
+  }
+  free(bus);
+}
+
+/**
+ * Adds a subscriber for the event types in event_mask (built with
+ * BUS_EVENT_BIT). capacity is rounded up to a power of two and is ignored by
+ * eBusOverflow_CoalesceLatest. Returns NULL if the mask contains no copyable
+ * event types or the bus is full.
+ */
+BusSubscriber* SubscribeEventBus(EventBus *bus, uint32_t event_mask, uint32_t capacity,
+                                 eBusOverflowPolicy policy){
+  event_mask &= BUS_COPYABLE_EVENTS;
+  if(!event_mask){
+    return NULL;
+  }
+  BusSubscriber *subscriber = calloc(1, sizeof(BusSubscriber));
+  if(!subscriber){
+    return NULL;
+  }
+  subscriber->mask = event_mask;
+  subscriber->policy = policy;
+  InitLock(&subscriber->waitLock);
+  InitCond(&subscriber->waitCond);
+
+  if(policy == eBusOverflow_CoalesceLatest){
+    subscriber->mailboxes = calloc(BUS_EVENT_BITS, sizeof(BusMailbox));
+    if(!subscriber->mailboxes){
+      freeSubscriber(subscriber);
+      return NULL;
+    }
+    for(int i = 0; i < BUS_EVENT_BITS; i++){
+      atomic_init(&subscriber->mailboxes[i].version, 0);
+    }
+  } else {
+    size_t size = 2;
+    while(size < capacity){
+      size <<= 1;
+    }
+    subscriber->cells = malloc(size * sizeof(BusCell));
+    if(!subscriber->cells){
+      freeSubscriber(subscriber);
+      return NULL;
+    }
+    for(size_t i = 0; i < size; i++){
+      atomic_init(&subscriber->cells[i].sequence, i);
+    }
+    subscriber->cellMask = size - 1;
+  }
+
+  for(int i = 0; i < BUS_MAX_SUBSCRIBERS; i++){
+    BusSubscriber *expected = NULL;
+    if(atomic_compare_exchange_strong(&bus->subscribers[i], &expected, subscriber)){
+      return subscriber;
+    }
+  }
+  freeSubscriber(subscriber);
+  return NULL;
+}
+
+/** Removes and frees a subscriber once the publisher can no longer be touching it. */
+void UnsubscribeEventBus(EventBus *bus, BusSubscriber *subscriber){
+  for(int i = 0; i < BUS_MAX_SUBSCRIBERS; i++){
+    BusSubscriber *expected = subscriber;
+    if(atomic_compare_exchange_strong(&bus->subscribers[i], &expected, NULL)){
+      unsigned int epoch = atomic_load(&bus->publishEpoch);
+      while((epoch & 1u) && atomic_load(&bus->publishEpoch) == epoch){
+        YieldThread();
+      }
+      freeSubscriber(subscriber);
+      return;
+    }
+  }
+}
+
+static BusCell* claimCell(BusSubscriber *subscriber){
+  size_t pos = atomic_load_explicit(&subscriber->enqueuePos, memory_order_relaxed);
+  for(;;){
+    BusCell *cell = &subscriber->cells[pos & subscriber->cellMask];
+    size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if(diff == 0){
+      if(atomic_compare_exchange_weak_explicit(&subscriber->enqueuePos, &pos, pos + 1,
+                                               memory_order_relaxed, memory_order_relaxed)){
+        return cell;
+      }
+    } else if(diff < 0){
+      return NULL;
+    } else {
+      pos = atomic_load_explicit(&subscriber->enqueuePos, memory_order_relaxed);
+    }
+  }
+}
+
+/** Dequeues one cell; copies it out if event is not NULL. */
+static bool takeCell(BusSubscriber *subscriber, BusEvent *event){
+  size_t pos = atomic_load_explicit(&subscriber->dequeuePos, memory_order_relaxed);
+  for(;;){
+    BusCell *cell = &subscriber->cells[pos & subscriber->cellMask];
+    size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+    if(diff == 0){
+      if(atomic_compare_exchange_weak_explicit(&subscriber->dequeuePos, &pos, pos + 1,
+                                               memory_order_relaxed, memory_order_relaxed)){
+        if(event){
+          copyEvent(event, &cell->event);
+        }
+        atomic_store_explicit(&cell->sequence, pos + subscriber->cellMask + 1, memory_order_release);
+        return true;
+      }
+    } else if(diff < 0){
+      return false;
+    } else {
+      pos = atomic_load_explicit(&subscriber->dequeuePos, memory_order_relaxed);
+    }
+  }
+}
+
+static void deliver(BusSubscriber *subscriber, const LEAP_CONNECTION_MESSAGE *msg, uint64_t sequence){
+  atomic_fetch_add_explicit(&subscriber->published, 1, memory_order_relaxed);
+
+  if(subscriber->policy == eBusOverflow_CoalesceLatest){
+    uint32_t bit = BUS_EVENT_BIT(msg->type);
+    BusMailbox *mailbox = &subscriber->mailboxes[eventBitIndex(bit)];
+    unsigned int version = atomic_load_explicit(&mailbox->version, memory_order_relaxed);
+    atomic_store_explicit(&mailbox->version, version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    copyMessage(&mailbox->event, msg, sequence);
+    atomic_store_explicit(&mailbox->version, version + 2, memory_order_release);
+    if(atomic_fetch_or(&subscriber->pending, bit) & bit){
+      atomic_fetch_add_explicit(&subscriber->dropped, 1, memory_order_relaxed);
+    }
+  } else {
+    BusCell *cell = claimCell(subscriber);
+    while(!cell && subscriber->policy == eBusOverflow_DropOldest){
+      if(takeCell(subscriber, NULL)){
+        atomic_fetch_add_explicit(&subscriber->dropped, 1, memory_order_relaxed);
+      }
+      cell = claimCell(subscriber);
+    }
+    if(!cell){
+      atomic_fetch_add_explicit(&subscriber->dropped, 1, memory_order_relaxed);
+      return;
+    }
+    size_t pos = atomic_load_explicit(&cell->sequence, memory_order_relaxed);
+    copyMessage(&cell->event, msg, sequence);
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+  }
+
+  WakeWaiter(&subscriber->waiting, &subscriber->waitLock, &subscriber->waitCond);
+}
+
+/**
+ * Offers a message to every subscriber of its type. Never blocks on a
+ * subscriber; the only lock taken is a waiting subscriber's wakeup lock.
+ */
+void PublishBusMessage(EventBus *bus, const LEAP_CONNECTION_MESSAGE *msg){
+  uint32_t bit = BUS_EVENT_BIT(msg->type);
+  if(!(bit & BUS_COPYABLE_EVENTS)){
+    return;
+  }
+  uint64_t sequence = ++bus->sequence;
+  atomic_fetch_add(&bus->publishEpoch, 1);
+  for(int i = 0; i < BUS_MAX_SUBSCRIBERS; i++){
+    BusSubscriber *subscriber = atomic_load(&bus->subscribers[i]);
+    if(subscriber && (subscriber->mask & bit)){
+      deliver(subscriber, msg, sequence);
+    }
+  }
+  atomic_fetch_add(&bus->publishEpoch, 1);
+}
+
+static bool receiveCoalesced(BusSubscriber *subscriber, BusEvent *event){
+  for(;;){
+    unsigned int pending = atomic_load(&subscriber->pending);
+    if(!pending){
+      return false;
+    }
+    uint32_t bit = pending & (~pending + 1u);
+    uint32_t index = eventBitIndex(bit);
+    BusMailbox *mailbox = &subscriber->mailboxes[index];
+    atomic_fetch_and(&subscriber->pending, ~bit);
+
+    unsigned int before, after = 0;
+    do {
+      before = atomic_load_explicit(&mailbox->version, memory_order_acquire);
+      if(before & 1u){
+        YieldThread();
+        continue;
+      }
+      copyEvent(event, &mailbox->event);
+      atomic_thread_fence(memory_order_acquire);
+      after = atomic_load_explicit(&mailbox->version, memory_order_relaxed);
+    } while((before & 1u) || before != after);
+
+    //A write that landed after the bit was cleared may already have been read
+    if(event->sequence != subscriber->delivered[index]){
+      subscriber->delivered[index] = event->sequence;
+      return true;
+    }
+  }
+}
+
+/** Takes the next event without blocking. Must only be called from the subscriber's thread. */
+bool ReceiveBusEvent(BusSubscriber *subscriber, BusEvent *event){
+  bool got = subscriber->policy == eBusOverflow_CoalesceLatest
+           ? receiveCoalesced(subscriber, event)
+           : takeCell(subscriber, event);
+  if(got){
+    atomic_fetch_add_explicit(&subscriber->received, 1, memory_order_relaxed);
+  }
+  return got;
+}
+
+/** Takes the next event, sleeping up to timeout_ms for one to be published. */
+bool WaitBusEvent(BusSubscriber *subscriber, BusEvent *event, uint32_t timeout_ms){
+  if(ReceiveBusEvent(subscriber, event)){
+    return true;
+  }
+  LockMutex(&subscriber->waitLock);
+  BeginWait(&subscriber->waiting);
+  bool got = ReceiveBusEvent(subscriber, event);
+  if(!got){
+    WaitCond(&subscriber->waitCond, &subscriber->waitLock, timeout_ms);
+  }
+  EndWait(&subscriber->waiting);
+  UnlockMutex(&subscriber->waitLock);
+  return got || ReceiveBusEvent(subscriber, event);
+}
+
+void GetBusSubscriberStats(const BusSubscriber *subscriber, BusSubscriberStats *stats){
+  stats->published = atomic_load_explicit(&subscriber->published, memory_order_relaxed);
+  stats->dropped = atomic_load_explicit(&subscriber->dropped, memory_order_relaxed);
+  stats->received = atomic_load_explicit(&subscriber->received, memory_order_relaxed);
+}
+//End-of-EventBus.c
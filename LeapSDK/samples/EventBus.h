@@ -0,0 +1,93 @@
+/* Publish/subscribe bus for LeapC events.
+ *
+ * The polling thread publishes every message it receives; each subscriber owns
+ * a bounded lock-free queue and consumes it on its own thread, so a slow
+ * subscriber can only ever lose its own events. Events are copied into the
+ * queue, so only event types whose payload is self-contained are carried
+ * (see BUS_COPYABLE_EVENTS).
+ *
+ */
+
+#ifndef EventBus_h
+#define EventBus_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Maps an eLeapEventType to a bit in a subscription mask. */
+#define BUS_EVENT_BIT(type) \
+  ((uint32_t)1 << ((type) < 0x100 ? (uint32_t)(type) : 8u + ((uint32_t)(type) - 0x100u)))
+#define BUS_EVENT_BITS 32
+
+#define BUS_COPYABLE_EVENTS ( \
+  BUS_EVENT_BIT(eLeapEventType_Connection) | BUS_EVENT_BIT(eLeapEventType_ConnectionLost) | \
+  BUS_EVENT_BIT(eLeapEventType_Device) | BUS_EVENT_BIT(eLeapEventType_DeviceLost) | \
+  BUS_EVENT_BIT(eLeapEventType_DeviceFailure) | BUS_EVENT_BIT(eLeapEventType_DeviceStatusChange) | \
+  BUS_EVENT_BIT(eLeapEventType_Policy) | BUS_EVENT_BIT(eLeapEventType_Tracking) | \
+  BUS_EVENT_BIT(eLeapEventType_TrackingMode) | BUS_EVENT_BIT(eLeapEventType_DroppedFrame) | \
+  BUS_EVENT_BIT(eLeapEventType_HeadPose) | BUS_EVENT_BIT(eLeapEventType_Eyes) | \
+  BUS_EVENT_BIT(eLeapEventType_IMU) | BUS_EVENT_BIT(eLeapEventType_NewDeviceTransform) | \
+  BUS_EVENT_BIT(eLeapEventType_Fiducial))
+
+#define BUS_MAX_SUBSCRIBERS 16
+#define BUS_MAX_HANDS 2
+
+/** What a subscriber's queue does when it is full. */
+typedef enum _eBusOverflowPolicy {
+  eBusOverflow_DropOldest,     //Discard the oldest queued event to make room
+  eBusOverflow_DropNewest,     //Discard the event being published
+  eBusOverflow_CoalesceLatest  //Keep only the newest event of each type
+} eBusOverflowPolicy;
+
+/** A self-contained copy of a LeapC message. */
+typedef struct _BusEvent {
+  eLeapEventType type;
+  uint32_t       device_id;
+  uint64_t       sequence;   //Publish order across all event types
+  union {
+    struct {
+      LEAP_TRACKING_EVENT event;  //event.pHands points at hands below
+      LEAP_HAND hands[BUS_MAX_HANDS];
+    } tracking;
+    LEAP_CONNECTION_EVENT           connection;
+    LEAP_CONNECTION_LOST_EVENT      connection_lost;
+    LEAP_DEVICE_EVENT               device;
+    LEAP_DEVICE_FAILURE_EVENT       device_failure;
+    LEAP_DEVICE_STATUS_CHANGE_EVENT device_status_change;
+    LEAP_POLICY_EVENT               policy;
+    LEAP_TRACKING_MODE_EVENT        tracking_mode;
+    LEAP_DROPPED_FRAME_EVENT        dropped_frame;
+    LEAP_HEAD_POSE_EVENT            head_pose;
+    LEAP_EYE_EVENT                  eye;
+    LEAP_IMU_EVENT                  imu;
+    LEAP_NEW_DEVICE_TRANSFORM       new_device_transform;
+    LEAP_FIDUCIAL_POSE_EVENT        fiducial_pose; //family is not carried
+  };
+} BusEvent;
+
+typedef struct _BusSubscriberStats {
+  uint64_t published; //Events offered to this subscriber
+  uint64_t dropped;   //Events discarded by the overflow policy
+  uint64_t received;  //Events handed to the subscriber
+} BusSubscriberStats;
+
+typedef struct _EventBus EventBus;
+typedef struct _BusSubscriber BusSubscriber;
+
+/* Bus lifetime */
+EventBus* CreateEventBus(void);
+void DestroyEventBus(EventBus *bus);
+
+/* Subscriber side; may be called from any thread */
+BusSubscriber* SubscribeEventBus(EventBus *bus, uint32_t event_mask, uint32_t capacity,
+                                 eBusOverflowPolicy policy);
+void UnsubscribeEventBus(EventBus *bus, BusSubscriber *subscriber);
+bool ReceiveBusEvent(BusSubscriber *subscriber, BusEvent *event);
+bool WaitBusEvent(BusSubscriber *subscriber, BusEvent *event, uint32_t timeout_ms);
+void GetBusSubscriberStats(const BusSubscriber *subscriber, BusSubscriberStats *stats);
+
+/* Publisher side; a single thread, normally serviceMessageLoop() */
+void PublishBusMessage(EventBus *bus, const LEAP_CONNECTION_MESSAGE *msg);
+
+#endif /* EventBus_h */
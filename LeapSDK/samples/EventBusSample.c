@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "LeapC.h"
+#include "ExampleConnection.h"
+#include "EventBus.h"
+#include "LeapThreads.h"
+
+/*
+ Two subscribers consume the same event stream on their own threads. The
+ "renderer" only ever wants the newest frame, so it coalesces. The "logger" is
+ deliberately slow and drops its oldest events when it falls behind; neither
+ one can hold up the polling thread or the other subscriber.
+*/
+
+static atomic_int running = 1;
+
+static ThreadReturnType rendererLoop(void* arg){
+  BusSubscriber* subscriber = (BusSubscriber*)arg;
+  BusEvent event;
+  int64_t lastFrameID = 0;
+  while(atomic_load(&running)){
+    if(!WaitBusEvent(subscriber, &event, 100))
+      continue;
+    const LEAP_TRACKING_EVENT* frame = &event.tracking.event;
+    if(frame->tracking_frame_id - lastFrameID >= 100){
+      lastFrameID = frame->tracking_frame_id;
+      printf("[renderer] frame %lli with %i hands.\n", (long long int)frame->tracking_frame_id, frame->nHands);
+    }
+  }
+  return ThreadReturnValue;
+}
+
+static ThreadReturnType loggerLoop(void* arg){
+  BusSubscriber* subscriber = (BusSubscriber*)arg;
+  BusEvent event;
+  while(atomic_load(&running)){
+    if(!WaitBusEvent(subscriber, &event, 100))
+      continue;
+    if(event.type == eLeapEventType_Tracking){
+      millisleep(50); //simulate a slow sink
+    } else {
+      printf("[logger] event type 0x%x from device %u.\n", event.type, event.device_id);
+    }
+  }
+  return ThreadReturnValue;
+}
+
+static void printStats(const char* name, const BusSubscriber* subscriber){
+  BusSubscriberStats stats;
+  GetBusSubscriberStats(subscriber, &stats);
+  printf("%s: published %llu, received %llu, dropped %llu.\n", name,
+         (unsigned long long)stats.published, (unsigned long long)stats.received,
+         (unsigned long long)stats.dropped);
+}
+
+int main(int argc, char** argv) {
+  EventBus* bus = CreateEventBus();
+  BusSubscriber* renderer = SubscribeEventBus(bus, BUS_EVENT_BIT(eLeapEventType_Tracking),
+                                              0, eBusOverflow_CoalesceLatest);
+  BusSubscriber* logger = SubscribeEventBus(bus, BUS_COPYABLE_EVENTS, 64, eBusOverflow_DropOldest);
+  if(!renderer || !logger){
+    printf("Failed to subscribe to the event bus.\n");
+    return -1;
+  }
+
+  ThreadType rendererThread, loggerThread;
+  StartThread(&rendererThread, rendererLoop, renderer);
+  StartThread(&loggerThread, loggerLoop, logger);
+
+  SetConnectionEventBus(bus);
+  OpenConnection();
+
+  printf("Press Enter to exit program.\n");
+  getchar();
+
+  CloseConnection();
+  atomic_store(&running, 0);
+  JoinThread(rendererThread);
+  JoinThread(loggerThread);
+
+  printStats("renderer", renderer);
+  printStats("logger", logger);
+
+  DestroyConnection();
+  DestroyEventBus(bus);
+  return 0;
+}
+//End-of-Sample
@@ -11,17 +11,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#if defined(_MSC_VER)
-  #include <Windows.h>
-  #include <process.h>
-  #define LockMutex EnterCriticalSection
-  #define UnlockMutex LeaveCriticalSection
-#else
-  #include <unistd.h>
-  #include <pthread.h>
-  #define LockMutex pthread_mutex_lock
-  #define UnlockMutex pthread_mutex_unlock
-#endif
+#include "LeapThreads.h"
+#include "AsyncLog.h"
+#include "ConfigClient.h"
+#include "DeviceRegistry.h"
+#include "EventBus.h"
+#include "HeadPoseCache.h"
+#include "ImuFusion.h"
+#include "ServiceLog.h"
 
 
 //Forward declarations
@@ -31,7 +28,7 @@ static void serviceMessageLoop(void * unused);
 static void* serviceMessageLoop(void * unused);
 #endif
 static void setFrame(const LEAP_TRACKING_EVENT *frame);
-static void setDevice(const LEAP_DEVICE, const LEAP_DEVICE_INFO *deviceProps);
+static void setDevice(const DeviceSnapshot *device);
 
 //External state
 bool IsConnected = false;
@@ -40,8 +37,16 @@ bool IsConnected = false;
 static volatile bool _isRunning = false;
 static LEAP_CONNECTION connectionHandle = NULL;
 static LEAP_TRACKING_EVENT *lastFrame = NULL;
+static LEAP_DEVICE_INFO lastDeviceInfo;
 static LEAP_DEVICE_INFO *lastDevice = NULL;
-static LEAP_DEVICE lastDeviceHandle = NULL;
+static _Atomic uint32_t lastDeviceId = 0;  //Read without dataLock by GetDeviceTransform()
+static DeviceRegistry *deviceRegistry = NULL;
+static LEAP_TRACKING_EVENT *polledFrame = NULL;
+static EventBus *eventBus = NULL;
+static ServiceLog *serviceLog = NULL;
+static ImuFusion *imuFusion = NULL;
+static HeadPoseCache *headPoseCache = NULL;
+static ConfigClient * volatile configClient = NULL;
 
 //Callback function pointers
 struct Callbacks ConnectionCallbacks;
@@ -49,11 +54,11 @@ struct Callbacks ConnectionCallbacks;
 //Threading variables
 #if defined(_MSC_VER)
 static HANDLE pollingThread;
-static CRITICAL_SECTION dataLock;
 #else
 static pthread_t pollingThread;
-static pthread_mutex_t dataLock;
 #endif
+static LockType dataLock;
+static CondType stateChanged; //Broadcast with dataLock held when a frame, device or connection arrives
 
 /**
  * Creates the connection handle and opens a connection to the Leap Motion
@@ -63,15 +68,18 @@ LEAP_CONNECTION* OpenConnection(void){
   if(_isRunning){
     return &connectionHandle;
   }
+  if(!deviceRegistry){
+    deviceRegistry = CreateDeviceRegistry();
+  }
   if(connectionHandle || LeapCreateConnection(NULL, &connectionHandle) == eLeapRS_Success){
     eLeapRS result = LeapOpenConnection(connectionHandle);
     if(result == eLeapRS_Success){
       _isRunning = true;
+      InitLock(&dataLock);
+      InitCond(&stateChanged);
 #if defined(_MSC_VER)
-      InitializeCriticalSection(&dataLock);
       pollingThread = (HANDLE)_beginthread(serviceMessageLoop, 0, NULL);
 #else
-      pthread_mutex_init(&dataLock, NULL);
       pthread_create(&pollingThread, NULL, serviceMessageLoop, NULL);
 #endif
     }
@@ -90,12 +98,65 @@ void CloseConnection(void){
   CloseHandle(pollingThread);
 #else
   pthread_join(pollingThread, NULL);
-  pthread_mutex_destroy(&dataLock);
 #endif
+  DestroyCond(&stateChanged);
+  DestroyLock(&dataLock);
+}
+
+/**
+ * Publishes every message received by serviceMessageLoop() to bus, in addition
+ * to the ConnectionCallbacks. Must be set before OpenConnection().
+ */
+void SetConnectionEventBus(EventBus *bus){
+  eventBus = bus;
+}
+
+/**
+ * Captures the service's log messages into log instead of discarding them.
+ * Must be set before OpenConnection().
+ */
+void SetConnectionServiceLog(ServiceLog *log){
+  serviceLog = log;
+}
+
+/**
+ * Buffers every IMU sample in fusion before on_imu is called, so orientation
+ * can be queried without handling each sample. Must be set before
+ * OpenConnection().
+ */
+void SetConnectionImuFusion(ImuFusion *fusion){
+  imuFusion = fusion;
+}
+
+/**
+ * Records head pose and eye events in cache, which otherwise are discarded.
+ * Must be set before OpenConnection().
+ */
+void SetConnectionHeadPoseCache(HeadPoseCache *cache){
+  headPoseCache = cache;
+}
+
+/**
+ * Routes config responses to client. Unlike the bus and the service log it
+ * can be set after OpenConnection(), since the client needs the connection.
+ */
+void SetConnectionConfigClient(ConfigClient *client){
+  configClient = client;
+}
+
+/**
+ * The devices seen on the connection. Snapshots can be taken from any thread;
+ * the registry lives until DestroyConnection().
+ */
+DeviceRegistry* GetDeviceRegistry(void){
+  return deviceRegistry;
 }
 
 void DestroyConnection(void){
   CloseConnection();
+  lastDevice = NULL;
+  DestroyDeviceRegistry(deviceRegistry); //Closes the devices before the connection goes
+  deviceRegistry = NULL;
   LeapDestroyConnection(connectionHandle);
 }
 
@@ -108,7 +169,10 @@ void CloseConnectionHandle(LEAP_CONNECTION* connectionHandle){
 
 /** Called by serviceMessageLoop() when a connection event is returned by LeapPollConnection(). */
 static void handleConnectionEvent(const LEAP_CONNECTION_EVENT *connection_event){
+  LockMutex(&dataLock);
   IsConnected = true;
+  BroadcastCond(&stateChanged);
+  UnlockMutex(&dataLock);
   if(ConnectionCallbacks.on_connection){
     ConnectionCallbacks.on_connection();
   }
@@ -116,7 +180,12 @@ static void handleConnectionEvent(const LEAP_CONNECTION_EVENT *connection_event)
 
 /** Called by serviceMessageLoop() when a connection lost event is returned by LeapPollConnection(). */
 static void handleConnectionLostEvent(const LEAP_CONNECTION_LOST_EVENT *connection_lost_event){
+  LockMutex(&dataLock);
   IsConnected = false;
+  UnlockMutex(&dataLock);
+  if(configClient){
+    FailPendingConfigRequests(configClient); //The service will not answer them now
+  }
   if(ConnectionCallbacks.on_connection_lost){
     ConnectionCallbacks.on_connection_lost();
   }
@@ -124,47 +193,25 @@ static void handleConnectionLostEvent(const LEAP_CONNECTION_LOST_EVENT *connecti
 
 /**
  * Called by serviceMessageLoop() when a device event is returned by LeapPollConnection()
- * Demonstrates how to access device properties.
+ * The registry opens the device and reads its properties once; the device stays open
+ * until it is lost.
  */
 static void handleDeviceEvent(const LEAP_DEVICE_EVENT *device_event){
-  LEAP_DEVICE deviceHandle;
-  //Open device using LEAP_DEVICE_REF from event struct.
-  eLeapRS result = LeapOpenDevice(device_event->device, &deviceHandle);
+  DeviceSnapshot device;
+  eLeapRS result = RegisterDevice(deviceRegistry, device_event, &device);
   if(result != eLeapRS_Success){
-    printf("Could not open device %s.\n", ResultString(result));
+    printf("Could not register device %s.\n", ResultString(result));
     return;
   }
-
-  //Create a struct to hold the device properties, we have to provide a buffer for the serial string
-  LEAP_DEVICE_INFO deviceProperties = { sizeof(deviceProperties) };
-  // Start with a length of 1 (pretending we don't know a priori what the length is).
-  // Currently device serial numbers are all the same length, but that could change in the future
-  deviceProperties.serial_length = 1;
-  deviceProperties.serial = malloc(deviceProperties.serial_length);
-  //This will fail since the serial buffer is only 1 character long
-  // But deviceProperties is updated to contain the required buffer length
-  result = LeapGetDeviceInfo(deviceHandle, &deviceProperties);
-  if(result == eLeapRS_InsufficientBuffer){
-    //try again with correct buffer size
-    deviceProperties.serial = realloc(deviceProperties.serial, deviceProperties.serial_length);
-    result = LeapGetDeviceInfo(deviceHandle, &deviceProperties);
-    if(result != eLeapRS_Success){
-      printf("Failed to get device info %s.\n", ResultString(result));
-      free(deviceProperties.serial);
-      return;
-    }
-  }
-  setDevice(deviceHandle, &deviceProperties);
+  setDevice(&device);
   if(ConnectionCallbacks.on_device_found){
-    ConnectionCallbacks.on_device_found(&deviceProperties);
+    ConnectionCallbacks.on_device_found(&device.info);
   }
-
-  free(deviceProperties.serial);
-  LeapCloseDevice(deviceHandle);
 }
 
 /** Called by serviceMessageLoop() when a device lost event is returned by LeapPollConnection(). */
 static void handleDeviceLostEvent(const LEAP_DEVICE_EVENT *device_event){
+  RemoveDevice(deviceRegistry, device_event->device.id);
   if(ConnectionCallbacks.on_device_lost){
     ConnectionCallbacks.on_device_lost();
   }
@@ -201,6 +248,9 @@ static void handleImageEvent(const LEAP_IMAGE_EVENT *image_event) {
 
 /** Called by serviceMessageLoop() when an IMU event is returned by LeapPollConnection(). */
 static void handleImuEvent(const LEAP_IMU_EVENT *imu_event) {
+  if(imuFusion){
+    AddImuSample(imuFusion, imu_event);
+  }
   if(ConnectionCallbacks.on_imu){
     ConnectionCallbacks.on_imu(imu_event);
   }
@@ -228,10 +278,14 @@ static void* serviceMessageLoop(void * unused){
     result = LeapPollConnection(connectionHandle, timeout, &msg);
 
     if(result != eLeapRS_Success){
-      printf("LeapC PollConnection call was %s.\n", ResultString(result));
+      ASYNC_LOG("LeapC PollConnection call was %s.\n", ResultString(result));
       continue;
     }
 
+    if(eventBus){
+      PublishBusMessage(eventBus, &msg);
+    }
+
     switch (msg.type){
       case eLeapEventType_Connection:
         handleConnectionEvent(msg.connection_event);
@@ -248,7 +302,14 @@ static void* serviceMessageLoop(void * unused){
       case eLeapEventType_DeviceFailure:
         handleDeviceFailureEvent(msg.device_failure_event);
         break;
+      case eLeapEventType_DeviceStatusChange:
+        UpdateDeviceStatus(deviceRegistry, msg.device_status_change_event);
+        break;
       case eLeapEventType_Tracking:
+        //Connections that are not multi-device aware leave device_id at 0
+        UpdateDeviceFramerate(deviceRegistry, msg.device_id ? msg.device_id :
+                              atomic_load_explicit(&lastDeviceId, memory_order_relaxed),
+                              msg.tracking_event->framerate);
         handleTrackingEvent(msg.tracking_event);
         break;
       case eLeapEventType_ImageComplete:
@@ -269,9 +330,42 @@ static void* serviceMessageLoop(void * unused){
       case eLeapEventType_IMU:
         handleImuEvent(msg.imu_event);
         break;
+      case eLeapEventType_HeadPose:
+        if(headPoseCache){
+          RecordHeadPose(headPoseCache, msg.head_pose_event);
+        }
+        break;
+      case eLeapEventType_Eyes:
+        if(headPoseCache){
+          RecordEyes(headPoseCache, msg.eye_event);
+        }
+        break;
+      case eLeapEventType_NewDeviceTransform:
+        RefreshDeviceTransform(deviceRegistry, msg.device_id);
+        break;
+      case eLeapEventType_ConfigResponse:
+        if(configClient){
+          HandleConfigResponse(configClient, msg.config_response_event);
+        }
+        break;
+      case eLeapEventType_ConfigChange:
+        if(configClient){
+          HandleConfigChange(configClient, msg.config_change_event);
+        }
+        break;
+      case eLeapEventType_LogEvent:
+        if(serviceLog){
+          RecordServiceLogEvent(serviceLog, msg.log_event);
+        }
+        break;
+      case eLeapEventType_LogEvents:
+        if(serviceLog){
+          RecordServiceLogEvents(serviceLog, msg.log_events);
+        }
+        break;
       default:
         //discard unknown message types
-        printf("Unhandled message type %i.\n", msg.type);
+        ASYNC_LOG("Unhandled message type %i.\n", msg.type);
     } //switch on msg.type
   }
 #if !defined(_MSC_VER)
@@ -305,20 +399,25 @@ void setFrame(const LEAP_TRACKING_EVENT *frame){
   if (frame != NULL)
   {
     deepCopyTrackingEvent(lastFrame, frame);
+    BroadcastCond(&stateChanged);
   }
 
   UnlockMutex(&dataLock);
 }
 
-/** Returns a pointer to a cached tracking frame which remains valid until the next call. */
-LEAP_TRACKING_EVENT* GetFrame(){
-  static LEAP_TRACKING_EVENT *currentFrame = NULL;
-  if(currentFrame == NULL)
+/** Copies the cached frame into the buffer returned by GetFrame() and WaitForFrame(). Call with dataLock held. */
+static LEAP_TRACKING_EVENT* copyPolledFrame(void){
+  if(polledFrame == NULL)
   {
-    currentFrame = malloc(sizeof(LEAP_TRACKING_EVENT));
-    currentFrame->pHands = malloc(2 * sizeof(LEAP_HAND));
+    polledFrame = malloc(sizeof(LEAP_TRACKING_EVENT));
+    polledFrame->pHands = malloc(2 * sizeof(LEAP_HAND));
   }
+  deepCopyTrackingEvent(polledFrame, lastFrame);
+  return polledFrame;
+}
 
+/** Returns a pointer to a cached tracking frame which remains valid until the next call. */
+LEAP_TRACKING_EVENT* GetFrame(){
   LockMutex(&dataLock);
   if (lastFrame == NULL)
   {
@@ -326,27 +425,71 @@ LEAP_TRACKING_EVENT* GetFrame(){
     return NULL;
   }
 
-  deepCopyTrackingEvent(currentFrame, lastFrame);
+  LEAP_TRACKING_EVENT *currentFrame = copyPolledFrame();
   UnlockMutex(&dataLock);
 
   return currentFrame;
 }
 
 /**
- * Caches the last device found by copying the device info struct returned by
- * LeapC.
+ * Sleeps on stateChanged until woken or deadline (LeapGetNow() time) passes.
+ * Call with dataLock held. Returns false once the deadline has passed.
  */
-static void setDevice(LEAP_DEVICE device, const LEAP_DEVICE_INFO *deviceProps){
+static bool waitStateChange(int64_t deadline){
+  int64_t remaining = deadline - LeapGetNow();
+  if(remaining <= 0){
+    return false;
+  }
+  WaitCond(&stateChanged, &dataLock, (uint32_t)((remaining + 999) / 1000));
+  return true;
+}
+
+static int64_t deadlineAfter(uint32_t timeout_ms){
+  return LeapGetNow() + (int64_t)timeout_ms * 1000;
+}
+
+/**
+ * Sleeps until a frame with tracking_frame_id greater than after_frame_id has
+ * been received and returns it like GetFrame() does, or NULL after timeout_ms.
+ */
+LEAP_TRACKING_EVENT* WaitForFrame(int64_t after_frame_id, uint32_t timeout_ms){
+  int64_t deadline = deadlineAfter(timeout_ms);
+  LockMutex(&dataLock);
+  while(lastFrame == NULL || lastFrame->tracking_frame_id <= after_frame_id){
+    if(!waitStateChange(deadline)){
+      UnlockMutex(&dataLock);
+      return NULL;
+    }
+  }
+  LEAP_TRACKING_EVENT *currentFrame = copyPolledFrame();
+  UnlockMutex(&dataLock);
+  return currentFrame;
+}
+
+/** Sleeps until the connection to the service is up. Returns false after timeout_ms. */
+bool WaitForConnection(uint32_t timeout_ms){
+  int64_t deadline = deadlineAfter(timeout_ms);
   LockMutex(&dataLock);
-  lastDeviceHandle = device;
-  if(lastDevice){
-    free(lastDevice->serial);
-  } else {
-    lastDevice = malloc(sizeof(*deviceProps));
+  while(!IsConnected){
+    if(!waitStateChange(deadline)){
+      break;
+    }
   }
-  *lastDevice = *deviceProps;
-  lastDevice->serial = malloc(deviceProps->serial_length);
-  memcpy(lastDevice->serial, deviceProps->serial, deviceProps->serial_length);
+  bool connected = IsConnected;
+  UnlockMutex(&dataLock);
+  return connected;
+}
+
+/**
+ * Remembers the last device found. The info's serial is interned in the
+ * device registry, so no copy of it is needed.
+ */
+static void setDevice(const DeviceSnapshot *device){
+  LockMutex(&dataLock);
+  atomic_store_explicit(&lastDeviceId, device->id, memory_order_relaxed);
+  lastDeviceInfo = device->info;
+  lastDevice = &lastDeviceInfo;
+  BroadcastCond(&stateChanged);
   UnlockMutex(&dataLock);
 }
 
@@ -359,6 +502,20 @@ LEAP_DEVICE_INFO* GetDeviceProperties(){
   return currentDevice;
 }
 
+/** Sleeps until a device has been found and returns its cached info, or NULL after timeout_ms. */
+LEAP_DEVICE_INFO* WaitForDevice(uint32_t timeout_ms){
+  int64_t deadline = deadlineAfter(timeout_ms);
+  LockMutex(&dataLock);
+  while(!lastDevice){
+    if(!waitStateChange(deadline)){
+      break;
+    }
+  }
+  LEAP_DEVICE_INFO *currentDevice = lastDevice;
+  UnlockMutex(&dataLock);
+  return currentDevice;
+}
+
 //End of polling example-specific code
 
 /* Used in DeviceTransform Example: */
@@ -370,28 +527,15 @@ bool GetDeviceTransform(float buffer[16])
     return false;
   }
 
-  bool available = false;
-  eLeapRS result = eLeapRS_UnknownError;
-  LockMutex(&dataLock);
-  available = LeapDeviceTransformAvailable(lastDeviceHandle);
-  if(available)
-  {
-    result = LeapGetDeviceTransform(lastDeviceHandle, buffer);
-  }
-  UnlockMutex(&dataLock);
-
-  if(!available)
+  //Cached by the device registry and reread only on eLeapEventType_NewDeviceTransform,
+  //so this takes no lock and makes no LeapC call and is cheap enough for every frame
+  uint32_t deviceId = atomic_load_explicit(&lastDeviceId, memory_order_relaxed);
+  if(!deviceRegistry || !GetCachedDeviceTransform(deviceRegistry, deviceId, buffer))
   {
     printf("Device transform not available for this device\n");
     return false;
   }
 
-  if(result != eLeapRS_Success)
-  {
-    printf("Failed to get device transform: %s.\n", ResultString(result));
-    return false;
-  }
-  
   return true;
 }
 //End of DeviceTransform example-specific code
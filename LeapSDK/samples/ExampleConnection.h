@@ -12,14 +12,35 @@
 
 #include "LeapC.h"
 
+/* Subsystems the connection can feed; include their headers to use them */
+typedef struct _EventBus EventBus;
+typedef struct _ServiceLog ServiceLog;
+typedef struct _ConfigClient ConfigClient;
+typedef struct _DeviceRegistry DeviceRegistry;
+typedef struct _ImuFusion ImuFusion;
+typedef struct _HeadPoseCache HeadPoseCache;
+
 /* Client functions */
 LEAP_CONNECTION* OpenConnection(void);
 void CloseConnection(void);
 void DestroyConnection(void);
 LEAP_TRACKING_EVENT* GetFrame(void); //Used in polling example
 LEAP_DEVICE_INFO* GetDeviceProperties(void); //Used in polling example
+DeviceRegistry* GetDeviceRegistry(void);
+
+/* Blocking waits; the caller sleeps until the message thread receives what it waits for */
+#define WAIT_INFINITE 0xFFFFFFFFu
+LEAP_TRACKING_EVENT* WaitForFrame(int64_t after_frame_id, uint32_t timeout_ms);
+bool WaitForConnection(uint32_t timeout_ms);
+LEAP_DEVICE_INFO* WaitForDevice(uint32_t timeout_ms);
+
 bool GetDeviceTransform(float[16]); //Used in device transform example
 const char* ResultString(eLeapRS r);
+void SetConnectionEventBus(EventBus *bus); //Call before OpenConnection()
+void SetConnectionServiceLog(ServiceLog *log); //Call before OpenConnection()
+void SetConnectionImuFusion(ImuFusion *fusion); //Call before OpenConnection()
+void SetConnectionHeadPoseCache(HeadPoseCache *cache); //Call before OpenConnection()
+void SetConnectionConfigClient(ConfigClient *client);
 
 /* State */
 extern bool IsConnected;
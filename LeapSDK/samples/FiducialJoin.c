@@ -0,0 +1,230 @@
+/* Temporal join between fiducial pose events and tracking frames.
+ *
+ */
+
+#include "FiducialJoin.h"
+#include "LeapMath.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _JoinFrame {
+  int64_t  timestamp;
+  uint32_t nHands;
+  LEAP_HAND hands[FIDUCIAL_JOIN_MAX_HANDS];
+} JoinFrame;
+
+struct _FiducialJoin {
+  JoinFrame *frames;          //Ring of tracking frames, oldest at frameHead
+  uint32_t   frameCapacity;
+  uint32_t   frameHead;
+  uint32_t   frameCount;
+
+  LEAP_FIDUCIAL_POSE_EVENT *pending; //Ring of fiducial poses newer than the newest frame
+  uint32_t   pendingCapacity;
+  uint32_t   pendingHead;
+  uint32_t   pendingCount;
+
+  int64_t    maxGap;
+  fiducial_join_callback callback;
+  void      *userData;
+  FiducialJoinStats stats;
+  LEAP_HAND  scratch;         //Interpolated hand handed to the callback
+};
+
+FiducialJoin* CreateFiducialJoin(uint32_t frame_capacity, uint32_t pending_capacity,
+                                 int64_t max_gap_us, fiducial_join_callback callback,
+                                 void *user_data){
+  if(frame_capacity < 2 || pending_capacity == 0){
+    return NULL;
+  }
+  FiducialJoin *join = calloc(1, sizeof(FiducialJoin));
+  if(!join){
+    return NULL;
+  }
+  join->frames = malloc(frame_capacity * sizeof(JoinFrame));
+  join->pending = malloc(pending_capacity * sizeof(LEAP_FIDUCIAL_POSE_EVENT));
+  if(!join->frames || !join->pending){
+    DestroyFiducialJoin(join);
+    return NULL;
+  }
+  join->frameCapacity = frame_capacity;
+  join->pendingCapacity = pending_capacity;
+  join->maxGap = max_gap_us;
+  join->callback = callback;
+  join->userData = user_data;
+  return join;
+}
+
+void DestroyFiducialJoin(FiducialJoin *join){
+  if(!join){
+    return;
+  }
+  free(join->frames);
+  free(join->pending);
+  free(join);
+}
+
+static const JoinFrame* frameAt(const FiducialJoin *join, uint32_t i){
+  return &join->frames[(join->frameHead + i) % join->frameCapacity];
+}
+
+static int64_t newestTimestamp(const FiducialJoin *join){
+  return frameAt(join, join->frameCount - 1)->timestamp;
+}
+
+static void interpolateBone(LEAP_BONE *out, const LEAP_BONE *a, const LEAP_BONE *b, float t){
+  out->prev_joint = VectorLerp(a->prev_joint, b->prev_joint, t);
+  out->next_joint = VectorLerp(a->next_joint, b->next_joint, t);
+  out->width = a->width + (b->width - a->width) * t;
+  out->rotation = QuaternionNlerp(a->rotation, b->rotation, t);
+}
+
+/** Interpolates the geometry of a hand; identity and bookkeeping fields come from b. */
+static void interpolateHand(LEAP_HAND *out, const LEAP_HAND *a, const LEAP_HAND *b, float t){
+  *out = *b;
+  out->palm.position = VectorLerp(a->palm.position, b->palm.position, t);
+  out->palm.stabilized_position = VectorLerp(a->palm.stabilized_position, b->palm.stabilized_position, t);
+  out->palm.velocity = VectorLerp(a->palm.velocity, b->palm.velocity, t);
+  out->palm.normal = VectorLerp(a->palm.normal, b->palm.normal, t);
+  out->palm.direction = VectorLerp(a->palm.direction, b->palm.direction, t);
+  out->palm.orientation = QuaternionNlerp(a->palm.orientation, b->palm.orientation, t);
+  for(int f = 0; f < 5; f++){
+    for(int j = 0; j < 4; j++){
+      interpolateBone(&out->digits[f].bones[j], &a->digits[f].bones[j], &b->digits[f].bones[j], t);
+    }
+  }
+  interpolateBone(&out->arm, &a->arm, &b->arm, t);
+}
+
+static const LEAP_HAND* findHand(const JoinFrame *frame, uint32_t id){
+  for(uint32_t h = 0; h < frame->nHands; h++){
+    if(frame->hands[h].id == id){
+      return &frame->hands[h];
+    }
+  }
+  return NULL;
+}
+
+static void emitPose(FiducialJoin *join, const LEAP_FIDUCIAL_POSE_EVENT *fiducial, const LEAP_HAND *hand){
+  FiducialHandPose pose;
+  LEAP_QUATERNION inverse = QuaternionConjugate(hand->palm.orientation);
+  LEAP_VECTOR offset = VectorSub(fiducial->translation, hand->palm.position);
+  pose.tag_id = fiducial->id;
+  pose.timestamp = fiducial->timestamp;
+  pose.hand_id = hand->id;
+  pose.hand_type = hand->type;
+  pose.tag_position = fiducial->translation;
+  pose.translation = QuaternionRotate(inverse, offset);
+  pose.rotation = QuaternionMultiply(inverse, fiducial->rotation);
+  pose.distance = VectorLength(offset);
+  pose.estimated_error = fiducial->estimated_error;
+  if(join->callback){
+    join->callback(&pose, hand, join->userData);
+  }
+}
+
+/** Joins one fiducial pose whose timestamp is no newer than the newest buffered frame. */
+static void resolvePose(FiducialJoin *join, const LEAP_FIDUCIAL_POSE_EVENT *fiducial){
+  int64_t t = fiducial->timestamp;
+  const JoinFrame *oldest = frameAt(join, 0);
+  if(t < oldest->timestamp){
+    if(oldest->timestamp - t > join->maxGap){
+      join->stats.too_old++;
+      return;
+    }
+    t = oldest->timestamp;
+  }
+
+  //Find the bracketing pair, searching from the newest end where most poses land
+  uint32_t i = join->frameCount - 1;
+  while(i > 0 && frameAt(join, i - 1)->timestamp >= t){
+    i--;
+  }
+  const JoinFrame *after = frameAt(join, i);
+  const JoinFrame *before = i > 0 ? frameAt(join, i - 1) : after;
+  int64_t span = after->timestamp - before->timestamp;
+  float alpha = span > 0 ? (float)(t - before->timestamp) / (float)span : 1.0f;
+  const JoinFrame *nearest = alpha < 0.5f ? before : after;
+  const JoinFrame *other = alpha < 0.5f ? after : before;
+  bool interpolate = span > 0 && span <= join->maxGap;
+
+  if(nearest->nHands == 0){
+    join->stats.no_hands++;
+    return;
+  }
+  for(uint32_t h = 0; h < nearest->nHands; h++){
+    const LEAP_HAND *hand = &nearest->hands[h];
+    const LEAP_HAND *match = interpolate ? findHand(other, hand->id) : NULL;
+    if(match){
+      if(nearest == after){
+        interpolateHand(&join->scratch, match, hand, alpha);
+      } else {
+        interpolateHand(&join->scratch, hand, match, alpha);
+      }
+      hand = &join->scratch;
+    }
+    emitPose(join, fiducial, hand);
+  }
+  join->stats.joined++;
+}
+
+void PushJoinTrackingFrame(FiducialJoin *join, const LEAP_TRACKING_EVENT *frame){
+  if(join->frameCount > 0 && frame->info.timestamp == newestTimestamp(join)){
+    join->stats.duplicate_frames++;
+    return;
+  }
+  //A timestamp going backwards means the stream restarted; the history is useless
+  if(join->frameCount > 0 && frame->info.timestamp < newestTimestamp(join)){
+    join->frameCount = 0;
+    join->frameHead = 0;
+    join->stats.pending_dropped += join->pendingCount;
+    join->pendingCount = 0;
+    join->pendingHead = 0;
+  }
+
+  JoinFrame *slot;
+  if(join->frameCount == join->frameCapacity){
+    slot = &join->frames[join->frameHead];
+    join->frameHead = (join->frameHead + 1) % join->frameCapacity;
+  } else {
+    slot = &join->frames[(join->frameHead + join->frameCount) % join->frameCapacity];
+    join->frameCount++;
+  }
+  slot->timestamp = frame->info.timestamp;
+  slot->nHands = frame->nHands < FIDUCIAL_JOIN_MAX_HANDS ? frame->nHands : FIDUCIAL_JOIN_MAX_HANDS;
+  memcpy(slot->hands, frame->pHands, slot->nHands * sizeof(LEAP_HAND));
+
+  //Release every pending pose that is now bracketed
+  while(join->pendingCount > 0){
+    const LEAP_FIDUCIAL_POSE_EVENT *pose = &join->pending[join->pendingHead];
+    if(pose->timestamp > slot->timestamp){
+      break;
+    }
+    resolvePose(join, pose);
+    join->pendingHead = (join->pendingHead + 1) % join->pendingCapacity;
+    join->pendingCount--;
+  }
+}
+
+void PushJoinFiducialPose(FiducialJoin *join, const LEAP_FIDUCIAL_POSE_EVENT *pose){
+  if(join->frameCount > 0 && pose->timestamp <= newestTimestamp(join) && join->pendingCount == 0){
+    resolvePose(join, pose);
+    return;
+  }
+
+  //Wait for a later frame. Poses are queued in arrival order, which keeps them time ordered per tag.
+  if(join->pendingCount == join->pendingCapacity){
+    join->pendingHead = (join->pendingHead + 1) % join->pendingCapacity;
+    join->pendingCount--;
+    join->stats.pending_dropped++;
+  }
+  LEAP_FIDUCIAL_POSE_EVENT *slot = &join->pending[(join->pendingHead + join->pendingCount) % join->pendingCapacity];
+  *slot = *pose;
+  slot->family = NULL; //Owned by LeapC and only valid for the current message
+  join->pendingCount++;
+}
+
+void GetFiducialJoinStats(const FiducialJoin *join, FiducialJoinStats *stats){
+  *stats = join->stats;
+}
+//End-of-FiducialJoin.c
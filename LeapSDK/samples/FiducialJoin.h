@@ -0,0 +1,61 @@
+/* Temporal join between fiducial pose events and tracking frames.
+ *
+ * Tracking frames are kept in a short time-ordered ring. Each fiducial pose is
+ * matched against the two frames that bracket its timestamp, the hands are
+ * interpolated to that instant and one hand-to-tag pose is emitted per hand.
+ * Fiducial poses that arrive before the tracking frame that follows them are
+ * held in a pending ring until that frame shows up. All storage is allocated
+ * once by CreateFiducialJoin().
+ *
+ */
+
+#ifndef FiducialJoin_h
+#define FiducialJoin_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FIDUCIAL_JOIN_MAX_HANDS 2
+
+/** The pose of a fiducial tag expressed in the palm frame of one hand. */
+typedef struct _FiducialHandPose {
+  int             tag_id;
+  int64_t         timestamp;       //Fiducial timestamp, which is also the interpolation time
+  uint32_t        hand_id;
+  eLeapHandType   hand_type;
+  LEAP_VECTOR     tag_position;    //Tag position in tracking space
+  LEAP_VECTOR     translation;     //Tag position relative to the palm, in the palm basis
+  LEAP_QUATERNION rotation;        //Tag rotation relative to the palm orientation
+  float           distance;        //Distance from the palm to the tag in millimeters
+  float           estimated_error; //Copied from the fiducial event
+} FiducialHandPose;
+
+typedef void (*fiducial_join_callback)(const FiducialHandPose *pose,
+                                       const LEAP_HAND *interpolated_hand,
+                                       void *user_data);
+
+typedef struct _FiducialJoinStats {
+  uint64_t joined;          //Fiducial poses matched to at least one hand
+  uint64_t no_hands;        //Fiducial poses whose bracketing frames held no hands
+  uint64_t too_old;         //Fiducial poses older than the buffered tracking history
+  uint64_t pending_dropped; //Fiducial poses evicted from a full pending ring
+  uint64_t duplicate_frames; //Tracking frames ignored for repeating the newest timestamp
+} FiducialJoinStats;
+
+typedef struct _FiducialJoin FiducialJoin;
+
+/*
+ * frame_capacity bounds the tracking history, pending_capacity the number of
+ * fiducial poses waiting for a later frame, and max_gap_us the largest frame
+ * spacing that is still interpolated across.
+ */
+FiducialJoin* CreateFiducialJoin(uint32_t frame_capacity, uint32_t pending_capacity,
+                                 int64_t max_gap_us, fiducial_join_callback callback,
+                                 void *user_data);
+void DestroyFiducialJoin(FiducialJoin *join);
+void PushJoinTrackingFrame(FiducialJoin *join, const LEAP_TRACKING_EVENT *frame);
+void PushJoinFiducialPose(FiducialJoin *join, const LEAP_FIDUCIAL_POSE_EVENT *pose);
+void GetFiducialJoinStats(const FiducialJoin *join, FiducialJoinStats *stats);
+
+#endif /* FiducialJoin_h */
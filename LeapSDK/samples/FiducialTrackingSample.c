@@ -11,12 +11,12 @@
 #include <string.h>
 #include <stdlib.h>
 
-#include <time.h>
 #include <math.h>
 #include "LeapC.h"
+#include "FiducialJoin.h"
 
 /*
- This sample tracks the left index tip and a fiducial marker and tells you the
+ This sample tracks the index tips and a fiducial marker and tells you the
  distance between them. To run this sample, you should have an AprilTag fiducial
  marker that is IR reflective. The family and scale of the tag should be put in
  the hand tracker config as such:
@@ -31,13 +31,25 @@
   Windows: C:\ProgramData\Ultraleap\HandTracker\hand_tracker_config.json
 */
 
-void clone_tracking_event(LEAP_TRACKING_EVENT* dst, const LEAP_TRACKING_EVENT* src)
+/*
+ Every fiducial pose is joined with the tracking frames either side of it, so
+ both hands are reported for every tag, interpolated to the tag timestamp.
+*/
+static void on_joined_pose(const FiducialHandPose* pose, const LEAP_HAND* hand, void* user_data)
 {
-  memcpy(&dst->info, &src->info, sizeof(LEAP_FRAME_HEADER));
-  dst->tracking_frame_id = src->tracking_frame_id;
-  dst->nHands = src->nHands;
-  dst->framerate = src->framerate;
-  memcpy(dst->pHands, src->pHands, src->nHands * sizeof(LEAP_HAND));
+  (void)user_data;
+  LEAP_VECTOR index_tip_pos = hand->index.distal.next_joint;
+  LEAP_VECTOR fiducial_pos = pose->tag_position;
+
+  float distance = sqrtf(powf(index_tip_pos.x - fiducial_pos.x, 2) +
+                         powf(index_tip_pos.y - fiducial_pos.y, 2) +
+                         powf(index_tip_pos.z - fiducial_pos.z, 2));
+
+  printf("tag %d: %s index tip is (%f, %f, %f) and fiducial is (%f, %f, %f), they are %f mm from each other \n",
+         pose->tag_id, hand->type == eLeapHandType_Left ? "left" : "right",
+         index_tip_pos.x, index_tip_pos.y, index_tip_pos.z,
+         fiducial_pos.x, fiducial_pos.y, fiducial_pos.z, distance);
+  fflush(stdout);
 }
 
 int main(int argc, char** argv) {
@@ -50,10 +62,15 @@ int main(int argc, char** argv) {
   LEAP_CONNECTION_MESSAGE msg;
   unsigned int timeout_ms = 1000;
 
-  LEAP_TRACKING_EVENT* latest_tracking_event = malloc(sizeof(LEAP_TRACKING_EVENT));
-  latest_tracking_event->nHands = 0;
-  latest_tracking_event->pHands = malloc(2 * sizeof(LEAP_HAND));
-  
+  //keep 32 tracking frames, up to 64 fiducial poses waiting for the next frame, and
+  //don't interpolate across gaps longer than 100ms
+  FiducialJoin* join = CreateFiducialJoin(32, 64, 100000, on_joined_pose, NULL);
+  if (!join)
+  {
+    printf("Failed to create fiducial join\n");
+    return -1;
+  }
+
   while (1)
   {
     eLeapRS res = LeapPollConnection(connection, timeout_ms, &msg);
@@ -62,31 +79,18 @@ int main(int argc, char** argv) {
       continue;
     }
 
-    if (msg.type == eLeapEventType_Fiducial && latest_tracking_event->nHands > 0)
+    if (msg.type == eLeapEventType_Fiducial)
     {
-      //if the last hand tracking event is older than 500ms, we won't try and compare them
-      int64_t time_between_events = llabs(msg.fiducial_pose_event->timestamp - latest_tracking_event->info.timestamp);
-      if (time_between_events < 500000)
-      {
-        LEAP_VECTOR index_tip_pos = latest_tracking_event->pHands[0].index.distal.next_joint;
-        LEAP_VECTOR fiducial_pos = msg.fiducial_pose_event->translation;
-
-        float distance = sqrt(powf(index_tip_pos.x - fiducial_pos.x, 2) +
-                              powf(index_tip_pos.y - fiducial_pos.y, 2) +
-                              powf(index_tip_pos.z - fiducial_pos.z, 2));
-
-        printf("index tip is (%f, %f, %f) and fiducial is (%f, %f, %f), they are %f mm from each other \n", index_tip_pos.x, index_tip_pos.y, index_tip_pos.z, fiducial_pos.x, fiducial_pos.y, fiducial_pos.z, distance);
-        fflush(stdout);
-      }
+      PushJoinFiducialPose(join, msg.fiducial_pose_event);
     }
 
-    //save the latest tracking event to compare with the next fiducial event
     if (msg.type == eLeapEventType_Tracking)
     {
-      clone_tracking_event(latest_tracking_event, msg.tracking_event);
+      PushJoinTrackingFrame(join, msg.tracking_event);
     }
   }
-  
+
+  DestroyFiducialJoin(join);
   return 0;
 }
 //End-of-Sample
@@ -0,0 +1,391 @@
+/* Compact, quantized binary encoding of tracking frames.
+ *
+ * Hand layout (FRAME_CODEC_HAND_SIZE bytes):
+ *   u32 id, u8 type | is_extended << 1, u8 confidence, u64 visible_time,
+ *   u16 pinch_distance, u16 grab_angle, u8 pinch_strength, u8 grab_strength,
+ *   u16 palm width, 5 x u8 digit width, u8 arm width,
+ *   29 x 3 x u16 positions: palm position, stabilized position, per digit the
+ *     metacarpal base and the end of each of the four bones, arm base and end,
+ *   3 x i16 palm velocity,
+ *   22 x u32 quaternions: palm orientation, 20 bones, arm.
+ *
+ */
+
+#include "FrameCodec.h"
+#include "LeapMath.h"
+#include <math.h>
+#include <string.h>
+
+#define FRAME_CODEC_MAGIC 0x4C //'L'
+
+//Smallest-three stores components in [-1/sqrt(2), 1/sqrt(2)] with 10 bits each.
+#define QUAT_COMPONENT_MAX  0.70710678f
+#define QUAT_COMPONENT_BITS 10
+#define QUAT_COMPONENT_STEPS ((1u << QUAT_COMPONENT_BITS) - 1u)
+
+#define PINCH_DISTANCE_STEP 0.05f  //mm
+#define PALM_WIDTH_STEP     0.01f  //mm
+#define DIGIT_WIDTH_STEP    0.25f  //mm
+#define ARM_WIDTH_STEP      0.5f   //mm
+#define FRAMERATE_STEP      0.01f  //Hz
+#define GRAB_ANGLE_MAX      3.14159265f
+
+//Double precision, so the decoded float is rounded once and the bounds hold exactly
+typedef struct _PositionQuantizer {
+  double min[3];
+  double scale[3];  //Steps per millimeter
+  double step[3];   //Millimeters per step
+} PositionQuantizer;
+
+/* Little-endian byte writers and readers */
+
+static uint8_t* put8(uint8_t *p, uint32_t v){
+  *p++ = (uint8_t)v;
+  return p;
+}
+
+static uint8_t* put16(uint8_t *p, uint32_t v){
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  return p + 2;
+}
+
+static uint8_t* put32(uint8_t *p, uint32_t v){
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+  return p + 4;
+}
+
+static uint8_t* put64(uint8_t *p, uint64_t v){
+  p = put32(p, (uint32_t)v);
+  return put32(p, (uint32_t)(v >> 32));
+}
+
+static uint32_t get8(const uint8_t **p){
+  return *(*p)++;
+}
+
+static uint32_t get16(const uint8_t **p){
+  const uint8_t *b = *p;
+  *p += 2;
+  return (uint32_t)b[0] | ((uint32_t)b[1] << 8);
+}
+
+static uint32_t get32(const uint8_t **p){
+  const uint8_t *b = *p;
+  *p += 4;
+  return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static uint64_t get64(const uint8_t **p){
+  uint64_t lo = get32(p);
+  return lo | ((uint64_t)get32(p) << 32);
+}
+
+/** Rounds v / step to the nearest integer in [0, max]. */
+static uint32_t quantizeUnsigned(double v, double step, uint32_t max){
+  double q = v / step + 0.5;
+  if(!(q > 0.0)){
+    return 0;
+  }
+  return q >= (double)max ? max : (uint32_t)q;
+}
+
+static void initQuantizer(PositionQuantizer *quantizer, const int16_t min[3], const int16_t max[3]){
+  for(int a = 0; a < 3; a++){
+    double range = (double)max[a] - (double)min[a];
+    if(range < 1.0){
+      range = 1.0;
+    }
+    quantizer->min[a] = (double)min[a];
+    quantizer->scale[a] = 65535.0 / range;
+    quantizer->step[a] = range / 65535.0;
+  }
+}
+
+static uint8_t* putPosition(uint8_t *p, const PositionQuantizer *quantizer, LEAP_VECTOR v){
+  for(int a = 0; a < 3; a++){
+    p = put16(p, quantizeUnsigned(((double)v.v[a] - quantizer->min[a]) * quantizer->scale[a], 1.0, 65535));
+  }
+  return p;
+}
+
+static LEAP_VECTOR getPosition(const uint8_t **p, const PositionQuantizer *quantizer){
+  LEAP_VECTOR v;
+  for(int a = 0; a < 3; a++){
+    v.v[a] = (float)(quantizer->min[a] + (double)get16(p) * quantizer->step[a]);
+  }
+  return v;
+}
+
+/** Smallest-three: 2 bits for the dropped component, 3 x 10 bits for the others. */
+static uint32_t packQuaternion(LEAP_QUATERNION q){
+  q = QuaternionNormalize(q);
+  int largest = 0;
+  for(int i = 1; i < 4; i++){
+    if(fabsf(q.v[i]) > fabsf(q.v[largest])){
+      largest = i;
+    }
+  }
+  float sign = q.v[largest] < 0.0f ? -1.0f : 1.0f;
+  uint32_t packed = (uint32_t)largest << 30;
+  int shift = 20;
+  for(int i = 0; i < 4; i++){
+    if(i == largest){
+      continue;
+    }
+    float c = (q.v[i] * sign + QUAT_COMPONENT_MAX) * (QUAT_COMPONENT_STEPS / (2.0f * QUAT_COMPONENT_MAX));
+    packed |= quantizeUnsigned(c, 1.0f, QUAT_COMPONENT_STEPS) << shift;
+    shift -= QUAT_COMPONENT_BITS;
+  }
+  return packed;
+}
+
+static LEAP_QUATERNION unpackQuaternion(uint32_t packed){
+  LEAP_QUATERNION q;
+  int largest = (int)(packed >> 30);
+  int shift = 20;
+  float sum = 0.0f;
+  for(int i = 0; i < 4; i++){
+    if(i == largest){
+      continue;
+    }
+    uint32_t u = (packed >> shift) & QUAT_COMPONENT_STEPS;
+    q.v[i] = (float)u * (2.0f * QUAT_COMPONENT_MAX / QUAT_COMPONENT_STEPS) - QUAT_COMPONENT_MAX;
+    sum += q.v[i] * q.v[i];
+    shift -= QUAT_COMPONENT_BITS;
+  }
+  q.v[largest] = sum < 1.0f ? sqrtf(1.0f - sum) : 0.0f;
+  return q;
+}
+
+static int16_t clampMillimeters(float v){
+  float r = floorf(v + 0.5f);
+  if(r < -32768.0f) return -32768;
+  if(r > 32767.0f) return 32767;
+  return (int16_t)r;
+}
+
+void GetDefaultFrameCodecConfig(FrameCodecConfig *config){
+  //Comfortably covers the interaction volume of current devices, and the arm behind it
+  config->position_min = VectorMake(-1000.0f, -1000.0f, -1000.0f);
+  config->position_max = VectorMake(1000.0f, 1000.0f, 1000.0f);
+  config->velocity_range = 8000.0f;
+}
+
+/** Half the spacing of floats just below magnitude, the rounding error of any decoded value up to it. */
+static float halfFloatSpacing(float magnitude){
+  return 0.5f * (magnitude - nextafterf(magnitude, 0.0f));
+}
+
+void GetFrameCodecErrorBounds(const FrameCodecConfig *config, FrameCodecErrorBounds *bounds){
+  //Half a step of quantization, plus the rounding of the decoded value to float
+  for(int a = 0; a < 3; a++){
+    float min = (float)clampMillimeters(config->position_min.v[a]);
+    float max = (float)clampMillimeters(config->position_max.v[a]);
+    float range = max - min;
+    bounds->position.v[a] = 0.5f * (range < 1.0f ? 1.0f : range) / 65535.0f + halfFloatSpacing(fmaxf(fabsf(min), fabsf(max)));
+  }
+  float velocityRange = (float)quantizeUnsigned(config->velocity_range, 1.0, 65535);
+  bounds->velocity = 0.5f * velocityRange / 32767.0f + halfFloatSpacing(velocityRange);
+
+  //Each stored component is off by at most half a step. The dropped component
+  //is at least 1/2 and the stored ones at most 1/sqrt(2), so its error is at
+  //most 3 * (1/sqrt(2)) / (1/2) times that; the rotation angle is twice the
+  //quaternion error for small errors.
+  float e = 0.5f * (2.0f * QUAT_COMPONENT_MAX / QUAT_COMPONENT_STEPS);
+  float dropped = 3.0f * QUAT_COMPONENT_MAX * e / 0.5f;
+  bounds->rotation = 2.0f * sqrtf(3.0f * e * e + dropped * dropped);
+  bounds->width = 0.5f * ARM_WIDTH_STEP;
+}
+
+size_t GetEncodedFrameSize(uint32_t nHands){
+  if(nHands > FRAME_CODEC_MAX_HANDS){
+    nHands = FRAME_CODEC_MAX_HANDS;
+  }
+  return FRAME_CODEC_HEADER_SIZE + (size_t)nHands * FRAME_CODEC_HAND_SIZE;
+}
+
+static uint8_t* encodeHand(uint8_t *p, const PositionQuantizer *quantizer, float velocityRange, const LEAP_HAND *hand){
+  uint32_t flags = hand->type == eLeapHandType_Right ? 1u : 0u;
+  for(int f = 0; f < 5; f++){
+    flags |= (hand->digits[f].is_extended ? 1u : 0u) << (f + 1);
+  }
+  p = put32(p, hand->id);
+  p = put8(p, flags);
+  p = put8(p, quantizeUnsigned(hand->confidence, 1.0f / 255.0f, 255));
+  p = put64(p, hand->visible_time);
+  p = put16(p, quantizeUnsigned(hand->pinch_distance, PINCH_DISTANCE_STEP, 65535));
+  p = put16(p, quantizeUnsigned(hand->grab_angle, GRAB_ANGLE_MAX / 65535.0f, 65535));
+  p = put8(p, quantizeUnsigned(hand->pinch_strength, 1.0f / 255.0f, 255));
+  p = put8(p, quantizeUnsigned(hand->grab_strength, 1.0f / 255.0f, 255));
+  p = put16(p, quantizeUnsigned(hand->palm.width, PALM_WIDTH_STEP, 65535));
+  for(int f = 0; f < 5; f++){
+    //The metacarpal of the thumb has zero width, so take the proximal bone
+    p = put8(p, quantizeUnsigned(hand->digits[f].proximal.width, DIGIT_WIDTH_STEP, 255));
+  }
+  p = put8(p, quantizeUnsigned(hand->arm.width, ARM_WIDTH_STEP, 255));
+
+  p = putPosition(p, quantizer, hand->palm.position);
+  p = putPosition(p, quantizer, hand->palm.stabilized_position);
+  for(int f = 0; f < 5; f++){
+    const LEAP_DIGIT *digit = &hand->digits[f];
+    p = putPosition(p, quantizer, digit->metacarpal.prev_joint);
+    for(int b = 0; b < 4; b++){
+      p = putPosition(p, quantizer, digit->bones[b].next_joint);
+    }
+  }
+  p = putPosition(p, quantizer, hand->arm.prev_joint);
+  p = putPosition(p, quantizer, hand->arm.next_joint);
+
+  for(int a = 0; a < 3; a++){
+    double v = (double)hand->palm.velocity.v[a] / velocityRange * 32767.0;
+    v = v < -32767.0 ? -32767.0 : (v > 32767.0 ? 32767.0 : v);
+    p = put16(p, (uint16_t)(int16_t)lrint(v));
+  }
+
+  p = put32(p, packQuaternion(hand->palm.orientation));
+  for(int f = 0; f < 5; f++){
+    for(int b = 0; b < 4; b++){
+      p = put32(p, packQuaternion(hand->digits[f].bones[b].rotation));
+    }
+  }
+  return put32(p, packQuaternion(hand->arm.rotation));
+}
+
+static const uint8_t* decodeHand(const uint8_t *p, const PositionQuantizer *quantizer, float velocityRange, LEAP_HAND *hand){
+  hand->id = get32(&p);
+  uint32_t flags = get8(&p);
+  hand->flags = 0;
+  hand->type = (flags & 1u) ? eLeapHandType_Right : eLeapHandType_Left;
+  hand->confidence = (float)get8(&p) / 255.0f;
+  hand->visible_time = get64(&p);
+  hand->pinch_distance = (float)get16(&p) * PINCH_DISTANCE_STEP;
+  hand->grab_angle = (float)get16(&p) * (GRAB_ANGLE_MAX / 65535.0f);
+  hand->pinch_strength = (float)get8(&p) / 255.0f;
+  hand->grab_strength = (float)get8(&p) / 255.0f;
+  hand->palm.width = (float)get16(&p) * PALM_WIDTH_STEP;
+  float digitWidth[5];
+  for(int f = 0; f < 5; f++){
+    digitWidth[f] = (float)get8(&p) * DIGIT_WIDTH_STEP;
+  }
+  hand->arm.width = (float)get8(&p) * ARM_WIDTH_STEP;
+
+  hand->palm.position = getPosition(&p, quantizer);
+  hand->palm.stabilized_position = getPosition(&p, quantizer);
+  for(int f = 0; f < 5; f++){
+    LEAP_DIGIT *digit = &hand->digits[f];
+    //Leap finger ids are the hand id times ten plus the digit index
+    digit->finger_id = (int32_t)(hand->id * 10 + f);
+    digit->is_extended = (flags >> (f + 1)) & 1u;
+    LEAP_VECTOR joint = getPosition(&p, quantizer);
+    for(int b = 0; b < 4; b++){
+      digit->bones[b].prev_joint = joint;
+      joint = getPosition(&p, quantizer);
+      digit->bones[b].next_joint = joint;
+      digit->bones[b].width = digitWidth[f];
+    }
+  }
+  //The thumb metacarpal is zero length, and reported with zero width
+  hand->thumb.metacarpal.width = 0.0f;
+  hand->arm.prev_joint = getPosition(&p, quantizer);
+  hand->arm.next_joint = getPosition(&p, quantizer);
+
+  for(int a = 0; a < 3; a++){
+    hand->palm.velocity.v[a] = (float)((double)(int16_t)get16(&p) * velocityRange / 32767.0);
+  }
+
+  hand->palm.orientation = unpackQuaternion(get32(&p));
+  for(int f = 0; f < 5; f++){
+    for(int b = 0; b < 4; b++){
+      hand->digits[f].bones[b].rotation = unpackQuaternion(get32(&p));
+    }
+  }
+  hand->arm.rotation = unpackQuaternion(get32(&p));
+
+  //The palm basis is {normal x direction, -normal, -direction}
+  hand->palm.normal = VectorScale(QuaternionRotate(hand->palm.orientation, VectorMake(0.0f, 1.0f, 0.0f)), -1.0f);
+  hand->palm.direction = VectorScale(QuaternionRotate(hand->palm.orientation, VectorMake(0.0f, 0.0f, 1.0f)), -1.0f);
+  return p;
+}
+
+size_t EncodeFrame(const FrameCodecConfig *config, const LEAP_TRACKING_EVENT *frame,
+                   uint8_t *buffer, size_t capacity){
+  uint32_t nHands = frame->nHands < FRAME_CODEC_MAX_HANDS ? frame->nHands : FRAME_CODEC_MAX_HANDS;
+  size_t size = GetEncodedFrameSize(nHands);
+  if(capacity < size){
+    return 0;
+  }
+
+  int16_t min[3], max[3];
+  PositionQuantizer quantizer;
+  for(int a = 0; a < 3; a++){
+    min[a] = clampMillimeters(config->position_min.v[a]);
+    max[a] = clampMillimeters(config->position_max.v[a]);
+  }
+  initQuantizer(&quantizer, min, max);
+  uint32_t velocityRange = quantizeUnsigned(config->velocity_range, 1.0, 65535);
+  if(velocityRange == 0){
+    velocityRange = 1;
+  }
+
+  uint8_t *p = buffer;
+  p = put8(p, FRAME_CODEC_MAGIC);
+  p = put8(p, FRAME_CODEC_VERSION);
+  p = put8(p, nHands);
+  p = put8(p, 0);
+  p = put64(p, (uint64_t)frame->info.frame_id);
+  p = put64(p, (uint64_t)frame->info.timestamp);
+  p = put64(p, (uint64_t)frame->tracking_frame_id);
+  p = put16(p, quantizeUnsigned(frame->framerate, FRAMERATE_STEP, 65535));
+  for(int a = 0; a < 3; a++){
+    p = put16(p, (uint16_t)min[a]);
+  }
+  for(int a = 0; a < 3; a++){
+    p = put16(p, (uint16_t)max[a]);
+  }
+  p = put16(p, velocityRange);
+
+  for(uint32_t h = 0; h < nHands; h++){
+    p = encodeHand(p, &quantizer, (float)velocityRange, &frame->pHands[h]);
+  }
+  return (size_t)(p - buffer);
+}
+
+bool DecodeFrame(const uint8_t *buffer, size_t size, LEAP_TRACKING_EVENT *frame,
+                 LEAP_HAND *hands, uint32_t max_hands){
+  if(size < FRAME_CODEC_HEADER_SIZE || buffer[0] != FRAME_CODEC_MAGIC || buffer[1] != FRAME_CODEC_VERSION){
+    return false;
+  }
+  uint32_t nHands = buffer[2];
+  if(nHands > FRAME_CODEC_MAX_HANDS || size < GetEncodedFrameSize(nHands)){
+    return false;
+  }
+
+  const uint8_t *p = buffer + 4;
+  frame->info.reserved = NULL;
+  frame->info.frame_id = (int64_t)get64(&p);
+  frame->info.timestamp = (int64_t)get64(&p);
+  frame->tracking_frame_id = (int64_t)get64(&p);
+  frame->framerate = (float)get16(&p) * FRAMERATE_STEP;
+  int16_t min[3], max[3];
+  for(int a = 0; a < 3; a++){
+    min[a] = (int16_t)get16(&p);
+  }
+  for(int a = 0; a < 3; a++){
+    max[a] = (int16_t)get16(&p);
+  }
+  float velocityRange = (float)get16(&p);
+  PositionQuantizer quantizer;
+  initQuantizer(&quantizer, min, max);
+
+  frame->nHands = nHands < max_hands ? nHands : max_hands;
+  frame->pHands = hands;
+  for(uint32_t h = 0; h < frame->nHands; h++){
+    p = decodeHand(p, &quantizer, velocityRange, &hands[h]);
+  }
+  return true;
+}
+//End-of-FrameCodec.c
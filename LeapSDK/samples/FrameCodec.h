@@ -0,0 +1,57 @@
+/* Compact, quantized binary encoding of tracking frames.
+ *
+ * A LEAP_HAND is 1084 bytes of floats, much of it redundant: every bone
+ * repeats the previous bone's end joint, the palm normal and direction follow
+ * from the palm orientation, and bone widths are constant along a digit. The
+ * encoding keeps one copy of each joint, quantizes positions to 16-bit fixed
+ * point inside a configurable box, stores unit quaternions in 32 bits with
+ * smallest-three encoding and squeezes the scalars, for 296 bytes per hand.
+ *
+ * Encoded frames are self-describing: the quantization box travels in the
+ * frame header, so decoding needs no configuration. All multi-byte fields are
+ * little-endian.
+ *
+ */
+
+#ifndef FrameCodec_h
+#define FrameCodec_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_CODEC_VERSION     1
+#define FRAME_CODEC_HEADER_SIZE 44
+#define FRAME_CODEC_HAND_SIZE   296
+#define FRAME_CODEC_MAX_HANDS   2
+#define FRAME_CODEC_MAX_SIZE    (FRAME_CODEC_HEADER_SIZE + FRAME_CODEC_MAX_HANDS * FRAME_CODEC_HAND_SIZE)
+
+/** Quantization ranges. Bounds are rounded to whole millimeters when encoded. */
+typedef struct _FrameCodecConfig {
+  LEAP_VECTOR position_min;   //Millimeters; positions outside the box are clamped
+  LEAP_VECTOR position_max;
+  float       velocity_range; //Palm velocity is clamped to +/- this many mm/s
+} FrameCodecConfig;
+
+/** Worst-case absolute reconstruction errors for values inside the configured ranges, float rounding included. */
+typedef struct _FrameCodecErrorBounds {
+  LEAP_VECTOR position;       //Millimeters per axis
+  float       velocity;       //Millimeters per second per axis
+  float       rotation;       //Radians, for any encoded orientation
+  float       width;          //Millimeters, for bone and arm widths
+} FrameCodecErrorBounds;
+
+void GetDefaultFrameCodecConfig(FrameCodecConfig *config);
+void GetFrameCodecErrorBounds(const FrameCodecConfig *config, FrameCodecErrorBounds *bounds);
+size_t GetEncodedFrameSize(uint32_t nHands);
+
+/* Returns the number of bytes written, or 0 if buffer is too small. Hands beyond FRAME_CODEC_MAX_HANDS are dropped. */
+size_t EncodeFrame(const FrameCodecConfig *config, const LEAP_TRACKING_EVENT *frame,
+                   uint8_t *buffer, size_t capacity);
+
+/* Decodes into frame, pointing frame->pHands at hands. Returns false on a malformed buffer. */
+bool DecodeFrame(const uint8_t *buffer, size_t size, LEAP_TRACKING_EVENT *frame,
+                 LEAP_HAND *hands, uint32_t max_hands);
+
+#endif /* FrameCodec_h */
@@ -0,0 +1,192 @@
+/* Measures encode and decode cost of the compact frame format, checks the
+ * reconstruction error on random frames against the documented bounds and
+ * reports the size reduction over raw LEAP_HAND structs.
+ *
+ * Frames are synthesized with joints, velocities and orientations spread over
+ * the whole default quantization range. No device is required.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "LeapMath.h"
+#include "FrameCodec.h"
+
+#define FRAME_COUNT 20000
+
+static float randomRange(float min, float max){
+  return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+static LEAP_VECTOR randomPosition(void){
+  return VectorMake(randomRange(-999.0f, 999.0f), randomRange(-999.0f, 999.0f), randomRange(-999.0f, 999.0f));
+}
+
+static LEAP_QUATERNION randomRotation(void){
+  return QuaternionNormalize(QuaternionMake(randomRange(-1.0f, 1.0f), randomRange(-1.0f, 1.0f),
+                                            randomRange(-1.0f, 1.0f), randomRange(-1.0f, 1.0f)));
+}
+
+/** Fills a hand whose joints are shared between consecutive bones, as LeapC reports them. */
+static void synthesizeHand(LEAP_HAND *hand, uint32_t id){
+  memset(hand, 0, sizeof(*hand));
+  hand->id = id;
+  hand->type = (id & 1) ? eLeapHandType_Right : eLeapHandType_Left;
+  hand->confidence = randomRange(0.0f, 1.0f);
+  hand->visible_time = (uint64_t)rand() * 1000;
+  hand->pinch_distance = randomRange(0.0f, 150.0f);
+  hand->grab_angle = randomRange(0.0f, 3.14f);
+  hand->pinch_strength = randomRange(0.0f, 1.0f);
+  hand->grab_strength = randomRange(0.0f, 1.0f);
+  hand->palm.position = randomPosition();
+  hand->palm.stabilized_position = randomPosition();
+  hand->palm.velocity = VectorMake(randomRange(-7999.0f, 7999.0f), randomRange(-7999.0f, 7999.0f), randomRange(-7999.0f, 7999.0f));
+  hand->palm.orientation = randomRotation();
+  hand->palm.width = randomRange(60.0f, 100.0f);
+  for(int f = 0; f < 5; f++){
+    LEAP_DIGIT *digit = &hand->digits[f];
+    float width = randomRange(10.0f, 20.0f);
+    digit->finger_id = (int32_t)(id * 10 + f);
+    digit->is_extended = rand() & 1;
+    LEAP_VECTOR joint = randomPosition();
+    for(int b = 0; b < 4; b++){
+      digit->bones[b].prev_joint = joint;
+      joint = randomPosition();
+      digit->bones[b].next_joint = joint;
+      digit->bones[b].width = width;
+      digit->bones[b].rotation = randomRotation();
+    }
+  }
+  hand->thumb.metacarpal.width = 0.0f;
+  hand->arm.prev_joint = randomPosition();
+  hand->arm.next_joint = randomPosition();
+  hand->arm.width = randomRange(40.0f, 70.0f);
+  hand->arm.rotation = randomRotation();
+}
+
+static float maxAxisError(LEAP_VECTOR a, LEAP_VECTOR b, float current){
+  for(int i = 0; i < 3; i++){
+    float e = fabsf(a.v[i] - b.v[i]);
+    current = e > current ? e : current;
+  }
+  return current;
+}
+
+static float maxAngleError(LEAP_QUATERNION a, LEAP_QUATERNION b, float current){
+  float dot = fabsf(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+  float angle = 2.0f * acosf(dot > 1.0f ? 1.0f : dot);
+  return angle > current ? angle : current;
+}
+
+static float maxWidthError(float a, float b, float current){
+  float e = fabsf(a - b);
+  return e > current ? e : current;
+}
+
+int main(int argc, char** argv) {
+  FrameCodecConfig config;
+  FrameCodecErrorBounds bounds;
+  GetDefaultFrameCodecConfig(&config);
+  GetFrameCodecErrorBounds(&config, &bounds);
+  srand(42);
+
+  LEAP_TRACKING_EVENT *frames = malloc(FRAME_COUNT * sizeof(LEAP_TRACKING_EVENT));
+  LEAP_HAND *hands = malloc((size_t)FRAME_COUNT * FRAME_CODEC_MAX_HANDS * sizeof(LEAP_HAND));
+  uint8_t *encoded = malloc((size_t)FRAME_COUNT * FRAME_CODEC_MAX_SIZE);
+  size_t *sizes = malloc(FRAME_COUNT * sizeof(size_t));
+  if(!frames || !hands || !encoded || !sizes){
+    printf("Failed to allocate frames.\n");
+    return 1;
+  }
+
+  size_t rawBytes = 0, encodedBytes = 0;
+  for(uint32_t i = 0; i < FRAME_COUNT; i++){
+    LEAP_TRACKING_EVENT *frame = &frames[i];
+    memset(frame, 0, sizeof(*frame));
+    frame->info.frame_id = i;
+    frame->info.timestamp = (int64_t)i * 8333;
+    frame->tracking_frame_id = i;
+    frame->framerate = 120.0f;
+    frame->nHands = (uint32_t)(rand() % (FRAME_CODEC_MAX_HANDS + 1));
+    frame->pHands = &hands[(size_t)i * FRAME_CODEC_MAX_HANDS];
+    for(uint32_t h = 0; h < frame->nHands; h++){
+      synthesizeHand(&frame->pHands[h], i * 2 + h);
+    }
+    rawBytes += sizeof(LEAP_TRACKING_EVENT) + frame->nHands * sizeof(LEAP_HAND);
+  }
+
+  int64_t start = LeapGetNow();
+  for(uint32_t i = 0; i < FRAME_COUNT; i++){
+    sizes[i] = EncodeFrame(&config, &frames[i], encoded + (size_t)i * FRAME_CODEC_MAX_SIZE, FRAME_CODEC_MAX_SIZE);
+  }
+  int64_t encodeTime = LeapGetNow() - start;
+
+  LEAP_TRACKING_EVENT decoded;
+  LEAP_HAND decodedHands[FRAME_CODEC_MAX_HANDS];
+  uint32_t failures = 0;
+  start = LeapGetNow();
+  for(uint32_t i = 0; i < FRAME_COUNT; i++){
+    failures += !DecodeFrame(encoded + (size_t)i * FRAME_CODEC_MAX_SIZE, sizes[i], &decoded, decodedHands, FRAME_CODEC_MAX_HANDS);
+  }
+  int64_t decodeTime = LeapGetNow() - start;
+
+  float positionError = 0.0f, velocityError = 0.0f, rotationError = 0.0f, widthError = 0.0f;
+  uint32_t mismatches = 0;
+  for(uint32_t i = 0; i < FRAME_COUNT; i++){
+    const LEAP_TRACKING_EVENT *frame = &frames[i];
+    encodedBytes += sizes[i];
+    DecodeFrame(encoded + (size_t)i * FRAME_CODEC_MAX_SIZE, sizes[i], &decoded, decodedHands, FRAME_CODEC_MAX_HANDS);
+    if(decoded.info.frame_id != frame->info.frame_id || decoded.nHands != frame->nHands){
+      mismatches++;
+      continue;
+    }
+    for(uint32_t h = 0; h < frame->nHands; h++){
+      const LEAP_HAND *a = &frame->pHands[h], *b = &decodedHands[h];
+      mismatches += a->id != b->id || a->type != b->type;
+      positionError = maxAxisError(a->palm.position, b->palm.position, positionError);
+      positionError = maxAxisError(a->palm.stabilized_position, b->palm.stabilized_position, positionError);
+      velocityError = maxAxisError(a->palm.velocity, b->palm.velocity, velocityError);
+      rotationError = maxAngleError(a->palm.orientation, b->palm.orientation, rotationError);
+      widthError = maxWidthError(a->arm.width, b->arm.width, widthError);
+      for(int f = 0; f < 5; f++){
+        mismatches += a->digits[f].is_extended != b->digits[f].is_extended;
+        for(int n = 0; n < 4; n++){
+          const LEAP_BONE *boneA = &a->digits[f].bones[n], *boneB = &b->digits[f].bones[n];
+          positionError = maxAxisError(boneA->prev_joint, boneB->prev_joint, positionError);
+          positionError = maxAxisError(boneA->next_joint, boneB->next_joint, positionError);
+          rotationError = maxAngleError(boneA->rotation, boneB->rotation, rotationError);
+          widthError = maxWidthError(boneA->width, boneB->width, widthError);
+        }
+      }
+      positionError = maxAxisError(a->arm.prev_joint, b->arm.prev_joint, positionError);
+      positionError = maxAxisError(a->arm.next_joint, b->arm.next_joint, positionError);
+      rotationError = maxAngleError(a->arm.rotation, b->arm.rotation, rotationError);
+    }
+  }
+
+  float positionBound = fmaxf(bounds.position.x, fmaxf(bounds.position.y, bounds.position.z));
+  bool withinBounds = positionError <= positionBound && velocityError <= bounds.velocity &&
+                      rotationError <= bounds.rotation && widthError <= bounds.width;
+
+  printf("Frames: %u, %u decode failures, %u mismatched fields\n", FRAME_COUNT, failures, mismatches);
+  printf("Encode: %8.1f ns/frame\n", encodeTime * 1000.0 / FRAME_COUNT);
+  printf("Decode: %8.1f ns/frame\n", decodeTime * 1000.0 / FRAME_COUNT);
+  printf("Size:   %zu bytes/hand encoded vs %zu raw, %.1fx smaller overall\n",
+         (size_t)FRAME_CODEC_HAND_SIZE, sizeof(LEAP_HAND), (double)rawBytes / (double)encodedBytes);
+  printf("%-10s %12s %12s\n", "error", "max", "bound");
+  printf("%-10s %12.5f %12.5f mm\n", "position", positionError, positionBound);
+  printf("%-10s %12.4f %12.4f mm/s\n", "velocity", velocityError, bounds.velocity);
+  printf("%-10s %12.5f %12.5f rad\n", "rotation", rotationError, bounds.rotation);
+  printf("%-10s %12.4f %12.4f mm\n", "width", widthError, bounds.width);
+  printf("All errors %s the documented bounds.\n", withinBounds ? "within" : "OUTSIDE");
+
+  free(frames);
+  free(hands);
+  free(encoded);
+  free(sizes);
+  return (failures || mismatches || !withinBounds) ? 1 : 0;
+}
+//End-of-Sample
@@ -0,0 +1,52 @@
+/* Shared-memory ring of tracking frames, and the reader side of it.
+ *
+ * One process publishes every tracking frame it polls from LeapC into a named
+ * shared-memory ring (see FrameShmPublisher.h). Any number of local processes
+ * map the same ring read-only and fetch the newest frame or the recent
+ * history with plain loads: each slot is guarded by its own seqlock, so
+ * readers never take a lock or make a system call and never slow the writer.
+ *
+ * The reader only needs LeapC.h for the frame types; it does not link LeapC.
+ *
+ */
+
+#ifndef FrameShm_h
+#define FrameShm_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+  #define FRAME_SHM_DEFAULT_NAME "Local\\leapc_frames"
+#else
+  #define FRAME_SHM_DEFAULT_NAME "/leapc_frames"
+#endif
+
+#define FRAME_SHM_MAGIC   0x314D52465041454CULL //"LEAPFRM1"
+#define FRAME_SHM_VERSION 1
+#define FRAME_SHM_MAX_HANDS 2
+
+/** A self-contained tracking frame as stored in the ring. */
+typedef struct _ShmFrame {
+  uint64_t          index;        //Publish index, increases by one per frame
+  int64_t           publish_time; //LeapGetNow() when the publisher wrote the slot
+  uint32_t          device_id;
+  uint32_t          nHands;
+  LEAP_FRAME_HEADER info;         //info.reserved is always NULL
+  int64_t           tracking_frame_id;
+  float             framerate;
+  LEAP_HAND         hands[FRAME_SHM_MAX_HANDS];
+} ShmFrame;
+
+typedef struct _FrameShmReader FrameShmReader;
+
+/* Reader functions */
+FrameShmReader* OpenFrameShmReader(const char *name);
+void CloseFrameShmReader(FrameShmReader *reader);
+uint64_t GetShmFrameCount(const FrameShmReader *reader);
+bool ReadLatestShmFrame(FrameShmReader *reader, ShmFrame *frame);
+uint32_t ReadShmFramesSince(FrameShmReader *reader, uint64_t next_index,
+                            ShmFrame *frames, uint32_t max_frames, uint64_t *missed);
+
+#endif /* FrameShm_h */
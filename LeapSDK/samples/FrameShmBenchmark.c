@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "LeapC.h"
+#include "FrameShm.h"
+#include "LeapThreads.h"
+
+/*
+ Measures how late tracking frames arrive, relative to their LeapC timestamp,
+ for a shared-memory reader and for a second LeapC connection in the same
+ process. Requires FrameShmPublisherSample to be running.
+*/
+
+#define SAMPLE_COUNT 1000
+#define READ_COST_ITERATIONS 1000000
+
+typedef struct _LatencySamples {
+  int64_t values[SAMPLE_COUNT];
+  int     count;
+} LatencySamples;
+
+static int compareInt64(const void* a, const void* b){
+  int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static void printLatency(const char* name, LatencySamples* samples){
+  if(samples->count == 0){
+    printf("%-28s no samples\n", name);
+    return;
+  }
+  double sum = 0;
+  for(int i = 0; i < samples->count; i++)
+    sum += (double)samples->values[i];
+  qsort(samples->values, samples->count, sizeof(int64_t), compareInt64);
+  printf("%-28s mean %8.1f us  p50 %6lli us  p99 %6lli us  max %6lli us\n", name,
+         sum / samples->count,
+         (long long int)samples->values[samples->count / 2],
+         (long long int)samples->values[samples->count * 99 / 100],
+         (long long int)samples->values[samples->count - 1]);
+}
+
+static LatencySamples connectionLatency;
+
+static ThreadReturnType connectionLoop(void* arg){
+  LEAP_CONNECTION connection = (LEAP_CONNECTION)arg;
+  LEAP_CONNECTION_MESSAGE msg;
+  while(connectionLatency.count < SAMPLE_COUNT){
+    if(LeapPollConnection(connection, 1000, &msg) != eLeapRS_Success)
+      continue;
+    if(msg.type == eLeapEventType_Tracking)
+      connectionLatency.values[connectionLatency.count++] = LeapGetNow() - msg.tracking_event->info.timestamp;
+  }
+  return ThreadReturnValue;
+}
+
+int main(int argc, char** argv) {
+  const char* name = argc > 1 ? argv[1] : FRAME_SHM_DEFAULT_NAME;
+  FrameShmReader* reader = OpenFrameShmReader(name);
+  if(!reader){
+    printf("Could not open %s; start FrameShmPublisherSample first.\n", name);
+    return -1;
+  }
+
+  //Cost of a read on its own, with no frame arriving in between
+  ShmFrame frame;
+  int64_t start = LeapGetNow();
+  for(int i = 0; i < READ_COST_ITERATIONS; i++)
+    ReadLatestShmFrame(reader, &frame);
+  int64_t elapsed = LeapGetNow() - start;
+  printf("ReadLatestShmFrame: %.1f ns per call\n", elapsed * 1000.0 / READ_COST_ITERATIONS);
+
+  LEAP_CONNECTION connection;
+  if(LeapCreateConnection(NULL, &connection) != eLeapRS_Success ||
+     LeapOpenConnection(connection) != eLeapRS_Success){
+    printf("Failed to open a second LeapC connection.\n");
+    return -1;
+  }
+  ThreadType connectionThread;
+  StartThread(&connectionThread, connectionLoop, connection);
+
+  static LatencySamples shmLatency, shmHop;
+  uint64_t seen = GetShmFrameCount(reader);
+  while(shmLatency.count < SAMPLE_COUNT){
+    uint64_t count = GetShmFrameCount(reader);
+    if(count == seen){
+      YieldThread();
+      continue;
+    }
+    seen = count;
+    if(ReadLatestShmFrame(reader, &frame)){
+      int64_t now = LeapGetNow();
+      shmLatency.values[shmLatency.count] = now - frame.info.timestamp;
+      shmHop.values[shmLatency.count] = now - frame.publish_time;
+      shmLatency.count++;
+    }
+  }
+  JoinThread(connectionThread);
+
+  printf("Latency from frame timestamp over %d frames:\n", SAMPLE_COUNT);
+  printLatency("shared memory reader", &shmLatency);
+  printLatency("  of which publisher->reader", &shmHop);
+  printLatency("second LeapC connection", &connectionLatency);
+
+  LeapCloseConnection(connection);
+  LeapDestroyConnection(connection);
+  CloseFrameShmReader(reader);
+  return 0;
+}
+//End-of-Sample
@@ -0,0 +1,34 @@
+/* Memory layout of the shared frame ring. Private to FrameShmReader.c and
+ * FrameShmPublisher.c; readers use the functions in FrameShm.h.
+ *
+ */
+
+#ifndef FrameShmLayout_h
+#define FrameShmLayout_h
+
+#include "FrameShm.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define FRAME_SHM_CACHE_LINE 64
+
+typedef struct _ShmSlot {
+  _Alignas(FRAME_SHM_CACHE_LINE) atomic_uint sequence; //Odd while the publisher writes the slot
+  ShmFrame frame;
+} ShmSlot;
+
+typedef struct _ShmRegion {
+  uint64_t    magic;
+  uint32_t    version;
+  uint32_t    slot_count;  //Power of two
+  uint32_t    slot_size;   //sizeof(ShmSlot), guards against mismatched builds
+  uint32_t    reserved;
+  _Alignas(FRAME_SHM_CACHE_LINE) atomic_uint_fast64_t frame_count; //Frames published so far
+  ShmSlot     slots[];
+} ShmRegion;
+
+static inline size_t frameShmRegionSize(uint32_t slot_count){
+  return sizeof(ShmRegion) + (size_t)slot_count * sizeof(ShmSlot);
+}
+
+#endif /* FrameShmLayout_h */
@@ -0,0 +1,137 @@
+/* Writer side of the shared-memory frame ring.
+ *
+ */
+
+#include "FrameShmPublisher.h"
+#include "FrameShmLayout.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(_MSC_VER)
+  #include <Windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+struct _FrameShmPublisher {
+  ShmRegion *region;
+  size_t     size;
+  uint64_t   count;
+  char       name[128];
+#if defined(_MSC_VER)
+  HANDLE     mapping;
+#endif
+};
+
+/**
+ * Creates (or replaces) the named ring with slot_count slots, rounded up to a
+ * power of two. Readers that mapped a previous ring keep the old mapping and
+ * must reopen.
+ */
+FrameShmPublisher* CreateFrameShmPublisher(const char *name, uint32_t slot_count){
+  FrameShmPublisher *publisher = calloc(1, sizeof(FrameShmPublisher));
+  if(!publisher){
+    return NULL;
+  }
+  if(!name){
+    name = FRAME_SHM_DEFAULT_NAME;
+  }
+  strncpy(publisher->name, name, sizeof(publisher->name) - 1);
+  uint32_t slots = 2;
+  while(slots < slot_count){
+    slots <<= 1;
+  }
+  publisher->size = frameShmRegionSize(slots);
+
+#if defined(_MSC_VER)
+  publisher->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                          (DWORD)((uint64_t)publisher->size >> 32),
+                                          (DWORD)publisher->size, name);
+  if(!publisher->mapping){
+    free(publisher);
+    return NULL;
+  }
+  publisher->region = MapViewOfFile(publisher->mapping, FILE_MAP_ALL_ACCESS, 0, 0, publisher->size);
+  if(!publisher->region){
+    CloseHandle(publisher->mapping);
+    free(publisher);
+    return NULL;
+  }
+#else
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if(fd < 0){
+    free(publisher);
+    return NULL;
+  }
+  if(ftruncate(fd, (off_t)publisher->size) != 0){
+    close(fd);
+    shm_unlink(name);
+    free(publisher);
+    return NULL;
+  }
+  void *mapped = mmap(NULL, publisher->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mapped == MAP_FAILED){
+    shm_unlink(name);
+    free(publisher);
+    return NULL;
+  }
+  publisher->region = mapped;
+#endif
+
+  ShmRegion *region = publisher->region;
+  memset(region, 0, publisher->size);
+  region->version = FRAME_SHM_VERSION;
+  region->slot_count = slots;
+  region->slot_size = sizeof(ShmSlot);
+  for(uint32_t i = 0; i < slots; i++){
+    atomic_init(&region->slots[i].sequence, 0);
+  }
+  atomic_init(&region->frame_count, 0);
+  //Readers check the magic last, so publish it after everything else is initialized
+  atomic_thread_fence(memory_order_release);
+  region->magic = FRAME_SHM_MAGIC;
+  return publisher;
+}
+
+void DestroyFrameShmPublisher(FrameShmPublisher *publisher){
+  if(!publisher){
+    return;
+  }
+#if defined(_MSC_VER)
+  UnmapViewOfFile(publisher->region);
+  CloseHandle(publisher->mapping);
+#else
+  munmap(publisher->region, publisher->size);
+  shm_unlink(publisher->name);
+#endif
+  free(publisher);
+}
+
+void PublishShmFrame(FrameShmPublisher *publisher, const LEAP_TRACKING_EVENT *frame, uint32_t device_id){
+  ShmRegion *region = publisher->region;
+  uint64_t index = publisher->count++;
+  ShmSlot *slot = &region->slots[index & (region->slot_count - 1)];
+  uint32_t nHands = frame->nHands < FRAME_SHM_MAX_HANDS ? frame->nHands : FRAME_SHM_MAX_HANDS;
+
+  unsigned int sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+  atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  slot->frame.index = index;
+  slot->frame.publish_time = LeapGetNow();
+  slot->frame.device_id = device_id;
+  slot->frame.nHands = nHands;
+  slot->frame.info = frame->info;
+  slot->frame.info.reserved = NULL;
+  slot->frame.tracking_frame_id = frame->tracking_frame_id;
+  slot->frame.framerate = frame->framerate;
+  memcpy(slot->frame.hands, frame->pHands, nHands * sizeof(LEAP_HAND));
+
+  atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+  atomic_store_explicit(&region->frame_count, index + 1, memory_order_release);
+}
+//End-of-FrameShmPublisher.c
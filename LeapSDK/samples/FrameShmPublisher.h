@@ -0,0 +1,20 @@
+/* Writer side of the shared-memory frame ring (see FrameShm.h).
+ *
+ * PublishShmFrame() is meant to be called from the polling thread, e.g. from
+ * ConnectionCallbacks.on_frame; it copies the frame into the next slot and
+ * never blocks.
+ *
+ */
+
+#ifndef FrameShmPublisher_h
+#define FrameShmPublisher_h
+
+#include "FrameShm.h"
+
+typedef struct _FrameShmPublisher FrameShmPublisher;
+
+FrameShmPublisher* CreateFrameShmPublisher(const char *name, uint32_t slot_count);
+void DestroyFrameShmPublisher(FrameShmPublisher *publisher);
+void PublishShmFrame(FrameShmPublisher *publisher, const LEAP_TRACKING_EVENT *frame, uint32_t device_id);
+
+#endif /* FrameShmPublisher_h */
@@ -0,0 +1,38 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "LeapC.h"
+#include "ExampleConnection.h"
+#include "FrameShmPublisher.h"
+
+/*
+ Publishes every tracking frame into the shared-memory ring so that other local
+ processes can read hands without opening their own LeapC connection. Run
+ FrameShmBenchmark alongside it to compare against a second connection.
+*/
+
+static FrameShmPublisher* publisher;
+
+/** Callback for when a frame of tracking data is available. */
+static void OnFrame(const LEAP_TRACKING_EVENT *frame){
+  PublishShmFrame(publisher, frame, 0);
+}
+
+int main(int argc, char** argv) {
+  const char* name = argc > 1 ? argv[1] : FRAME_SHM_DEFAULT_NAME;
+  publisher = CreateFrameShmPublisher(name, 64);
+  if(!publisher){
+    printf("Failed to create shared memory ring %s.\n", name);
+    return -1;
+  }
+
+  ConnectionCallbacks.on_frame = &OnFrame;
+  OpenConnection();
+
+  printf("Publishing frames to %s. Press Enter to exit program.\n", name);
+  getchar();
+  CloseConnection();
+  DestroyConnection();
+  DestroyFrameShmPublisher(publisher);
+  return 0;
+}
+//End-of-Sample
@@ -0,0 +1,171 @@
+/* Reader side of the shared-memory frame ring.
+ *
+ */
+
+#include "FrameShmLayout.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(_MSC_VER)
+  #include <Windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+//A slot can only be overwritten while it is being read if the reader stalls for a full ring lap.
+#define FRAME_SHM_READ_RETRIES 8
+
+struct _FrameShmReader {
+  const ShmRegion *region;
+  size_t           size;
+#if defined(_MSC_VER)
+  HANDLE           mapping;
+#endif
+};
+
+/** Maps an existing frame ring read-only. Returns NULL if it does not exist or is incompatible. */
+FrameShmReader* OpenFrameShmReader(const char *name){
+  FrameShmReader *reader = calloc(1, sizeof(FrameShmReader));
+  if(!reader){
+    return NULL;
+  }
+  if(!name){
+    name = FRAME_SHM_DEFAULT_NAME;
+  }
+#if defined(_MSC_VER)
+  reader->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+  if(!reader->mapping){
+    free(reader);
+    return NULL;
+  }
+  reader->region = MapViewOfFile(reader->mapping, FILE_MAP_READ, 0, 0, 0);
+  if(!reader->region){
+    CloseHandle(reader->mapping);
+    free(reader);
+    return NULL;
+  }
+  {
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(reader->region, &info, sizeof(info));
+    reader->size = info.RegionSize;
+  }
+#else
+  int fd = shm_open(name, O_RDONLY, 0);
+  if(fd < 0){
+    free(reader);
+    return NULL;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmRegion)){
+    close(fd);
+    free(reader);
+    return NULL;
+  }
+  reader->size = (size_t)st.st_size;
+  void *mapped = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mapped == MAP_FAILED){
+    free(reader);
+    return NULL;
+  }
+  reader->region = mapped;
+#endif
+
+  const ShmRegion *region = reader->region;
+  uint64_t magic = region->magic;
+  atomic_thread_fence(memory_order_acquire);
+  if(magic != FRAME_SHM_MAGIC || region->version != FRAME_SHM_VERSION ||
+     region->slot_size != sizeof(ShmSlot) || reader->size < frameShmRegionSize(region->slot_count)){
+    CloseFrameShmReader(reader);
+    return NULL;
+  }
+  return reader;
+}
+
+void CloseFrameShmReader(FrameShmReader *reader){
+  if(!reader){
+    return;
+  }
+#if defined(_MSC_VER)
+  UnmapViewOfFile(reader->region);
+  CloseHandle(reader->mapping);
+#else
+  munmap((void*)reader->region, reader->size);
+#endif
+  free(reader);
+}
+
+/** Number of frames published so far; the newest has index GetShmFrameCount() - 1. */
+uint64_t GetShmFrameCount(const FrameShmReader *reader){
+  return atomic_load_explicit((atomic_uint_fast64_t*)&reader->region->frame_count, memory_order_acquire);
+}
+
+/** Copies the frame with the given publish index. Fails if it has been overwritten. */
+static bool readSlot(const FrameShmReader *reader, uint64_t index, ShmFrame *frame){
+  const ShmRegion *region = reader->region;
+  ShmSlot *slot = (ShmSlot*)&region->slots[index & (region->slot_count - 1)];
+  for(int attempt = 0; attempt < FRAME_SHM_READ_RETRIES; attempt++){
+    unsigned int before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if(before & 1u){
+      continue;
+    }
+    memcpy(frame, &slot->frame, offsetof(ShmFrame, hands));
+    uint32_t nHands = frame->nHands < FRAME_SHM_MAX_HANDS ? frame->nHands : FRAME_SHM_MAX_HANDS;
+    memcpy(frame->hands, slot->frame.hands, nHands * sizeof(LEAP_HAND));
+    atomic_thread_fence(memory_order_acquire);
+    if(atomic_load_explicit(&slot->sequence, memory_order_relaxed) != before){
+      continue;
+    }
+    if(frame->index != index){
+      return false;
+    }
+    frame->nHands = nHands;
+    return true;
+  }
+  return false;
+}
+
+/** Copies the newest published frame. Returns false if nothing has been published yet. */
+bool ReadLatestShmFrame(FrameShmReader *reader, ShmFrame *frame){
+  for(int attempt = 0; attempt < FRAME_SHM_READ_RETRIES; attempt++){
+    uint64_t count = GetShmFrameCount(reader);
+    if(count == 0){
+      return false;
+    }
+    if(readSlot(reader, count - 1, frame)){
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Copies frames with publish index >= next_index, oldest first, up to
+ * max_frames. Frames that were already overwritten are added to *missed.
+ * Pass the index after the last returned frame on the next call.
+ */
+uint32_t ReadShmFramesSince(FrameShmReader *reader, uint64_t next_index,
+                            ShmFrame *frames, uint32_t max_frames, uint64_t *missed){
+  uint64_t count = GetShmFrameCount(reader);
+  uint64_t oldest = count > reader->region->slot_count ? count - reader->region->slot_count : 0;
+  uint64_t lost = 0;
+  if(next_index < oldest){
+    lost += oldest - next_index;
+    next_index = oldest;
+  }
+  uint32_t n = 0;
+  for(uint64_t index = next_index; index < count && n < max_frames; index++){
+    if(readSlot(reader, index, &frames[n])){
+      n++;
+    } else {
+      lost++;
+    }
+  }
+  if(missed){
+    *missed += lost;
+  }
+  return n;
+}
+//End-of-FrameShmReader.c
@@ -0,0 +1,56 @@
+/* Datagram streaming of tracking frames, and the receiver side of it.
+ *
+ * A streaming server (see FrameStreamServer.h) sends every tracking frame as
+ * one datagram: a small packet header followed by the FrameCodec encoding.
+ * Addresses are given as strings:
+ *
+ *   udp://239.255.76.67:7467  UDP; multicast when the host is a multicast group
+ *   udp://127.0.0.1:7467      UDP unicast
+ *   unix:/tmp/leapc.sock      Unix datagram socket (POSIX only)
+ *
+ * Each packet carries a sequence number, so receivers count lost and
+ * reordered frames instead of silently skipping them. A restarted server
+ * starts again from 0; the receiver follows it rather than discarding its
+ * packets as late. The receiver does not link LeapC.
+ *
+ */
+
+#ifndef FrameStream_h
+#define FrameStream_h
+
+#include "FrameCodec.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAME_STREAM_DEFAULT_ADDRESS "udp://239.255.76.67:7467"
+
+#define FRAME_STREAM_MAGIC        0x3153464C //"LFS1"
+#define FRAME_STREAM_HEADER_SIZE  20
+#define FRAME_STREAM_MAX_PACKET   (FRAME_STREAM_HEADER_SIZE + FRAME_CODEC_MAX_SIZE)
+#define FRAME_STREAM_REORDER_WINDOW 256   //Packets further behind than this mean the server restarted
+
+/** A decoded frame as handed out by the receiver. */
+typedef struct _StreamFrame {
+  uint64_t            sequence;   //Server send order, increases by one per frame
+  int64_t             send_time;  //LeapGetNow() on the server when the frame was queued
+  LEAP_TRACKING_EVENT event;      //event.pHands points at hands below
+  LEAP_HAND           hands[FRAME_CODEC_MAX_HANDS];
+} StreamFrame;
+
+typedef struct _FrameStreamReceiverStats {
+  uint64_t received;   //Frames handed out
+  uint64_t lost;       //Sequence numbers skipped over
+  uint64_t reordered;  //Packets slightly older than one already received; discarded
+  uint64_t resyncs;    //Sequence jumped back past FRAME_STREAM_REORDER_WINDOW; counting restarted there
+  uint64_t malformed;  //Packets that failed to decode
+} FrameStreamReceiverStats;
+
+typedef struct _FrameStreamReceiver FrameStreamReceiver;
+
+/* Receiver functions */
+FrameStreamReceiver* OpenFrameStreamReceiver(const char *address);
+void CloseFrameStreamReceiver(FrameStreamReceiver *receiver);
+bool ReceiveStreamFrame(FrameStreamReceiver *receiver, StreamFrame *frame, uint32_t timeout_ms);
+void GetFrameStreamReceiverStats(const FrameStreamReceiver *receiver, FrameStreamReceiverStats *stats);
+
+#endif /* FrameStream_h */
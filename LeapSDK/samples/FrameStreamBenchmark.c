@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "FrameStreamServer.h"
+#include "LeapThreads.h"
+
+/*
+ Streams synthetic two-hand frames through a FrameStreamServer to a receiver
+ in the same process, standing in for a render node. Reports sustained
+ messages per second with the producer unthrottled, then end-to-end latency
+ with the producer paced like a fast device. No device is required.
+
+ Usage: FrameStreamBenchmark [address]
+*/
+
+#if defined(_MSC_VER)
+  #define BENCHMARK_ADDRESS "udp://127.0.0.1:7468"
+#else
+  #define BENCHMARK_ADDRESS "unix:/tmp/leapc_stream_benchmark.sock"
+#endif
+
+#define THROUGHPUT_US 1000000
+#define SAMPLE_COUNT 2000
+#define PACED_INTERVAL_US 1000
+
+typedef struct _Producer {
+  FrameStreamServer  *server;
+  LEAP_TRACKING_EVENT frame;
+  LEAP_HAND           hands[2];
+  int64_t             duration_us;   //Throughput phase: push for this long
+  uint32_t            paced_count;   //Latency phase: push this many, one per interval
+  uint64_t            pushed;
+} Producer;
+
+static int compareInt64(const void* a, const void* b){
+  int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static ThreadReturnType produce(void* arg){
+  Producer* producer = arg;
+  int64_t start = LeapGetNow();
+  if(producer->duration_us){
+    while(LeapGetNow() - start < producer->duration_us){
+      producer->frame.info.frame_id++;
+      PushStreamFrame(producer->server, &producer->frame);
+      producer->pushed++;
+    }
+  } else {
+    for(uint32_t i = 0; i < producer->paced_count; i++){
+      while(LeapGetNow() - start < (int64_t)i * PACED_INTERVAL_US)
+        YieldThread();
+      producer->frame.info.frame_id++;
+      PushStreamFrame(producer->server, &producer->frame);
+      producer->pushed++;
+    }
+  }
+  return ThreadReturnValue;
+}
+
+static void initProducer(Producer* producer, FrameStreamServer* server){
+  memset(producer, 0, sizeof(*producer));
+  producer->server = server;
+  for(int h = 0; h < 2; h++){
+    LEAP_HAND* hand = &producer->hands[h];
+    hand->id = h + 1;
+    hand->type = h ? eLeapHandType_Right : eLeapHandType_Left;
+    hand->palm.position.y = 200.0f;
+    hand->palm.orientation.w = 1.0f;
+    hand->arm.rotation.w = 1.0f;
+    for(int b = 0; b < 20; b++)
+      hand->digits[b / 4].bones[b % 4].rotation.w = 1.0f;
+  }
+  producer->frame.nHands = 2;
+  producer->frame.pHands = producer->hands;
+  producer->frame.framerate = 120.0f;
+}
+
+/** Runs one phase; fills latencies (if not NULL) and returns frames received. */
+static uint64_t runPhase(Producer* producer, FrameStreamReceiver* receiver,
+                         int64_t* latencies, uint32_t* latencyCount, int64_t* elapsed){
+  ThreadType thread;
+  StreamFrame frame;
+  uint64_t received = 0;
+  int64_t start = LeapGetNow(), last = start;
+  if(!StartThread(&thread, produce, producer))
+    return 0;
+  //Drain until the stream has been quiet for a while after the producer is done
+  while(ReceiveStreamFrame(receiver, &frame, 200)){
+    last = LeapGetNow();
+    if(latencies && *latencyCount < SAMPLE_COUNT)
+      latencies[(*latencyCount)++] = last - frame.send_time;
+    received++;
+  }
+  JoinThread(thread);
+  *elapsed = last - start;
+  return received;
+}
+
+int main(int argc, char** argv) {
+  const char* address = argc > 1 ? argv[1] : BENCHMARK_ADDRESS;
+  FrameStreamReceiver* receiver = OpenFrameStreamReceiver(address);
+  FrameStreamServer* server = CreateFrameStreamServer(address, NULL, 1024);
+  if(!receiver || !server){
+    printf("Failed to open %s.\n", address);
+    return 1;
+  }
+  printf("Streaming over %s, %u bytes per two-hand frame.\n", address,
+         (unsigned)(FRAME_STREAM_HEADER_SIZE + GetEncodedFrameSize(2)));
+
+  Producer producer;
+  FrameStreamServerStats serverStats;
+  FrameStreamReceiverStats receiverStats;
+  int64_t elapsed;
+
+  initProducer(&producer, server);
+  producer.duration_us = THROUGHPUT_US;
+  uint64_t received = runPhase(&producer, receiver, NULL, NULL, &elapsed);
+  GetFrameStreamServerStats(server, &serverStats);
+  GetFrameStreamReceiverStats(receiver, &receiverStats);
+  printf("Unthrottled: pushed %llu, queue drops %llu, sent %llu in %llu batches, socket drops %llu\n",
+         (unsigned long long)producer.pushed, (unsigned long long)serverStats.dropped,
+         (unsigned long long)serverStats.sent, (unsigned long long)serverStats.batches,
+         (unsigned long long)serverStats.failed);
+  printf("             received %llu (%.0f msgs/s), lost %llu, reordered %llu\n",
+         (unsigned long long)received, elapsed > 0 ? received * 1e6 / (double)elapsed : 0.0,
+         (unsigned long long)receiverStats.lost, (unsigned long long)receiverStats.reordered);
+
+  static int64_t latencies[SAMPLE_COUNT];
+  uint32_t latencyCount = 0;
+  uint64_t lostBefore = receiverStats.lost;
+  initProducer(&producer, server);
+  producer.paced_count = SAMPLE_COUNT;
+  runPhase(&producer, receiver, latencies, &latencyCount, &elapsed);
+  GetFrameStreamReceiverStats(receiver, &receiverStats);
+  if(latencyCount){
+    qsort(latencies, latencyCount, sizeof(int64_t), compareInt64);
+    printf("Paced %u Hz: %u frames, lost %llu, latency p50 %lli us  p99 %lli us  max %lli us\n",
+           1000000 / PACED_INTERVAL_US, latencyCount,
+           (unsigned long long)(receiverStats.lost - lostBefore),
+           (long long int)latencies[latencyCount / 2],
+           (long long int)latencies[latencyCount * 99 / 100],
+           (long long int)latencies[latencyCount - 1]);
+  }
+
+  DestroyFrameStreamServer(server);
+  CloseFrameStreamReceiver(receiver);
+  return 0;
+}
+//End-of-Sample
@@ -0,0 +1,205 @@
+/* Receiver side of the datagram frame stream.
+ *
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+  #define _GNU_SOURCE //recvmmsg()
+#endif
+#include "FrameStream.h"
+#include "FrameStreamSocket.h"
+#include <stdlib.h>
+#include <string.h>
+#if !defined(_MSC_VER)
+  #include <sys/select.h>
+#endif
+
+#define RECEIVE_BATCH 16
+
+struct _FrameStreamReceiver {
+  SocketType    socket;
+  StreamAddress address;
+  bool          started;      //Whether a sequence number has been seen yet
+  uint64_t      nextSequence;
+
+  //Datagrams read by the last batch receive, handed out one at a time
+  uint8_t       packets[RECEIVE_BATCH][FRAME_STREAM_MAX_PACKET];
+  size_t        sizes[RECEIVE_BATCH];
+  uint32_t      count;
+  uint32_t      next;
+
+  FrameStreamReceiverStats stats;
+};
+
+/**
+ * Binds to address (see FrameStream.h), joining the group for multicast
+ * addresses. A Unix socket path is created by the receiver and removed again
+ * by CloseFrameStreamReceiver().
+ */
+FrameStreamReceiver* OpenFrameStreamReceiver(const char *address){
+  FrameStreamReceiver *receiver = calloc(1, sizeof(FrameStreamReceiver));
+  if(!receiver){
+    return NULL;
+  }
+  receiver->socket = INVALID_SOCKET_VALUE;
+  if(!parseStreamAddress(address ? address : FRAME_STREAM_DEFAULT_ADDRESS, &receiver->address) ||
+     !startSockets()){
+    free(receiver);
+    return NULL;
+  }
+  receiver->socket = socket(receiver->address.family, SOCK_DGRAM, 0);
+  if(receiver->socket == INVALID_SOCKET_VALUE){
+    goto fail;
+  }
+
+  //Room for a few hundred milliseconds of frames if the reader stalls
+  int bufferSize = 1 << 20;
+  setsockopt(receiver->socket, SOL_SOCKET, SO_RCVBUF, (const char *)&bufferSize, sizeof(bufferSize));
+
+  if(receiver->address.family == AF_INET){
+    struct sockaddr_in bindAddress = *(struct sockaddr_in *)&receiver->address.addr;
+    if(receiver->address.multicast){
+      //Several receivers on one host may join the same group
+      int reuse = 1;
+      setsockopt(receiver->socket, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+      bindAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+    }
+    if(bind(receiver->socket, (const struct sockaddr *)&bindAddress, sizeof(bindAddress)) != 0){
+      goto fail;
+    }
+    if(receiver->address.multicast){
+      struct ip_mreq membership;
+      membership.imr_multiaddr = ((struct sockaddr_in *)&receiver->address.addr)->sin_addr;
+      membership.imr_interface.s_addr = htonl(INADDR_ANY);
+      if(setsockopt(receiver->socket, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                    (const char *)&membership, sizeof(membership)) != 0){
+        goto fail;
+      }
+    }
+  }
+#if !defined(_MSC_VER)
+  else {
+    unlink(((struct sockaddr_un *)&receiver->address.addr)->sun_path);
+    if(bind(receiver->socket, (const struct sockaddr *)&receiver->address.addr, receiver->address.length) != 0){
+      goto fail;
+    }
+  }
+#endif
+  return receiver;
+
+fail:
+  if(receiver->socket != INVALID_SOCKET_VALUE){
+    closeSocket(receiver->socket);
+  }
+  stopSockets();
+  free(receiver);
+  return NULL;
+}
+
+void CloseFrameStreamReceiver(FrameStreamReceiver *receiver){
+  if(!receiver){
+    return;
+  }
+  closeSocket(receiver->socket);
+#if !defined(_MSC_VER)
+  if(receiver->address.family == AF_UNIX){
+    unlink(((struct sockaddr_un *)&receiver->address.addr)->sun_path);
+  }
+#endif
+  stopSockets();
+  free(receiver);
+}
+
+/** Waits up to timeout_ms for the socket to become readable. */
+static bool waitReadable(FrameStreamReceiver *receiver, uint32_t timeout_ms){
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(receiver->socket, &readable);
+  struct timeval timeout;
+  timeout.tv_sec = (long)(timeout_ms / 1000);
+  timeout.tv_usec = (long)(timeout_ms % 1000) * 1000;
+  return select((int)receiver->socket + 1, &readable, NULL, NULL, &timeout) > 0;
+}
+
+/** Reads as many waiting datagrams as fit in the batch, without blocking. */
+static uint32_t receiveBatch(FrameStreamReceiver *receiver){
+#if defined(__linux__)
+  struct mmsghdr messages[RECEIVE_BATCH];
+  struct iovec vectors[RECEIVE_BATCH];
+  memset(messages, 0, sizeof(messages));
+  for(uint32_t i = 0; i < RECEIVE_BATCH; i++){
+    vectors[i].iov_base = receiver->packets[i];
+    vectors[i].iov_len = FRAME_STREAM_MAX_PACKET;
+    messages[i].msg_hdr.msg_iov = &vectors[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  int n = recvmmsg(receiver->socket, messages, RECEIVE_BATCH, MSG_DONTWAIT, NULL);
+  for(int i = 0; i < n; i++){
+    receiver->sizes[i] = messages[i].msg_len;
+  }
+  return n > 0 ? (uint32_t)n : 0;
+#else
+  //One datagram per call
+  if(!waitReadable(receiver, 0)){
+    return 0;
+  }
+  int n = recv(receiver->socket, (char *)receiver->packets[0], FRAME_STREAM_MAX_PACKET, 0);
+  receiver->sizes[0] = n > 0 ? (size_t)n : 0;
+  return n > 0 ? 1 : 0;
+#endif
+}
+
+/** Decodes one datagram and updates the loss counters. Returns false if it is not handed out. */
+static bool acceptPacket(FrameStreamReceiver *receiver, const uint8_t *packet, size_t size, StreamFrame *frame){
+  if(!getStreamHeader(packet, size, &frame->sequence, &frame->send_time) ||
+     !DecodeFrame(packet + FRAME_STREAM_HEADER_SIZE, size - FRAME_STREAM_HEADER_SIZE,
+                  &frame->event, frame->hands, FRAME_CODEC_MAX_HANDS)){
+    receiver->stats.malformed++;
+    return false;
+  }
+  if(receiver->started && frame->sequence < receiver->nextSequence){
+    if(receiver->nextSequence - frame->sequence <= FRAME_STREAM_REORDER_WINDOW){
+      receiver->stats.reordered++;
+      return false;
+    }
+    //Too far back to be late: the server restarted, so follow its new sequence
+    receiver->stats.resyncs++;
+    receiver->nextSequence = frame->sequence;
+  }
+  if(receiver->started){
+    receiver->stats.lost += frame->sequence - receiver->nextSequence;
+  }
+  receiver->started = true;
+  receiver->nextSequence = frame->sequence + 1;
+  receiver->stats.received++;
+  return true;
+}
+
+/**
+ * Returns the next frame in sequence order, waiting up to timeout_ms for one
+ * to arrive. Late packets are counted and discarded rather than handed out
+ * out of order.
+ */
+bool ReceiveStreamFrame(FrameStreamReceiver *receiver, StreamFrame *frame, uint32_t timeout_ms){
+  bool waited = false;
+  for(;;){
+    while(receiver->next < receiver->count){
+      uint32_t i = receiver->next++;
+      if(acceptPacket(receiver, receiver->packets[i], receiver->sizes[i], frame)){
+        return true;
+      }
+    }
+    receiver->next = 0;
+    receiver->count = receiveBatch(receiver);
+    if(receiver->count == 0){
+      if(waited || !waitReadable(receiver, timeout_ms)){
+        return false;
+      }
+      waited = true;
+    }
+  }
+}
+
+void GetFrameStreamReceiverStats(const FrameStreamReceiver *receiver, FrameStreamReceiverStats *stats){
+  *stats = receiver->stats;
+}
+//End-of-FrameStreamReceiver.c
@@ -0,0 +1,227 @@
+/* Sender side of the datagram frame stream.
+ *
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+  #define _GNU_SOURCE //sendmmsg()
+#endif
+#include "FrameStreamServer.h"
+#include "FrameStreamSocket.h"
+#include "LeapThreads.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#if !defined(_MSC_VER)
+  #include <errno.h>
+#endif
+
+#define STREAM_BATCH 32
+#define STREAM_IDLE_WAIT_MS 100
+
+typedef struct _StreamPacket {
+  size_t  size;
+  uint8_t data[FRAME_STREAM_MAX_PACKET];
+} StreamPacket;
+
+struct _FrameStreamServer {
+  SocketType       socket;
+  StreamAddress    destination;
+  FrameCodecConfig config;
+  StreamPacket    *packets;
+  uint32_t         capacity;    //Power of two
+  uint64_t         sequence;    //Owned by the pushing thread
+
+  //Single producer, single consumer
+  _Alignas(64) atomic_uint_fast64_t head; //Next packet to send; written by the sender thread
+  _Alignas(64) atomic_uint_fast64_t tail; //Next packet to fill; written by PushStreamFrame()
+
+  atomic_uint_fast64_t queued;
+  atomic_uint_fast64_t dropped;
+  atomic_uint_fast64_t sent;
+  atomic_uint_fast64_t failed;
+  atomic_uint_fast64_t batches;
+
+  atomic_int       running;
+  atomic_int       waiting;
+  LockType         waitLock;
+  CondType         waitCond;
+  ThreadType       thread;
+};
+
+/** Sends count packets starting at head; returns how many the socket took. */
+static uint32_t sendBatch(FrameStreamServer *server, uint64_t head, uint32_t count){
+  uint32_t mask = server->capacity - 1;
+#if defined(__linux__)
+  struct mmsghdr messages[STREAM_BATCH];
+  struct iovec vectors[STREAM_BATCH];
+  for(uint32_t i = 0; i < count; i++){
+    StreamPacket *packet = &server->packets[(head + i) & mask];
+    vectors[i].iov_base = packet->data;
+    vectors[i].iov_len = packet->size;
+    memset(&messages[i], 0, sizeof(messages[i]));
+    messages[i].msg_hdr.msg_name = &server->destination.addr;
+    messages[i].msg_hdr.msg_namelen = server->destination.length;
+    messages[i].msg_hdr.msg_iov = &vectors[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+  }
+  uint32_t sent = 0;
+  while(sent < count){
+    int n = sendmmsg(server->socket, messages + sent, count - sent, MSG_DONTWAIT);
+    if(n > 0){
+      sent += (uint32_t)n;
+    } else if(n < 0 && errno == EINTR){
+      continue;
+    } else {
+      //A full receive buffer or no receiver; drop this datagram, keep the rest fresh
+      atomic_fetch_add_explicit(&server->failed, 1, memory_order_relaxed);
+      count--;
+      memmove(messages + sent, messages + sent + 1, (count - sent) * sizeof(messages[0]));
+    }
+  }
+#else
+  uint32_t sent = 0;
+  for(uint32_t i = 0; i < count; i++){
+    StreamPacket *packet = &server->packets[(head + i) & mask];
+    if(sendto(server->socket, (const char *)packet->data, (int)packet->size, 0,
+              (const struct sockaddr *)&server->destination.addr, server->destination.length) >= 0){
+      sent++;
+    } else {
+      atomic_fetch_add_explicit(&server->failed, 1, memory_order_relaxed);
+    }
+  }
+#endif
+  atomic_fetch_add_explicit(&server->batches, 1, memory_order_relaxed);
+  return sent;
+}
+
+static ThreadReturnType senderThread(void *arg){
+  FrameStreamServer *server = arg;
+  uint64_t head = atomic_load_explicit(&server->head, memory_order_relaxed);
+  while(atomic_load(&server->running)){
+    uint64_t tail = atomic_load_explicit(&server->tail, memory_order_acquire);
+    if(tail == head){
+      LockMutex(&server->waitLock);
+      BeginWait(&server->waiting);
+      if(atomic_load(&server->tail) == head && atomic_load(&server->running)){
+        WaitCond(&server->waitCond, &server->waitLock, STREAM_IDLE_WAIT_MS);
+      }
+      EndWait(&server->waiting);
+      UnlockMutex(&server->waitLock);
+      continue;
+    }
+    uint32_t count = (uint32_t)(tail - head) < STREAM_BATCH ? (uint32_t)(tail - head) : STREAM_BATCH;
+    uint32_t sent = sendBatch(server, head, count);
+    atomic_fetch_add_explicit(&server->sent, sent, memory_order_relaxed);
+    head += count;
+    atomic_store_explicit(&server->head, head, memory_order_release);
+  }
+  return ThreadReturnValue;
+}
+
+/**
+ * Opens a socket towards address (see FrameStream.h) and starts the sender
+ * thread. config may be NULL for the default quantization ranges;
+ * queue_capacity is rounded up to a power of two.
+ */
+FrameStreamServer* CreateFrameStreamServer(const char *address, const FrameCodecConfig *config,
+                                           uint32_t queue_capacity){
+  FrameStreamServer *server = calloc(1, sizeof(FrameStreamServer));
+  if(!server){
+    return NULL;
+  }
+  server->socket = INVALID_SOCKET_VALUE;
+  if(!parseStreamAddress(address ? address : FRAME_STREAM_DEFAULT_ADDRESS, &server->destination) ||
+     !startSockets()){
+    free(server);
+    return NULL;
+  }
+  if(config){
+    server->config = *config;
+  } else {
+    GetDefaultFrameCodecConfig(&server->config);
+  }
+  server->capacity = 2;
+  while(server->capacity < queue_capacity){
+    server->capacity <<= 1;
+  }
+  server->packets = malloc((size_t)server->capacity * sizeof(StreamPacket));
+  server->socket = socket(server->destination.family, SOCK_DGRAM, 0);
+  if(!server->packets || server->socket == INVALID_SOCKET_VALUE){
+    goto fail;
+  }
+  if(server->destination.multicast){
+    //Stay on this host's network segment, and deliver to local receivers too
+    int ttl = 1, loop = 1;
+    setsockopt(server->socket, IPPROTO_IP, IP_MULTICAST_TTL, (const char *)&ttl, sizeof(ttl));
+    setsockopt(server->socket, IPPROTO_IP, IP_MULTICAST_LOOP, (const char *)&loop, sizeof(loop));
+  }
+
+  InitLock(&server->waitLock);
+  InitCond(&server->waitCond);
+  atomic_store(&server->running, 1);
+  if(!StartThread(&server->thread, senderThread, server)){
+    DestroyCond(&server->waitCond);
+    DestroyLock(&server->waitLock);
+    goto fail;
+  }
+  return server;
+
+fail:
+  if(server->socket != INVALID_SOCKET_VALUE){
+    closeSocket(server->socket);
+  }
+  stopSockets();
+  free(server->packets);
+  free(server);
+  return NULL;
+}
+
+void DestroyFrameStreamServer(FrameStreamServer *server){
+  if(!server){
+    return;
+  }
+  LockMutex(&server->waitLock);
+  atomic_store(&server->running, 0);
+  SignalCond(&server->waitCond);
+  UnlockMutex(&server->waitLock);
+  JoinThread(server->thread);
+  DestroyCond(&server->waitCond);
+  DestroyLock(&server->waitLock);
+  closeSocket(server->socket);
+  stopSockets();
+  free(server->packets);
+  free(server);
+}
+
+/**
+ * Encodes frame and queues it for sending. Returns false if the queue was
+ * full; the frame's sequence number is still consumed, so receivers see the
+ * drop as loss.
+ */
+bool PushStreamFrame(FrameStreamServer *server, const LEAP_TRACKING_EVENT *frame){
+  uint64_t sequence = server->sequence++;
+  uint64_t tail = atomic_load_explicit(&server->tail, memory_order_relaxed);
+  if(tail - atomic_load_explicit(&server->head, memory_order_acquire) >= server->capacity){
+    atomic_fetch_add_explicit(&server->dropped, 1, memory_order_relaxed);
+    return false;
+  }
+
+  StreamPacket *packet = &server->packets[tail & (server->capacity - 1)];
+  putStreamHeader(packet->data, sequence, LeapGetNow());
+  packet->size = FRAME_STREAM_HEADER_SIZE +
+                 EncodeFrame(&server->config, frame, packet->data + FRAME_STREAM_HEADER_SIZE, FRAME_CODEC_MAX_SIZE);
+  atomic_store_explicit(&server->tail, tail + 1, memory_order_release);
+  atomic_fetch_add_explicit(&server->queued, 1, memory_order_relaxed);
+
+  WakeWaiter(&server->waiting, &server->waitLock, &server->waitCond);
+  return true;
+}
+
+void GetFrameStreamServerStats(const FrameStreamServer *server, FrameStreamServerStats *stats){
+  stats->queued = atomic_load_explicit(&server->queued, memory_order_relaxed);
+  stats->dropped = atomic_load_explicit(&server->dropped, memory_order_relaxed);
+  stats->sent = atomic_load_explicit(&server->sent, memory_order_relaxed);
+  stats->failed = atomic_load_explicit(&server->failed, memory_order_relaxed);
+  stats->batches = atomic_load_explicit(&server->batches, memory_order_relaxed);
+}
+//End-of-FrameStreamServer.c
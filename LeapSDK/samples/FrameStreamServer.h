@@ -0,0 +1,31 @@
+/* Sender side of the datagram frame stream (see FrameStream.h).
+ *
+ * PushStreamFrame() is meant to be called from the polling thread: it encodes
+ * the frame into a preallocated queue slot and returns. A sender thread drains
+ * the queue in batches (one sendmmsg() call per batch on Linux), so a slow
+ * network or receiver can only cost frames, never poller time.
+ *
+ */
+
+#ifndef FrameStreamServer_h
+#define FrameStreamServer_h
+
+#include "FrameStream.h"
+
+typedef struct _FrameStreamServerStats {
+  uint64_t queued;   //Frames accepted by PushStreamFrame()
+  uint64_t dropped;  //Frames refused because the queue was full
+  uint64_t sent;     //Datagrams handed to the socket
+  uint64_t failed;   //Datagrams the socket refused, e.g. no receiver bound
+  uint64_t batches;  //Send calls, for the average batch size
+} FrameStreamServerStats;
+
+typedef struct _FrameStreamServer FrameStreamServer;
+
+FrameStreamServer* CreateFrameStreamServer(const char *address, const FrameCodecConfig *config,
+                                           uint32_t queue_capacity);
+void DestroyFrameStreamServer(FrameStreamServer *server);
+bool PushStreamFrame(FrameStreamServer *server, const LEAP_TRACKING_EVENT *frame);
+void GetFrameStreamServerStats(const FrameStreamServer *server, FrameStreamServerStats *stats);
+
+#endif /* FrameStreamServer_h */
@@ -0,0 +1,132 @@
+/* Socket plumbing and packet header shared by FrameStreamServer.c and
+ * FrameStreamReceiver.c; main.c reuses the address parsing for its control
+ * socket. Private; applications use FrameStream.h.
+ *
+ */
+
+#ifndef FrameStreamSocket_h
+#define FrameStreamSocket_h
+
+#include "FrameStream.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_MSC_VER)
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  #define SocketType SOCKET
+  #define INVALID_SOCKET_VALUE INVALID_SOCKET
+#else
+  #include <arpa/inet.h>
+  #include <netinet/in.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+  #define SocketType int
+  #define INVALID_SOCKET_VALUE (-1)
+#endif
+
+typedef struct _StreamAddress {
+  struct sockaddr_storage addr;
+  socklen_t               length;
+  int                     family;     //AF_INET or AF_UNIX
+  bool                    multicast;
+} StreamAddress;
+
+static inline bool startSockets(void){
+#if defined(_MSC_VER)
+  WSADATA data;
+  return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+  return true;
+#endif
+}
+
+static inline void stopSockets(void){
+#if defined(_MSC_VER)
+  WSACleanup();
+#endif
+}
+
+static inline void closeSocket(SocketType s){
+#if defined(_MSC_VER)
+  closesocket(s);
+#else
+  close(s);
+#endif
+}
+
+/** Parses "udp://a.b.c.d:port" or "unix:/path". */
+static inline bool parseStreamAddress(const char *text, StreamAddress *address){
+  memset(address, 0, sizeof(*address));
+  if(strncmp(text, "udp://", 6) == 0){
+    char host[64];
+    const char *colon = strrchr(text + 6, ':');
+    size_t hostLength = colon ? (size_t)(colon - (text + 6)) : 0;
+    if(!colon || hostLength == 0 || hostLength >= sizeof(host)){
+      return false;
+    }
+    memcpy(host, text + 6, hostLength);
+    host[hostLength] = '\0';
+    int port = atoi(colon + 1);
+    struct sockaddr_in *in = (struct sockaddr_in *)&address->addr;
+    in->sin_family = AF_INET;
+    in->sin_port = htons((uint16_t)port);
+    if(port <= 0 || port > 65535 || inet_pton(AF_INET, host, &in->sin_addr) != 1){
+      return false;
+    }
+    address->family = AF_INET;
+    address->length = sizeof(struct sockaddr_in);
+    address->multicast = (ntohl(in->sin_addr.s_addr) >> 28) == 0xE;
+    return true;
+  }
+#if !defined(_MSC_VER)
+  if(strncmp(text, "unix:", 5) == 0){
+    struct sockaddr_un *un = (struct sockaddr_un *)&address->addr;
+    size_t pathLength = strlen(text + 5);
+    if(pathLength == 0 || pathLength >= sizeof(un->sun_path)){
+      return false;
+    }
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, text + 5, pathLength + 1);
+    address->family = AF_UNIX;
+    address->length = (socklen_t)sizeof(struct sockaddr_un);
+    return true;
+  }
+#endif
+  return false;
+}
+
+static inline void putStreamHeader(uint8_t *p, uint64_t sequence, int64_t send_time){
+  uint64_t fields[2] = { sequence, (uint64_t)send_time };
+  for(int i = 0; i < 4; i++){
+    p[i] = (uint8_t)((uint32_t)FRAME_STREAM_MAGIC >> (8 * i));
+  }
+  for(int f = 0; f < 2; f++){
+    for(int i = 0; i < 8; i++){
+      p[4 + f * 8 + i] = (uint8_t)(fields[f] >> (8 * i));
+    }
+  }
+}
+
+static inline bool getStreamHeader(const uint8_t *p, size_t size, uint64_t *sequence, int64_t *send_time){
+  uint32_t magic = 0;
+  uint64_t fields[2] = { 0, 0 };
+  if(size < FRAME_STREAM_HEADER_SIZE){
+    return false;
+  }
+  for(int i = 0; i < 4; i++){
+    magic |= (uint32_t)p[i] << (8 * i);
+  }
+  for(int f = 0; f < 2; f++){
+    for(int i = 0; i < 8; i++){
+      fields[f] |= (uint64_t)p[4 + f * 8 + i] << (8 * i);
+    }
+  }
+  *sequence = fields[0];
+  *send_time = (int64_t)fields[1];
+  return magic == FRAME_STREAM_MAGIC;
+}
+
+#endif /* FrameStreamSocket_h */
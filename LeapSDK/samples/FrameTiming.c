@@ -0,0 +1,286 @@
+/* Streaming analysis of tracking frame timing, per device.
+ *
+ * Each device record has two halves: the accumulators of the open window,
+ * which only the polling thread touches, and the published windows and
+ * histogram, which are written under the lock when a window closes. The
+ * polling thread also adds devices under the lock, so it can read the device
+ * table without it.
+ *
+ */
+
+#include "FrameTiming.h"
+#include "LeapThreads.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Weight of each healthy window in a device's baseline framerate.
+#define FRAME_TIMING_BASELINE_WEIGHT 0.1f
+
+typedef struct _DeviceTiming {
+  uint32_t           device_id;
+  //Open window; polling thread only
+  bool               started;
+  int64_t            lastTimestamp;     //Latest seen, so one stamp going backwards does not distort the next interval
+  int64_t            lastFrameId;
+  int64_t            windowStart;
+  uint32_t           frames;
+  uint32_t           intervals;
+  uint32_t           dropped;
+  uint32_t           nonMonotonic;
+  double             intervalSum;
+  double             intervalSquares;
+  double             framerateSum;
+  int64_t            minInterval;
+  int64_t            maxInterval;
+  float              baseline;
+  uint32_t           buckets[FRAME_TIMING_BUCKETS];
+  //Published under the lock
+  FrameTimingWindow *ring;
+  uint64_t           count;
+  uint64_t           histogram[FRAME_TIMING_BUCKETS];
+} DeviceTiming;
+
+struct _FrameTiming {
+  FrameTimingConfig config;
+  LockType          lock;
+  uint32_t          deviceCount;
+  DeviceTiming      devices[FRAME_TIMING_MAX_DEVICES];
+  FrameTimingStats  stats;
+};
+
+void GetDefaultFrameTimingConfig(FrameTimingConfig *config){
+  memset(config, 0, sizeof(FrameTimingConfig));
+  config->window_us = 1000000;
+  config->history = 600;
+  config->collapse_ratio = 0.5f;
+}
+
+FrameTiming* CreateFrameTiming(const FrameTimingConfig *config){
+  FrameTimingConfig defaults;
+  if(!config){
+    GetDefaultFrameTimingConfig(&defaults);
+    config = &defaults;
+  }
+  if(config->window_us <= 0 || config->history == 0){
+    return NULL;
+  }
+  FrameTiming *timing = calloc(1, sizeof(FrameTiming));
+  if(!timing){
+    return NULL;
+  }
+  timing->config = *config;
+  InitLock(&timing->lock);
+  return timing;
+}
+
+void DestroyFrameTiming(FrameTiming *timing){
+  if(!timing){
+    return;
+  }
+  for(uint32_t d = 0; d < timing->deviceCount; d++){
+    free(timing->devices[d].ring);
+  }
+  DestroyLock(&timing->lock);
+  free(timing);
+}
+
+static DeviceTiming* findDevice(FrameTiming *timing, uint32_t device_id){
+  for(uint32_t d = 0; d < timing->deviceCount; d++){
+    if(timing->devices[d].device_id == device_id){
+      return &timing->devices[d];
+    }
+  }
+  return NULL;
+}
+
+static DeviceTiming* addDevice(FrameTiming *timing, uint32_t device_id){
+  if(timing->deviceCount == FRAME_TIMING_MAX_DEVICES){
+    return NULL;
+  }
+  FrameTimingWindow *ring = malloc((size_t)timing->config.history * sizeof(FrameTimingWindow));
+  if(!ring){
+    return NULL;
+  }
+  LockMutex(&timing->lock);
+  DeviceTiming *device = &timing->devices[timing->deviceCount++];
+  device->device_id = device_id;
+  device->ring = ring;
+  timing->stats.devices = timing->deviceCount;
+  UnlockMutex(&timing->lock);
+  return device;
+}
+
+/** Upper edge of the bucket holding the given fraction of the intervals. */
+static float percentile(const uint32_t *buckets, uint32_t total, float fraction){
+  uint32_t target = (uint32_t)(fraction * (float)(total - 1)) + 1, seen = 0;
+  for(int b = 0; b < FRAME_TIMING_BUCKETS; b++){
+    seen += buckets[b];
+    if(seen >= target){
+      return (float)((b + 1) * FRAME_TIMING_BUCKET_US);
+    }
+  }
+  return (float)(FRAME_TIMING_BUCKETS * FRAME_TIMING_BUCKET_US);
+}
+
+/** Summarises the open window as ending at end, publishes it and opens the next one there. */
+static void closeWindow(FrameTiming *timing, DeviceTiming *device, int64_t end){
+  FrameTimingWindow window;
+  memset(&window, 0, sizeof(window));
+  window.start = device->windowStart;
+  window.end = end;
+  window.device_id = device->device_id;
+  window.frames = device->frames;
+  window.dropped = device->dropped;
+  window.nonMonotonic = device->nonMonotonic;
+  window.reportedFramerate = device->frames ? (float)(device->framerateSum / device->frames) : 0.0f;
+  window.measuredFramerate = (float)(device->frames * 1e6 / (double)(end - device->windowStart));
+  window.baselineFramerate = device->baseline;
+  if(device->intervals){
+    double mean = device->intervalSum / device->intervals;
+    double variance = device->intervalSquares / device->intervals - mean * mean;
+    window.meanInterval = (float)mean;
+    window.maxInterval = (float)device->maxInterval;
+    window.medianInterval = fminf(percentile(device->buckets, device->intervals, 0.5f), window.maxInterval);
+    window.p99Interval = fminf(percentile(device->buckets, device->intervals, 0.99f), window.maxInterval);
+    window.jitterRms = (float)sqrt(variance > 0.0 ? variance : 0.0);
+    window.jitterMax = (float)fmax(device->maxInterval - mean, mean - device->minInterval);
+  }
+  float ratio = timing->config.collapse_ratio;
+  window.collapsed = (device->baseline > 0.0f && window.measuredFramerate < ratio * device->baseline) ||
+                     (window.reportedFramerate > 0.0f && window.measuredFramerate < ratio * window.reportedFramerate);
+  if(!window.collapsed && device->frames > 1){
+    device->baseline = device->baseline > 0.0f ?
+                       device->baseline + (window.measuredFramerate - device->baseline) * FRAME_TIMING_BASELINE_WEIGHT :
+                       window.measuredFramerate;
+  }
+
+  LockMutex(&timing->lock);
+  device->ring[device->count % timing->config.history] = window;
+  device->count++;
+  for(int b = 0; b < FRAME_TIMING_BUCKETS; b++){
+    device->histogram[b] += device->buckets[b];
+  }
+  timing->stats.frames += device->frames;
+  timing->stats.windows++;
+  timing->stats.dropped += device->dropped;
+  timing->stats.nonMonotonic += device->nonMonotonic;
+  timing->stats.collapses += window.collapsed;
+  timing->stats.emptyWindows += device->frames == 0;
+  UnlockMutex(&timing->lock);
+
+  device->windowStart = end;
+  device->frames = device->intervals = device->dropped = device->nonMonotonic = 0;
+  device->intervalSum = device->intervalSquares = device->framerateSum = 0.0;
+  device->minInterval = INT64_MAX;
+  device->maxInterval = 0;
+  memset(device->buckets, 0, sizeof(device->buckets));
+}
+
+/** Closes every window that has ended by now; a gap longer than a window becomes one empty window. */
+static void closeWindowsBefore(FrameTiming *timing, DeviceTiming *device, int64_t now){
+  int64_t length = timing->config.window_us;
+  if(now < device->windowStart + length){
+    return;
+  }
+  closeWindow(timing, device, device->windowStart + length);
+  if(now >= device->windowStart + length){
+    closeWindow(timing, device, now - (now - device->windowStart) % length);
+  }
+}
+
+void RecordFrameTiming(FrameTiming *timing, uint32_t device_id, const LEAP_TRACKING_EVENT *frame){
+  DeviceTiming *device = findDevice(timing, device_id);
+  if(!device && !(device = addDevice(timing, device_id))){
+    return;
+  }
+  int64_t timestamp = frame->info.timestamp;
+  if(!device->started){
+    device->started = true;
+    device->windowStart = timestamp;
+    device->lastTimestamp = timestamp;
+    device->lastFrameId = frame->info.frame_id;
+    device->minInterval = INT64_MAX;
+    device->frames = 1;
+    device->framerateSum = frame->framerate;
+    return;
+  }
+  closeWindowsBefore(timing, device, timestamp);
+
+  device->frames++;
+  device->framerateSum += frame->framerate;
+  int64_t idStep = frame->info.frame_id - device->lastFrameId;
+  if(idStep > 1){
+    device->dropped += (uint32_t)(idStep - 1);
+  }
+  device->lastFrameId = frame->info.frame_id;
+  int64_t interval = timestamp - device->lastTimestamp;
+  if(interval <= 0){
+    device->nonMonotonic++;
+    return;
+  }
+  device->lastTimestamp = timestamp;
+  int64_t bucket = interval / FRAME_TIMING_BUCKET_US;
+  device->buckets[bucket < FRAME_TIMING_BUCKETS ? bucket : FRAME_TIMING_BUCKETS - 1]++;
+  device->intervals++;
+  device->intervalSum += (double)interval;
+  device->intervalSquares += (double)interval * (double)interval;
+  device->minInterval = interval < device->minInterval ? interval : device->minInterval;
+  device->maxInterval = interval > device->maxInterval ? interval : device->maxInterval;
+}
+
+void UpdateFrameTiming(FrameTiming *timing, int64_t now){
+  //Frames still queued for the last window may be up to a quarter window late.
+  now -= timing->config.window_us / 4;
+  for(uint32_t d = 0; d < timing->deviceCount; d++){
+    if(timing->devices[d].started){
+      closeWindowsBefore(timing, &timing->devices[d], now);
+    }
+  }
+}
+
+uint32_t GetFrameTimingDevices(FrameTiming *timing, uint32_t *device_ids, uint32_t max){
+  LockMutex(&timing->lock);
+  uint32_t count = 0;
+  for(uint32_t d = 0; d < timing->deviceCount && count < max; d++){
+    device_ids[count++] = timing->devices[d].device_id;
+  }
+  UnlockMutex(&timing->lock);
+  return count;
+}
+
+bool GetLatestFrameTimingWindow(FrameTiming *timing, uint32_t device_id, FrameTimingWindow *window){
+  return GetFrameTimingWindows(timing, device_id, window, 1) == 1;
+}
+
+uint32_t GetFrameTimingWindows(FrameTiming *timing, uint32_t device_id, FrameTimingWindow *windows, uint32_t max){
+  LockMutex(&timing->lock);
+  const DeviceTiming *device = findDevice(timing, device_id);
+  uint32_t count = 0;
+  if(device){
+    uint64_t kept = device->count < timing->config.history ? device->count : timing->config.history;
+    uint64_t first = device->count - (kept < max ? kept : max);
+    for(uint64_t i = first; i < device->count; i++){
+      windows[count++] = device->ring[i % timing->config.history];
+    }
+  }
+  UnlockMutex(&timing->lock);
+  return count;
+}
+
+bool GetFrameIntervalHistogram(FrameTiming *timing, uint32_t device_id, uint64_t counts[FRAME_TIMING_BUCKETS]){
+  LockMutex(&timing->lock);
+  const DeviceTiming *device = findDevice(timing, device_id);
+  if(device){
+    memcpy(counts, device->histogram, sizeof(device->histogram));
+  }
+  UnlockMutex(&timing->lock);
+  return device != NULL;
+}
+
+void GetFrameTimingStats(FrameTiming *timing, FrameTimingStats *stats){
+  LockMutex(&timing->lock);
+  *stats = timing->stats;
+  UnlockMutex(&timing->lock);
+}
+//End-of-FrameTiming.c
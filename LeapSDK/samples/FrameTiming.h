@@ -0,0 +1,96 @@
+/* Streaming analysis of tracking frame timing, per device.
+ *
+ * RecordFrameTiming() is called on the polling thread with every
+ * LEAP_TRACKING_EVENT. It takes no lock and does a handful of arithmetic
+ * operations per frame: the interval since the device's previous frame goes
+ * into a histogram and running sums, and frame ids and info.timestamp are
+ * checked for gaps and for going backwards. Every window_us the window is
+ * closed and summarised:
+ *
+ *   - interval mean, median, 99th percentile and maximum;
+ *   - jitter, as the RMS and the largest deviation of the intervals from
+ *     their mean;
+ *   - the measured framerate, frames per second of window, next to the mean
+ *     of LEAP_TRACKING_EVENT.framerate the service reported;
+ *   - frames dropped, judged by frame id, and timestamps not after the last.
+ *
+ * A window whose measured rate falls below collapse_ratio of the device's
+ * baseline, a running average of its earlier healthy windows, or of the
+ * rate the service reports is flagged as a collapse. A device that stops
+ * sending frames is caught by UpdateFrameTiming(), which the polling thread
+ * calls when a poll returns anything but a frame: it closes windows that have
+ * run out with whatever they hold, so a stall shows up as a window with few
+ * or no frames instead of no window at all.
+ *
+ * Summaries, the all-time interval histogram and the totals are published
+ * under a lock once per window, and may be read from any thread. Totals lag
+ * the newest frames by up to one window.
+ *
+ */
+
+#ifndef FrameTiming_h
+#define FrameTiming_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAME_TIMING_MAX_DEVICES 8
+#define FRAME_TIMING_BUCKET_US 50
+#define FRAME_TIMING_BUCKETS 1000       //50 ms; longer intervals land in the last bucket
+
+typedef struct _FrameTimingConfig {
+  int64_t  window_us;
+  uint32_t history;                   //Windows kept per device
+  float    collapse_ratio;            //Fraction of the baseline or reported rate below which a window has collapsed
+} FrameTimingConfig;
+
+typedef struct _FrameTimingWindow {
+  int64_t  start;                     //LeapGetNow() microseconds
+  int64_t  end;
+  uint32_t device_id;
+  uint32_t frames;
+  uint32_t dropped;                   //Frame ids skipped
+  uint32_t nonMonotonic;              //Frames whose timestamp was not after the previous one
+  float    reportedFramerate;         //Mean of LEAP_TRACKING_EVENT.framerate
+  float    measuredFramerate;         //Frames per second of window
+  float    baselineFramerate;         //Running average of earlier windows that had not collapsed
+  float    meanInterval;              //Microseconds
+  float    medianInterval;            //To FRAME_TIMING_BUCKET_US
+  float    p99Interval;
+  float    maxInterval;
+  float    jitterRms;                 //Microseconds
+  float    jitterMax;
+  bool     collapsed;
+} FrameTimingWindow;
+
+typedef struct _FrameTimingStats {
+  uint64_t frames;
+  uint64_t windows;
+  uint64_t dropped;
+  uint64_t nonMonotonic;
+  uint64_t collapses;                 //Windows flagged as collapsed
+  uint64_t emptyWindows;              //Windows without a single frame
+  uint32_t devices;
+} FrameTimingStats;
+
+typedef struct _FrameTiming FrameTiming;
+
+void GetDefaultFrameTimingConfig(FrameTimingConfig *config);
+FrameTiming* CreateFrameTiming(const FrameTimingConfig *config);
+void DestroyFrameTiming(FrameTiming *timing);
+
+/* For the polling thread only. device_id is LEAP_CONNECTION_MESSAGE.device_id, 0 without multi-device support. */
+void RecordFrameTiming(FrameTiming *timing, uint32_t device_id, const LEAP_TRACKING_EVENT *frame);
+void UpdateFrameTiming(FrameTiming *timing, int64_t now);
+
+/* For any thread */
+uint32_t GetFrameTimingDevices(FrameTiming *timing, uint32_t *device_ids, uint32_t max);
+bool GetLatestFrameTimingWindow(FrameTiming *timing, uint32_t device_id, FrameTimingWindow *window);
+/* Copies the newest windows, up to max, oldest first. Returns the count. */
+uint32_t GetFrameTimingWindows(FrameTiming *timing, uint32_t device_id, FrameTimingWindow *windows, uint32_t max);
+/* Interval counts over the device's whole run, FRAME_TIMING_BUCKET_US per bucket. */
+bool GetFrameIntervalHistogram(FrameTiming *timing, uint32_t device_id, uint64_t counts[FRAME_TIMING_BUCKETS]);
+void GetFrameTimingStats(FrameTiming *timing, FrameTimingStats *stats);
+
+#endif /* FrameTiming_h */
@@ -0,0 +1,124 @@
+/* Feeds a FrameTiming analyzer a minute of synthetic frames from two devices.
+ *
+ * Device 1 runs at 90 Hz with 0.5 ms of timestamp jitter. At 20 s one frame
+ * is stamped 2 ms before its predecessor; from 30 s to 33 s only every third
+ * frame arrives while the service still reports 90 fps; from 45 s to 47 s no
+ * frames arrive at all, and UpdateFrameTiming() is called as a poll timeout
+ * would. Device 2 runs a clean 120 Hz alongside. The windows flagged as
+ * collapsed and the totals are printed, then the cost per frame.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "FrameTiming.h"
+
+#define SECONDS 60
+#define TIMING_ROUNDS 5
+
+static uint32_t seed = 4242;
+static float uniform(void){
+  seed = seed * 1664525u + 1013904223u;
+  return (float)(seed >> 8) / 16777216.0f;
+}
+
+typedef struct _SyntheticDevice {
+  uint32_t id;
+  int64_t  period;
+  int64_t  next;
+  int64_t  frame_id;
+  bool     faults;
+} SyntheticDevice;
+
+/* Runs the minute through timing; returns the frames recorded. */
+static uint64_t run(FrameTiming *timing){
+  SyntheticDevice devices[2] = {{1, 11111, 0, 0, true}, {2, 8333, 0, 0, false}};
+  LEAP_TRACKING_EVENT frame;
+  memset(&frame, 0, sizeof(frame));
+  uint64_t recorded = 0;
+  int64_t lastUpdate = 0;
+  for(;;){
+    SyntheticDevice *device = devices[0].next <= devices[1].next ? &devices[0] : &devices[1];
+    int64_t now = device->next;
+    if(now >= SECONDS * 1000000LL){
+      break;
+    }
+    device->next += device->period;
+    device->frame_id++;
+    int64_t timestamp = now;
+    if(device->faults){
+      timestamp += (int64_t)((uniform() - 0.5f) * 1000.0f);
+      if(now >= 20000000 && now < 20000000 + device->period){
+        timestamp -= 2 * device->period + 2000;
+      }
+      if(now >= 30000000 && now < 33000000 && device->frame_id % 3){
+        continue;
+      }
+      if(now >= 45000000 && now < 47000000){
+        if(now - lastUpdate >= 10000){
+          UpdateFrameTiming(timing, now);
+          lastUpdate = now;
+        }
+        continue;
+      }
+    }
+    frame.info.frame_id = device->frame_id;
+    frame.info.timestamp = timestamp;
+    frame.framerate = 1e6f / (float)device->period;
+    RecordFrameTiming(timing, device->id, &frame);
+    recorded++;
+  }
+  UpdateFrameTiming(timing, (SECONDS + 1) * 1000000LL);
+  return recorded;
+}
+
+int main(int argc, char** argv) {
+  FrameTiming *timing = CreateFrameTiming(NULL);
+  if(!timing){
+    printf("Failed to create the analyzer.\n");
+    return 1;
+  }
+  run(timing);
+
+  uint32_t ids[FRAME_TIMING_MAX_DEVICES];
+  uint32_t count = GetFrameTimingDevices(timing, ids, FRAME_TIMING_MAX_DEVICES);
+  FrameTimingWindow windows[SECONDS + 1];
+  for(uint32_t d = 0; d < count; d++){
+    uint32_t kept = GetFrameTimingWindows(timing, ids[d], windows, SECONDS + 1);
+    for(uint32_t w = 0; w < kept; w++){
+      if(windows[w].collapsed || windows[w].nonMonotonic){
+        printf("Device %u, %5.1f s to %5.1f s: %5.1f fps measured, %5.1f reported, %5.1f usual, %u dropped, %u out of order%s\n",
+               ids[d], windows[w].start / 1e6, windows[w].end / 1e6, windows[w].measuredFramerate,
+               windows[w].reportedFramerate, windows[w].baselineFramerate, windows[w].dropped,
+               windows[w].nonMonotonic, windows[w].collapsed ? ", collapsed" : "");
+      }
+    }
+    FrameTimingWindow *last = &windows[kept - 1];
+    printf("Device %u: %u windows; last %.1f fps, interval median %.0f us, p99 %.0f us, max %.0f us, jitter rms %.0f us, max %.0f us\n",
+           ids[d], kept, last->measuredFramerate, last->medianInterval, last->p99Interval, last->maxInterval,
+           last->jitterRms, last->jitterMax);
+  }
+  FrameTimingStats stats;
+  GetFrameTimingStats(timing, &stats);
+  printf("%llu frames, %llu windows (%llu empty), %llu dropped, %llu out of order, %llu collapses\n",
+         (unsigned long long)stats.frames, (unsigned long long)stats.windows,
+         (unsigned long long)stats.emptyWindows, (unsigned long long)stats.dropped,
+         (unsigned long long)stats.nonMonotonic, (unsigned long long)stats.collapses);
+  DestroyFrameTiming(timing);
+
+  int64_t best = INT64_MAX;
+  uint64_t frames = 0;
+  for(int round = 0; round < TIMING_ROUNDS; round++){
+    timing = CreateFrameTiming(NULL);
+    int64_t start = LeapGetNow();
+    frames = run(timing);
+    int64_t elapsed = LeapGetNow() - start;
+    best = elapsed < best ? elapsed : best;
+    DestroyFrameTiming(timing);
+  }
+  printf("%.1f ns per frame, including the synthetic source\n", best * 1000.0 / frames);
+  return 0;
+}
+//End-of-Sample
@@ -0,0 +1,434 @@
+/* Hand-centred regions of interest cut out of the IR images.
+ *
+ * The area filter first sums factor rows into a row of uint16 column sums,
+ * then adds neighbouring sums. For power-of-two factors the neighbours are
+ * added with SSE2, eight output pixels per step: each round adds the two
+ * 16-bit halves of every 32-bit lane and packs the results back to 16 bits.
+ * Sums stay below 8 * 8 * 255, so the signed pack never saturates.
+ *
+ */
+
+#include "HandRoi.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define HANDROI_USE_SSE 1
+#endif
+
+#define HANDROI_MAX_DOWNSCALE 8
+//The distortion grid covers ray slopes from -4 to 4 in both directions.
+#define HANDROI_GRID_SLOPE 4.0f
+//Nearer than this to the cameras' plane a point has no usable projection.
+#define HANDROI_MIN_HEIGHT 1.0f
+
+typedef struct _CameraModel {
+  bool     built;
+  bool     hasGrid;
+  uint64_t version;               //matrix_version the model was built from
+  uint32_t width;
+  uint32_t height;
+  LEAP_DISTORTION_MATRIX grid;    //Copy of the distortion matrix in pixels
+} CameraModel;
+
+typedef struct _HandBox {
+  uint32_t      id;
+  eLeapHandType type;
+  LEAP_VECTOR   min;              //Joint box grown by margin_mm
+  LEAP_VECTOR   max;
+  LEAP_VECTOR   velocity;         //Palm velocity, mm/s
+} HandBox;
+
+typedef struct _RoiBuffer {
+  uint8_t *pixels;
+  size_t   capacity;
+} RoiBuffer;
+
+struct _HandRoi {
+  HandRoiConfig config;
+  CameraModel   models[2];
+  HandBox       hands[HANDROI_MAX_HANDS];
+  uint32_t      handCount;
+  int64_t       trackingFrameId;
+  int64_t       trackingTime;
+  bool          tracked;
+  RoiBuffer     buffers[HANDROI_MAX_ROIS];
+  uint16_t     *sums;             //One row of column sums
+  uint32_t      sumsCapacity;
+  HandRoiFrame  frame;
+  HandRoiStats  stats;
+};
+
+void GetDefaultHandRoiConfig(HandRoiConfig *config){
+  memset(config, 0, sizeof(HandRoiConfig));
+  config->margin_mm = 15.0f;
+  config->margin_px = 4;
+  config->downscale = 2;
+  config->baseline = 40.0f;
+  config->range_x = 1.5f;
+  config->range_y = 1.5f;
+  config->max_age = 50000;
+}
+
+HandRoi* CreateHandRoi(const HandRoiConfig *config){
+  HandRoiConfig defaults;
+  if(!config){
+    GetDefaultHandRoiConfig(&defaults);
+    config = &defaults;
+  }
+  if(config->downscale == 0 || config->downscale > HANDROI_MAX_DOWNSCALE || config->baseline < 0.0f ||
+     config->range_x <= 0.0f || config->range_y <= 0.0f){
+    return NULL;
+  }
+  HandRoi *cropper = calloc(1, sizeof(HandRoi));
+  if(!cropper){
+    return NULL;
+  }
+  cropper->config = *config;
+  return cropper;
+}
+
+void DestroyHandRoi(HandRoi *cropper){
+  if(!cropper){
+    return;
+  }
+  for(int i = 0; i < HANDROI_MAX_ROIS; i++){
+    free(cropper->buffers[i].pixels);
+  }
+  free(cropper->sums);
+  free(cropper);
+}
+
+static void growBox(LEAP_VECTOR *min, LEAP_VECTOR *max, LEAP_VECTOR p){
+  if(p.x < min->x) min->x = p.x;
+  if(p.y < min->y) min->y = p.y;
+  if(p.z < min->z) min->z = p.z;
+  if(p.x > max->x) max->x = p.x;
+  if(p.y > max->y) max->y = p.y;
+  if(p.z > max->z) max->z = p.z;
+}
+
+void UpdateHandRoiHands(HandRoi *cropper, const LEAP_TRACKING_EVENT *frame){
+  float margin = cropper->config.margin_mm;
+  uint32_t count = 0;
+  for(uint32_t h = 0; h < frame->nHands && count < HANDROI_MAX_HANDS; h++){
+    const LEAP_HAND *hand = &frame->pHands[h];
+    HandBox *box = &cropper->hands[count++];
+    box->id = hand->id;
+    box->type = hand->type;
+    box->velocity = hand->palm.velocity;
+    box->min = box->max = hand->palm.position;
+    //The forearm is left out; only the wrist end of the arm bone belongs to the hand.
+    growBox(&box->min, &box->max, hand->arm.next_joint);
+    for(int d = 0; d < 5; d++){
+      growBox(&box->min, &box->max, hand->digits[d].bones[0].prev_joint);
+      for(int b = 0; b < 4; b++){
+        growBox(&box->min, &box->max, hand->digits[d].bones[b].next_joint);
+      }
+    }
+    box->min.x -= margin;
+    box->min.y -= margin;
+    box->min.z -= margin;
+    box->max.x += margin;
+    box->max.y += margin;
+    box->max.z += margin;
+  }
+  cropper->handCount = count;
+  cropper->trackingFrameId = frame->info.frame_id;
+  cropper->trackingTime = frame->info.timestamp;
+  cropper->tracked = true;
+}
+
+/** Copies the distortion grid scaled to pixels, or notes that the image is rectified. */
+static void ensureModel(HandRoi *cropper, const LEAP_IMAGE *image, uint32_t camera){
+  CameraModel *model = &cropper->models[camera];
+  const LEAP_DISTORTION_MATRIX *matrix = image->distortion_matrix;
+  uint32_t W = image->properties.width, H = image->properties.height;
+  if(model->built && model->hasGrid == (matrix != NULL) && model->width == W && model->height == H &&
+     (!matrix || model->version == image->matrix_version)){
+    return;
+  }
+  model->hasGrid = matrix != NULL;
+  model->width = W;
+  model->height = H;
+  model->version = image->matrix_version;
+  if(matrix){
+    //As in StereoDepth, normalised and pixel grids are told apart by the optical centre.
+    const int centre = LEAP_DISTORTION_MATRIX_N / 2;
+    bool pixels = matrix->matrix[centre][centre].x > 2.0f;
+    float scaleX = pixels ? 1.0f : (float)(W - 1);
+    float scaleY = pixels ? 1.0f : (float)(H - 1);
+    for(int i = 0; i < LEAP_DISTORTION_MATRIX_N; i++){
+      for(int j = 0; j < LEAP_DISTORTION_MATRIX_N; j++){
+        model->grid.matrix[i][j].x = matrix->matrix[i][j].x * scaleX;
+        model->grid.matrix[i][j].y = matrix->matrix[i][j].y * scaleY;
+      }
+    }
+  }
+  model->built = true;
+  cropper->stats.modelBuilds++;
+}
+
+static bool project(const HandRoi *cropper, const CameraModel *model, uint32_t camera,
+                    LEAP_VECTOR point, float *x, float *y){
+  if(!(point.y >= HANDROI_MIN_HEIGHT)){
+    return false;
+  }
+  float cameraX = (camera ? 0.5f : -0.5f) * cropper->config.baseline;
+  float slopeX = (point.x - cameraX) / point.y, slopeY = point.z / point.y;
+  if(!model->hasGrid){
+    *x = (slopeX / cropper->config.range_x + 1.0f) * 0.5f * (float)(model->width - 1);
+    *y = (slopeY / cropper->config.range_y + 1.0f) * 0.5f * (float)(model->height - 1);
+    return true;
+  }
+  const float last = (float)(LEAP_DISTORTION_MATRIX_N - 1);
+  float gx = (slopeX + HANDROI_GRID_SLOPE) / (2.0f * HANDROI_GRID_SLOPE) * last;
+  float gy = (slopeY + HANDROI_GRID_SLOPE) / (2.0f * HANDROI_GRID_SLOPE) * last;
+  if(!(gx >= 0.0f && gy >= 0.0f && gx <= last && gy <= last)){
+    return false;
+  }
+  int ix = (int)gx, iy = (int)gy;
+  if(ix > LEAP_DISTORTION_MATRIX_N - 2) ix = LEAP_DISTORTION_MATRIX_N - 2;
+  if(iy > LEAP_DISTORTION_MATRIX_N - 2) iy = LEAP_DISTORTION_MATRIX_N - 2;
+  float fx = gx - (float)ix, fy = gy - (float)iy;
+  const LEAP_DISTORTION_MATRIX *grid = &model->grid;
+  float x0 = grid->matrix[iy][ix].x * (1.0f - fx) + grid->matrix[iy][ix + 1].x * fx;
+  float x1 = grid->matrix[iy + 1][ix].x * (1.0f - fx) + grid->matrix[iy + 1][ix + 1].x * fx;
+  float y0 = grid->matrix[iy][ix].y * (1.0f - fx) + grid->matrix[iy][ix + 1].y * fx;
+  float y1 = grid->matrix[iy + 1][ix].y * (1.0f - fx) + grid->matrix[iy + 1][ix + 1].y * fx;
+  *x = x0 * (1.0f - fy) + x1 * fy;
+  *y = y0 * (1.0f - fy) + y1 * fy;
+  return true;
+}
+
+bool ProjectToHandRoiCamera(HandRoi *cropper, const LEAP_IMAGE *image, uint32_t camera,
+                            LEAP_VECTOR point, float *x, float *y){
+  if(camera > 1 || image->properties.width < 2 || image->properties.height < 2){
+    return false;
+  }
+  ensureModel(cropper, image, camera);
+  return project(cropper, &cropper->models[camera], camera, point, x, y);
+}
+
+/** Sums rows [0, rows) of width pixels into sums. */
+static void sumRows(const uint8_t *source, uint32_t stride, uint32_t width, uint32_t rows, uint16_t *sums){
+  memset(sums, 0, (size_t)width * sizeof(uint16_t));
+  for(uint32_t r = 0; r < rows; r++){
+    const uint8_t *row = source + (size_t)r * stride;
+    uint32_t x = 0;
+#ifdef HANDROI_USE_SSE
+    const __m128i zero = _mm_setzero_si128();
+    for(; x + 16 <= width; x += 16){
+      __m128i pixels = _mm_loadu_si128((const __m128i*)(row + x));
+      __m128i *lo = (__m128i*)(sums + x), *hi = (__m128i*)(sums + x + 8);
+      _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(pixels, zero)));
+      _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(pixels, zero)));
+    }
+#endif
+    for(; x < width; x++){
+      sums[x] += row[x];
+    }
+  }
+}
+
+#ifdef HANDROI_USE_SSE
+/** Adds neighbouring 16-bit lanes: a's four sums, then b's. */
+static inline __m128i pairSums(__m128i a, __m128i b){
+  const __m128i low = _mm_set1_epi32(0xffff);
+  __m128i sa = _mm_add_epi32(_mm_and_si128(a, low), _mm_srli_epi32(a, 16));
+  __m128i sb = _mm_add_epi32(_mm_and_si128(b, low), _mm_srli_epi32(b, 16));
+  return _mm_packs_epi32(sa, sb);
+}
+#endif
+
+/** Averages scale x scale blocks of the crop at source into outW x outH pixels. */
+static void areaDownscale(const uint8_t *source, uint32_t stride, uint32_t outW, uint32_t outH,
+                          uint32_t scale, uint16_t *sums, uint8_t *target){
+  uint32_t area = scale * scale, shift = 0;
+  while((1u << shift) < scale){
+    shift++;
+  }
+  bool powerOfTwo = (1u << shift) == scale;
+  for(uint32_t v = 0; v < outH; v++){
+    uint8_t *out = target + (size_t)v * outW;
+    if(scale == 1){
+      memcpy(out, source + (size_t)v * stride, outW);
+      continue;
+    }
+    sumRows(source + (size_t)v * scale * stride, stride, outW * scale, scale, sums);
+    uint32_t u = 0;
+#ifdef HANDROI_USE_SSE
+    if(powerOfTwo){
+      const __m128i round = _mm_set1_epi16((short)(area / 2));
+      const __m128i shiftBits = _mm_cvtsi32_si128((int)(2 * shift));
+      for(; u + 8 <= outW; u += 8){
+        //scale vectors of column sums fold into one vector of 8 block sums.
+        __m128i lanes[HANDROI_MAX_DOWNSCALE];
+        for(uint32_t k = 0; k < scale; k++){
+          lanes[k] = _mm_loadu_si128((const __m128i*)(sums + (size_t)u * scale + 8 * k));
+        }
+        for(uint32_t n = scale; n > 1; n /= 2){
+          for(uint32_t k = 0; k < n / 2; k++){
+            lanes[k] = pairSums(lanes[2 * k], lanes[2 * k + 1]);
+          }
+        }
+        __m128i mean = _mm_srl_epi16(_mm_add_epi16(lanes[0], round), shiftBits);
+        _mm_storel_epi64((__m128i*)(out + u), _mm_packus_epi16(mean, mean));
+      }
+    }
+#endif
+    for(; u < outW; u++){
+      uint32_t sum = 0;
+      for(uint32_t k = 0; k < scale; k++){
+        sum += sums[u * scale + k];
+      }
+      out[u] = (uint8_t)(powerOfTwo ? (sum + area / 2) >> (2 * shift) : (sum + area / 2) / area);
+    }
+  }
+}
+
+/** Fits [begin, end) to a multiple of scale inside [0, size), growing it where there is room. */
+static bool alignSpan(int32_t *begin, int32_t *end, uint32_t size, uint32_t scale){
+  int32_t length = *end - *begin;
+  int32_t aligned = (length + (int32_t)scale - 1) / (int32_t)scale * (int32_t)scale;
+  if(aligned > (int32_t)size){
+    aligned = (int32_t)(size / scale * scale);
+  }
+  if(aligned <= 0){
+    return false;
+  }
+  *end = *begin + aligned;
+  if(*end > (int32_t)size){
+    *end = (int32_t)size;
+    *begin = *end - aligned;
+  }
+  return true;
+}
+
+static bool reserve(RoiBuffer *buffer, size_t size){
+  if(buffer->capacity >= size){
+    return true;
+  }
+  uint8_t *pixels = realloc(buffer->pixels, size);
+  if(!pixels){
+    return false;
+  }
+  buffer->pixels = pixels;
+  buffer->capacity = size;
+  return true;
+}
+
+const HandRoiFrame* CropHandRois(HandRoi *cropper, const LEAP_IMAGE_EVENT *event){
+  int64_t start = LeapGetNow();
+  const HandRoiConfig *config = &cropper->config;
+  HandRoiFrame *frame = &cropper->frame;
+  frame->frame_id = event->info.frame_id;
+  frame->timestamp = event->info.timestamp;
+  frame->tracking_frame_id = cropper->trackingFrameId;
+  frame->count = 0;
+  cropper->stats.frames++;
+
+  int64_t age = event->info.timestamp - cropper->trackingTime;
+  if(!cropper->tracked || age > config->max_age || age < -config->max_age){
+    cropper->stats.stale++;
+    cropper->stats.cropTime += LeapGetNow() - start;
+    return frame;
+  }
+  float seconds = (float)age / 1000000.0f;
+
+  for(uint32_t c = 0; c < 2; c++){
+    const LEAP_IMAGE *image = &event->image[c];
+    uint32_t W = image->properties.width, H = image->properties.height;
+    if(image->properties.bpp != 1 || W < 2 || H < 2 || !image->data){
+      continue;
+    }
+    cropper->stats.inputBytes += (uint64_t)W * H;
+    ensureModel(cropper, image, c);
+    const CameraModel *model = &cropper->models[c];
+    const uint8_t *pixels = (const uint8_t*)image->data + image->offset;
+    uint32_t scale = config->downscale;
+
+    for(uint32_t h = 0; h < cropper->handCount; h++){
+      const HandBox *box = &cropper->hands[h];
+      float shiftX = box->velocity.x * seconds, shiftY = box->velocity.y * seconds, shiftZ = box->velocity.z * seconds;
+      float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+      for(int corner = 0; corner < 8; corner++){
+        LEAP_VECTOR p;
+        p.x = (corner & 1 ? box->max.x : box->min.x) + shiftX;
+        p.y = (corner & 2 ? box->max.y : box->min.y) + shiftY;
+        p.z = (corner & 4 ? box->max.z : box->min.z) + shiftZ;
+        float x, y;
+        if(project(cropper, model, c, p, &x, &y)){
+          if(x < minX) minX = x;
+          if(y < minY) minY = y;
+          if(x > maxX) maxX = x;
+          if(y > maxY) maxY = y;
+        }
+      }
+      int32_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+      if(minX <= maxX){
+        float margin = (float)config->margin_px;
+        x0 = (int32_t)fmaxf(floorf(minX - margin), 0.0f);
+        y0 = (int32_t)fmaxf(floorf(minY - margin), 0.0f);
+        x1 = (int32_t)fminf(ceilf(maxX + margin) + 1.0f, (float)W);
+        y1 = (int32_t)fminf(ceilf(maxY + margin) + 1.0f, (float)H);
+      }
+      if(x1 <= x0 || y1 <= y0 || !alignSpan(&x0, &x1, W, scale) || !alignSpan(&y0, &y1, H, scale)){
+        cropper->stats.offImage++;
+        continue;
+      }
+
+      HandRoiImage *roi = &frame->rois[frame->count];
+      RoiBuffer *buffer = &cropper->buffers[frame->count];
+      uint32_t cropW = (uint32_t)(x1 - x0), cropH = (uint32_t)(y1 - y0);
+      size_t outSize = (size_t)(cropW / scale) * (cropH / scale);
+      if(!reserve(buffer, outSize)){
+        continue;
+      }
+      if(scale > 1 && cropper->sumsCapacity < W){
+        //Sized for the widest crop of this image size.
+        uint16_t *sums = realloc(cropper->sums, (size_t)W * sizeof(uint16_t));
+        if(!sums){
+          continue;
+        }
+        cropper->sums = sums;
+        cropper->sumsCapacity = W;
+      }
+      roi->hand_id = box->id;
+      roi->type = box->type;
+      roi->camera = c;
+      roi->x = x0;
+      roi->y = y0;
+      roi->width = cropW;
+      roi->height = cropH;
+      roi->scale = scale;
+      roi->out_width = cropW / scale;
+      roi->out_height = cropH / scale;
+      roi->pixels = buffer->pixels;
+      areaDownscale(pixels + (size_t)y0 * W + x0, W, roi->out_width, roi->out_height, scale,
+                    cropper->sums, roi->pixels);
+      frame->count++;
+      cropper->stats.rois++;
+      cropper->stats.outputBytes += outSize;
+    }
+  }
+  cropper->stats.cropTime += LeapGetNow() - start;
+  return frame;
+}
+
+void HandRoiToImage(const HandRoiImage *roi, float u, float v, float *x, float *y){
+  *x = (float)roi->x + (u + 0.5f) * (float)roi->scale - 0.5f;
+  *y = (float)roi->y + (v + 0.5f) * (float)roi->scale - 0.5f;
+}
+
+void ImageToHandRoi(const HandRoiImage *roi, float x, float y, float *u, float *v){
+  *u = (x - (float)roi->x + 0.5f) / (float)roi->scale - 0.5f;
+  *v = (y - (float)roi->y + 0.5f) / (float)roi->scale - 0.5f;
+}
+
+void GetHandRoiStats(const HandRoi *cropper, HandRoiStats *stats){
+  *stats = cropper->stats;
+}
+//End-of-HandRoi.c
@@ -0,0 +1,97 @@
+/* Hand-centred regions of interest cut out of the IR images.
+ *
+ * UpdateHandRoiHands() takes the hands of a tracking frame and keeps, per
+ * hand, the box around its palm, wrist and finger joints grown by a margin
+ * in millimetres. CropHandRois() projects each box into both cameras of an
+ * image event, moving it by the palm velocity over the time since the
+ * tracking frame. It crops the enclosing rectangle, grown by a margin in
+ * pixels, and optionally shrinks it by an integer factor with an area
+ * filter, so each output pixel is the rounded mean of a factor x factor
+ * block.
+ *
+ * Points are projected the way StereoDepth rectifies. A point at x, y, z mm
+ * has ray slopes (x -+ baseline / 2) / y and z / y for the left and right
+ * camera, which index the image's distortion matrix. The projection is kept
+ * per camera and refreshed only when matrix_version changes. Images without
+ * a distortion matrix are taken as rectified over -range_x..range_x and
+ * -range_y..range_y.
+ *
+ * A region maps back to the full image by x = roi.x + (u + 0.5) * scale - 0.5,
+ * and likewise for y, as HandRoiToImage() does.
+ *
+ * The returned HandRoiFrame and its pixels are owned by the cropper and valid
+ * until the next crop. A cropper is meant for one thread, typically the one
+ * dispatching LeapC events.
+ *
+ */
+
+#ifndef HandRoi_h
+#define HandRoi_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HANDROI_MAX_HANDS 2
+#define HANDROI_MAX_ROIS (2 * HANDROI_MAX_HANDS)
+
+typedef struct _HandRoiConfig {
+  float    margin_mm;             //Grows the joint box on every side
+  uint32_t margin_px;             //Grows the projected rectangle on every side
+  uint32_t downscale;             //Area filter factor, 1 to keep full resolution; at most 8
+  float    baseline;              //Distance between the cameras in millimetres
+  float    range_x;               //Ray-slope half ranges of images without a distortion matrix
+  float    range_y;
+  int64_t  max_age;               //Microseconds a tracking frame stays usable for images
+} HandRoiConfig;
+
+typedef struct _HandRoiImage {
+  uint32_t      hand_id;
+  eLeapHandType type;
+  uint32_t      camera;           //0 left, 1 right
+  int32_t       x;                //Top-left corner in the full image
+  int32_t       y;
+  uint32_t      width;            //Size in the full image, a multiple of scale
+  uint32_t      height;
+  uint32_t      scale;            //Full-image pixels per region pixel along each axis
+  uint32_t      out_width;        //width / scale
+  uint32_t      out_height;
+  uint8_t      *pixels;           //out_width x out_height
+} HandRoiImage;
+
+typedef struct _HandRoiFrame {
+  int64_t      frame_id;          //Image frame
+  int64_t      timestamp;
+  int64_t      tracking_frame_id; //Frame the hands came from
+  uint32_t     count;
+  HandRoiImage rois[HANDROI_MAX_ROIS];
+} HandRoiFrame;
+
+typedef struct _HandRoiStats {
+  uint64_t frames;
+  uint64_t rois;
+  uint64_t stale;                 //Images with no recent enough tracking frame
+  uint64_t offImage;              //Hands that projected outside an image
+  uint64_t inputBytes;            //Full image bytes seen
+  uint64_t outputBytes;           //Region bytes produced
+  uint64_t modelBuilds;
+  int64_t  cropTime;              //Microseconds spent projecting and cropping
+} HandRoiStats;
+
+typedef struct _HandRoi HandRoi;
+
+void GetDefaultHandRoiConfig(HandRoiConfig *config);
+HandRoi* CreateHandRoi(const HandRoiConfig *config);
+void DestroyHandRoi(HandRoi *cropper);
+
+void UpdateHandRoiHands(HandRoi *cropper, const LEAP_TRACKING_EVENT *frame);
+const HandRoiFrame* CropHandRois(HandRoi *cropper, const LEAP_IMAGE_EVENT *event);
+
+/* Pixel position of a point in millimetres; false if it is behind the cameras or outside the distortion grid. */
+bool ProjectToHandRoiCamera(HandRoi *cropper, const LEAP_IMAGE *image, uint32_t camera,
+                            LEAP_VECTOR point, float *x, float *y);
+void HandRoiToImage(const HandRoiImage *roi, float u, float v, float *x, float *y);
+void ImageToHandRoi(const HandRoiImage *roi, float x, float y, float *u, float *v);
+void GetHandRoiStats(const HandRoi *cropper, HandRoiStats *stats);
+
+#endif /* HandRoi_h */
@@ -0,0 +1,205 @@
+/* Measures hand-centred cropping against processing the full IR images.
+ *
+ * Two synthetic hands move above the device for a number of frames, each
+ * with a tracking frame and a 640x240 image pair whose distortion grid maps
+ * the rectified view straight onto the image. For every downscale factor the
+ * benchmark crops the hands out of both images and reports the share of the
+ * pixels kept, the time to crop, and the time of a stand-in vision stage, a
+ * gradient-magnitude pass, over the full images and over the regions. It
+ * also checks the area filter against a plain reference, and that each palm
+ * lands inside its region and maps back to the same image position.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "HandRoi.h"
+
+#define WIDTH 640
+#define HEIGHT 240
+#define FRAMES 200
+#define RANGE 1.5f
+
+static void fillLinearGrid(LEAP_DISTORTION_MATRIX *matrix, float range_x, float range_y){
+  for(int i = 0; i < LEAP_DISTORTION_MATRIX_N; i++){
+    for(int j = 0; j < LEAP_DISTORTION_MATRIX_N; j++){
+      float slopeX = -4.0f + 8.0f * (float)j / (LEAP_DISTORTION_MATRIX_N - 1);
+      float slopeY = -4.0f + 8.0f * (float)i / (LEAP_DISTORTION_MATRIX_N - 1);
+      matrix->matrix[i][j].x = (slopeX / range_x + 1.0f) * 0.5f;
+      matrix->matrix[i][j].y = (slopeY / range_y + 1.0f) * 0.5f;
+    }
+  }
+}
+
+static LEAP_VECTOR vec(float x, float y, float z){
+  LEAP_VECTOR v;
+  v.x = x;
+  v.y = y;
+  v.z = z;
+  return v;
+}
+
+/** An open hand with the fingers fanned out towards -z from the palm. */
+static void makeHand(LEAP_HAND *hand, uint32_t id, eLeapHandType type, LEAP_VECTOR palm, LEAP_VECTOR velocity){
+  static const float lengths[5] = { 55.0f, 80.0f, 88.0f, 82.0f, 65.0f };
+  memset(hand, 0, sizeof(LEAP_HAND));
+  hand->id = id;
+  hand->type = type;
+  hand->palm.position = palm;
+  hand->palm.velocity = velocity;
+  hand->arm.prev_joint = vec(palm.x, palm.y - 20.0f, palm.z + 280.0f);
+  hand->arm.next_joint = vec(palm.x, palm.y, palm.z + 50.0f);
+  float side = type == eLeapHandType_Left ? 1.0f : -1.0f;
+  for(int d = 0; d < 5; d++){
+    float spread = side * (d - 2) * 0.22f;
+    LEAP_VECTOR joint = vec(palm.x + side * (d - 2) * 12.0f, palm.y, palm.z + 40.0f);
+    for(int b = 0; b < 4; b++){
+      float length = b == 0 ? 45.0f : lengths[d] / 3.0f;
+      hand->digits[d].bones[b].prev_joint = joint;
+      joint = vec(joint.x + sinf(spread) * length, joint.y + 2.0f, joint.z - cosf(spread) * length);
+      hand->digits[d].bones[b].next_joint = joint;
+    }
+  }
+}
+
+/** Stand-in for a vision stage: sum of |dx| + |dy| over the image. */
+static uint64_t gradientEnergy(const uint8_t *pixels, uint32_t W, uint32_t H){
+  uint64_t energy = 0;
+  for(uint32_t y = 1; y < H; y++){
+    for(uint32_t x = 1; x < W; x++){
+      int here = pixels[(size_t)y * W + x];
+      energy += (uint64_t)(abs(here - pixels[(size_t)y * W + x - 1]) + abs(here - pixels[(size_t)(y - 1) * W + x]));
+    }
+  }
+  return energy;
+}
+
+static bool checkArea(const HandRoiImage *roi, const uint8_t *image){
+  uint32_t s = roi->scale;
+  for(uint32_t v = 0; v < roi->out_height; v++){
+    for(uint32_t u = 0; u < roi->out_width; u++){
+      uint32_t sum = 0;
+      for(uint32_t dy = 0; dy < s; dy++){
+        for(uint32_t dx = 0; dx < s; dx++){
+          sum += image[(size_t)(roi->y + v * s + dy) * WIDTH + roi->x + u * s + dx];
+        }
+      }
+      if(roi->pixels[(size_t)v * roi->out_width + u] != (sum + s * s / 2) / (s * s)){
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint8_t *pixels = malloc((size_t)WIDTH * HEIGHT * 2);
+  LEAP_DISTORTION_MATRIX *grid = malloc(sizeof(LEAP_DISTORTION_MATRIX));
+  if(!pixels || !grid){
+    printf("Failed to allocate the images.\n");
+    return 1;
+  }
+  srand(7);
+  for(size_t i = 0; i < (size_t)WIDTH * HEIGHT * 2; i++){
+    pixels[i] = (uint8_t)(rand() & 0xff);
+  }
+  fillLinearGrid(grid, RANGE, RANGE);
+
+  LEAP_IMAGE_EVENT event;
+  memset(&event, 0, sizeof(event));
+  for(int c = 0; c < 2; c++){
+    event.image[c].properties.width = WIDTH;
+    event.image[c].properties.height = HEIGHT;
+    event.image[c].properties.bpp = 1;
+    event.image[c].data = pixels + (size_t)c * WIDTH * HEIGHT;
+    event.image[c].matrix_version = 1;
+    event.image[c].distortion_matrix = grid;
+  }
+  LEAP_HAND hands[2];
+  LEAP_TRACKING_EVENT tracking;
+  memset(&tracking, 0, sizeof(tracking));
+  tracking.nHands = 2;
+  tracking.pHands = hands;
+
+  int64_t fullTime = 0;
+  uint64_t fullEnergy = 0;
+  for(uint32_t f = 0; f < FRAMES; f++){
+    int64_t start = LeapGetNow();
+    for(int c = 0; c < 2; c++){
+      fullEnergy += gradientEnergy(event.image[c].data, WIDTH, HEIGHT);
+    }
+    fullTime += LeapGetNow() - start;
+  }
+  printf("Full images: %u x %u x 2, vision stage %.3f ms per frame, gradient %.1f per pixel\n", WIDTH, HEIGHT,
+         (double)fullTime / FRAMES / 1000.0, (double)fullEnergy / ((double)FRAMES * WIDTH * HEIGHT * 2));
+
+  static const uint32_t scales[] = { 1, 2, 4 };
+  for(size_t s = 0; s < sizeof(scales) / sizeof(scales[0]); s++){
+    HandRoiConfig config;
+    GetDefaultHandRoiConfig(&config);
+    config.downscale = scales[s];
+    config.range_x = config.range_y = RANGE;
+    HandRoi *cropper = CreateHandRoi(&config);
+    if(!cropper){
+      printf("Failed to create the cropper.\n");
+      return 1;
+    }
+    int64_t roiTime = 0;
+    uint64_t roiEnergy = 0;
+    uint32_t filterErrors = 0, mappingErrors = 0;
+    for(uint32_t f = 0; f < FRAMES; f++){
+      float t = (float)f / FRAMES;
+      tracking.info.frame_id = f;
+      tracking.info.timestamp = (int64_t)f * 11111;
+      makeHand(&hands[0], 1, eLeapHandType_Left, vec(-90.0f + 40.0f * t, 180.0f + 60.0f * t, 10.0f),
+               vec(40.0f * 90.0f / FRAMES, 60.0f * 90.0f / FRAMES, 0.0f));
+      makeHand(&hands[1], 2, eLeapHandType_Right, vec(80.0f, 220.0f, -20.0f + 30.0f * t),
+               vec(0.0f, 0.0f, 30.0f * 90.0f / FRAMES));
+      UpdateHandRoiHands(cropper, &tracking);
+      event.info.frame_id = f;
+      event.info.timestamp = tracking.info.timestamp + 2000;
+
+      const HandRoiFrame *frame = CropHandRois(cropper, &event);
+      int64_t start = LeapGetNow();
+      for(uint32_t r = 0; r < frame->count; r++){
+        roiEnergy += gradientEnergy(frame->rois[r].pixels, frame->rois[r].out_width, frame->rois[r].out_height);
+      }
+      roiTime += LeapGetNow() - start;
+
+      for(uint32_t r = 0; r < frame->count; r++){
+        const HandRoiImage *roi = &frame->rois[r];
+        filterErrors += !checkArea(roi, event.image[roi->camera].data);
+        const LEAP_HAND *hand = &hands[roi->hand_id - 1];
+        float x, y, u, v, bx, by;
+        LEAP_VECTOR palm = vec(hand->palm.position.x + hand->palm.velocity.x * 0.002f,
+                               hand->palm.position.y + hand->palm.velocity.y * 0.002f,
+                               hand->palm.position.z + hand->palm.velocity.z * 0.002f);
+        if(!ProjectToHandRoiCamera(cropper, &event.image[roi->camera], roi->camera, palm, &x, &y)){
+          mappingErrors++;
+          continue;
+        }
+        ImageToHandRoi(roi, x, y, &u, &v);
+        HandRoiToImage(roi, u, v, &bx, &by);
+        mappingErrors += u < 0.0f || v < 0.0f || u > roi->out_width || v > roi->out_height ||
+                         fabsf(bx - x) > 0.01f || fabsf(by - y) > 0.01f;
+      }
+    }
+    HandRoiStats stats;
+    GetHandRoiStats(cropper, &stats);
+    printf("Downscale %u: %llu regions, %.1f%% of the pixels kept (%.1fx less), model builds %llu\n",
+           scales[s], (unsigned long long)stats.rois, 100.0 * (double)stats.outputBytes / (double)stats.inputBytes,
+           (double)stats.inputBytes / (double)stats.outputBytes, (unsigned long long)stats.modelBuilds);
+    printf("  crop %.3f ms, vision stage %.3f ms per frame (%.1fx faster with cropping), gradient %.1f per pixel\n",
+           (double)stats.cropTime / FRAMES / 1000.0, (double)roiTime / FRAMES / 1000.0,
+           (double)fullTime / (double)(roiTime + stats.cropTime), (double)roiEnergy / (double)stats.outputBytes);
+    printf("  area filter %s, mapping %s\n", filterErrors ? "MISMATCH" : "exact", mappingErrors ? "FAILED" : "ok");
+    DestroyHandRoi(cropper);
+  }
+  free(grid);
+  free(pixels);
+  return 0;
+}
+//End-of-Sample
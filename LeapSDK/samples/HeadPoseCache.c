@@ -0,0 +1,354 @@
+/* Time-indexed cache of head pose and eye position events.
+ *
+ * Both rings hold whole LeapC events in timestamp order; count is the number
+ * ever recorded, so the window is [count - capacity, count). Queries are
+ * resolved in two passes: everything the rings cover under the lock, then,
+ * with the lock released, LeapC for the rest, so a slow service call never
+ * holds up the polling thread.
+ *
+ */
+
+#include "HeadPoseCache.h"
+#include "LeapMath.h"
+#include "LeapThreads.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Marks a result the rings could not answer, between the two passes.
+#define UNRESOLVED INT64_MIN
+
+typedef struct _EventRing {
+  uint8_t *items;
+  size_t   itemSize;
+  size_t   timestampOffset;
+  uint64_t count;
+} EventRing;
+
+struct _HeadPoseCache {
+  HeadPoseCacheConfig config;
+  LockType            lock;
+  uint32_t            mask;
+  EventRing           heads;
+  EventRing           eyes;
+  LEAP_CONNECTION     connection;
+  LEAP_DEVICE         device;
+  HeadPoseCacheStats  stats;
+};
+
+void GetDefaultHeadPoseCacheConfig(HeadPoseCacheConfig *config){
+  memset(config, 0, sizeof(HeadPoseCacheConfig));
+  config->capacity = 256;
+  config->max_interval = 50000;
+  config->max_extrapolation = 25000;
+  config->fallback = true;
+}
+
+static bool initRing(EventRing *ring, uint32_t capacity, size_t itemSize, size_t timestampOffset){
+  ring->items = malloc((size_t)capacity * itemSize);
+  ring->itemSize = itemSize;
+  ring->timestampOffset = timestampOffset;
+  ring->count = 0;
+  return ring->items != NULL;
+}
+
+HeadPoseCache* CreateHeadPoseCache(const HeadPoseCacheConfig *config){
+  HeadPoseCacheConfig defaults;
+  if(!config){
+    GetDefaultHeadPoseCacheConfig(&defaults);
+    config = &defaults;
+  }
+  uint32_t capacity = 2;
+  while(capacity < config->capacity && capacity < (1u << 20)){
+    capacity <<= 1;
+  }
+  HeadPoseCache *cache = calloc(1, sizeof(HeadPoseCache));
+  if(!cache){
+    return NULL;
+  }
+  if(!initRing(&cache->heads, capacity, sizeof(LEAP_HEAD_POSE_EVENT), offsetof(LEAP_HEAD_POSE_EVENT, timestamp)) ||
+     !initRing(&cache->eyes, capacity, sizeof(LEAP_EYE_EVENT), offsetof(LEAP_EYE_EVENT, timestamp))){
+    free(cache->heads.items);
+    free(cache->eyes.items);
+    free(cache);
+    return NULL;
+  }
+  cache->config = *config;
+  cache->config.capacity = capacity;
+  cache->mask = capacity - 1;
+  InitLock(&cache->lock);
+  return cache;
+}
+
+void DestroyHeadPoseCache(HeadPoseCache *cache){
+  if(!cache){
+    return;
+  }
+  DestroyLock(&cache->lock);
+  free(cache->heads.items);
+  free(cache->eyes.items);
+  free(cache);
+}
+
+void SetHeadPoseCacheConnection(HeadPoseCache *cache, LEAP_CONNECTION connection, LEAP_DEVICE device){
+  LockMutex(&cache->lock);
+  cache->connection = connection;
+  cache->device = device;
+  UnlockMutex(&cache->lock);
+}
+
+static const void* itemAt(const HeadPoseCache *cache, const EventRing *ring, uint64_t index){
+  return ring->items + (size_t)(index & cache->mask) * ring->itemSize;
+}
+
+static int64_t timestampAt(const HeadPoseCache *cache, const EventRing *ring, uint64_t index){
+  int64_t timestamp;
+  memcpy(&timestamp, (const uint8_t*)itemAt(cache, ring, index) + ring->timestampOffset, sizeof(timestamp));
+  return timestamp;
+}
+
+/** Appends event unless it is not newer than the last one. Call with lock held. */
+static bool append(HeadPoseCache *cache, EventRing *ring, const void *event, int64_t timestamp){
+  if(ring->count && timestamp <= timestampAt(cache, ring, ring->count - 1)){
+    cache->stats.outOfOrder++;
+    return false;
+  }
+  memcpy((void*)itemAt(cache, ring, ring->count), event, ring->itemSize);
+  ring->count++;
+  return true;
+}
+
+void RecordHeadPose(HeadPoseCache *cache, const LEAP_HEAD_POSE_EVENT *event){
+  LockMutex(&cache->lock);
+  if(append(cache, &cache->heads, event, event->timestamp)){
+    cache->stats.headPoses++;
+  }
+  UnlockMutex(&cache->lock);
+}
+
+void RecordEyes(HeadPoseCache *cache, const LEAP_EYE_EVENT *event){
+  LockMutex(&cache->lock);
+  if(append(cache, &cache->eyes, event, event->timestamp)){
+    cache->stats.eyes++;
+  }
+  UnlockMutex(&cache->lock);
+}
+
+/**
+ * Finds the events to answer timestamp from: the two around it, or the
+ * newest in b and the one before it in a, if close enough, when extrapolating.
+ * Call with lock held.
+ */
+static eHeadPoseSource locate(const HeadPoseCache *cache, const EventRing *ring, int64_t timestamp,
+                              const void **a, const void **b){
+  uint64_t oldest = ring->count > cache->config.capacity ? ring->count - cache->config.capacity : 0;
+  uint64_t newest = ring->count;
+  if(newest == oldest || timestamp < timestampAt(cache, ring, oldest)){
+    return eHeadPoseSource_None;
+  }
+  int64_t last = timestampAt(cache, ring, newest - 1);
+  if(timestamp >= last){
+    if(timestamp - last > cache->config.max_extrapolation){
+      return eHeadPoseSource_None;
+    }
+    *b = itemAt(cache, ring, newest - 1);
+    *a = newest - 1 > oldest && last - timestampAt(cache, ring, newest - 2) <= cache->config.max_interval ?
+         itemAt(cache, ring, newest - 2) : NULL;
+    if(timestamp == last){
+      *a = *b;
+      return eHeadPoseSource_Interpolated;
+    }
+    return eHeadPoseSource_Extrapolated;
+  }
+  //First event after timestamp; the event before it is at or before timestamp.
+  uint64_t lo = oldest + 1, hi = newest - 1;
+  while(lo < hi){
+    uint64_t mid = lo + (hi - lo) / 2;
+    if(timestampAt(cache, ring, mid) <= timestamp){
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if(timestampAt(cache, ring, lo) - timestampAt(cache, ring, lo - 1) > cache->config.max_interval){
+    return eHeadPoseSource_None;
+  }
+  *a = itemAt(cache, ring, lo - 1);
+  *b = itemAt(cache, ring, lo);
+  return eHeadPoseSource_Interpolated;
+}
+
+static float fraction(int64_t a, int64_t b, int64_t timestamp){
+  return b > a ? (float)(timestamp - a) / (float)(b - a) : 0.0f;
+}
+
+/** Interpolates a and b; fractions past 1 extrapolate along the line through them. */
+static void interpolateHead(const LEAP_HEAD_POSE_EVENT *a, const LEAP_HEAD_POSE_EVENT *b, int64_t timestamp,
+                            LEAP_HEAD_POSE_EVENT *pose){
+  float t = fraction(a->timestamp, b->timestamp, timestamp);
+  pose->timestamp = timestamp;
+  pose->head_position = VectorLerp(a->head_position, b->head_position, t);
+  pose->head_orientation = QuaternionNlerp(a->head_orientation, b->head_orientation, t);
+  pose->head_linear_velocity = VectorLerp(a->head_linear_velocity, b->head_linear_velocity, t);
+  pose->head_angular_velocity = VectorLerp(a->head_angular_velocity, b->head_angular_velocity, t);
+}
+
+static void extrapolateHead(const LEAP_HEAD_POSE_EVENT *previous, const LEAP_HEAD_POSE_EVENT *last, int64_t timestamp,
+                            LEAP_HEAD_POSE_EVENT *pose){
+  const LEAP_VECTOR *v = &last->head_linear_velocity, *w = &last->head_angular_velocity;
+  bool hasVelocity = VectorLength(*v) > 0.0f || VectorLength(*w) > 0.0f;
+  if(!hasVelocity && previous){
+    interpolateHead(previous, last, timestamp, pose);
+    return;
+  }
+  *pose = *last;
+  pose->timestamp = timestamp;
+  float seconds = (float)(timestamp - last->timestamp) / 1000000.0f;
+  pose->head_position = VectorAdd(last->head_position, VectorScale(*v, seconds));
+  //The angular velocity is taken to be in tracking space, like the position.
+  float rate = VectorLength(*w);
+  if(rate > 0.0f){
+    float s = sinf(0.5f * rate * seconds) / rate;
+    LEAP_QUATERNION step = QuaternionMake(w->x * s, w->y * s, w->z * s, cosf(0.5f * rate * seconds));
+    pose->head_orientation = QuaternionNormalize(QuaternionMultiply(step, last->head_orientation));
+  }
+}
+
+static void interpolateEyes(const LEAP_EYE_EVENT *a, const LEAP_EYE_EVENT *b, int64_t timestamp, LEAP_EYE_EVENT *eyes){
+  float t = fraction(a->timestamp, b->timestamp, timestamp);
+  float e = t < 1.0f ? t : 1.0f;
+  eyes->frame_id = t < 0.5f ? a->frame_id : b->frame_id;
+  eyes->timestamp = timestamp;
+  eyes->left_eye_position = VectorLerp(a->left_eye_position, b->left_eye_position, t);
+  eyes->right_eye_position = VectorLerp(a->right_eye_position, b->right_eye_position, t);
+  eyes->left_eye_estimated_error = a->left_eye_estimated_error + (b->left_eye_estimated_error - a->left_eye_estimated_error) * e;
+  eyes->right_eye_estimated_error = a->right_eye_estimated_error + (b->right_eye_estimated_error - a->right_eye_estimated_error) * e;
+}
+
+static void extrapolateEyes(const LEAP_EYE_EVENT *previous, const LEAP_EYE_EVENT *last, int64_t timestamp, LEAP_EYE_EVENT *eyes){
+  if(previous){
+    interpolateEyes(previous, last, timestamp, eyes);
+  } else {
+    *eyes = *last;
+    eyes->timestamp = timestamp;
+  }
+}
+
+/** Answers what the rings cover and marks the rest UNRESOLVED. Call with lock held. */
+static uint32_t resolveLocally(HeadPoseCache *cache, bool head, const int64_t *timestamps, uint32_t count,
+                               void *results, eHeadPoseSource *sources){
+  const EventRing *ring = head ? &cache->heads : &cache->eyes;
+  uint32_t answered = 0;
+  for(uint32_t i = 0; i < count; i++){
+    const void *a = NULL, *b = NULL;
+    eHeadPoseSource source = locate(cache, ring, timestamps[i], &a, &b);
+    LEAP_HEAD_POSE_EVENT *pose = head ? (LEAP_HEAD_POSE_EVENT*)results + i : NULL;
+    LEAP_EYE_EVENT *eyes = head ? NULL : (LEAP_EYE_EVENT*)results + i;
+    if(source == eHeadPoseSource_Interpolated){
+      if(head){
+        interpolateHead(a, b, timestamps[i], pose);
+      } else {
+        interpolateEyes(a, b, timestamps[i], eyes);
+      }
+      cache->stats.interpolated++;
+      answered++;
+    } else if(source == eHeadPoseSource_Extrapolated){
+      if(head){
+        extrapolateHead(a, b, timestamps[i], pose);
+      } else {
+        extrapolateEyes(a, b, timestamps[i], eyes);
+      }
+      cache->stats.extrapolated++;
+      answered++;
+    } else if(head){
+      pose->timestamp = UNRESOLVED;
+    } else {
+      eyes->timestamp = UNRESOLVED;
+    }
+    if(sources){
+      sources[i] = source;
+    }
+  }
+  return answered;
+}
+
+static uint32_t interpolateCached(HeadPoseCache *cache, bool head, const int64_t *timestamps, uint32_t count,
+                                  void *results, eHeadPoseSource *sources){
+  LockMutex(&cache->lock);
+  uint32_t answered = resolveLocally(cache, head, timestamps, count, results, sources);
+  LEAP_CONNECTION connection = cache->config.fallback ? cache->connection : NULL;
+  LEAP_DEVICE device = cache->device;
+  UnlockMutex(&cache->lock);
+  if(answered == count){
+    return answered;
+  }
+
+  uint64_t fallbacks = 0, failures = 0, misses = 0;
+  int64_t waited = 0;
+  for(uint32_t i = 0; i < count; i++){
+    LEAP_HEAD_POSE_EVENT *pose = head ? (LEAP_HEAD_POSE_EVENT*)results + i : NULL;
+    LEAP_EYE_EVENT *eyes = head ? NULL : (LEAP_EYE_EVENT*)results + i;
+    if((head ? pose->timestamp : eyes->timestamp) != UNRESOLVED){
+      continue;
+    }
+    if(!connection){
+      misses++;
+      continue;
+    }
+    int64_t start = LeapGetNow();
+    eLeapRS result;
+    if(head){
+      result = device ? LeapInterpolateHeadPoseEx(connection, device, timestamps[i], pose)
+                      : LeapInterpolateHeadPose(connection, timestamps[i], pose);
+    } else {
+      result = LeapInterpolateEyePositions(connection, timestamps[i], eyes);
+    }
+    waited += LeapGetNow() - start;
+    if(result == eLeapRS_Success){
+      fallbacks++;
+      answered++;
+      if(sources){
+        sources[i] = eHeadPoseSource_LeapC;
+      }
+    } else {
+      failures++;
+      misses++;
+    }
+  }
+  LockMutex(&cache->lock);
+  cache->stats.fallbacks += fallbacks;
+  cache->stats.fallbackFailures += failures;
+  cache->stats.misses += misses;
+  cache->stats.fallbackTime += waited;
+  UnlockMutex(&cache->lock);
+  return answered;
+}
+
+uint32_t InterpolateCachedHeadPoses(HeadPoseCache *cache, const int64_t *timestamps, uint32_t count,
+                                    LEAP_HEAD_POSE_EVENT *poses, eHeadPoseSource *sources){
+  return interpolateCached(cache, true, timestamps, count, poses, sources);
+}
+
+uint32_t InterpolateCachedEyes(HeadPoseCache *cache, const int64_t *timestamps, uint32_t count,
+                               LEAP_EYE_EVENT *eyes, eHeadPoseSource *sources){
+  return interpolateCached(cache, false, timestamps, count, eyes, sources);
+}
+
+eHeadPoseSource GetCachedHeadPose(HeadPoseCache *cache, int64_t timestamp, LEAP_HEAD_POSE_EVENT *pose){
+  eHeadPoseSource source;
+  interpolateCached(cache, true, &timestamp, 1, pose, &source);
+  return source;
+}
+
+eHeadPoseSource GetCachedEyes(HeadPoseCache *cache, int64_t timestamp, LEAP_EYE_EVENT *eyes){
+  eHeadPoseSource source;
+  interpolateCached(cache, false, &timestamp, 1, eyes, &source);
+  return source;
+}
+
+void GetHeadPoseCacheStats(HeadPoseCache *cache, HeadPoseCacheStats *stats){
+  LockMutex(&cache->lock);
+  *stats = cache->stats;
+  UnlockMutex(&cache->lock);
+}
+//End-of-HeadPoseCache.c
@@ -0,0 +1,82 @@
+/* Time-indexed cache of head pose and eye position events.
+ *
+ * LeapInterpolateHeadPose(), LeapInterpolateHeadPoseEx() and
+ * LeapInterpolateEyePositions() each ask the service and wait for its answer.
+ * The same data also arrives as eLeapEventType_HeadPose and
+ * eLeapEventType_Eyes messages; once SetConnectionHeadPoseCache() is set,
+ * ExampleConnection records every one of them in two rings ordered by
+ * timestamp, and queries for a time inside the buffered window are answered
+ * locally:
+ *
+ *   - between two events no more than max_interval apart, by interpolating
+ *     them: positions and velocities linearly, orientations by nlerp;
+ *   - up to max_extrapolation past the newest event, by extrapolating with
+ *     the head velocities, or from the last two events when the service
+ *     leaves the velocities at zero, as it does for the eyes.
+ *
+ * Times older than the window, gaps and times too far ahead go to LeapC when
+ * a connection has been set with SetHeadPoseCacheConnection() and fallback
+ * is enabled. The batch functions answer several times, e.g. one per view,
+ * under one lock and then fall back for whatever is left. Every answer says
+ * where it came from.
+ *
+ * All functions may be called from any thread.
+ *
+ */
+
+#ifndef HeadPoseCache_h
+#define HeadPoseCache_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum _eHeadPoseSource {
+  eHeadPoseSource_None,           //Not buffered, and LeapC was not asked or could not answer
+  eHeadPoseSource_Interpolated,   //From the buffered events around the time
+  eHeadPoseSource_Extrapolated,   //Past the newest buffered event
+  eHeadPoseSource_LeapC           //From LeapInterpolateHeadPose() or LeapInterpolateEyePositions()
+} eHeadPoseSource;
+
+typedef struct _HeadPoseCacheConfig {
+  uint32_t capacity;              //Events kept per ring; rounded up to a power of two
+  int64_t  max_interval;          //Microseconds between two events beyond which they are not interpolated
+  int64_t  max_extrapolation;     //Microseconds past the newest event a query may reach
+  bool     fallback;              //Ask LeapC for times the rings do not cover
+} HeadPoseCacheConfig;
+
+typedef struct _HeadPoseCacheStats {
+  uint64_t headPoses;             //Events recorded
+  uint64_t eyes;
+  uint64_t outOfOrder;            //Events not newer than the last of their kind, dropped
+  uint64_t interpolated;          //Answers, of either kind
+  uint64_t extrapolated;
+  uint64_t fallbacks;             //Answered by LeapC
+  uint64_t fallbackFailures;      //LeapC asked and failed
+  uint64_t misses;                //Not answered
+  int64_t  fallbackTime;          //Microseconds spent waiting for LeapC
+} HeadPoseCacheStats;
+
+typedef struct _HeadPoseCache HeadPoseCache;
+
+void GetDefaultHeadPoseCacheConfig(HeadPoseCacheConfig *config);
+HeadPoseCache* CreateHeadPoseCache(const HeadPoseCacheConfig *config);
+void DestroyHeadPoseCache(HeadPoseCache *cache);
+/* device may be NULL for the connection's default device. */
+void SetHeadPoseCacheConnection(HeadPoseCache *cache, LEAP_CONNECTION connection, LEAP_DEVICE device);
+
+/* For the polling thread */
+void RecordHeadPose(HeadPoseCache *cache, const LEAP_HEAD_POSE_EVENT *event);
+void RecordEyes(HeadPoseCache *cache, const LEAP_EYE_EVENT *event);
+
+/* Times are LeapGetNow() microseconds; results carry the requested time as their timestamp. */
+eHeadPoseSource GetCachedHeadPose(HeadPoseCache *cache, int64_t timestamp, LEAP_HEAD_POSE_EVENT *pose);
+eHeadPoseSource GetCachedEyes(HeadPoseCache *cache, int64_t timestamp, LEAP_EYE_EVENT *eyes);
+/* Fill one result and one source per timestamp; sources may be NULL. Return how many were answered. */
+uint32_t InterpolateCachedHeadPoses(HeadPoseCache *cache, const int64_t *timestamps, uint32_t count,
+                                    LEAP_HEAD_POSE_EVENT *poses, eHeadPoseSource *sources);
+uint32_t InterpolateCachedEyes(HeadPoseCache *cache, const int64_t *timestamps, uint32_t count,
+                               LEAP_EYE_EVENT *eyes, eHeadPoseSource *sources);
+void GetHeadPoseCacheStats(HeadPoseCache *cache, HeadPoseCacheStats *stats);
+
+#endif /* HeadPoseCache_h */
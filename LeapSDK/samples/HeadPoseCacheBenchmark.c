@@ -0,0 +1,219 @@
+/* Answers a renderer's head pose and eye queries from a HeadPoseCache.
+ *
+ * A simulated head sways and turns; head pose and eye events arrive at about
+ * 90 Hz with 1 ms of timestamp jitter, each 2 ms after its timestamp. A 120 Hz
+ * renderer asks for the pose at its frame time, past the newest event, and
+ * for both eye views 20 ms back, inside the window. Errors are against the
+ * true motion. The run is repeated with the event velocities left at zero,
+ * so extrapolation has to use the last two events. No connection is set, so
+ * the times the rings do not cover show up as misses rather than LeapC calls.
+ *
+ * A second phase records and queries from two threads at once.
+ *
+ */
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "ExampleConnection.h"
+#include "HeadPoseCache.h"
+#include "LeapMath.h"
+#include "LeapThreads.h"
+
+#define EVENT_US 11111
+#define RENDER_US 8333
+#define DELIVERY_US 2000
+#define LOOKBACK_US 20000
+#define SECONDS 60
+
+static uint32_t seed = 777;
+static float uniform(void){
+  seed = seed * 1664525u + 1013904223u;
+  return (float)(seed >> 8) / 16777216.0f;
+}
+
+static LEAP_VECTOR truePosition(int64_t us){
+  double t = us / 1e6;
+  return VectorMake(100.0f * (float)sin(2.0 * M_PI * 0.5 * t),
+                    300.0f + 50.0f * (float)sin(2.0 * M_PI * 0.7 * t),
+                    80.0f * (float)cos(2.0 * M_PI * 0.3 * t));
+}
+
+static LEAP_QUATERNION trueOrientation(int64_t us){
+  double t = us / 1e6;
+  float yaw = 0.6f * (float)sin(2.0 * M_PI * 0.4 * t), pitch = 0.3f * (float)sin(2.0 * M_PI * 0.25 * t);
+  LEAP_QUATERNION y = QuaternionMake(0.0f, sinf(0.5f * yaw), 0.0f, cosf(0.5f * yaw));
+  LEAP_QUATERNION x = QuaternionMake(sinf(0.5f * pitch), 0.0f, 0.0f, cosf(0.5f * pitch));
+  return QuaternionMultiply(y, x);
+}
+
+static float angleBetween(LEAP_QUATERNION a, LEAP_QUATERNION b){
+  float d = fabsf(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+  return 2.0f * acosf(d > 1.0f ? 1.0f : d) * 180.0f / (float)M_PI;
+}
+
+static LEAP_HEAD_POSE_EVENT headAt(int64_t us, bool velocities){
+  LEAP_HEAD_POSE_EVENT event;
+  memset(&event, 0, sizeof(event));
+  event.timestamp = us;
+  event.head_position = truePosition(us);
+  event.head_orientation = trueOrientation(us);
+  if(velocities){
+    const int64_t h = 500;
+    event.head_linear_velocity = VectorScale(VectorSub(truePosition(us + h), truePosition(us - h)), 1e6f / (2 * h));
+    LEAP_QUATERNION d = QuaternionMultiply(trueOrientation(us + h), QuaternionConjugate(trueOrientation(us - h)));
+    //Small rotation: the vector part is half the angle times the axis.
+    event.head_angular_velocity = VectorScale(VectorMake(d.x, d.y, d.z), (d.w < 0.0f ? -2.0f : 2.0f) * 1e6f / (2 * h));
+  }
+  return event;
+}
+
+static LEAP_EYE_EVENT eyesAt(int64_t us, int64_t frame){
+  LEAP_EYE_EVENT event;
+  memset(&event, 0, sizeof(event));
+  event.frame_id = frame;
+  event.timestamp = us;
+  LEAP_VECTOR half = QuaternionRotate(trueOrientation(us), VectorMake(32.0f, 0.0f, 0.0f));
+  event.left_eye_position = VectorSub(truePosition(us), half);
+  event.right_eye_position = VectorAdd(truePosition(us), half);
+  event.left_eye_estimated_error = event.right_eye_estimated_error = 2.0f;
+  return event;
+}
+
+typedef struct _Error {
+  double   position;
+  double   angle;
+  double   worstPosition;
+  uint32_t count;
+} Error;
+
+static void score(Error *error, const LEAP_HEAD_POSE_EVENT *pose){
+  float p = VectorLength(VectorSub(pose->head_position, truePosition(pose->timestamp)));
+  error->position += p;
+  error->angle += angleBetween(pose->head_orientation, trueOrientation(pose->timestamp));
+  error->worstPosition = p > error->worstPosition ? p : error->worstPosition;
+  error->count++;
+}
+
+static void printError(const char *label, const Error *error){
+  printf("  %-28s %.3f mm mean, %.3f mm worst, %.3f deg mean over %u queries\n", label,
+         error->count ? error->position / error->count : 0.0, error->worstPosition,
+         error->count ? error->angle / error->count : 0.0, error->count);
+}
+
+static void runVirtual(bool velocities){
+  HeadPoseCache *cache = CreateHeadPoseCache(NULL);
+  Error predicted, past, eyes;
+  memset(&predicted, 0, sizeof(predicted));
+  memset(&past, 0, sizeof(past));
+  memset(&eyes, 0, sizeof(eyes));
+  uint32_t sourceCount[4] = { 0 };
+  int64_t start = 10000000, nextEvent = start, frame = 0;
+  int64_t localTime = 0;
+  uint32_t queries = 0;
+  for(int64_t now = start + 100000; now < start + SECONDS * 1000000LL; now += RENDER_US){
+    //Deliver every event whose timestamp is at least DELIVERY_US old; drop a second of them midway.
+    while(nextEvent + DELIVERY_US <= now){
+      int64_t stamp = nextEvent + (int64_t)((uniform() - 0.5f) * 2000.0f);
+      if(nextEvent < start + 30000000 || nextEvent > start + 31000000){
+        LEAP_HEAD_POSE_EVENT head = headAt(stamp, velocities);
+        LEAP_EYE_EVENT eye = eyesAt(stamp, ++frame);
+        RecordHeadPose(cache, &head);
+        RecordEyes(cache, &eye);
+      }
+      nextEvent += EVENT_US;
+    }
+    LEAP_HEAD_POSE_EVENT pose, views[2];
+    LEAP_EYE_EVENT eye;
+    eHeadPoseSource sources[2];
+    int64_t viewTimes[2] = { now - LOOKBACK_US, now - LOOKBACK_US + 100 };
+    int64_t before = LeapGetNow();
+    eHeadPoseSource source = GetCachedHeadPose(cache, now, &pose);
+    uint32_t answered = InterpolateCachedHeadPoses(cache, viewTimes, 2, views, sources);
+    eHeadPoseSource eyeSource = GetCachedEyes(cache, now - LOOKBACK_US, &eye);
+    localTime += LeapGetNow() - before;
+    queries += 4;
+    sourceCount[source]++;
+    sourceCount[sources[0]]++;
+    sourceCount[sources[1]]++;
+    sourceCount[eyeSource]++;
+    if(source != eHeadPoseSource_None){
+      score(&predicted, &pose);
+    }
+    for(uint32_t v = 0; v < 2 && answered == 2; v++){
+      score(&past, &views[v]);
+    }
+    if(eyeSource != eHeadPoseSource_None){
+      LEAP_EYE_EVENT actual = eyesAt(eye.timestamp, 0);
+      float e = VectorLength(VectorSub(eye.left_eye_position, actual.left_eye_position));
+      eyes.position += e;
+      eyes.worstPosition = e > eyes.worstPosition ? e : eyes.worstPosition;
+      eyes.count++;
+    }
+  }
+  HeadPoseCacheStats stats;
+  GetHeadPoseCacheStats(cache, &stats);
+  printf("%s:\n", velocities ? "Events with velocities" : "Events without velocities");
+  printError("predicted at frame time", &predicted);
+  printError("views 20 ms back", &past);
+  printf("  %-28s %.3f mm mean, %.3f mm worst over %u queries\n", "left eye 20 ms back",
+         eyes.count ? eyes.position / eyes.count : 0.0, eyes.worstPosition, eyes.count);
+  printf("  %u interpolated, %u extrapolated, %u misses of %u queries; %llu events recorded\n",
+         sourceCount[eHeadPoseSource_Interpolated], sourceCount[eHeadPoseSource_Extrapolated],
+         sourceCount[eHeadPoseSource_None], queries, (unsigned long long)(stats.headPoses + stats.eyes));
+  printf("  %.0f ns per query, none of them a service round trip\n", localTime * 1000.0 / queries);
+  DestroyHeadPoseCache(cache);
+}
+
+typedef struct _Live {
+  HeadPoseCache *cache;
+  atomic_bool    running;
+} Live;
+
+static ThreadReturnType record(void *arg){
+  Live *live = (Live*)arg;
+  int64_t frame = 0;
+  while(atomic_load(&live->running)){
+    int64_t now = LeapGetNow();
+    LEAP_HEAD_POSE_EVENT head = headAt(now, true);
+    LEAP_EYE_EVENT eye = eyesAt(now, ++frame);
+    RecordHeadPose(live->cache, &head);
+    RecordEyes(live->cache, &eye);
+    millisleep(2);
+  }
+  return ThreadReturnValue;
+}
+
+static void runLive(void){
+  Live live;
+  live.cache = CreateHeadPoseCache(NULL);
+  atomic_init(&live.running, true);
+  ThreadType recorder;
+  StartThread(&recorder, record, &live);
+  uint32_t answered = 0, queries = 0;
+  int64_t end = LeapGetNow() + 500000;
+  while(LeapGetNow() < end){
+    int64_t times[2] = { LeapGetNow() - 5000, LeapGetNow() };
+    LEAP_HEAD_POSE_EVENT poses[2];
+    answered += InterpolateCachedHeadPoses(live.cache, times, 2, poses, NULL);
+    queries += 2;
+  }
+  atomic_store(&live.running, false);
+  JoinThread(recorder);
+  HeadPoseCacheStats stats;
+  GetHeadPoseCacheStats(live.cache, &stats);
+  printf("Two threads: %u of %u queries answered locally while %llu events were recorded\n",
+         answered, queries, (unsigned long long)stats.headPoses);
+  DestroyHeadPoseCache(live.cache);
+}
+
+int main(int argc, char** argv) {
+  runVirtual(true);
+  runVirtual(false);
+  runLive();
+  return 0;
+}
+//End-of-Sample
@@ -0,0 +1,449 @@
+/* Lossless compression of 8-bit image planes.
+ *
+ * Encoded plane:
+ *   u8  mode               0 stored, 1 Huffman
+ *   u8  predictor          eImagePredictor
+ *   u16 reserved
+ *   u32 payload size       bytes following the header (and code lengths)
+ *   u8  lengths[6][136]    Huffman mode only: 4-bit code length per symbol and
+ *                          context, low nibble first
+ *   payload                pixels, or the code bits, most significant bit first
+ *
+ * Symbols 0 to 255 are zigzag-mapped residuals. Symbol 255 + k, k = 1..15,
+ * is a run of 2^k + e zero residuals, with e in the following k bits.
+ *
+ * Each symbol is coded with one of six codes, chosen by the size of the
+ * residuals already coded to its left and above. Flat background, where
+ * those are small, then gets short codes for small residuals without
+ * lengthening the codes needed on the noisier, brighter hands.
+ *
+ */
+
+#include "ImageCodec.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CODEC_MODE_STORED 0
+#define CODEC_MODE_HUFFMAN 1
+#define CODEC_HEADER_SIZE 8
+#define CODEC_SYMBOLS 271
+#define CODEC_RUN_SYMBOL 255
+#define CODEC_MAX_RUN 65535
+#define CODEC_MAX_LENGTH 12
+#define CODEC_CONTEXTS 6
+#define CODEC_LENGTHS_SIZE ((CODEC_SYMBOLS + 1) / 2)
+#define CODEC_TABLES_SIZE (CODEC_CONTEXTS * CODEC_LENGTHS_SIZE)
+
+struct _ImageCodec {
+  uint32_t  maxPixels;
+  uint8_t  *residuals;
+  uint16_t *symbols;
+  uint16_t *extra;                //Run length bits of run symbols
+  uint8_t  *contexts;             //Context of each symbol
+  uint16_t *table;                //Decoding tables: symbol << 4 | length for every code-length prefix
+};
+
+ImageCodec* CreateImageCodec(uint32_t max_pixels){
+  ImageCodec *codec = calloc(1, sizeof(ImageCodec));
+  if(!codec){
+    return NULL;
+  }
+  codec->maxPixels = max_pixels;
+  codec->residuals = malloc(max_pixels ? max_pixels : 1);
+  codec->symbols = malloc((max_pixels ? max_pixels : 1) * sizeof(uint16_t));
+  codec->extra = malloc((max_pixels ? max_pixels : 1) * sizeof(uint16_t));
+  codec->contexts = malloc(max_pixels ? max_pixels : 1);
+  codec->table = malloc(((size_t)CODEC_CONTEXTS << CODEC_MAX_LENGTH) * sizeof(uint16_t));
+  if(!codec->residuals || !codec->symbols || !codec->extra || !codec->contexts || !codec->table){
+    DestroyImageCodec(codec);
+    return NULL;
+  }
+  return codec;
+}
+
+void DestroyImageCodec(ImageCodec *codec){
+  if(!codec){
+    return;
+  }
+  free(codec->residuals);
+  free(codec->symbols);
+  free(codec->extra);
+  free(codec->contexts);
+  free(codec->table);
+  free(codec);
+}
+
+size_t GetEncodedPlaneBound(uint32_t width, uint32_t height){
+  return CODEC_HEADER_SIZE + (size_t)width * height;
+}
+
+static void putU32(uint8_t *p, uint32_t v){
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t getU32(const uint8_t *p){
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint8_t zigzag(uint8_t pixel, uint8_t prediction){
+  int8_t r = (int8_t)(uint8_t)(pixel - prediction);
+  return (uint8_t)(r >= 0 ? 2 * r : -2 * r - 1);
+}
+
+static inline uint8_t unzigzag(uint8_t z, uint8_t prediction){
+  return (uint8_t)(prediction + ((z & 1) ? -(z >> 1) - 1 : z >> 1));
+}
+
+static inline uint8_t medianEdge(uint8_t a, uint8_t b, uint8_t c){
+  uint8_t lo = a < b ? a : b, hi = a < b ? b : a;
+  return c >= hi ? lo : c <= lo ? hi : (uint8_t)(a + b - c);
+}
+
+/** The first row predicts from the left, the first column from above. */
+static void computeResiduals(const uint8_t *pixels, uint32_t W, uint32_t H, eImagePredictor predictor, uint8_t *out){
+  out[0] = zigzag(pixels[0], 0);
+  for(uint32_t x = 1; x < W; x++){
+    out[x] = zigzag(pixels[x], pixels[x - 1]);
+  }
+  for(uint32_t y = 1; y < H; y++){
+    const uint8_t *row = pixels + (size_t)y * W, *above = row - W;
+    uint8_t *res = out + (size_t)y * W;
+    res[0] = zigzag(row[0], above[0]);
+    switch(predictor){
+      case eImagePredictor_Left:
+        for(uint32_t x = 1; x < W; x++) res[x] = zigzag(row[x], row[x - 1]);
+        break;
+      case eImagePredictor_Up:
+        for(uint32_t x = 1; x < W; x++) res[x] = zigzag(row[x], above[x]);
+        break;
+      default:
+        for(uint32_t x = 1; x < W; x++) res[x] = zigzag(row[x], medianEdge(row[x - 1], above[x], above[x - 1]));
+        break;
+    }
+  }
+}
+
+static void reconstruct(const uint8_t *res, uint32_t W, uint32_t H, eImagePredictor predictor, uint8_t *pixels){
+  pixels[0] = unzigzag(res[0], 0);
+  for(uint32_t x = 1; x < W; x++){
+    pixels[x] = unzigzag(res[x], pixels[x - 1]);
+  }
+  for(uint32_t y = 1; y < H; y++){
+    uint8_t *row = pixels + (size_t)y * W, *above = row - W;
+    const uint8_t *r = res + (size_t)y * W;
+    row[0] = unzigzag(r[0], above[0]);
+    switch(predictor){
+      case eImagePredictor_Left:
+        for(uint32_t x = 1; x < W; x++) row[x] = unzigzag(r[x], row[x - 1]);
+        break;
+      case eImagePredictor_Up:
+        for(uint32_t x = 1; x < W; x++) row[x] = unzigzag(r[x], above[x]);
+        break;
+      default:
+        for(uint32_t x = 1; x < W; x++) row[x] = unzigzag(r[x], medianEdge(row[x - 1], above[x], above[x - 1]));
+        break;
+    }
+  }
+}
+
+static inline uint32_t floorLog2(uint32_t v){
+  uint32_t k = 0;
+  while(v >>= 1){
+    k++;
+  }
+  return k;
+}
+
+/** Coding context from the residuals left of and above i; the left of a row start is the previous row's end. */
+static inline uint32_t contextAt(const uint8_t *res, size_t i, uint32_t W){
+  uint32_t e = i >= W ? (uint32_t)res[i - 1] + res[i - W] : i ? 2u * res[i - 1] : 0;
+  return (e > 0) + (e > 2) + (e > 6) + (e > 14) + (e > 30);
+}
+
+/** Splits the residuals into symbols, collapsing zero runs. Returns the number of symbols. */
+static uint32_t tokenize(ImageCodec *codec, uint32_t n, uint32_t W, uint32_t freq[][CODEC_SYMBOLS]){
+  const uint8_t *res = codec->residuals;
+  uint32_t count = 0;
+  for(uint32_t i = 0; i < n;){
+    uint32_t context = contextAt(res, i, W);
+    codec->contexts[count] = (uint8_t)context;
+    if(res[i]){
+      codec->symbols[count++] = res[i];
+      freq[context][res[i]]++;
+      i++;
+      continue;
+    }
+    uint32_t run = 1;
+    while(i + run < n && run < CODEC_MAX_RUN && !res[i + run]){
+      run++;
+    }
+    i += run;
+    if(run == 1){
+      codec->symbols[count++] = 0;
+      freq[context][0]++;
+      continue;
+    }
+    uint32_t k = floorLog2(run);
+    codec->symbols[count] = (uint16_t)(CODEC_RUN_SYMBOL + k);
+    codec->extra[count++] = (uint16_t)(run - (1u << k));
+    freq[context][CODEC_RUN_SYMBOL + k]++;
+  }
+  return count;
+}
+
+static int compareWeights(const void *a, const void *b){
+  uint64_t wa = *(const uint64_t*)a, wb = *(const uint64_t*)b;
+  return wa < wb ? -1 : wa > wb;
+}
+
+/** Huffman code lengths; frequencies are flattened until no code exceeds CODEC_MAX_LENGTH. */
+static void buildLengths(const uint32_t *counts, uint8_t *lengths){
+  uint32_t freq[CODEC_SYMBOLS];
+  memcpy(freq, counts, sizeof(freq));
+  for(;;){
+    //Leaves sorted by weight, symbol in the low bits
+    uint64_t leaves[CODEC_SYMBOLS];
+    uint32_t m = 0;
+    for(uint32_t s = 0; s < CODEC_SYMBOLS; s++){
+      if(freq[s]){
+        leaves[m++] = (uint64_t)freq[s] << 16 | s;
+      }
+    }
+    memset(lengths, 0, CODEC_SYMBOLS);
+    if(m == 0){
+      return;
+    }
+    if(m == 1){
+      lengths[leaves[0] & 0xffff] = 1;
+      return;
+    }
+    qsort(leaves, m, sizeof(uint64_t), compareWeights);
+
+    //Two-queue merge: internal nodes are created in order of weight.
+    uint64_t weight[2 * CODEC_SYMBOLS];
+    uint32_t parent[2 * CODEC_SYMBOLS], depth[2 * CODEC_SYMBOLS];
+    for(uint32_t i = 0; i < m; i++){
+      weight[i] = leaves[i] >> 16;
+    }
+    uint32_t leaf = 0, node = m, next = m;
+    for(uint32_t merge = 0; merge + 1 < m; merge++){
+      uint32_t pick[2];
+      for(int k = 0; k < 2; k++){
+        if(leaf < m && (node >= next || weight[leaf] <= weight[node])){
+          pick[k] = leaf++;
+        } else {
+          pick[k] = node++;
+        }
+      }
+      weight[next] = weight[pick[0]] + weight[pick[1]];
+      parent[pick[0]] = parent[pick[1]] = next;
+      next++;
+    }
+    uint32_t root = next - 1, longest = 0;
+    depth[root] = 0;
+    for(uint32_t i = root; i-- > 0;){
+      depth[i] = depth[parent[i]] + 1;
+    }
+    for(uint32_t i = 0; i < m; i++){
+      lengths[leaves[i] & 0xffff] = (uint8_t)depth[i];
+      if(depth[i] > longest){
+        longest = depth[i];
+      }
+    }
+    if(longest <= CODEC_MAX_LENGTH){
+      return;
+    }
+    for(uint32_t s = 0; s < CODEC_SYMBOLS; s++){
+      if(freq[s]){
+        freq[s] = (freq[s] >> 1) | 1;
+      }
+    }
+  }
+}
+
+/** Canonical codes; returns false if the lengths over-subscribe the code space. */
+static bool assignCodes(const uint8_t *lengths, uint16_t *codes){
+  uint32_t count[CODEC_MAX_LENGTH + 1] = { 0 }, next[CODEC_MAX_LENGTH + 1];
+  uint32_t space = 0;
+  for(uint32_t s = 0; s < CODEC_SYMBOLS; s++){
+    if(lengths[s]){
+      count[lengths[s]]++;
+      space += 1u << (CODEC_MAX_LENGTH - lengths[s]);
+    }
+  }
+  if(space > 1u << CODEC_MAX_LENGTH){
+    return false;
+  }
+  uint32_t code = 0;
+  for(uint32_t len = 1; len <= CODEC_MAX_LENGTH; len++){
+    code = (code + count[len - 1]) << 1;
+    next[len] = code;
+  }
+  for(uint32_t s = 0; s < CODEC_SYMBOLS; s++){
+    if(lengths[s]){
+      codes[s] = (uint16_t)next[lengths[s]]++;
+    }
+  }
+  return true;
+}
+
+size_t EncodePlane(ImageCodec *codec, const uint8_t *pixels, uint32_t width, uint32_t height,
+                   eImagePredictor predictor, uint8_t *buffer, size_t capacity){
+  size_t n = (size_t)width * height;
+  if(n == 0 || n > codec->maxPixels || capacity < GetEncodedPlaneBound(width, height)){
+    return 0;
+  }
+  computeResiduals(pixels, width, height, predictor, codec->residuals);
+  uint32_t freq[CODEC_CONTEXTS][CODEC_SYMBOLS];
+  memset(freq, 0, sizeof(freq));
+  uint32_t count = tokenize(codec, (uint32_t)n, width, freq);
+  uint8_t lengths[CODEC_CONTEXTS][CODEC_SYMBOLS];
+  uint16_t codes[CODEC_CONTEXTS][CODEC_SYMBOLS];
+  uint64_t bits = 0;
+  for(uint32_t c = 0; c < CODEC_CONTEXTS; c++){
+    buildLengths(freq[c], lengths[c]);
+    assignCodes(lengths[c], codes[c]);
+    for(uint32_t s = 0; s < CODEC_SYMBOLS; s++){
+      bits += (uint64_t)freq[c][s] * (lengths[c][s] + (s > CODEC_RUN_SYMBOL ? s - CODEC_RUN_SYMBOL : 0));
+    }
+  }
+  size_t payload = (size_t)((bits + 7) / 8);
+  buffer[1] = (uint8_t)predictor;
+  buffer[2] = buffer[3] = 0;
+  if(CODEC_TABLES_SIZE + payload >= n){
+    buffer[0] = CODEC_MODE_STORED;
+    putU32(buffer + 4, (uint32_t)n);
+    memcpy(buffer + CODEC_HEADER_SIZE, pixels, n);
+    return CODEC_HEADER_SIZE + n;
+  }
+  buffer[0] = CODEC_MODE_HUFFMAN;
+  putU32(buffer + 4, (uint32_t)payload);
+  uint8_t *out = buffer + CODEC_HEADER_SIZE;
+  for(uint32_t c = 0; c < CODEC_CONTEXTS; c++){
+    for(uint32_t s = 0; s < CODEC_LENGTHS_SIZE; s++){
+      uint8_t high = 2 * s + 1 < CODEC_SYMBOLS ? lengths[c][2 * s + 1] : 0;
+      *out++ = (uint8_t)(lengths[c][2 * s] | high << 4);
+    }
+  }
+
+  uint64_t acc = 0;
+  uint32_t pending = 0;
+  for(uint32_t i = 0; i < count; i++){
+    uint32_t s = codec->symbols[i], c = codec->contexts[i];
+    acc = acc << lengths[c][s] | codes[c][s];
+    pending += lengths[c][s];
+    if(s > CODEC_RUN_SYMBOL){
+      uint32_t k = s - CODEC_RUN_SYMBOL;
+      acc = acc << k | codec->extra[i];
+      pending += k;
+    }
+    while(pending >= 32){
+      uint32_t word = (uint32_t)(acc >> (pending - 32));
+      out[0] = (uint8_t)(word >> 24);
+      out[1] = (uint8_t)(word >> 16);
+      out[2] = (uint8_t)(word >> 8);
+      out[3] = (uint8_t)word;
+      out += 4;
+      pending -= 32;
+    }
+  }
+  while(pending >= 8){
+    *out++ = (uint8_t)(acc >> (pending - 8));
+    pending -= 8;
+  }
+  if(pending){
+    *out++ = (uint8_t)(acc << (8 - pending));
+  }
+  return CODEC_HEADER_SIZE + CODEC_TABLES_SIZE + payload;
+}
+
+bool DecodePlane(ImageCodec *codec, const uint8_t *buffer, size_t size,
+                 uint8_t *pixels, uint32_t width, uint32_t height){
+  size_t n = (size_t)width * height;
+  if(n == 0 || n > codec->maxPixels || size < CODEC_HEADER_SIZE || buffer[1] > eImagePredictor_MED){
+    return false;
+  }
+  eImagePredictor predictor = (eImagePredictor)buffer[1];
+  size_t payload = getU32(buffer + 4);
+  if(buffer[0] == CODEC_MODE_STORED){
+    if(payload != n || size < CODEC_HEADER_SIZE + n){
+      return false;
+    }
+    memcpy(pixels, buffer + CODEC_HEADER_SIZE, n);
+    return true;
+  }
+  if(buffer[0] != CODEC_MODE_HUFFMAN || size < CODEC_HEADER_SIZE + CODEC_TABLES_SIZE + payload){
+    return false;
+  }
+
+  const uint8_t *in = buffer + CODEC_HEADER_SIZE;
+  for(uint32_t c = 0; c < CODEC_CONTEXTS; c++){
+    uint8_t lengths[CODEC_SYMBOLS];
+    uint16_t codes[CODEC_SYMBOLS];
+    const uint8_t *packed = in + c * CODEC_LENGTHS_SIZE;
+    for(uint32_t s = 0; s < CODEC_SYMBOLS; s++){
+      lengths[s] = (packed[s / 2] >> (4 * (s & 1))) & 0x0f;
+      if(lengths[s] > CODEC_MAX_LENGTH){
+        return false;
+      }
+    }
+    if(!assignCodes(lengths, codes)){
+      return false;
+    }
+    uint16_t *table = codec->table + ((size_t)c << CODEC_MAX_LENGTH);
+    memset(table, 0, ((size_t)1 << CODEC_MAX_LENGTH) * sizeof(uint16_t));
+    for(uint32_t s = 0; s < CODEC_SYMBOLS; s++){
+      if(lengths[s]){
+        uint32_t shift = CODEC_MAX_LENGTH - lengths[s];
+        uint16_t entry = (uint16_t)(s << 4 | lengths[s]);
+        for(uint32_t code = (uint32_t)codes[s] << shift; code < (uint32_t)(codes[s] + 1) << shift; code++){
+          table[code] = entry;
+        }
+      }
+    }
+  }
+
+  const uint8_t *bits = in + CODEC_TABLES_SIZE;
+  size_t read = 0;                //Bytes moved into acc, zeros past the payload
+  uint64_t acc = 0;               //Unread bits, most significant first
+  uint32_t available = 0;
+  uint8_t *res = codec->residuals;
+  for(size_t i = 0; i < n;){
+    while(available <= 56){
+      acc |= (uint64_t)(read < payload ? bits[read] : 0) << (56 - available);
+      read++;
+      available += 8;
+    }
+    const uint16_t *table = codec->table + ((size_t)contextAt(res, i, width) << CODEC_MAX_LENGTH);
+    uint16_t entry = table[acc >> (64 - CODEC_MAX_LENGTH)];
+    uint32_t len = entry & 0x0f, s = entry >> 4;
+    if(!len){
+      return false;
+    }
+    acc <<= len;
+    available -= len;
+    if(s <= CODEC_RUN_SYMBOL){
+      res[i++] = (uint8_t)s;
+      continue;
+    }
+    uint32_t k = s - CODEC_RUN_SYMBOL;
+    uint32_t run = (1u << k) + (uint32_t)(acc >> (64 - k));
+    acc <<= k;
+    available -= k;
+    if(run > n - i){
+      return false;
+    }
+    memset(res + i, 0, run);
+    i += run;
+  }
+  //Bits consumed must lie inside the payload.
+  if(read * 8 - available > payload * 8){
+    return false;
+  }
+  reconstruct(res, width, height, predictor, pixels);
+  return true;
+}
+//End-of-ImageCodec.c
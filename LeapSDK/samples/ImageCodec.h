@@ -0,0 +1,48 @@
+/* Lossless compression of 8-bit image planes.
+ *
+ * Each pixel is predicted from its decoded neighbours: the pixel to the left,
+ * the one above, or the median edge detector of LOCO-I/JPEG-LS, which picks
+ * left or above next to an edge and their gradient blend elsewhere. The
+ * prediction residuals are mapped to small unsigned values, runs of zero
+ * residual collapse into run-length symbols, and the symbols are stored with
+ * canonical Huffman codes built for the plane, one per local activity
+ * context. IR images are mostly a dark, smooth background, so the runs and
+ * the skewed residual histogram carry most of the gain.
+ *
+ * An encoded plane is self-describing apart from its size: a small header
+ * gives the predictor and the code lengths. A plane that would not shrink is
+ * stored verbatim. All multi-byte fields are little-endian.
+ *
+ * An ImageCodec holds the scratch buffers for planes up to the size it was
+ * created for and may be used by one thread at a time.
+ *
+ */
+
+#ifndef ImageCodec_h
+#define ImageCodec_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum _eImagePredictor {
+  eImagePredictor_Left,
+  eImagePredictor_Up,
+  eImagePredictor_MED             //Median edge detector
+} eImagePredictor;
+
+typedef struct _ImageCodec ImageCodec;
+
+ImageCodec* CreateImageCodec(uint32_t max_pixels);
+void DestroyImageCodec(ImageCodec *codec);
+size_t GetEncodedPlaneBound(uint32_t width, uint32_t height);
+
+/* Returns the number of bytes written, or 0 if the plane is larger than the codec or capacity is too small. */
+size_t EncodePlane(ImageCodec *codec, const uint8_t *pixels, uint32_t width, uint32_t height,
+                   eImagePredictor predictor, uint8_t *buffer, size_t capacity);
+
+/* Returns false on a malformed buffer. */
+bool DecodePlane(ImageCodec *codec, const uint8_t *buffer, size_t size,
+                 uint8_t *pixels, uint32_t width, uint32_t height);
+
+#endif /* ImageCodec_h */
@@ -0,0 +1,352 @@
+/* Fixed-capacity pool of image buffers for LeapC's image stream.
+ *
+ * Each slot is free when LeapC has deallocated it and no consumer has it
+ * queued or held. The slots are few, so finding a free slot or the oldest
+ * queued image is a scan rather than a list. The policy flag is changed
+ * under its own lock, never from inside the allocator callbacks, which run
+ * within LeapPollConnection(); PublishPooledImage() pauses and
+ * ReleasePooledImage() resumes.
+ *
+ */
+
+#include "ImagePool.h"
+#include "LeapThreads.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGEPOOL_MAX_SLOTS 64
+//Smaller requests are not image buffers.
+#define IMAGEPOOL_MIN_IMAGE_BYTES 65536
+
+typedef enum _eSlotStage {
+  eSlotStage_Idle,
+  eSlotStage_Queued,
+  eSlotStage_Held
+} eSlotStage;
+
+typedef struct _PoolSlot {
+  uint8_t   *buffer;
+  uint32_t   bytes;
+  bool       inLibrary;       //Allocated to LeapC and not yet deallocated
+  eSlotStage stage;
+  uint64_t   sequence;        //Publication order
+  PooledImage image;
+  bool       hasDistortion[2];
+  uint64_t   distortionVersion[2];
+  LEAP_DISTORTION_MATRIX distortion[2];
+} PoolSlot;
+
+struct _ImagePool {
+  ImagePoolConfig config;
+  LEAP_CONNECTION connection;
+  LockType        lock;
+  CondType        queuedCond;
+  PoolSlot       *slots;
+  uint32_t        slotBytes;  //Size new and regrown slots get
+  uint64_t        nextSequence;
+  bool            wantImages; //Policy the pool asks for
+  LockType        policyLock;
+  bool            imagesOn;   //Policy last sent to LeapC, under policyLock
+  ImagePoolStats  stats;
+};
+
+void GetDefaultImagePoolConfig(ImagePoolConfig *config){
+  memset(config, 0, sizeof(ImagePoolConfig));
+  config->capacity = 8;
+  config->exhausted = eImagePoolExhausted_DropOldest;
+  config->resume_below = 4;
+}
+
+static bool allocateSlot(ImagePool *pool, PoolSlot *slot, uint32_t bytes){
+  uint8_t *buffer = realloc(slot->buffer, bytes);
+  if(!buffer){
+    return false;
+  }
+  pool->stats.slotBytes += (uint64_t)bytes - slot->bytes;
+  slot->buffer = buffer;
+  slot->bytes = bytes;
+  return true;
+}
+
+/** Brings a slot up to the current slot size. Call with lock held. */
+static bool growSlot(ImagePool *pool, PoolSlot *slot){
+  if(slot->bytes >= pool->slotBytes){
+    return true;
+  }
+  bool resize = slot->buffer != NULL;
+  if(!allocateSlot(pool, slot, pool->slotBytes)){
+    return false;
+  }
+  pool->stats.resizes += resize;
+  return true;
+}
+
+ImagePool* CreateImagePool(const ImagePoolConfig *config, LEAP_CONNECTION connection){
+  ImagePoolConfig defaults;
+  if(!config){
+    GetDefaultImagePoolConfig(&defaults);
+    config = &defaults;
+  }
+  if(config->capacity == 0 || config->capacity > IMAGEPOOL_MAX_SLOTS || config->resume_below >= config->capacity){
+    return NULL;
+  }
+  ImagePool *pool = calloc(1, sizeof(ImagePool));
+  if(!pool){
+    return NULL;
+  }
+  pool->slots = calloc(config->capacity, sizeof(PoolSlot));
+  if(!pool->slots){
+    free(pool);
+    return NULL;
+  }
+  pool->config = *config;
+  pool->connection = connection;
+  pool->slotBytes = config->slot_bytes;
+  pool->wantImages = true;
+  pool->imagesOn = true;
+  for(uint32_t i = 0; i < config->capacity && config->slot_bytes; i++){
+    if(!allocateSlot(pool, &pool->slots[i], config->slot_bytes)){
+      for(uint32_t j = 0; j < i; j++){
+        free(pool->slots[j].buffer);
+      }
+      free(pool->slots);
+      free(pool);
+      return NULL;
+    }
+  }
+  InitLock(&pool->lock);
+  InitLock(&pool->policyLock);
+  InitCond(&pool->queuedCond);
+  return pool;
+}
+
+void DestroyImagePool(ImagePool *pool){
+  if(!pool){
+    return;
+  }
+  for(uint32_t i = 0; i < pool->config.capacity; i++){
+    free(pool->slots[i].buffer);
+  }
+  DestroyCond(&pool->queuedCond);
+  DestroyLock(&pool->policyLock);
+  DestroyLock(&pool->lock);
+  free(pool->slots);
+  free(pool);
+}
+
+eLeapRS InstallImagePool(ImagePool *pool, LEAP_CONNECTION connection){
+  LEAP_ALLOCATOR allocator = { AllocatePooledBuffer, DeallocatePooledBuffer, pool };
+  return LeapSetAllocator(connection, &allocator);
+}
+
+/** Call with lock held. */
+static PoolSlot* findSlot(ImagePool *pool, const void *ptr){
+  const uint8_t *address = (const uint8_t*)ptr;
+  for(uint32_t i = 0; i < pool->config.capacity; i++){
+    PoolSlot *slot = &pool->slots[i];
+    if(slot->buffer && address >= slot->buffer && address < slot->buffer + slot->bytes){
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+/** The oldest queued slot, optionally only among those LeapC has let go of. Call with lock held. */
+static PoolSlot* oldestQueued(ImagePool *pool, bool released){
+  PoolSlot *oldest = NULL;
+  for(uint32_t i = 0; i < pool->config.capacity; i++){
+    PoolSlot *slot = &pool->slots[i];
+    if(slot->stage == eSlotStage_Queued && !(released && slot->inLibrary) &&
+       (!oldest || slot->sequence < oldest->sequence)){
+      oldest = slot;
+    }
+  }
+  return oldest;
+}
+
+/** Call with lock held. */
+static void countSlots(ImagePool *pool){
+  uint32_t queued = 0, held = 0, inUse = 0;
+  for(uint32_t i = 0; i < pool->config.capacity; i++){
+    const PoolSlot *slot = &pool->slots[i];
+    queued += slot->stage == eSlotStage_Queued;
+    held += slot->stage == eSlotStage_Held;
+    inUse += slot->inLibrary || slot->stage != eSlotStage_Idle;
+  }
+  pool->stats.queued = queued;
+  pool->stats.held = held;
+  if(inUse > pool->stats.peakInUse){
+    pool->stats.peakInUse = inUse;
+  }
+}
+
+void* AllocatePooledBuffer(uint32_t size, eLeapAllocatorType typeHint, void *state){
+  ImagePool *pool = (ImagePool*)state;
+  if(typeHint != eLeapAllocatorType_Uint8 || size < IMAGEPOOL_MIN_IMAGE_BYTES){
+    LockMutex(&pool->lock);
+    pool->stats.passthrough++;
+    UnlockMutex(&pool->lock);
+    return malloc(size);
+  }
+  LockMutex(&pool->lock);
+  if(size > pool->slotBytes){
+    //The first image, or a device with larger images: size every free slot now
+    //rather than while streaming. Slots in use grow when they are next picked.
+    pool->slotBytes = size;
+    for(uint32_t i = 0; i < pool->config.capacity; i++){
+      PoolSlot *slot = &pool->slots[i];
+      if(!slot->inLibrary && slot->stage == eSlotStage_Idle){
+        growSlot(pool, slot);
+      }
+    }
+  }
+  PoolSlot *slot = NULL;
+  for(uint32_t i = 0; i < pool->config.capacity && !slot; i++){
+    if(!pool->slots[i].inLibrary && pool->slots[i].stage == eSlotStage_Idle){
+      slot = &pool->slots[i];
+    }
+  }
+  if(!slot && pool->config.exhausted == eImagePoolExhausted_DropOldest){
+    slot = oldestQueued(pool, true);
+    if(slot){
+      slot->stage = eSlotStage_Idle;
+      pool->stats.dropped++;
+    }
+  }
+  if(slot && slot->bytes < size && !growSlot(pool, slot)){
+    slot = NULL;
+  }
+  if(!slot){
+    pool->stats.rejected++;
+    UnlockMutex(&pool->lock);
+    return NULL;
+  }
+  slot->inLibrary = true;
+  pool->stats.allocations++;
+  countSlots(pool);
+  UnlockMutex(&pool->lock);
+  return slot->buffer;
+}
+
+void DeallocatePooledBuffer(void *ptr, void *state){
+  ImagePool *pool = (ImagePool*)state;
+  if(!ptr){
+    return;
+  }
+  LockMutex(&pool->lock);
+  PoolSlot *slot = findSlot(pool, ptr);
+  if(slot){
+    slot->inLibrary = false;
+  }
+  UnlockMutex(&pool->lock);
+  if(!slot){
+    free(ptr);
+  }
+}
+
+/** Sends the policy the pool wants if it differs from the last one sent. */
+static void applyPolicy(ImagePool *pool){
+  LockMutex(&pool->policyLock);
+  LockMutex(&pool->lock);
+  bool want = pool->wantImages;
+  UnlockMutex(&pool->lock);
+  if(want != pool->imagesOn){
+    if(pool->connection){
+      LeapSetPolicyFlags(pool->connection, want ? eLeapPolicyFlag_Images : 0, want ? 0 : eLeapPolicyFlag_Images);
+    }
+    pool->imagesOn = want;
+  }
+  UnlockMutex(&pool->policyLock);
+}
+
+bool PublishPooledImage(ImagePool *pool, const LEAP_IMAGE_EVENT *event){
+  LockMutex(&pool->lock);
+  PoolSlot *slot = findSlot(pool, event->image[0].data);
+  if(!slot || slot->stage != eSlotStage_Idle){
+    pool->stats.unpooled++;
+    UnlockMutex(&pool->lock);
+    return false;
+  }
+  UnlockMutex(&pool->lock);
+
+  //The slot is LeapC's until it is queued, so it is filled in without the lock.
+  slot->image.event = *event;
+  slot->image.slot = (uint32_t)(slot - pool->slots);
+  for(int c = 0; c < 2; c++){
+    const LEAP_DISTORTION_MATRIX *matrix = event->image[c].distortion_matrix;
+    if(!matrix){
+      continue;
+    }
+    if(!slot->hasDistortion[c] || slot->distortionVersion[c] != event->image[c].matrix_version){
+      memcpy(&slot->distortion[c], matrix, sizeof(LEAP_DISTORTION_MATRIX));
+      slot->distortionVersion[c] = event->image[c].matrix_version;
+      slot->hasDistortion[c] = true;
+    }
+    slot->image.event.image[c].distortion_matrix = &slot->distortion[c];
+  }
+
+  LockMutex(&pool->lock);
+  slot->stage = eSlotStage_Queued;
+  slot->sequence = pool->nextSequence++;
+  pool->stats.published++;
+  countSlots(pool);
+  if(pool->config.exhausted == eImagePoolExhausted_PauseImages && pool->wantImages &&
+     pool->stats.queued + pool->stats.held + 1 >= pool->config.capacity){
+    pool->wantImages = false;
+    pool->stats.pauses++;
+  }
+  SignalCond(&pool->queuedCond);
+  UnlockMutex(&pool->lock);
+  applyPolicy(pool);
+  return true;
+}
+
+const PooledImage* AcquirePooledImage(ImagePool *pool, uint32_t timeout_ms){
+  int64_t deadline = LeapGetNow() + (int64_t)timeout_ms * 1000;
+  LockMutex(&pool->lock);
+  PoolSlot *slot = oldestQueued(pool, false);
+  while(!slot){
+    int64_t remaining = deadline - LeapGetNow();
+    if(remaining <= 0){
+      break;
+    }
+    WaitCond(&pool->queuedCond, &pool->lock, (uint32_t)((remaining + 999) / 1000));
+    slot = oldestQueued(pool, false);
+  }
+  if(slot){
+    slot->stage = eSlotStage_Held;
+    pool->stats.acquired++;
+    countSlots(pool);
+  }
+  UnlockMutex(&pool->lock);
+  return slot ? &slot->image : NULL;
+}
+
+void ReleasePooledImage(ImagePool *pool, const PooledImage *image){
+  if(!image || image->slot >= pool->config.capacity){
+    return;
+  }
+  LockMutex(&pool->lock);
+  PoolSlot *slot = &pool->slots[image->slot];
+  if(slot->stage != eSlotStage_Held){
+    UnlockMutex(&pool->lock);
+    return;
+  }
+  slot->stage = eSlotStage_Idle;
+  pool->stats.released++;
+  countSlots(pool);
+  if(!pool->wantImages && pool->stats.queued + pool->stats.held <= pool->config.resume_below){
+    pool->wantImages = true;
+    pool->stats.resumes++;
+  }
+  UnlockMutex(&pool->lock);
+  applyPolicy(pool);
+}
+
+void GetImagePoolStats(ImagePool *pool, ImagePoolStats *stats){
+  LockMutex(&pool->lock);
+  *stats = pool->stats;
+  stats->paused = !pool->wantImages;
+  UnlockMutex(&pool->lock);
+}
+//End-of-ImagePool.c
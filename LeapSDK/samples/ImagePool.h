@@ -0,0 +1,89 @@
+/* Fixed-capacity pool of image buffers for LeapC's image stream.
+ *
+ * With eLeapPolicyFlag_Images set, LeapC asks the connection's allocator for
+ * a buffer for every image pair and tells it through deallocate when it no
+ * longer reads that buffer; both images of a pair share one buffer. An
+ * ImagePool installed with InstallImagePool() serves those requests from a
+ * fixed set of slots instead of the heap, and hands the filled slots to
+ * consumers:
+ *
+ *   - on the polling thread, PublishPooledImage() is called with each
+ *     LEAP_IMAGE_EVENT, e.g. from ConnectionCallbacks.on_image. It queues the
+ *     slot the event's images live in, with a copy of the event;
+ *   - any thread takes the oldest queued image with AcquirePooledImage() and
+ *     gives it back with ReleasePooledImage(). A slot is reused once it has
+ *     been released and LeapC has deallocated it.
+ *
+ * When every slot is in use the pool either drops the oldest queued image to
+ * make room, or clears eLeapPolicyFlag_Images when consumers hold or have
+ * queued all but one slot and sets it again once they are down to
+ * resume_below. Memory stays at capacity slots however far consumers fall
+ * behind. Requests that are not image-sized go to malloc.
+ *
+ */
+
+#ifndef ImagePool_h
+#define ImagePool_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum _eImagePoolExhausted {
+  eImagePoolExhausted_DropOldest,     //Reuse the oldest image no consumer has acquired
+  eImagePoolExhausted_PauseImages     //Clear eLeapPolicyFlag_Images until consumers catch up
+} eImagePoolExhausted;
+
+typedef struct _ImagePoolConfig {
+  uint32_t            capacity;       //Slots; at most 64
+  uint32_t            slot_bytes;     //Bytes per slot; 0 to size them from the first image
+  eImagePoolExhausted exhausted;
+  uint32_t            resume_below;   //Queued plus held images at which a paused stream restarts
+} ImagePoolConfig;
+
+typedef struct _ImagePoolStats {
+  uint64_t allocations;               //Image buffers handed to LeapC
+  uint64_t published;
+  uint64_t acquired;
+  uint64_t released;
+  uint64_t dropped;                   //Queued images discarded to make room
+  uint64_t rejected;                  //Image buffers refused because no slot was free
+  uint64_t unpooled;                  //Published events whose images were not in the pool
+  uint64_t passthrough;               //Other allocations served by malloc
+  uint64_t pauses;
+  uint64_t resumes;
+  uint64_t resizes;                   //Slots regrown for larger images
+  uint64_t slotBytes;                 //Memory held by the slots
+  uint32_t queued;
+  uint32_t held;
+  uint32_t peakInUse;                 //Most slots in use at once
+  bool     paused;
+} ImagePoolStats;
+
+/** An image pair owned by a consumer until released. */
+typedef struct _PooledImage {
+  LEAP_IMAGE_EVENT event;             //Image data and distortion matrices point into the slot
+  uint32_t         slot;
+} PooledImage;
+
+typedef struct _ImagePool ImagePool;
+
+void GetDefaultImagePoolConfig(ImagePoolConfig *config);
+/* connection is only used to pause and resume images and may be NULL. */
+ImagePool* CreateImagePool(const ImagePoolConfig *config, LEAP_CONNECTION connection);
+/* Call after the connection has stopped polling and every image is released. */
+void DestroyImagePool(ImagePool *pool);
+
+/* Makes the pool the connection's allocator. */
+eLeapRS InstallImagePool(ImagePool *pool, LEAP_CONNECTION connection);
+/* The allocator functions, for callers that wrap them; state is the pool. */
+void* AllocatePooledBuffer(uint32_t size, eLeapAllocatorType typeHint, void *state);
+void DeallocatePooledBuffer(void *ptr, void *state);
+
+bool PublishPooledImage(ImagePool *pool, const LEAP_IMAGE_EVENT *event);
+/* Waits up to timeout_ms for a queued image; NULL if there is none. */
+const PooledImage* AcquirePooledImage(ImagePool *pool, uint32_t timeout_ms);
+void ReleasePooledImage(ImagePool *pool, const PooledImage *image);
+void GetImagePoolStats(ImagePool *pool, ImagePoolStats *stats);
+
+#endif /* ImagePool_h */
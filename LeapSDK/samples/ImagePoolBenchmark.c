@@ -0,0 +1,156 @@
+/* Streams images through an ImagePool faster than its consumers keep up.
+ *
+ * A producer thread stands in for LeapC: at about 90 frames per second it
+ * asks the pool's allocator for a 640x240 pair, stamps the frame id into the
+ * pixels, publishes the event and deallocates the buffer, as LeapC does once
+ * the event has been dispatched. While the pool is paused it produces
+ * nothing, as the service would with the image policy cleared. Two consumers
+ * hold each image for 30 ms, about two thirds of the frame rate together,
+ * and check that the pixels still carry the frame id of their event.
+ *
+ * Both exhaustion modes are run. The summary shows the memory the pool held
+ * against what an unbounded queue would have reached.
+ *
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "ExampleConnection.h"
+#include "ImagePool.h"
+#include "LeapThreads.h"
+
+#define WIDTH 640
+#define HEIGHT 240
+#define FRAMES 300
+#define FRAME_MS 11
+#define CONSUMERS 2
+#define HOLD_MS 30
+
+typedef struct _Run {
+  ImagePool  *pool;
+  atomic_bool producing;
+  atomic_uint consumed;
+  atomic_uint corrupt;
+  uint32_t    skipped;          //Frames not produced while paused
+  atomic_llong latencySum;      //Publish to acquire, microseconds
+} Run;
+
+static ThreadReturnType produce(void *arg){
+  Run *run = (Run*)arg;
+  LEAP_IMAGE_EVENT event;
+  memset(&event, 0, sizeof(event));
+  for(uint32_t f = 0; f < FRAMES; f++){
+    millisleep(FRAME_MS);
+    ImagePoolStats stats;
+    GetImagePoolStats(run->pool, &stats);
+    if(stats.paused){
+      run->skipped++;
+      continue;
+    }
+    uint8_t *buffer = AllocatePooledBuffer(WIDTH * HEIGHT * 2, eLeapAllocatorType_Uint8, run->pool);
+    if(!buffer){
+      continue;
+    }
+    int64_t id = f;
+    memcpy(buffer, &id, sizeof(id));
+    memcpy(buffer + WIDTH * HEIGHT, &id, sizeof(id));
+    event.info.frame_id = id;
+    event.info.timestamp = LeapGetNow();
+    for(int c = 0; c < 2; c++){
+      event.image[c].properties.width = WIDTH;
+      event.image[c].properties.height = HEIGHT;
+      event.image[c].properties.bpp = 1;
+      event.image[c].data = buffer;
+      event.image[c].offset = c * WIDTH * HEIGHT;
+    }
+    PublishPooledImage(run->pool, &event);
+    DeallocatePooledBuffer(buffer, run->pool);
+  }
+  atomic_store(&run->producing, false);
+  return ThreadReturnValue;
+}
+
+static ThreadReturnType consume(void *arg){
+  Run *run = (Run*)arg;
+  for(;;){
+    const PooledImage *image = AcquirePooledImage(run->pool, 50);
+    if(!image){
+      if(!atomic_load(&run->producing)){
+        break;
+      }
+      continue;
+    }
+    atomic_fetch_add(&run->latencySum, LeapGetNow() - image->event.info.timestamp);
+    millisleep(HOLD_MS);
+    for(int c = 0; c < 2; c++){
+      int64_t id;
+      memcpy(&id, (const uint8_t*)image->event.image[c].data + image->event.image[c].offset, sizeof(id));
+      if(id != image->event.info.frame_id){
+        atomic_fetch_add(&run->corrupt, 1);
+      }
+    }
+    atomic_fetch_add(&run->consumed, 1);
+    ReleasePooledImage(run->pool, image);
+  }
+  return ThreadReturnValue;
+}
+
+static void runMode(const char *label, eImagePoolExhausted exhausted){
+  ImagePoolConfig config;
+  GetDefaultImagePoolConfig(&config);
+  config.exhausted = exhausted;
+  Run run;
+  memset(&run, 0, sizeof(run));
+  run.pool = CreateImagePool(&config, NULL);
+  if(!run.pool){
+    printf("Failed to create the pool.\n");
+    return;
+  }
+  atomic_init(&run.producing, true);
+  atomic_init(&run.consumed, 0);
+  atomic_init(&run.corrupt, 0);
+  atomic_init(&run.latencySum, 0);
+
+  //Small requests are not images and bypass the slots.
+  void *small = AllocatePooledBuffer(256, eLeapAllocatorType_Float, run.pool);
+  DeallocatePooledBuffer(small, run.pool);
+
+  int64_t start = LeapGetNow();
+  ThreadType producer, consumers[CONSUMERS];
+  StartThread(&producer, produce, &run);
+  for(int i = 0; i < CONSUMERS; i++){
+    StartThread(&consumers[i], consume, &run);
+  }
+  JoinThread(producer);
+  for(int i = 0; i < CONSUMERS; i++){
+    JoinThread(consumers[i]);
+  }
+  double seconds = (LeapGetNow() - start) / 1e6;
+
+  ImagePoolStats stats;
+  GetImagePoolStats(run.pool, &stats);
+  uint32_t consumed = atomic_load(&run.consumed);
+  //Without a bound every frame would have been queued, and the consumers would be just as far behind.
+  uint32_t backlog = FRAMES - consumed;
+  printf("%s, %u slots:\n", label, config.capacity);
+  printf("  %llu published, %u consumed, %llu dropped, %llu rejected, %u not produced while paused\n",
+         (unsigned long long)stats.published, consumed, (unsigned long long)stats.dropped,
+         (unsigned long long)stats.rejected, run.skipped);
+  printf("  %llu pauses, %llu resumes, %llu passthrough, %u corrupt, mean wait %.1f ms, %.1f s\n",
+         (unsigned long long)stats.pauses, (unsigned long long)stats.resumes,
+         (unsigned long long)stats.passthrough, atomic_load(&run.corrupt),
+         consumed ? (double)atomic_load(&run.latencySum) / consumed / 1000.0 : 0.0, seconds);
+  printf("  pool memory %.2f MB flat, peak %u slots in use; an unbounded queue would have grown to %.1f MB\n",
+         stats.slotBytes / 1e6, stats.peakInUse, (double)backlog * WIDTH * HEIGHT * 2 / 1e6);
+  DestroyImagePool(run.pool);
+}
+
+int main(int argc, char** argv) {
+  runMode("Drop oldest", eImagePoolExhausted_DropOldest);
+  runMode("Pause images", eImagePoolExhausted_PauseImages);
+  return 0;
+}
+//End-of-Sample
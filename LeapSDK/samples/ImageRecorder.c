@@ -0,0 +1,626 @@
+/* Lossless recording of the IR stereo images to a chunked, indexed file.
+ *
+ * The queue is a ring of frame slots. RecordImages() fills the slot at head
+ * under the lock; the writer thread owns the slots from tail to head while it
+ * compresses and writes them, and hands them back by advancing tail. Frames
+ * are compressed one per WorkerPool index with the writer taking part, so a
+ * batch finishes in about the time of one frame when enough threads exist.
+ *
+ */
+
+#include "ImageRecorder.h"
+#include "LeapThreads.h"
+#include "WorkerPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORDING_VERSION 1
+#define RECORDING_HEADER_SIZE 8
+#define CHUNK_HEADER_SIZE 16
+#define FRAME_HEADER_SIZE 36
+#define INDEX_HEADER_SIZE 8
+#define INDEX_ENTRY_SIZE 24
+#define FOOTER_SIZE 16
+
+typedef struct _QueuedFrame {
+  int64_t  frame_id;
+  int64_t  timestamp;
+  uint32_t width;
+  uint32_t height;
+  uint32_t bpp;
+  size_t   capacity;              //Bytes allocated per image
+  uint8_t *raw;                   //Left then right image
+  uint8_t *packed;                //Both encoded planes, GetEncodedPlaneBound() each
+  size_t   packedSize[2];
+} QueuedFrame;
+
+typedef struct _IndexEntry {
+  int64_t  frame_id;
+  int64_t  timestamp;
+  uint64_t offset;
+} IndexEntry;
+
+struct _ImageRecorder {
+  ImageRecorderConfig config;
+  FILE              *file;
+  WorkerPool        *pool;
+  uint32_t           workers;
+  ImageCodec       **codecs;      //One per worker
+  uint32_t           codecPixels;
+  ThreadType         thread;
+  LockType           lock;
+  CondType           ready;
+  QueuedFrame       *queue;
+  uint32_t           head;
+  uint32_t           tail;
+  uint32_t           count;
+  bool               stopping;
+  ImageRecorderStats stats;       //Under lock
+
+  //Writer thread only
+  uint8_t           *chunk;       //Chunk header space followed by the frames
+  size_t             chunkSize;
+  size_t             chunkCapacity;
+  uint32_t           chunkFrames;
+  uint64_t           fileOffset;
+  IndexEntry        *index;
+  uint32_t           indexCount;
+  uint32_t           indexCapacity;
+  bool               failed;
+};
+
+struct _ImageRecording {
+  FILE          *file;
+  IndexEntry    *index;
+  uint32_t       count;
+  ImageCodec    *codec;
+  uint32_t       codecPixels;
+  uint8_t       *packed;
+  size_t         packedCapacity;
+  uint8_t       *pixels;
+  size_t         pixelCapacity;
+  RecordedImages images;
+};
+
+typedef struct _CompressJob {
+  ImageRecorder *recorder;
+  uint32_t       first;
+} CompressJob;
+
+static void putU32(uint8_t *p, uint32_t v){
+  for(int i = 0; i < 4; i++){
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static void putU64(uint8_t *p, uint64_t v){
+  for(int i = 0; i < 8; i++){
+    p[i] = (uint8_t)(v >> (8 * i));
+  }
+}
+
+static uint32_t getU32(const uint8_t *p){
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t getU64(const uint8_t *p){
+  return (uint64_t)getU32(p) | (uint64_t)getU32(p + 4) << 32;
+}
+
+/** Recordings grow past 2 GB within minutes, beyond what fseek() can address on Windows. */
+static bool seekFile(FILE *file, int64_t offset, int whence){
+#if defined(_MSC_VER)
+  return _fseeki64(file, offset, whence) == 0;
+#else
+  return fseeko(file, (off_t)offset, whence) == 0;
+#endif
+}
+
+static int64_t tellFile(FILE *file){
+#if defined(_MSC_VER)
+  return _ftelli64(file);
+#else
+  return (int64_t)ftello(file);
+#endif
+}
+
+void GetDefaultImageRecorderConfig(ImageRecorderConfig *config){
+  config->predictor = eImagePredictor_MED;
+  config->queue_frames = 32;
+  config->chunk_frames = 64;
+  config->threads = 0;
+}
+
+static bool growIndex(IndexEntry **index, uint32_t *capacity, uint32_t needed){
+  if(needed <= *capacity){
+    return true;
+  }
+  uint32_t grown = *capacity ? *capacity * 2 : 1024;
+  while(grown < needed){
+    grown *= 2;
+  }
+  IndexEntry *entries = realloc(*index, grown * sizeof(IndexEntry));
+  if(!entries){
+    return false;
+  }
+  *index = entries;
+  *capacity = grown;
+  return true;
+}
+
+static bool writeBytes(ImageRecorder *recorder, const void *bytes, size_t size){
+  if(recorder->failed || fwrite(bytes, 1, size, recorder->file) != size){
+    recorder->failed = true;
+    return false;
+  }
+  recorder->fileOffset += size;
+  return true;
+}
+
+static void flushChunk(ImageRecorder *recorder){
+  if(recorder->chunkFrames == 0){
+    return;
+  }
+  uint8_t *header = recorder->chunk;
+  memcpy(header, "CHNK", 4);
+  putU32(header + 4, recorder->chunkFrames);
+  putU32(header + 8, (uint32_t)(recorder->chunkSize - CHUNK_HEADER_SIZE));
+  putU32(header + 12, 0);
+  writeBytes(recorder, recorder->chunk, recorder->chunkSize);
+  fflush(recorder->file);
+  recorder->chunkSize = CHUNK_HEADER_SIZE;
+  recorder->chunkFrames = 0;
+  LockMutex(&recorder->lock);
+  recorder->stats.chunks++;
+  recorder->stats.fileBytes = recorder->fileOffset;
+  UnlockMutex(&recorder->lock);
+}
+
+static void appendFrame(ImageRecorder *recorder, const QueuedFrame *frame){
+  size_t size = FRAME_HEADER_SIZE + frame->packedSize[0] + frame->packedSize[1];
+  if(recorder->chunkSize + size > recorder->chunkCapacity){
+    size_t grown = recorder->chunkCapacity * 2;
+    while(grown < recorder->chunkSize + size){
+      grown *= 2;
+    }
+    uint8_t *chunk = realloc(recorder->chunk, grown);
+    if(!chunk){
+      recorder->failed = true;
+      return;
+    }
+    recorder->chunk = chunk;
+    recorder->chunkCapacity = grown;
+  }
+  if(!growIndex(&recorder->index, &recorder->indexCapacity, recorder->indexCount + 1)){
+    recorder->failed = true;
+    return;
+  }
+  IndexEntry *entry = &recorder->index[recorder->indexCount++];
+  entry->frame_id = frame->frame_id;
+  entry->timestamp = frame->timestamp;
+  entry->offset = recorder->fileOffset + recorder->chunkSize;
+
+  uint8_t *p = recorder->chunk + recorder->chunkSize;
+  putU64(p, (uint64_t)frame->frame_id);
+  putU64(p + 8, (uint64_t)frame->timestamp);
+  putU32(p + 16, frame->width);
+  putU32(p + 20, frame->height);
+  putU32(p + 24, frame->bpp);
+  putU32(p + 28, (uint32_t)frame->packedSize[0]);
+  putU32(p + 32, (uint32_t)frame->packedSize[1]);
+  memcpy(p + FRAME_HEADER_SIZE, frame->packed, frame->packedSize[0] + frame->packedSize[1]);
+  recorder->chunkSize += size;
+  if(++recorder->chunkFrames >= recorder->config.chunk_frames){
+    flushChunk(recorder);
+  }
+}
+
+static void writeIndex(ImageRecorder *recorder){
+  uint64_t indexOffset = recorder->fileOffset;
+  uint8_t header[INDEX_HEADER_SIZE], entry[INDEX_ENTRY_SIZE], footer[FOOTER_SIZE];
+  memcpy(header, "INDX", 4);
+  putU32(header + 4, recorder->indexCount);
+  writeBytes(recorder, header, sizeof(header));
+  for(uint32_t i = 0; i < recorder->indexCount; i++){
+    putU64(entry, (uint64_t)recorder->index[i].frame_id);
+    putU64(entry + 8, (uint64_t)recorder->index[i].timestamp);
+    putU64(entry + 16, recorder->index[i].offset);
+    writeBytes(recorder, entry, sizeof(entry));
+  }
+  putU64(footer, indexOffset);
+  putU32(footer + 8, recorder->indexCount);
+  memcpy(footer + 12, "LIRX", 4);
+  writeBytes(recorder, footer, sizeof(footer));
+}
+
+static void compressFrame(void *context, uint32_t index, uint32_t worker){
+  CompressJob *job = context;
+  ImageRecorder *recorder = job->recorder;
+  QueuedFrame *frame = &recorder->queue[(job->first + index) % recorder->config.queue_frames];
+  uint32_t rowBytes = frame->width * frame->bpp;
+  size_t bound = GetEncodedPlaneBound(rowBytes, frame->height), plane = (size_t)rowBytes * frame->height;
+  ImageCodec *codec = recorder->codecs[worker];
+  frame->packedSize[0] = EncodePlane(codec, frame->raw, rowBytes, frame->height,
+                                     recorder->config.predictor, frame->packed, bound);
+  frame->packedSize[1] = EncodePlane(codec, frame->raw + plane, rowBytes, frame->height,
+                                     recorder->config.predictor, frame->packed + frame->packedSize[0], bound);
+}
+
+/** Makes every worker's codec large enough for the biggest frame in the batch. */
+static bool ensureCodecs(ImageRecorder *recorder, uint32_t first, uint32_t batch){
+  uint32_t needed = recorder->codecPixels;
+  for(uint32_t i = 0; i < batch; i++){
+    const QueuedFrame *frame = &recorder->queue[(first + i) % recorder->config.queue_frames];
+    uint32_t pixels = frame->width * frame->bpp * frame->height;
+    if(pixels > needed){
+      needed = pixels;
+    }
+  }
+  if(needed == recorder->codecPixels){
+    return true;
+  }
+  for(uint32_t w = 0; w < recorder->workers; w++){
+    DestroyImageCodec(recorder->codecs[w]);
+    recorder->codecs[w] = CreateImageCodec(needed);
+    if(!recorder->codecs[w]){
+      recorder->codecPixels = 0;
+      return false;
+    }
+  }
+  recorder->codecPixels = needed;
+  return true;
+}
+
+static ThreadReturnType writerThread(void *arg){
+  ImageRecorder *recorder = arg;
+  LockMutex(&recorder->lock);
+  for(;;){
+    while(recorder->count == 0 && !recorder->stopping){
+      WaitCond(&recorder->ready, &recorder->lock, 100);
+    }
+    if(recorder->count == 0){
+      break;
+    }
+    CompressJob job = { recorder, recorder->tail };
+    uint32_t batch = recorder->count;
+    UnlockMutex(&recorder->lock);
+
+    int64_t start = LeapGetNow();
+    if(!ensureCodecs(recorder, job.first, batch)){
+      recorder->failed = true;
+    }
+    if(!recorder->failed){
+      RunParallel(recorder->pool, batch, compressFrame, &job);
+    }
+    int64_t compressed = LeapGetNow();
+    uint32_t written = 0;
+    uint64_t raw = 0;
+    for(uint32_t i = 0; i < batch && !recorder->failed; i++){
+      QueuedFrame *frame = &recorder->queue[(job.first + i) % recorder->config.queue_frames];
+      if(frame->packedSize[0] && frame->packedSize[1]){
+        appendFrame(recorder, frame);
+        written++;
+        raw += 2 * (uint64_t)frame->width * frame->bpp * frame->height;
+      }
+    }
+
+    LockMutex(&recorder->lock);
+    recorder->tail = (recorder->tail + batch) % recorder->config.queue_frames;
+    recorder->count -= batch;
+    recorder->stats.written += written;
+    recorder->stats.dropped += batch - written;
+    recorder->stats.rawBytes += raw;
+    recorder->stats.compressTime += compressed - start;
+  }
+  UnlockMutex(&recorder->lock);
+
+  flushChunk(recorder);
+  writeIndex(recorder);
+  LockMutex(&recorder->lock);
+  recorder->stats.fileBytes = recorder->fileOffset;
+  UnlockMutex(&recorder->lock);
+  return ThreadReturnValue;
+}
+
+static void freeRecorder(ImageRecorder *recorder){
+  if(recorder->queue){
+    for(uint32_t i = 0; i < recorder->config.queue_frames; i++){
+      free(recorder->queue[i].raw);
+      free(recorder->queue[i].packed);
+    }
+  }
+  if(recorder->codecs){
+    for(uint32_t w = 0; w < recorder->workers; w++){
+      DestroyImageCodec(recorder->codecs[w]);
+    }
+  }
+  DestroyWorkerPool(recorder->pool);
+  free(recorder->codecs);
+  free(recorder->queue);
+  free(recorder->chunk);
+  free(recorder->index);
+  free(recorder);
+}
+
+ImageRecorder* StartImageRecorder(const char *path, const ImageRecorderConfig *config){
+  ImageRecorder *recorder = calloc(1, sizeof(ImageRecorder));
+  if(!recorder){
+    return NULL;
+  }
+  recorder->config = *config;
+  if(recorder->config.queue_frames == 0){
+    recorder->config.queue_frames = 1;
+  }
+  if(recorder->config.chunk_frames == 0){
+    recorder->config.chunk_frames = 1;
+  }
+  recorder->pool = CreateWorkerPool(config->threads);
+  recorder->workers = recorder->pool ? GetWorkerCount(recorder->pool) : 0;
+  recorder->codecs = calloc(recorder->workers ? recorder->workers : 1, sizeof(ImageCodec*));
+  recorder->queue = calloc(recorder->config.queue_frames, sizeof(QueuedFrame));
+  recorder->chunkCapacity = 1 << 20;
+  recorder->chunkSize = CHUNK_HEADER_SIZE;
+  recorder->chunk = malloc(recorder->chunkCapacity);
+  if(!recorder->pool || !recorder->codecs || !recorder->queue || !recorder->chunk){
+    freeRecorder(recorder);
+    return NULL;
+  }
+  recorder->file = fopen(path, "wb");
+  if(!recorder->file){
+    freeRecorder(recorder);
+    return NULL;
+  }
+  uint8_t header[RECORDING_HEADER_SIZE];
+  memcpy(header, "LIRC", 4);
+  putU32(header + 4, RECORDING_VERSION);
+  writeBytes(recorder, header, sizeof(header));
+
+  InitLock(&recorder->lock);
+  InitCond(&recorder->ready);
+  if(!StartThread(&recorder->thread, writerThread, recorder)){
+    fclose(recorder->file);
+    DestroyCond(&recorder->ready);
+    DestroyLock(&recorder->lock);
+    freeRecorder(recorder);
+    return NULL;
+  }
+  return recorder;
+}
+
+/** Queues both images of the event; returns false if the frame was dropped. */
+bool RecordImages(ImageRecorder *recorder, const LEAP_IMAGE_EVENT *event){
+  const LEAP_IMAGE_PROPERTIES *props = &event->image[0].properties;
+  size_t plane = (size_t)props->width * props->bpp * props->height;
+  bool recordable = event->image[0].data && event->image[1].data && plane > 0 &&
+                    event->image[1].properties.width == props->width &&
+                    event->image[1].properties.height == props->height &&
+                    event->image[1].properties.bpp == props->bpp;
+  LockMutex(&recorder->lock);
+  recorder->stats.submitted++;
+  if(!recordable || recorder->stopping || recorder->count == recorder->config.queue_frames){
+    recorder->stats.dropped++;
+    UnlockMutex(&recorder->lock);
+    return false;
+  }
+  QueuedFrame *frame = &recorder->queue[recorder->head];
+  if(frame->capacity < plane){
+    free(frame->raw);
+    free(frame->packed);
+    frame->raw = malloc(2 * plane);
+    frame->packed = malloc(2 * GetEncodedPlaneBound(props->width * props->bpp, props->height));
+    frame->capacity = frame->raw && frame->packed ? plane : 0;
+    if(!frame->capacity){
+      recorder->stats.dropped++;
+      UnlockMutex(&recorder->lock);
+      return false;
+    }
+  }
+  frame->frame_id = event->info.frame_id;
+  frame->timestamp = event->info.timestamp;
+  frame->width = props->width;
+  frame->height = props->height;
+  frame->bpp = props->bpp;
+  for(int c = 0; c < 2; c++){
+    memcpy(frame->raw + c * plane, (const uint8_t*)event->image[c].data + event->image[c].offset, plane);
+  }
+  recorder->head = (recorder->head + 1) % recorder->config.queue_frames;
+  recorder->count++;
+  if(recorder->count > recorder->stats.queuePeak){
+    recorder->stats.queuePeak = recorder->count;
+  }
+  SignalCond(&recorder->ready);
+  UnlockMutex(&recorder->lock);
+  return true;
+}
+
+void GetImageRecorderStats(ImageRecorder *recorder, ImageRecorderStats *stats){
+  LockMutex(&recorder->lock);
+  *stats = recorder->stats;
+  UnlockMutex(&recorder->lock);
+}
+
+/** Writes the queued frames, the last chunk and the index. Returns false if any write failed. */
+bool StopImageRecorder(ImageRecorder *recorder){
+  if(!recorder){
+    return false;
+  }
+  LockMutex(&recorder->lock);
+  recorder->stopping = true;
+  SignalCond(&recorder->ready);
+  UnlockMutex(&recorder->lock);
+  JoinThread(recorder->thread);
+  bool ok = !recorder->failed;
+  if(fclose(recorder->file) != 0){
+    ok = false;
+  }
+  DestroyCond(&recorder->ready);
+  DestroyLock(&recorder->lock);
+  freeRecorder(recorder);
+  return ok;
+}
+
+static bool readIndex(ImageRecording *recording){
+  uint8_t footer[FOOTER_SIZE], header[INDEX_HEADER_SIZE], entry[INDEX_ENTRY_SIZE];
+  if(!seekFile(recording->file, -FOOTER_SIZE, SEEK_END) || fread(footer, 1, FOOTER_SIZE, recording->file) != FOOTER_SIZE ||
+     memcmp(footer + 12, "LIRX", 4) != 0){
+    return false;
+  }
+  uint32_t count = getU32(footer + 8);
+  if(!seekFile(recording->file, (int64_t)getU64(footer), SEEK_SET) ||
+     fread(header, 1, INDEX_HEADER_SIZE, recording->file) != INDEX_HEADER_SIZE ||
+     memcmp(header, "INDX", 4) != 0 || getU32(header + 4) != count){
+    return false;
+  }
+  recording->index = malloc((count ? count : 1) * sizeof(IndexEntry));
+  if(!recording->index){
+    return false;
+  }
+  for(uint32_t i = 0; i < count; i++){
+    if(fread(entry, 1, INDEX_ENTRY_SIZE, recording->file) != INDEX_ENTRY_SIZE){
+      return false;
+    }
+    recording->index[i].frame_id = (int64_t)getU64(entry);
+    recording->index[i].timestamp = (int64_t)getU64(entry + 8);
+    recording->index[i].offset = getU64(entry + 16);
+  }
+  recording->count = count;
+  return true;
+}
+
+/** Rebuilds the index from the chunks of a recording that was not stopped cleanly. */
+static bool scanChunks(ImageRecording *recording){
+  uint32_t capacity = 0;
+  free(recording->index);
+  recording->index = NULL;
+  recording->count = 0;
+  if(!seekFile(recording->file, 0, SEEK_END)){
+    return false;
+  }
+  int64_t size = tellFile(recording->file), offset = RECORDING_HEADER_SIZE;
+  uint8_t header[CHUNK_HEADER_SIZE], frame[FRAME_HEADER_SIZE];
+  while(seekFile(recording->file, offset, SEEK_SET) &&
+        fread(header, 1, CHUNK_HEADER_SIZE, recording->file) == CHUNK_HEADER_SIZE &&
+        memcmp(header, "CHNK", 4) == 0){
+    uint32_t frames = getU32(header + 4), first = recording->count;
+    int64_t position = offset + CHUNK_HEADER_SIZE, end = position + getU32(header + 8);
+    if(end > size){
+      break;                      //Cut short by a crash
+    }
+    for(uint32_t f = 0; f < frames && position < end; f++){
+      if(!seekFile(recording->file, position, SEEK_SET) ||
+         fread(frame, 1, FRAME_HEADER_SIZE, recording->file) != FRAME_HEADER_SIZE ||
+         !growIndex(&recording->index, &capacity, recording->count + 1)){
+        break;
+      }
+      IndexEntry *entry = &recording->index[recording->count++];
+      entry->frame_id = (int64_t)getU64(frame);
+      entry->timestamp = (int64_t)getU64(frame + 8);
+      entry->offset = (uint64_t)position;
+      position += FRAME_HEADER_SIZE + (int64_t)getU32(frame + 28) + getU32(frame + 32);
+    }
+    if(position != end){
+      recording->count = first;
+      break;
+    }
+    offset = end;
+  }
+  return true;
+}
+
+ImageRecording* OpenImageRecording(const char *path){
+  ImageRecording *recording = calloc(1, sizeof(ImageRecording));
+  if(!recording){
+    return NULL;
+  }
+  recording->file = fopen(path, "rb");
+  uint8_t header[RECORDING_HEADER_SIZE];
+  if(!recording->file || fread(header, 1, RECORDING_HEADER_SIZE, recording->file) != RECORDING_HEADER_SIZE ||
+     memcmp(header, "LIRC", 4) != 0 || getU32(header + 4) != RECORDING_VERSION ||
+     (!readIndex(recording) && !scanChunks(recording))){
+    CloseImageRecording(recording);
+    return NULL;
+  }
+  return recording;
+}
+
+void CloseImageRecording(ImageRecording *recording){
+  if(!recording){
+    return;
+  }
+  if(recording->file){
+    fclose(recording->file);
+  }
+  DestroyImageCodec(recording->codec);
+  free(recording->index);
+  free(recording->packed);
+  free(recording->pixels);
+  free(recording);
+}
+
+uint32_t GetRecordedFrameCount(const ImageRecording *recording){
+  return recording->count;
+}
+
+/** Index of the last frame recorded at or before timestamp, or -1 if there is none. */
+int64_t FindRecordedFrame(const ImageRecording *recording, int64_t timestamp){
+  int64_t lo = 0, hi = (int64_t)recording->count - 1, found = -1;
+  while(lo <= hi){
+    int64_t mid = (lo + hi) / 2;
+    if(recording->index[mid].timestamp <= timestamp){
+      found = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return found;
+}
+
+/** Decodes frame index; the result is valid until the next call. Returns NULL if it cannot be read. */
+const RecordedImages* ReadRecordedImages(ImageRecording *recording, uint32_t index){
+  uint8_t header[FRAME_HEADER_SIZE];
+  if(index >= recording->count ||
+     !seekFile(recording->file, (int64_t)recording->index[index].offset, SEEK_SET) ||
+     fread(header, 1, FRAME_HEADER_SIZE, recording->file) != FRAME_HEADER_SIZE){
+    return NULL;
+  }
+  RecordedImages *images = &recording->images;
+  images->frame_id = (int64_t)getU64(header);
+  images->timestamp = (int64_t)getU64(header + 8);
+  images->width = getU32(header + 16);
+  images->height = getU32(header + 20);
+  images->bpp = getU32(header + 24);
+  size_t sizes[2] = { getU32(header + 28), getU32(header + 32) };
+  uint32_t rowBytes = images->width * images->bpp;
+  size_t plane = (size_t)rowBytes * images->height;
+  if(plane == 0 || sizes[0] > GetEncodedPlaneBound(rowBytes, images->height) ||
+     sizes[1] > GetEncodedPlaneBound(rowBytes, images->height)){
+    return NULL;
+  }
+  if(recording->packedCapacity < sizes[0] + sizes[1]){
+    free(recording->packed);
+    recording->packed = malloc(sizes[0] + sizes[1]);
+    recording->packedCapacity = recording->packed ? sizes[0] + sizes[1] : 0;
+  }
+  if(recording->pixelCapacity < 2 * plane){
+    free(recording->pixels);
+    recording->pixels = malloc(2 * plane);
+    recording->pixelCapacity = recording->pixels ? 2 * plane : 0;
+  }
+  if(recording->codecPixels < plane){
+    DestroyImageCodec(recording->codec);
+    recording->codec = CreateImageCodec((uint32_t)plane);
+    recording->codecPixels = recording->codec ? (uint32_t)plane : 0;
+  }
+  if(!recording->packed || !recording->pixels || !recording->codec ||
+     fread(recording->packed, 1, sizes[0] + sizes[1], recording->file) != sizes[0] + sizes[1] ||
+     !DecodePlane(recording->codec, recording->packed, sizes[0], recording->pixels, rowBytes, images->height) ||
+     !DecodePlane(recording->codec, recording->packed + sizes[0], sizes[1], recording->pixels + plane, rowBytes, images->height)){
+    return NULL;
+  }
+  images->image[0] = recording->pixels;
+  images->image[1] = recording->pixels + plane;
+  return images;
+}
+//End-of-ImageRecorder.c
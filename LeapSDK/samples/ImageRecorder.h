@@ -0,0 +1,78 @@
+/* Lossless recording of the IR stereo images to a chunked, indexed file.
+ *
+ * RecordImages() copies both images of a LEAP_IMAGE_EVENT into a queue slot
+ * and returns; it never compresses or writes on the calling thread. A writer
+ * thread takes whatever frames are queued, compresses them in parallel with
+ * ImageCodec on a WorkerPool, and appends them in arrival order to the
+ * current chunk. A full chunk is written and flushed in one piece, so after a
+ * crash the file still holds every complete chunk. When the queue is full the
+ * frame is dropped and counted rather than blocking the caller.
+ *
+ * File layout, little-endian:
+ *   header   "LIRC", u32 version
+ *   chunks   "CHNK", u32 frames, u32 bytes, u32 reserved, then the frames:
+ *            i64 frame_id, i64 timestamp, u32 width, u32 height, u32 bpp,
+ *            u32 size[2], and the two encoded planes
+ *   index    "INDX", u32 frames, then per frame i64 frame_id, i64 timestamp,
+ *            u64 file offset of the frame
+ *   footer   u64 index offset, u32 frames, "LIRX"
+ *
+ * ImageRecording reads the file back. It uses the index when the footer is
+ * present and otherwise rebuilds it by walking the chunks.
+ *
+ */
+
+#ifndef ImageRecorder_h
+#define ImageRecorder_h
+
+#include "LeapC.h"
+#include "ImageCodec.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct _ImageRecorderConfig {
+  eImagePredictor predictor;
+  uint32_t        queue_frames;   //Frames waiting for compression before new ones are dropped
+  uint32_t        chunk_frames;   //Frames per chunk
+  uint32_t        threads;        //Compression threads, including the writer; 0 for one per CPU
+} ImageRecorderConfig;
+
+typedef struct _ImageRecorderStats {
+  uint64_t submitted;
+  uint64_t dropped;               //Queue full or image not recordable
+  uint64_t written;
+  uint64_t chunks;
+  uint64_t rawBytes;              //Image bytes of written frames
+  uint64_t fileBytes;             //Bytes written to the file
+  int64_t  compressTime;          //Microseconds spent compressing, wall clock
+  uint32_t queuePeak;             //Most frames queued at once
+} ImageRecorderStats;
+
+/** One frame read back from a recording; the images are owned by the recording. */
+typedef struct _RecordedImages {
+  int64_t  frame_id;
+  int64_t  timestamp;
+  uint32_t width;
+  uint32_t height;
+  uint32_t bpp;
+  uint8_t *image[2];              //Left and right, width x height x bpp bytes
+} RecordedImages;
+
+typedef struct _ImageRecorder ImageRecorder;
+typedef struct _ImageRecording ImageRecording;
+
+/* Recording */
+void GetDefaultImageRecorderConfig(ImageRecorderConfig *config);
+ImageRecorder* StartImageRecorder(const char *path, const ImageRecorderConfig *config);
+bool RecordImages(ImageRecorder *recorder, const LEAP_IMAGE_EVENT *event);
+void GetImageRecorderStats(ImageRecorder *recorder, ImageRecorderStats *stats);
+bool StopImageRecorder(ImageRecorder *recorder);
+
+/* Playback */
+ImageRecording* OpenImageRecording(const char *path);
+void CloseImageRecording(ImageRecording *recording);
+uint32_t GetRecordedFrameCount(const ImageRecording *recording);
+int64_t FindRecordedFrame(const ImageRecording *recording, int64_t timestamp);
+const RecordedImages* ReadRecordedImages(ImageRecording *recording, uint32_t index);
+
+#endif /* ImageRecorder_h */
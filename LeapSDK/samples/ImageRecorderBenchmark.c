@@ -0,0 +1,196 @@
+/* Measures the lossless image codec and the recorder.
+ *
+ * Each predictor is timed on single planes first. Then a sequence is
+ * recorded through an ImageRecorder as fast as it accepts frames, read back
+ * and compared byte for byte with the input.
+ *
+ * Without arguments the sequence is synthetic 640x240 IR: a background the
+ * LEDs barely reach, two bright, moving blobs with soft edges standing in for
+ * hands, and sensor noise that grows with brightness. The compression ratio
+ * depends mostly on that noise, so recorded images are the better measure.
+ * Given a file name, width and height it instead reads raw 8-bit left and
+ * right images, one pair after the other, such as frames dumped from
+ * ImageSample.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "ImageCodec.h"
+#include "ImageRecorder.h"
+#include "LeapThreads.h"
+
+#define SYNTHETIC_WIDTH 640
+#define SYNTHETIC_HEIGHT 240
+#define SYNTHETIC_FRAMES 120
+#define RECORDING_PATH "ImageRecorderBenchmark.lirc"
+
+static float noise(void){
+  //Sum of uniforms, roughly normal with unit variance
+  return ((float)rand() + (float)rand() + (float)rand() - 1.5f * (float)RAND_MAX) / (0.5f * (float)RAND_MAX);
+}
+
+static void renderFrame(uint8_t *image, uint32_t W, uint32_t H, uint32_t frame, uint32_t camera){
+  float shift = camera ? -24.0f : 0.0f;
+  float cx[2] = { 200.0f + 3.0f * frame + shift, 430.0f - 2.0f * frame + shift };
+  float cy[2] = { 120.0f + 30.0f * sinf(frame * 0.1f), 100.0f };
+  for(uint32_t y = 0; y < H; y++){
+    for(uint32_t x = 0; x < W; x++){
+      float dx = ((float)x - W / 2.0f) / W, dy = ((float)y - H / 2.0f) / H;
+      float value = 4.0f * (1.0f - dx * dx - dy * dy);
+      for(int b = 0; b < 2; b++){
+        float ex = ((float)x - cx[b]) / 70.0f, ey = ((float)y - cy[b]) / 45.0f;
+        value += 190.0f * expf(-(ex * ex + ey * ey) * 1.5f);
+      }
+      value += noise() * (0.7f + value * 0.02f);
+      image[(size_t)y * W + x] = (uint8_t)(value < 0.0f ? 0.0f : value > 255.0f ? 255.0f : value + 0.5f);
+    }
+  }
+}
+
+static void timePredictor(const char *label, eImagePredictor predictor, const uint8_t *pixels,
+                          uint32_t W, uint32_t H, uint32_t frames){
+  ImageCodec *codec = CreateImageCodec(W * H);
+  size_t bound = GetEncodedPlaneBound(W, H);
+  uint8_t *packed = malloc(bound), *decoded = malloc((size_t)W * H);
+  uint64_t total = 0;
+  uint32_t exact = 0, planes = frames * 2;
+  int64_t encodeTime = 0, decodeTime = 0;
+  for(uint32_t p = 0; p < planes; p++){
+    const uint8_t *plane = pixels + (size_t)p * W * H;
+    int64_t start = LeapGetNow();
+    size_t size = EncodePlane(codec, plane, W, H, predictor, packed, bound);
+    int64_t encoded = LeapGetNow();
+    bool ok = DecodePlane(codec, packed, size, decoded, W, H);
+    decodeTime += LeapGetNow() - encoded;
+    encodeTime += encoded - start;
+    total += size;
+    exact += ok && memcmp(decoded, plane, (size_t)W * H) == 0;
+  }
+  double raw = (double)planes * W * H;
+  printf("  %-5s %5.2fx, %5.2f bits/pixel, encode %6.2f ms (%5.0f MB/s), decode %6.2f ms, %u/%u exact\n",
+         label, raw / (double)total, 8.0 * (double)total / raw,
+         (double)encodeTime / planes / 1000.0, raw / (double)encodeTime,
+         (double)decodeTime / planes / 1000.0, exact, planes);
+  free(decoded);
+  free(packed);
+  DestroyImageCodec(codec);
+}
+
+int main(int argc, char** argv) {
+  uint32_t W = SYNTHETIC_WIDTH, H = SYNTHETIC_HEIGHT, frames = SYNTHETIC_FRAMES;
+  uint8_t *pixels = NULL;
+  if(argc >= 4){
+    W = (uint32_t)atoi(argv[2]);
+    H = (uint32_t)atoi(argv[3]);
+    FILE *file = fopen(argv[1], "rb");
+    if(!file || W == 0 || H == 0){
+      printf("Usage: %s [<pairs.raw> <width> <height>]\n", argv[0]);
+      return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    frames = (uint32_t)(size / ((long)W * H * 2));
+    pixels = malloc((size_t)frames * W * H * 2);
+    if(!pixels || frames == 0 || fread(pixels, (size_t)W * H * 2, frames, file) != frames){
+      printf("Could not read any %ux%u image pairs from %s.\n", W, H, argv[1]);
+      return 1;
+    }
+    fclose(file);
+    printf("%u recorded %ux%u pairs from %s\n", frames, W, H, argv[1]);
+  } else {
+    srand(42);
+    pixels = malloc((size_t)frames * W * H * 2);
+    if(!pixels){
+      printf("Failed to allocate the images.\n");
+      return 1;
+    }
+    for(uint32_t f = 0; f < frames; f++){
+      renderFrame(pixels + (size_t)f * 2 * W * H, W, H, f, 0);
+      renderFrame(pixels + ((size_t)f * 2 + 1) * W * H, W, H, f, 1);
+    }
+    printf("%u synthetic %ux%u pairs\n", frames, W, H);
+  }
+
+  printf("Codec, one thread:\n");
+  timePredictor("left", eImagePredictor_Left, pixels, W, H, frames);
+  timePredictor("up", eImagePredictor_Up, pixels, W, H, frames);
+  timePredictor("MED", eImagePredictor_MED, pixels, W, H, frames);
+
+  ImageRecorderConfig config;
+  GetDefaultImageRecorderConfig(&config);
+  ImageRecorder *recorder = StartImageRecorder(RECORDING_PATH, &config);
+  if(!recorder){
+    printf("Could not create %s.\n", RECORDING_PATH);
+    return 1;
+  }
+  LEAP_IMAGE_EVENT event;
+  memset(&event, 0, sizeof(event));
+  int64_t start = LeapGetNow();
+  for(uint32_t f = 0; f < frames; f++){
+    event.info.frame_id = f;
+    event.info.timestamp = start + (int64_t)f * 11111;
+    for(int c = 0; c < 2; c++){
+      event.image[c].properties.bpp = 1;
+      event.image[c].properties.width = W;
+      event.image[c].properties.height = H;
+      event.image[c].data = pixels + ((size_t)f * 2 + c) * W * H;
+    }
+    //Wait for room rather than drop so every frame can be verified.
+    while(!RecordImages(recorder, &event)){
+      YieldThread();
+    }
+  }
+  //Stopping drains the queue, so the stats are taken just before the recorder goes away.
+  ImageRecorderStats stats;
+  do {
+    YieldThread();
+    GetImageRecorderStats(recorder, &stats);
+  } while(stats.written < frames);
+  bool stopped = StopImageRecorder(recorder);
+  int64_t elapsed = LeapGetNow() - start;
+
+  ImageRecording *recording = OpenImageRecording(RECORDING_PATH);
+  uint32_t exact = 0, count = recording ? GetRecordedFrameCount(recording) : 0;
+  int64_t readStart = LeapGetNow();
+  for(uint32_t i = 0; i < count; i++){
+    const RecordedImages *images = ReadRecordedImages(recording, i);
+    if(!images || images->frame_id < 0 || images->frame_id >= (int64_t)frames){
+      continue;
+    }
+    const uint8_t *expected = pixels + (size_t)images->frame_id * 2 * W * H;
+    exact += images->width == W && images->height == H &&
+             memcmp(images->image[0], expected, (size_t)W * H) == 0 &&
+             memcmp(images->image[1], expected + (size_t)W * H, (size_t)W * H) == 0;
+  }
+  int64_t readTime = LeapGetNow() - readStart;
+  FILE *file = fopen(RECORDING_PATH, "rb");
+  long fileSize = 0;
+  if(file){
+    fseek(file, 0, SEEK_END);
+    fileSize = ftell(file);
+    fclose(file);
+  }
+
+  printf("Recorder, %u threads:\n", config.threads ? config.threads : GetCpuCount());
+  printf("  %llu frames in %.1f ms (%.0f fps), queue peak %u, %llu chunks, %s\n",
+         (unsigned long long)stats.written, elapsed / 1000.0, frames * 1e6 / (double)elapsed, stats.queuePeak,
+         (unsigned long long)stats.chunks, stopped ? "closed cleanly" : "write failed");
+  printf("  %.1f MB raw to %.1f MB on disk, %.2fx\n", (double)frames * 2 * W * H / 1e6, fileSize / 1e6,
+         (double)frames * 2 * W * H / (double)fileSize);
+  printf("  read back %u/%u frames exactly, %.2f ms per frame\n", exact, frames,
+         count ? (double)readTime / count / 1000.0 : 0.0);
+  int64_t middle = frames ? start + (int64_t)(frames / 2) * 11111 + 5000 : 0;
+  printf("  frame at t+%.1f ms is index %lli\n", (middle - start) / 1000.0,
+         recording ? (long long)FindRecordedFrame(recording, middle) : -1LL);
+
+  CloseImageRecording(recording);
+  remove(RECORDING_PATH);
+  free(pixels);
+  return 0;
+}
+//End-of-Sample
@@ -11,6 +11,11 @@
 #include <stdlib.h>
 #include "LeapC.h"
 #include "ExampleConnection.h"
+#include "StereoDepth.h"
+#include "HandRoi.h"
+
+static StereoDepth *depthEngine = NULL;
+static HandRoi *handCropper = NULL;
 
 /** Callback for when the connection opens. */
 static void OnConnect(void){
@@ -20,11 +25,26 @@ static void OnConnect(void){
 /** Callback for when a device is found. */
 static void OnDevice(const LEAP_DEVICE_INFO *props){
   printf("Found device %s.\n", props->serial);
+  if(!depthEngine){
+    StereoDepthConfig config;
+    GetDefaultStereoDepthConfig(&config);
+    config.baseline = props->baseline / 1000.0f;
+    depthEngine = CreateStereoDepth(&config);
+  }
+  if(!handCropper){
+    HandRoiConfig config;
+    GetDefaultHandRoiConfig(&config);
+    config.baseline = props->baseline / 1000.0f;
+    handCropper = CreateHandRoi(&config);
+  }
 }
 
 /** Callback for when a frame of tracking data is available. */
 static void OnFrame(const LEAP_TRACKING_EVENT *frame){
   printf("Frame %lli with %i hands.\n", (long long int)frame->info.frame_id, frame->nHands);
+  if(handCropper){
+    UpdateHandRoiHands(handCropper, frame);
+  }
   for(uint32_t h = 0; h < frame->nHands; h++){
     LEAP_HAND* hand = &frame->pHands[h];
     printf("    Hand id %i is a %s hand with position (%f, %f, %f).\n",
@@ -42,6 +62,24 @@ static void OnImage(const LEAP_IMAGE_EVENT *imageEvent){
            (long long int)imageEvent->info.frame_id,
            (long long int)imageEvent->image[0].properties.width*
            (long long int)imageEvent->image[0].properties.height*2);
+    const DepthMap *depth = depthEngine ? ComputeDepth(depthEngine, imageEvent) : NULL;
+    if(depth){
+      float nearest = 0;
+      for(uint32_t i = 0; i < depth->width * depth->height; i++){
+        if(depth->depth[i] > 0 && (nearest == 0 || depth->depth[i] < nearest)){
+          nearest = depth->depth[i];
+        }
+      }
+      printf("    Depth map with %u of %u pixels matched, nearest at %.0f mm.\n",
+             depth->valid, depth->width * depth->height, nearest);
+    }
+    const HandRoiFrame *rois = handCropper ? CropHandRois(handCropper, imageEvent) : NULL;
+    for(uint32_t r = 0; rois && r < rois->count; r++){
+      const HandRoiImage *roi = &rois->rois[r];
+      printf("    Hand %u in the %s image at (%i, %i), %ux%u cropped to %ux%u.\n",
+             roi->hand_id, roi->camera ? "right" : "left", roi->x, roi->y,
+             roi->width, roi->height, roi->out_width, roi->out_height);
+    }
 }
 
 int main(int argc, char** argv) {
@@ -58,6 +96,8 @@ int main(int argc, char** argv) {
   getchar();
   CloseConnection();
   DestroyConnection();
+  DestroyStereoDepth(depthEngine);
+  DestroyHandRoi(handCropper);
   return 0;
 }
 //End-of-Sample
@@ -0,0 +1,275 @@
+/* Buffered IMU samples with batched orientation fusion.
+ *
+ * The ring holds samples in hardware-timestamp order; count is the number
+ * ever added and fused the number that have been through the filter, so
+ * samples [fused, count) are pending. batch_size is at most half the ring,
+ * which keeps pending samples from being overwritten before they are fused.
+ * Each fusion step rotates the estimate by the exact axis-angle increment of
+ * the corrected rate rather than a first-order update, so long batches of
+ * fast head turns do not lose length or accuracy.
+ *
+ */
+
+#include "ImuFusion.h"
+#include "LeapMath.h"
+#include "LeapThreads.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IMU_GRAVITY 9.80665f
+//Weight of each new sample in the smoothed clock offset.
+#define IMU_OFFSET_SMOOTHING (1.0 / 256.0)
+
+struct _ImuFusion {
+  ImuFusionConfig config;
+  LockType        lock;
+  ImuSample      *ring;
+  uint32_t        mask;
+  uint64_t        count;
+  uint64_t        fused;
+  int64_t         lastHw;         //Newest hardware timestamp added
+  bool            haveOffset;
+  double          offset;         //Smoothed LeapGetNow() minus hardware time
+  LEAP_QUATERNION q;              //Filter state: device to world
+  LEAP_VECTOR     bias;           //Integral term, added to the gyroscope
+  int64_t         stateHw;        //Hardware time of the filter state
+  ImuFusionStats  stats;
+};
+
+void GetDefaultImuFusionConfig(ImuFusionConfig *config){
+  memset(config, 0, sizeof(ImuFusionConfig));
+  config->capacity = 4096;
+  config->batch_size = 64;
+  config->kp = 1.0f;
+  config->ki = 0.1f;
+  config->accel_tolerance = 0.05f;
+  config->max_gap = 100000;
+  config->max_extrapolation = 20000;
+}
+
+ImuFusion* CreateImuFusion(const ImuFusionConfig *config){
+  ImuFusionConfig defaults;
+  if(!config){
+    GetDefaultImuFusionConfig(&defaults);
+    config = &defaults;
+  }
+  uint32_t capacity = 2;
+  while(capacity < config->capacity && capacity < (1u << 24)){
+    capacity <<= 1;
+  }
+  if(config->batch_size == 0 || config->batch_size > capacity / 2 || config->kp < 0.0f || config->ki < 0.0f){
+    return NULL;
+  }
+  ImuFusion *fusion = calloc(1, sizeof(ImuFusion));
+  if(!fusion){
+    return NULL;
+  }
+  fusion->ring = malloc((size_t)capacity * sizeof(ImuSample));
+  if(!fusion->ring){
+    free(fusion);
+    return NULL;
+  }
+  fusion->config = *config;
+  fusion->config.capacity = capacity;
+  fusion->mask = capacity - 1;
+  fusion->q = QuaternionMake(0.0f, 0.0f, 0.0f, 1.0f);
+  InitLock(&fusion->lock);
+  return fusion;
+}
+
+void DestroyImuFusion(ImuFusion *fusion){
+  if(!fusion){
+    return;
+  }
+  DestroyLock(&fusion->lock);
+  free(fusion->ring);
+  free(fusion);
+}
+
+/** The rotation taking the measured up direction in the device frame onto world +y, without heading. */
+static LEAP_QUATERNION levelFromGravity(LEAP_VECTOR up){
+  float length = VectorLength(up);
+  if(length <= 0.0f){
+    return QuaternionMake(0.0f, 0.0f, 0.0f, 1.0f);
+  }
+  up = VectorScale(up, 1.0f / length);
+  //Shortest arc from up to (0, 1, 0): axis up x y, half-angle form.
+  float w = 1.0f + up.y;
+  if(w < 1e-6f){
+    return QuaternionMake(1.0f, 0.0f, 0.0f, 0.0f);
+  }
+  return QuaternionNormalize(QuaternionMake(-up.z, 0.0f, up.x, w));
+}
+
+/** q rotated by angular velocity w (device frame, rad/s) for seconds. */
+static LEAP_QUATERNION integrate(LEAP_QUATERNION q, LEAP_VECTOR w, float seconds){
+  float angle = VectorLength(w) * seconds;
+  if(angle <= 0.0f){
+    return q;
+  }
+  float s = sinf(0.5f * angle) / VectorLength(w);
+  LEAP_QUATERNION step = QuaternionMake(w.x * s, w.y * s, w.z * s, cosf(0.5f * angle));
+  return QuaternionNormalize(QuaternionMultiply(q, step));
+}
+
+/** Runs the filter over every pending sample. Call with lock held. */
+static void fusePending(ImuFusion *fusion){
+  if(fusion->fused == fusion->count){
+    return;
+  }
+  int64_t start = LeapGetNow();
+  const ImuFusionConfig *config = &fusion->config;
+  const LEAP_VECTOR worldUp = VectorMake(0.0f, 1.0f, 0.0f);
+  LEAP_QUATERNION q = fusion->q;
+  LEAP_VECTOR bias = fusion->bias;
+  for(uint64_t i = fusion->fused; i < fusion->count; i++){
+    ImuSample *sample = &fusion->ring[i & fusion->mask];
+    bool hasAccel = (sample->flags & eLeapIMUFlag_HasAccelerometer) != 0;
+    LEAP_VECTOR gyro = sample->flags & eLeapIMUFlag_HasGyroscope ? sample->gyroscope : VectorMake(0.0f, 0.0f, 0.0f);
+
+    if(fusion->fused == 0 && i == 0){
+      //Start level with the first gravity reading.
+      q = hasAccel ? levelFromGravity(sample->accelerometer) : q;
+      sample->orientation = q;
+      sample->angular_velocity = gyro;
+      fusion->stateHw = sample->timestamp_hw;
+      continue;
+    }
+    int64_t step = sample->timestamp_hw - fusion->stateHw;
+    fusion->stateHw = sample->timestamp_hw;
+    float dt = (float)step / 1000000.0f;
+    if(step > config->max_gap){
+      fusion->stats.gaps++;
+      dt = 0.0f;
+    }
+
+    LEAP_VECTOR correction = VectorMake(0.0f, 0.0f, 0.0f);
+    float magnitude = hasAccel ? VectorLength(sample->accelerometer) : 0.0f;
+    if(hasAccel && fabsf(magnitude / IMU_GRAVITY - 1.0f) <= config->accel_tolerance){
+      LEAP_VECTOR measured = VectorScale(sample->accelerometer, 1.0f / magnitude);
+      LEAP_VECTOR estimated = QuaternionRotate(QuaternionConjugate(q), worldUp);
+      //Rotating at measured x estimated turns the estimate towards the measurement.
+      LEAP_VECTOR error = VectorCross(measured, estimated);
+      bias = VectorAdd(bias, VectorScale(error, config->ki * dt));
+      correction = VectorScale(error, config->kp);
+    } else {
+      fusion->stats.accelRejected++;
+    }
+    LEAP_VECTOR rate = VectorAdd(gyro, bias);
+    q = integrate(q, VectorAdd(rate, correction), dt);
+    sample->orientation = q;
+    sample->angular_velocity = rate;
+  }
+  fusion->stats.fused += fusion->count - fusion->fused;
+  fusion->stats.batches++;
+  fusion->fused = fusion->count;
+  fusion->q = q;
+  fusion->bias = bias;
+  fusion->stats.fuseTime += LeapGetNow() - start;
+}
+
+void AddImuSample(ImuFusion *fusion, const LEAP_IMU_EVENT *event){
+  LockMutex(&fusion->lock);
+  fusion->stats.samples++;
+  if(fusion->count && event->timestamp_hw <= fusion->lastHw){
+    fusion->stats.outOfOrder++;
+    UnlockMutex(&fusion->lock);
+    return;
+  }
+  ImuSample *sample = &fusion->ring[fusion->count & fusion->mask];
+  sample->timestamp = event->timestamp;
+  sample->timestamp_hw = event->timestamp_hw;
+  sample->flags = event->flags;
+  sample->accelerometer = event->accelerometer;
+  sample->gyroscope = event->gyroscope;
+  sample->temperature = event->temperature;
+  fusion->count++;
+  fusion->lastHw = event->timestamp_hw;
+
+  double offset = (double)(event->timestamp - event->timestamp_hw);
+  fusion->offset = fusion->haveOffset ? fusion->offset + (offset - fusion->offset) * IMU_OFFSET_SMOOTHING : offset;
+  fusion->haveOffset = true;
+
+  if(fusion->count - fusion->fused >= fusion->config.batch_size){
+    fusePending(fusion);
+  }
+  UnlockMutex(&fusion->lock);
+}
+
+void UpdateImuFusion(ImuFusion *fusion){
+  LockMutex(&fusion->lock);
+  fusePending(fusion);
+  UnlockMutex(&fusion->lock);
+}
+
+static uint64_t oldestIndex(const ImuFusion *fusion){
+  return fusion->count > fusion->config.capacity ? fusion->count - fusion->config.capacity : 0;
+}
+
+/** First index in [lo, hi) whose hardware time is after hw. Call with lock held. */
+static uint64_t firstAfter(const ImuFusion *fusion, uint64_t lo, uint64_t hi, int64_t hw){
+  while(lo < hi){
+    uint64_t mid = lo + (hi - lo) / 2;
+    if(fusion->ring[mid & fusion->mask].timestamp_hw <= hw){
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+bool GetImuOrientation(ImuFusion *fusion, int64_t timestamp, ImuOrientation *orientation){
+  LockMutex(&fusion->lock);
+  fusePending(fusion);
+  uint64_t oldest = oldestIndex(fusion), newest = fusion->fused;
+  if(newest == oldest){
+    UnlockMutex(&fusion->lock);
+    return false;
+  }
+  int64_t hw = timestamp - (int64_t)(fusion->offset + (fusion->offset < 0.0 ? -0.5 : 0.5));
+  const ImuSample *first = &fusion->ring[oldest & fusion->mask];
+  const ImuSample *last = &fusion->ring[(newest - 1) & fusion->mask];
+  bool found = true;
+  orientation->timestamp = timestamp;
+  orientation->extrapolated = false;
+  if(hw < first->timestamp_hw){
+    found = false;
+  } else if(hw >= last->timestamp_hw){
+    int64_t ahead = hw - last->timestamp_hw;
+    found = ahead <= fusion->config.max_extrapolation;
+    orientation->orientation = integrate(last->orientation, last->angular_velocity, (float)ahead / 1000000.0f);
+    orientation->angular_velocity = last->angular_velocity;
+    orientation->extrapolated = ahead > 0;
+  } else {
+    uint64_t next = firstAfter(fusion, oldest, newest, hw);
+    const ImuSample *a = &fusion->ring[(next - 1) & fusion->mask];
+    const ImuSample *b = &fusion->ring[next & fusion->mask];
+    float t = (float)(hw - a->timestamp_hw) / (float)(b->timestamp_hw - a->timestamp_hw);
+    orientation->orientation = QuaternionNlerp(a->orientation, b->orientation, t);
+    orientation->angular_velocity = VectorLerp(a->angular_velocity, b->angular_velocity, t);
+  }
+  UnlockMutex(&fusion->lock);
+  return found;
+}
+
+uint32_t ReadImuSamples(ImuFusion *fusion, int64_t after_timestamp_hw, ImuSample *samples, uint32_t max){
+  LockMutex(&fusion->lock);
+  fusePending(fusion);
+  uint64_t begin = firstAfter(fusion, oldestIndex(fusion), fusion->fused, after_timestamp_hw);
+  uint32_t count = 0;
+  for(uint64_t i = begin; i < fusion->fused && count < max; i++){
+    samples[count++] = fusion->ring[i & fusion->mask];
+  }
+  UnlockMutex(&fusion->lock);
+  return count;
+}
+
+void GetImuFusionStats(ImuFusion *fusion, ImuFusionStats *stats){
+  LockMutex(&fusion->lock);
+  *stats = fusion->stats;
+  stats->clockOffset = (int64_t)fusion->offset;
+  stats->gyroBias = fusion->bias;
+  UnlockMutex(&fusion->lock);
+}
+//End-of-ImuFusion.c
@@ -0,0 +1,89 @@
+/* Buffered IMU samples with batched orientation fusion.
+ *
+ * AddImuSample() appends a LEAP_IMU_EVENT to a ring ordered by its hardware
+ * timestamp and returns; ExampleConnection calls it on the polling thread
+ * for every eLeapEventType_IMU once SetConnectionImuFusion() is set, so no
+ * per-sample callback is needed. Samples are fused in batches: whenever
+ * batch_size of them are pending, and before every query, all pending
+ * samples go through a Mahony filter in one pass. The filter integrates the
+ * gyroscope and pulls the estimate towards the measured gravity with
+ * proportional gain kp and integral gain ki; the integral term learns the
+ * gyroscope bias, and with ki = 0 it is a plain complementary filter.
+ * Accelerometer readings far from 1 g are left out, since they are mostly
+ * the device's own acceleration.
+ *
+ * The world frame has +y up, as Leap tracking space on a desk; heading
+ * starts at zero. GetImuOrientation() gives the device orientation at any
+ * time the ring still covers, interpolated between the two samples around
+ * it, or extrapolated with the last angular velocity up to max_extrapolation
+ * past the newest. Times are in LeapGetNow() microseconds, like tracking
+ * frames; the hardware clock is mapped to it with a smoothed offset.
+ * ReadImuSamples() copies whole fused samples out in batches.
+ *
+ * All functions may be called from any thread.
+ *
+ */
+
+#ifndef ImuFusion_h
+#define ImuFusion_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct _ImuFusionConfig {
+  uint32_t capacity;              //Samples kept; rounded up to a power of two
+  uint32_t batch_size;            //Pending samples that trigger fusion on the adding thread
+  float    kp;                    //Proportional gain towards gravity, 1/s
+  float    ki;                    //Integral gain for gyroscope bias, 1/s^2
+  float    accel_tolerance;       //Accepted deviation of |accelerometer| from 1 g, as a fraction
+  int64_t  max_gap;               //Microseconds between samples beyond which the step is not integrated
+  int64_t  max_extrapolation;     //Microseconds past the newest sample a query may reach
+} ImuFusionConfig;
+
+typedef struct _ImuSample {
+  int64_t         timestamp;      //LeapGetNow() microseconds
+  int64_t         timestamp_hw;   //Device clock microseconds
+  uint32_t        flags;          //eLeapIMUFlag
+  LEAP_VECTOR     accelerometer;  //m/s^2
+  LEAP_VECTOR     gyroscope;      //rad/s, as measured
+  float           temperature;
+  LEAP_QUATERNION orientation;    //Device to world after fusing this sample
+  LEAP_VECTOR     angular_velocity; //rad/s, bias-corrected
+} ImuSample;
+
+typedef struct _ImuOrientation {
+  int64_t         timestamp;
+  LEAP_QUATERNION orientation;    //Device to world
+  LEAP_VECTOR     angular_velocity; //rad/s in the device frame
+  bool            extrapolated;
+} ImuOrientation;
+
+typedef struct _ImuFusionStats {
+  uint64_t samples;
+  uint64_t fused;
+  uint64_t batches;
+  uint64_t outOfOrder;            //Samples not newer than the last, dropped
+  uint64_t gaps;                  //Steps longer than max_gap
+  uint64_t accelRejected;         //Samples fused on the gyroscope alone
+  int64_t  fuseTime;              //Microseconds spent fusing
+  int64_t  clockOffset;           //LeapGetNow() minus hardware time, microseconds
+  LEAP_VECTOR gyroBias;           //rad/s learnt by the integral term
+} ImuFusionStats;
+
+typedef struct _ImuFusion ImuFusion;
+
+void GetDefaultImuFusionConfig(ImuFusionConfig *config);
+ImuFusion* CreateImuFusion(const ImuFusionConfig *config);
+void DestroyImuFusion(ImuFusion *fusion);
+
+void AddImuSample(ImuFusion *fusion, const LEAP_IMU_EVENT *event);
+/* Fuses whatever is pending; queries do this themselves. */
+void UpdateImuFusion(ImuFusion *fusion);
+
+bool GetImuOrientation(ImuFusion *fusion, int64_t timestamp, ImuOrientation *orientation);
+/* Copies up to max samples newer than after_timestamp_hw, oldest first. Returns the count. */
+uint32_t ReadImuSamples(ImuFusion *fusion, int64_t after_timestamp_hw, ImuSample *samples, uint32_t max);
+void GetImuFusionStats(ImuFusion *fusion, ImuFusionStats *stats);
+
+#endif /* ImuFusion_h */
@@ -0,0 +1,242 @@
+/* Feeds a simulated 1 kHz IMU through ImuFusion and scores the orientation.
+ *
+ * The device turns about all three axes with a known angular velocity; the
+ * gyroscope reads it with a constant bias and noise, the accelerometer reads
+ * gravity with noise and, for 200 ms every 3 s, an extra 4 m/s^2 of the
+ * device's own acceleration. Host timestamps carry up to 1.5 ms of transport
+ * jitter, one sample in 500 is lost and a few arrive twice. While samples
+ * are added, a second thread queries the orientation at the latest host
+ * time, as a renderer would.
+ *
+ * Tilt error is the angle between the true and estimated up direction in the
+ * device frame; heading is not observable from gravity and is not scored.
+ * Each filter is run with batched fusion and with batch_size 1, which costs
+ * what fusing in a per-sample callback would.
+ *
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "ImuFusion.h"
+#include "LeapMath.h"
+#include "LeapThreads.h"
+
+#define RATE_US 1000
+#define SECONDS 30
+#define SAMPLES (SECONDS * 1000000 / RATE_US)
+#define HOST_OFFSET 123456789
+#define QUERIES 20000
+
+typedef struct _Truth {
+  int64_t         timestamp_hw;
+  LEAP_QUATERNION orientation;
+} Truth;
+
+static LEAP_IMU_EVENT *events;
+static Truth *truth;
+static uint32_t eventCount;
+static const LEAP_VECTOR trueBias = {{{ 0.02f, -0.015f, 0.01f }}};
+
+static uint32_t seed = 12345;
+static float uniform(void){
+  seed = seed * 1664525u + 1013904223u;
+  return (float)(seed >> 8) / 16777216.0f;
+}
+static float gaussian(void){
+  return (uniform() + uniform() + uniform() + uniform() - 2.0f) * 1.7320508f;
+}
+
+static LEAP_VECTOR angularVelocity(double t){
+  return VectorMake(0.8f * (float)sin(2.0 * M_PI * 0.3 * t),
+                    1.5f * (float)sin(2.0 * M_PI * 0.2 * t),
+                    0.6f * (float)cos(2.0 * M_PI * 0.5 * t));
+}
+
+static LEAP_VECTOR deviceUp(LEAP_QUATERNION q){
+  return QuaternionRotate(QuaternionConjugate(q), VectorMake(0.0f, 1.0f, 0.0f));
+}
+
+static float tiltError(LEAP_QUATERNION estimate, LEAP_QUATERNION actual){
+  float d = VectorDot(deviceUp(estimate), deviceUp(actual));
+  return acosf(d > 1.0f ? 1.0f : d) * 180.0f / (float)M_PI;
+}
+
+static void simulate(void){
+  events = calloc(SAMPLES + SAMPLES / 100, sizeof(LEAP_IMU_EVENT));
+  truth = calloc(SAMPLES, sizeof(Truth));
+  //Start tilted, so the filter has to find level from the first reading.
+  LEAP_QUATERNION q = QuaternionNormalize(QuaternionMake(0.2f, 0.1f, -0.1f, 1.0f));
+  int64_t hw = 5000000;
+  for(uint32_t i = 0; i < SAMPLES; i++){
+    double t = (double)i * RATE_US / 1e6;
+    //Integrate the true motion in ten substeps.
+    for(int s = 0; s < 10; s++){
+      LEAP_VECTOR w = angularVelocity(t + s * RATE_US / 1e7);
+      float angle = VectorLength(w) * RATE_US / 1e7f;
+      if(angle > 0.0f){
+        LEAP_VECTOR axis = VectorScale(w, sinf(0.5f * angle) / VectorLength(w));
+        q = QuaternionNormalize(QuaternionMultiply(q, QuaternionMake(axis.x, axis.y, axis.z, cosf(0.5f * angle))));
+      }
+    }
+    hw += RATE_US;
+    truth[i].timestamp_hw = hw;
+    truth[i].orientation = q;
+    if(i % 500 == 499){
+      continue;
+    }
+    LEAP_IMU_EVENT *event = &events[eventCount++];
+    event->timestamp_hw = hw;
+    event->timestamp = hw + HOST_OFFSET + (int64_t)(uniform() * 1500.0f);
+    event->flags = eLeapIMUFlag_HasAccelerometer | eLeapIMUFlag_HasGyroscope | eLeapIMUFlag_HasTemperature;
+    LEAP_VECTOR w = angularVelocity(t + RATE_US / 1e6);
+    event->gyroscope = VectorMake(w.x + trueBias.x + 0.005f * gaussian(),
+                                  w.y + trueBias.y + 0.005f * gaussian(),
+                                  w.z + trueBias.z + 0.005f * gaussian());
+    LEAP_VECTOR a = VectorScale(deviceUp(q), 9.80665f);
+    if(fmod(t, 3.0) < 0.2){
+      a = VectorAdd(a, VectorMake(4.0f, 0.0f, 0.0f));
+    }
+    event->accelerometer = VectorMake(a.x + 0.05f * gaussian(), a.y + 0.05f * gaussian(), a.z + 0.05f * gaussian());
+    event->temperature = 35.0f;
+    if(i % 4000 == 1000){
+      events[eventCount] = *event;
+      eventCount++;
+    }
+  }
+}
+
+static const Truth* truthAt(int64_t hw){
+  uint32_t i = (uint32_t)((hw - truth[0].timestamp_hw) / RATE_US);
+  return i < SAMPLES ? &truth[i] : NULL;
+}
+
+typedef struct _Run {
+  ImuFusion  *fusion;
+  atomic_bool adding;
+  atomic_llong now;
+  uint32_t    queries;
+  uint32_t    answered;
+} Run;
+
+static ThreadReturnType query(void *arg){
+  Run *run = (Run*)arg;
+  ImuOrientation orientation;
+  while(atomic_load(&run->adding)){
+    int64_t now = atomic_load(&run->now);
+    if(now && GetImuOrientation(run->fusion, now, &orientation)){
+      run->answered++;
+    }
+    run->queries++;
+    YieldThread();
+  }
+  return ThreadReturnValue;
+}
+
+static void runFilter(const char *label, float kp, float ki, uint32_t batchSize){
+  ImuFusionConfig config;
+  GetDefaultImuFusionConfig(&config);
+  config.kp = kp;
+  config.ki = ki;
+  config.batch_size = batchSize;
+  config.capacity = 2048;
+  Run run;
+  memset(&run, 0, sizeof(run));
+  run.fusion = CreateImuFusion(&config);
+  if(!run.fusion){
+    printf("Failed to create the filter.\n");
+    return;
+  }
+  atomic_init(&run.adding, true);
+  atomic_init(&run.now, 0);
+  ThreadType reader;
+  StartThread(&reader, query, &run);
+
+  double sum = 0.0, worst = 0.0;
+  uint32_t scored = 0;
+  ImuSample batch[256];
+  int64_t readHw = 0;
+  for(uint32_t i = 0; i < eventCount; i++){
+    AddImuSample(run.fusion, &events[i]);
+    atomic_store(&run.now, events[i].timestamp);
+    //Score the last two thirds of the run in batches, once the filter has settled.
+    if(i % 200 == 199){
+      uint32_t n;
+      while((n = ReadImuSamples(run.fusion, readHw, batch, 256)) > 0){
+        for(uint32_t k = 0; k < n; k++){
+          const Truth *actual = truthAt(batch[k].timestamp_hw);
+          if(actual && batch[k].timestamp_hw - truth[0].timestamp_hw > SECONDS * 1000000 / 3){
+            double e = tiltError(batch[k].orientation, actual->orientation);
+            sum += e * e;
+            worst = e > worst ? e : worst;
+            scored++;
+          }
+        }
+        readHw = batch[n - 1].timestamp_hw;
+      }
+    }
+  }
+  UpdateImuFusion(run.fusion);
+  atomic_store(&run.adding, false);
+  JoinThread(reader);
+
+  ImuFusionStats stats;
+  GetImuFusionStats(run.fusion, &stats);
+  //Interpolated lookups halfway between samples, by host time.
+  double interpolated = 0.0;
+  uint32_t found = 0;
+  int64_t lookupStart = LeapGetNow();
+  for(uint32_t q = 0; q < QUERIES; q++){
+    const Truth *a = &truth[SAMPLES - 1900 + (q % 1800)];
+    ImuOrientation orientation;
+    if(GetImuOrientation(run.fusion, a->timestamp_hw + RATE_US / 2 + stats.clockOffset, &orientation)){
+      LEAP_QUATERNION actual = QuaternionNlerp(a->orientation, (a + 1)->orientation, 0.5f);
+      interpolated += tiltError(orientation.orientation, actual);
+      found++;
+    }
+  }
+  int64_t lookupTime = LeapGetNow() - lookupStart;
+
+  //Adding alone, best of five, without the reader.
+  int64_t elapsed = INT64_MAX;
+  for(int r = 0; r < 5; r++){
+    ImuFusion *timed = CreateImuFusion(&config);
+    int64_t start = LeapGetNow();
+    for(uint32_t i = 0; i < eventCount; i++){
+      AddImuSample(timed, &events[i]);
+    }
+    UpdateImuFusion(timed);
+    int64_t took = LeapGetNow() - start;
+    elapsed = took < elapsed ? took : elapsed;
+    DestroyImuFusion(timed);
+  }
+
+  printf("%s, batch %u:\n", label, batchSize);
+  printf("  tilt error rms %.2f deg, worst %.2f deg over %u samples; at half-sample lookups %.2f deg mean\n",
+         scored ? sqrt(sum / scored) : 0.0, worst, scored, found ? interpolated / found : 0.0);
+  printf("  gyro bias learnt (%.4f, %.4f, %.4f) rad/s, true (%.4f, %.4f, %.4f)\n",
+         -stats.gyroBias.x, -stats.gyroBias.y, -stats.gyroBias.z, trueBias.x, trueBias.y, trueBias.z);
+  printf("  %llu samples, %llu out of order, %llu gaps, %llu without gravity, %llu batches, clock offset %lld us\n",
+         (unsigned long long)stats.samples, (unsigned long long)stats.outOfOrder, (unsigned long long)stats.gaps,
+         (unsigned long long)stats.accelRejected, (unsigned long long)stats.batches, (long long)stats.clockOffset);
+  printf("  %.0f ns per sample added and fused, %.0f ns per lookup, %u of %u lookups from the reader answered\n",
+         elapsed * 1000.0 / eventCount, lookupTime * 1000.0 / QUERIES, run.answered, run.queries);
+  DestroyImuFusion(run.fusion);
+}
+
+int main(int argc, char** argv) {
+  simulate();
+  printf("%u samples over %d s\n", eventCount, SECONDS);
+  runFilter("Gyroscope only", 0.0f, 0.0f, 64);
+  runFilter("Complementary", 1.0f, 0.0f, 64);
+  runFilter("Mahony", 1.0f, 0.1f, 64);
+  runFilter("Mahony", 1.0f, 0.1f, 1);
+  free(events);
+  free(truth);
+  return 0;
+}
+//End-of-Sample
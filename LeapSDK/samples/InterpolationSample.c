@@ -25,9 +25,7 @@ LEAP_CLOCK_REBASER clockSynchronizer;
 int main(int argc, char** argv) {
   LEAP_CONNECTION* connHandle = OpenConnection();
 
-  while(!IsConnected){
-    millisleep(250);
-  }
+  WaitForConnection(WAIT_INFINITE);
 
   printf("Connected.\n");
   //Create the clock synchronizer
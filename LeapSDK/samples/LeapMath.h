@@ -0,0 +1,93 @@
+/* Small inline vector and quaternion helpers for LEAP_VECTOR and
+ * LEAP_QUATERNION, shared by the sample subsystems.
+ *
+ */
+
+#ifndef LeapMath_h
+#define LeapMath_h
+
+#include "LeapC.h"
+#include <math.h>
+
+static inline LEAP_VECTOR VectorMake(float x, float y, float z){
+  LEAP_VECTOR r;
+  r.x = x;
+  r.y = y;
+  r.z = z;
+  return r;
+}
+
+static inline LEAP_VECTOR VectorAdd(LEAP_VECTOR a, LEAP_VECTOR b){
+  return VectorMake(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+static inline LEAP_VECTOR VectorSub(LEAP_VECTOR a, LEAP_VECTOR b){
+  return VectorMake(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static inline LEAP_VECTOR VectorScale(LEAP_VECTOR a, float s){
+  return VectorMake(a.x * s, a.y * s, a.z * s);
+}
+
+static inline float VectorDot(LEAP_VECTOR a, LEAP_VECTOR b){
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline LEAP_VECTOR VectorCross(LEAP_VECTOR a, LEAP_VECTOR b){
+  return VectorMake(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+static inline float VectorLength(LEAP_VECTOR a){
+  return sqrtf(VectorDot(a, a));
+}
+
+static inline LEAP_VECTOR VectorLerp(LEAP_VECTOR a, LEAP_VECTOR b, float t){
+  return VectorMake(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+}
+
+static inline LEAP_QUATERNION QuaternionMake(float x, float y, float z, float w){
+  LEAP_QUATERNION q;
+  q.x = x;
+  q.y = y;
+  q.z = z;
+  q.w = w;
+  return q;
+}
+
+static inline LEAP_QUATERNION QuaternionConjugate(LEAP_QUATERNION q){
+  return QuaternionMake(-q.x, -q.y, -q.z, q.w);
+}
+
+static inline LEAP_QUATERNION QuaternionMultiply(LEAP_QUATERNION a, LEAP_QUATERNION b){
+  return QuaternionMake(a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+                        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
+static inline LEAP_QUATERNION QuaternionNormalize(LEAP_QUATERNION q){
+  float n = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+  if(n <= 0.0f){
+    return QuaternionMake(0.0f, 0.0f, 0.0f, 1.0f);
+  }
+  return QuaternionMake(q.x / n, q.y / n, q.z / n, q.w / n);
+}
+
+/** Rotates v by the unit quaternion q. */
+static inline LEAP_VECTOR QuaternionRotate(LEAP_QUATERNION q, LEAP_VECTOR v){
+  LEAP_VECTOR u = VectorMake(q.x, q.y, q.z);
+  LEAP_VECTOR t = VectorScale(VectorCross(u, v), 2.0f);
+  return VectorAdd(VectorAdd(v, VectorScale(t, q.w)), VectorCross(u, t));
+}
+
+/** Normalized linear interpolation along the shorter arc; accurate enough between adjacent frames. */
+static inline LEAP_QUATERNION QuaternionNlerp(LEAP_QUATERNION a, LEAP_QUATERNION b, float t){
+  float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+  float sign = dot < 0.0f ? -1.0f : 1.0f;
+  return QuaternionNormalize(QuaternionMake(a.x + (sign * b.x - a.x) * t,
+                                            a.y + (sign * b.y - a.y) * t,
+                                            a.z + (sign * b.z - a.z) * t,
+                                            a.w + (sign * b.w - a.w) * t));
+}
+
+#endif /* LeapMath_h */
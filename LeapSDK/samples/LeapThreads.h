@@ -0,0 +1,189 @@
+/* Cross-platform threading primitives shared by the sample subsystems.
+ *
+ * Follows the same _MSC_VER / pthread split as ExampleConnection.c and
+ * MultiDeviceSample.c. Lock-free code uses C11 <stdatomic.h>; MSVC needs
+ * /experimental:c11atomics, which the samples CMakeLists.txt adds.
+ *
+ */
+
+#ifndef LeapThreads_h
+#define LeapThreads_h
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+  #include <Windows.h>
+  #include <process.h>
+  #define LockType CRITICAL_SECTION
+  #define CondType CONDITION_VARIABLE
+  #define ThreadType HANDLE
+  #define ThreadReturnType unsigned __stdcall
+  #define ThreadReturnValue 0
+  #define LockMutex EnterCriticalSection
+  #define UnlockMutex LeaveCriticalSection
+#else
+  #include <errno.h>
+  #include <pthread.h>
+  #include <sched.h>
+  #include <time.h>
+  #include <unistd.h>
+  #if defined(__APPLE__)
+    #include <pthread/qos.h>
+  #elif defined(__linux__)
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+  #endif
+  #define LockType pthread_mutex_t
+  #define CondType pthread_cond_t
+  #define ThreadType pthread_t
+  #define ThreadReturnType void*
+  #define ThreadReturnValue NULL
+  #define LockMutex pthread_mutex_lock
+  #define UnlockMutex pthread_mutex_unlock
+#endif
+
+typedef ThreadReturnType (*thread_function)(void *arg);
+
+static inline void InitLock(LockType *lock){
+#if defined(_MSC_VER)
+  InitializeCriticalSection(lock);
+#else
+  pthread_mutex_init(lock, NULL);
+#endif
+}
+
+static inline void DestroyLock(LockType *lock){
+#if defined(_MSC_VER)
+  DeleteCriticalSection(lock);
+#else
+  pthread_mutex_destroy(lock);
+#endif
+}
+
+static inline void InitCond(CondType *cond){
+#if defined(_MSC_VER)
+  InitializeConditionVariable(cond);
+#else
+  pthread_cond_init(cond, NULL);
+#endif
+}
+
+static inline void DestroyCond(CondType *cond){
+#if defined(_MSC_VER)
+  (void)cond;
+#else
+  pthread_cond_destroy(cond);
+#endif
+}
+
+static inline void SignalCond(CondType *cond){
+#if defined(_MSC_VER)
+  WakeConditionVariable(cond);
+#else
+  pthread_cond_signal(cond);
+#endif
+}
+
+static inline void BroadcastCond(CondType *cond){
+#if defined(_MSC_VER)
+  WakeAllConditionVariable(cond);
+#else
+  pthread_cond_broadcast(cond);
+#endif
+}
+
+/** Waits on cond with lock held. Returns false on timeout. */
+static inline bool WaitCond(CondType *cond, LockType *lock, uint32_t timeout_ms){
+#if defined(_MSC_VER)
+  return SleepConditionVariableCS(cond, lock, timeout_ms) != 0;
+#else
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+  if(deadline.tv_nsec >= 1000000000L){
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  return pthread_cond_timedwait(cond, lock, &deadline) != ETIMEDOUT;
+#endif
+}
+
+/*
+ * Sleeping on a lock-free queue. The consumer, holding lock, calls
+ * BeginWait(), checks the queue once more and only then waits on cond; the
+ * producer publishes, then calls WakeWaiter(). The two full fences keep
+ * each side's store ahead of its following load, so either the consumer's
+ * check sees the item or the producer sees waiting and signals.
+ */
+static inline void BeginWait(atomic_int *waiting){
+  atomic_store_explicit(waiting, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+static inline void EndWait(atomic_int *waiting){
+  atomic_store_explicit(waiting, 0, memory_order_relaxed);
+}
+
+static inline void WakeWaiter(atomic_int *waiting, LockType *lock, CondType *cond){
+  atomic_thread_fence(memory_order_seq_cst);
+  if(atomic_load_explicit(waiting, memory_order_relaxed)){
+    LockMutex(lock);
+    SignalCond(cond);
+    UnlockMutex(lock);
+  }
+}
+
+static inline bool StartThread(ThreadType *thread, thread_function function, void *arg){
+#if defined(_MSC_VER)
+  *thread = (HANDLE)_beginthreadex(NULL, 0, function, arg, 0, NULL);
+  return *thread != 0;
+#else
+  return pthread_create(thread, NULL, function, arg) == 0;
+#endif
+}
+
+static inline void JoinThread(ThreadType thread){
+#if defined(_MSC_VER)
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+/** Number of logical processors, at least 1. */
+static inline uint32_t GetCpuCount(void){
+#if defined(_MSC_VER)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors ? (uint32_t)info.dwNumberOfProcessors : 1;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t)count : 1;
+#endif
+}
+
+static inline void YieldThread(void){
+#if defined(_MSC_VER)
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
+/** Moves the calling thread below normal priority, for background work that must not delay tracking. Best effort. */
+static inline void LowerThreadPriority(void){
+#if defined(_MSC_VER)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__APPLE__)
+  pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#elif defined(__linux__)
+  //Nice values apply per thread on Linux.
+  setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+#endif
+}
+
+#endif /* LeapThreads_h */
@@ -8,6 +8,7 @@
  */
 
 #include <LeapC.h>
+#include "DeviceRegistry.h"
 #include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
@@ -69,19 +70,17 @@ static const char* devicePIDToString(eLeapDevicePID p)
   return "Unknown Tracking Device";
 }
 
-typedef struct _DeviceState
-{
-  LEAP_DEVICE device;
-  uint32_t id;
-} DeviceState;
-
 static ThreadReturnType pollingServiceLoop(void* p)
 {
   LEAP_CONNECTION* connection = (LEAP_CONNECTION*)p;
 
-  // LEAP_DEVICE's can be passed to -Ex forms of the LeapC API
-  DeviceState* devices = NULL;
-  uint32_t deviceCount = 0;
+  // The registry keeps each device open; its LEAP_DEVICE can be passed to -Ex forms of the LeapC API
+  DeviceRegistry* devices = CreateDeviceRegistry();
+  if (!devices)
+  {
+    printf("Failed to allocate the device registry\n");
+    abort();
+  }
 
   while (true)
   {
@@ -103,60 +102,35 @@ static ThreadReturnType pollingServiceLoop(void* p)
 
     if (msg.type == eLeapEventType_Device)
     {
-      DeviceState* newDevices = realloc(devices, sizeof(DeviceState) * (deviceCount + 1));
-      if (!newDevices)
-      {
-        printf("Failed to allocate memory to accomodate %u devices\n", deviceCount + 1);
-        abort();
-      }
-      else
-      {
-        devices = newDevices;
-        LEAPC_CHECK(LeapOpenDevice(msg.device_event->device, &devices[deviceCount].device));
-
-        devices[deviceCount].id = msg.device_event->device.id;
+      // Opens the device and reads its info, serial number included, once
+      DeviceSnapshot device;
+      LEAPC_CHECK(RegisterDevice(devices, msg.device_event, &device));
 
-        LEAP_DEVICE_INFO deviceInfo;
-        memset(&deviceInfo, 0, sizeof(deviceInfo));
+      printf("Found device with ID: %u, type: %s, serial number: %s\n", device.id, devicePIDToString(device.info.pid), device.info.serial);
 
-        // Use stack memory to allocate for the serial number field.
-        char serial[1000];
-        memset(serial, 0, sizeof(serial));
-        deviceInfo.serial = serial;
-        deviceInfo.serial_length = sizeof(serial) - 1;
-        deviceInfo.size = sizeof(deviceInfo);
-
-        LEAPC_CHECK(LeapGetDeviceInfo(devices[deviceCount].device, &deviceInfo));
-
-        printf("Found device with ID: %u, type: %s, serial number: %s\n", msg.device_event->device.id, devicePIDToString(deviceInfo.pid), deviceInfo.serial);
-
-        // Unconditionally subscribe to the device:
-        LEAPC_CHECK(LeapSubscribeEvents(*connection, devices[deviceCount].device));
-        ++deviceCount;
-      }
+      // Unconditionally subscribe to the device:
+      LEAPC_CHECK(LeapSubscribeEvents(*connection, device.handle));
     }
 
     if (msg.type == eLeapEventType_DeviceLost)
     {
-      LEAP_DEVICE* deviceLost = NULL;
-      for (int i = 0; i < deviceCount; ++i)
+      DeviceSnapshot device;
+      if (GetDeviceSnapshot(devices, msg.device_event->device.id, &device) && device.attached)
       {
-        if (devices[i].id == msg.device_event->device.id)
-        {
-          deviceLost = &devices[i].device;
-        }
+        printf("Unsubscribing from device: %u\n", device.id);
+        LEAPC_CHECK(LeapUnsubscribeEvents(*connection, device.handle));
+        RemoveDevice(devices, device.id);
       }
+    }
 
-      if (deviceLost)
-      {
-        printf("Unsubscribing from device: %u\n", msg.device_event->device.id);
-        LEAPC_CHECK(LeapUnsubscribeEvents(*connection, *deviceLost));
-        LeapCloseDevice(*deviceLost);
-      }
+    if (msg.type == eLeapEventType_DeviceStatusChange)
+    {
+      UpdateDeviceStatus(devices, msg.device_status_change_event);
     }
 
     if (msg.type == eLeapEventType_Tracking)
     {
+      UpdateDeviceFramerate(devices, msg.device_id, msg.tracking_event->framerate);
       if (msg.tracking_event->info.frame_id % 100 == 0)
       {
         printf("Got tracking event for device ID: %u, Tracking Frame ID: %" PRIu64 ", Hand Count: %u\n", msg.device_id, msg.tracking_event->info.frame_id, msg.tracking_event->nHands);
@@ -164,7 +138,7 @@ static ThreadReturnType pollingServiceLoop(void* p)
     }
   }
 
-  free(devices);
+  DestroyDeviceRegistry(devices);
 
 #if defined(_MSC_VER)
   return;
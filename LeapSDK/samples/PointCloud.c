@@ -0,0 +1,690 @@
+/* Point cloud built from LEAP_POINT_MAPPING, with voxel downsampling and a
+ * spatial hash for neighbour queries.
+ *
+ * The cloud finds a point by ID through an open-addressed map and removes
+ * points by moving the last one into the hole, so an update costs time in
+ * proportion to the points it reports. The voxel grid and the spatial hash
+ * both quantize coordinates relative to the cloud's minimum corner, which
+ * keeps cell coordinates non-negative so SIMD truncation is a floor, and then
+ * hash the cell. Voxels are found through a table whose slots are stamped
+ * with the call they were filled in, so it never has to be cleared; the
+ * spatial hash is a counting sort of the points into buckets.
+ *
+ */
+
+#include "PointCloud.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX__)
+  #include <immintrin.h>
+  #define POINT_USE_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define POINT_USE_SSE 1
+#endif
+
+#define MIN_CAPACITY 64
+#define NO_INDEX 0xFFFFFFFFu
+//A query whose bounding box spans more cells than this scans every point instead
+#define MAX_QUERY_CELLS 125
+
+typedef struct _IdSlot {
+  uint32_t id;
+  uint32_t index;                 //NO_INDEX for an empty slot
+} IdSlot;
+
+struct _PointCloud {
+  PointSet        points;
+  uint32_t       *ids;
+  uint32_t       *seen;           //Update that last reported each point
+  IdSlot         *map;            //Twice the point capacity
+  uint32_t        mapMask;
+  uint32_t        update;
+  int64_t         timestamp;
+  LEAP_POINT_MAPPING *mapping;    //Buffer for FetchPointMapping()
+  uint64_t        mappingSize;
+  PointCloudStats stats;
+};
+
+typedef struct _VoxelSlot {
+  int32_t  x, y, z;
+  uint32_t stamp;                 //Call that filled the slot; older slots are empty
+  uint32_t voxel;
+} VoxelSlot;
+
+struct _VoxelGrid {
+  float      inverseSize;
+  PointSet   voxels;              //Centroids
+  float     *sums;                //x, y, z and point count of each voxel, interleaved
+  int32_t   *cells;               //Quantized x, y and z, capacity each
+  uint32_t   cellCapacity;
+  VoxelSlot *table;
+  uint32_t   tableMask;
+  uint32_t   stamp;
+};
+
+struct _SpatialHash {
+  float     cellSize;
+  float     inverseSize;
+  float     origin[3];
+  uint32_t  count;
+  uint32_t  capacity;
+  uint32_t  bucketMask;
+  uint32_t *start;                //Bucket b holds entries start[b] to start[b + 1] - 1
+  uint32_t *cursor;
+  uint32_t *bucket;               //Bucket of each point
+  uint32_t *entries;              //Point indices in bucket order
+  float    *ordered;              //x, y and z in bucket order, capacity each
+  int32_t  *cells;
+};
+
+static uint32_t hashId(uint32_t id){
+  return id * 2654435761u;
+}
+
+/** Tables index by the low bits, so the product is mixed to make them depend on every coordinate bit. */
+static uint32_t hashCell(int32_t x, int32_t y, int32_t z){
+  uint32_t h = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  return h ^ (h >> 13);
+}
+
+static uint32_t roundUpPow2(uint32_t n){
+  uint32_t size = MIN_CAPACITY;
+  while(size < n){
+    size <<= 1;
+  }
+  return size;
+}
+
+/** Enlarges set to hold at least n points, keeping its contents. */
+static bool reservePoints(PointSet *set, uint32_t n){
+  if(n <= set->capacity){
+    return true;
+  }
+  uint32_t capacity = roundUpPow2(n);
+  float *x = realloc(set->x, capacity * sizeof(float));
+  if(x){
+    set->x = x;
+  }
+  float *y = realloc(set->y, capacity * sizeof(float));
+  if(y){
+    set->y = y;
+  }
+  float *z = realloc(set->z, capacity * sizeof(float));
+  if(z){
+    set->z = z;
+  }
+  if(!x || !y || !z){
+    return false;
+  }
+  set->capacity = capacity;
+  return true;
+}
+
+static void freePoints(PointSet *set){
+  free(set->x);
+  free(set->y);
+  free(set->z);
+}
+
+static float minValue(const float *v, uint32_t n){
+  uint32_t i = 0;
+  float result = FLT_MAX;
+#if defined(POINT_USE_AVX)
+  if(n >= 8){
+    __m256 m = _mm256_loadu_ps(v);
+    for(i = 8; i + 8 <= n; i += 8){
+      m = _mm256_min_ps(m, _mm256_loadu_ps(v + i));
+    }
+    __m128 h = _mm_min_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+    h = _mm_min_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_min_ss(h, _mm_shuffle_ps(h, h, 1));
+    result = _mm_cvtss_f32(h);
+  }
+#elif defined(POINT_USE_SSE)
+  if(n >= 4){
+    __m128 m = _mm_loadu_ps(v);
+    for(i = 4; i + 4 <= n; i += 4){
+      m = _mm_min_ps(m, _mm_loadu_ps(v + i));
+    }
+    m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+    result = _mm_cvtss_f32(m);
+  }
+#endif
+  for(; i < n; i++){
+    result = v[i] < result ? v[i] : result;
+  }
+  return result;
+}
+
+/** cells[i] = (v[i] - origin) * inverseSize, truncated; v[i] >= origin so this is the floor. */
+static void quantize(const float *v, uint32_t n, float origin, float inverseSize, int32_t *cells){
+  uint32_t i = 0;
+#if defined(POINT_USE_AVX)
+  __m256 o = _mm256_set1_ps(origin);
+  __m256 s = _mm256_set1_ps(inverseSize);
+  for(; i + 8 <= n; i += 8){
+    __m256 t = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(v + i), o), s);
+    _mm256_storeu_si256((__m256i*)(cells + i), _mm256_cvttps_epi32(t));
+  }
+#elif defined(POINT_USE_SSE)
+  __m128 o = _mm_set1_ps(origin);
+  __m128 s = _mm_set1_ps(inverseSize);
+  for(; i + 4 <= n; i += 4){
+    __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(v + i), o), s);
+    _mm_storeu_si128((__m128i*)(cells + i), _mm_cvttps_epi32(t));
+  }
+#endif
+  for(; i < n; i++){
+    cells[i] = (int32_t)((v[i] - origin) * inverseSize);
+  }
+}
+
+/** Divides each interleaved x, y, z, count sum by its count into the coordinate arrays of voxels. */
+static void centroids(const float *sums, PointSet *voxels){
+  for(uint32_t v = 0; v < voxels->count; v++){
+    const float *sum = sums + 4 * (size_t)v;
+#if defined(POINT_USE_AVX) || defined(POINT_USE_SSE)
+    __m128 s = _mm_loadu_ps(sum);
+    float c[4];
+    _mm_storeu_ps(c, _mm_div_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3))));
+    voxels->x[v] = c[0];
+    voxels->y[v] = c[1];
+    voxels->z[v] = c[2];
+#else
+    voxels->x[v] = sum[0] / sum[3];
+    voxels->y[v] = sum[1] / sum[3];
+    voxels->z[v] = sum[2] / sum[3];
+#endif
+  }
+}
+
+/* Point cloud */
+
+static IdSlot* findId(const PointCloud *cloud, uint32_t id){
+  for(uint32_t i = hashId(id) & cloud->mapMask; ; i = (i + 1) & cloud->mapMask){
+    IdSlot *slot = &cloud->map[i];
+    if(slot->index == NO_INDEX || slot->id == id){
+      return slot;
+    }
+  }
+}
+
+/** Removes slot, shifting later entries of the same probe run back so lookups need no tombstones. */
+static void removeId(PointCloud *cloud, IdSlot *slot){
+  uint32_t mask = cloud->mapMask;
+  uint32_t hole = (uint32_t)(slot - cloud->map);
+  cloud->map[hole].index = NO_INDEX;
+  for(uint32_t i = (hole + 1) & mask; cloud->map[i].index != NO_INDEX; i = (i + 1) & mask){
+    uint32_t home = hashId(cloud->map[i].id) & mask;
+    //Move the entry into the hole unless its home lies cyclically in (hole, i]
+    bool stays = hole <= i ? (home > hole && home <= i) : (home > hole || home <= i);
+    if(!stays){
+      cloud->map[hole] = cloud->map[i];
+      cloud->map[i].index = NO_INDEX;
+      hole = i;
+    }
+  }
+}
+
+/** Grows the cloud to hold n points and rebuilds the ID map for the new size. */
+static bool growCloud(PointCloud *cloud, uint32_t n){
+  if(n <= cloud->points.capacity && cloud->map){
+    return true;
+  }
+  //Arrays that were enlarged before a failure are kept; capacity only changes once all have been
+  uint32_t capacity = roundUpPow2(n);
+  float *x = realloc(cloud->points.x, capacity * sizeof(float));
+  if(x){
+    cloud->points.x = x;
+  }
+  float *y = realloc(cloud->points.y, capacity * sizeof(float));
+  if(y){
+    cloud->points.y = y;
+  }
+  float *z = realloc(cloud->points.z, capacity * sizeof(float));
+  if(z){
+    cloud->points.z = z;
+  }
+  uint32_t *ids = realloc(cloud->ids, capacity * sizeof(uint32_t));
+  if(ids){
+    cloud->ids = ids;
+  }
+  uint32_t *seen = realloc(cloud->seen, capacity * sizeof(uint32_t));
+  if(seen){
+    cloud->seen = seen;
+  }
+  IdSlot *map = malloc(2 * (size_t)capacity * sizeof(IdSlot));
+  if(!x || !y || !z || !ids || !seen || !map){
+    free(map);
+    return false;
+  }
+  cloud->points.capacity = capacity;
+  free(cloud->map);
+  cloud->map = map;
+  cloud->mapMask = 2 * capacity - 1;
+  for(uint32_t i = 0; i <= cloud->mapMask; i++){
+    map[i].index = NO_INDEX;
+  }
+  for(uint32_t i = 0; i < cloud->points.count; i++){
+    IdSlot *slot = findId(cloud, cloud->ids[i]);
+    slot->id = cloud->ids[i];
+    slot->index = i;
+  }
+  cloud->stats.grows++;
+  return true;
+}
+
+/** capacity is a hint; the cloud grows to fit the largest mapping it is given. */
+PointCloud* CreatePointCloud(uint32_t capacity){
+  PointCloud *cloud = calloc(1, sizeof(PointCloud));
+  if(!cloud){
+    return NULL;
+  }
+  if(!growCloud(cloud, capacity)){
+    DestroyPointCloud(cloud);
+    return NULL;
+  }
+  cloud->stats.grows = 0;
+  return cloud;
+}
+
+void DestroyPointCloud(PointCloud *cloud){
+  if(!cloud){
+    return;
+  }
+  freePoints(&cloud->points);
+  free(cloud->ids);
+  free(cloud->seen);
+  free(cloud->map);
+  free(cloud->mapping);
+  free(cloud);
+}
+
+/**
+ * Reads the service's current point mapping into the cloud. The mapping
+ * buffer is kept and only enlarged when the service reports more points.
+ */
+eLeapRS FetchPointMapping(PointCloud *cloud, LEAP_CONNECTION connection){
+  uint64_t size = 0;
+  eLeapRS result = LeapGetPointMappingSize(connection, &size);
+  if(result != eLeapRS_Success){
+    return result;
+  }
+  if(size < sizeof(LEAP_POINT_MAPPING)){
+    return eLeapRS_NotAvailable;
+  }
+  if(size > cloud->mappingSize){
+    LEAP_POINT_MAPPING *mapping = realloc(cloud->mapping, (size_t)size);
+    if(!mapping){
+      return eLeapRS_InsufficientResources;
+    }
+    cloud->mapping = mapping;
+    cloud->mappingSize = size;
+  }
+  size = cloud->mappingSize;
+  result = LeapGetPointMapping(connection, cloud->mapping, &size);
+  if(result == eLeapRS_Success && !UpdatePointCloud(cloud, cloud->mapping)){
+    result = eLeapRS_InsufficientResources;
+  }
+  return result;
+}
+
+/**
+ * Makes the cloud hold exactly the points of mapping: points whose ID the
+ * cloud already has are moved, new IDs are appended and IDs not in mapping
+ * are removed. Returns false, leaving the cloud unchanged, if it cannot grow.
+ */
+bool UpdatePointCloud(PointCloud *cloud, const LEAP_POINT_MAPPING *mapping){
+  PointSet *points = &cloud->points;
+  uint32_t n = mapping->nPoints;
+  if(!growCloud(cloud, points->count + n)){
+    return false;
+  }
+  uint32_t update = ++cloud->update;
+  for(uint32_t i = 0; i < n; i++){
+    uint32_t id = mapping->pIDs ? mapping->pIDs[i] : i;
+    const LEAP_VECTOR *p = &mapping->pPoints[i];
+    IdSlot *slot = findId(cloud, id);
+    uint32_t index = slot->index;
+    if(index == NO_INDEX){
+      index = points->count++;
+      slot->id = id;
+      slot->index = index;
+      cloud->ids[index] = id;
+      cloud->stats.added++;
+    } else if(points->x[index] != p->x || points->y[index] != p->y || points->z[index] != p->z){
+      cloud->stats.moved++;
+    }
+    points->x[index] = p->x;
+    points->y[index] = p->y;
+    points->z[index] = p->z;
+    cloud->seen[index] = update;
+  }
+
+  for(uint32_t i = 0; i < points->count; ){
+    if(cloud->seen[i] == update){
+      i++;
+      continue;
+    }
+    removeId(cloud, findId(cloud, cloud->ids[i]));
+    uint32_t last = --points->count;
+    if(i != last){
+      points->x[i] = points->x[last];
+      points->y[i] = points->y[last];
+      points->z[i] = points->z[last];
+      cloud->ids[i] = cloud->ids[last];
+      cloud->seen[i] = cloud->seen[last];
+      findId(cloud, cloud->ids[i])->index = i;
+    }
+    cloud->stats.removed++;
+  }
+  cloud->timestamp = mapping->timestamp;
+  cloud->stats.updates++;
+  return true;
+}
+
+const PointSet* GetCloudPoints(const PointCloud *cloud){
+  return &cloud->points;
+}
+
+/** The pID of each point, in the same order as GetCloudPoints(). */
+const uint32_t* GetCloudPointIds(const PointCloud *cloud){
+  return cloud->ids;
+}
+
+/** Timestamp of the last mapping applied, referenced against LeapGetNow(). */
+int64_t GetCloudTimestamp(const PointCloud *cloud){
+  return cloud->timestamp;
+}
+
+void GetPointCloudStats(const PointCloud *cloud, PointCloudStats *stats){
+  *stats = cloud->stats;
+}
+
+/* Voxel grid */
+
+VoxelGrid* CreateVoxelGrid(float voxel_size){
+  VoxelGrid *grid = calloc(1, sizeof(VoxelGrid));
+  if(grid){
+    grid->inverseSize = 1.0f / voxel_size;
+  }
+  return grid;
+}
+
+void DestroyVoxelGrid(VoxelGrid *grid){
+  if(!grid){
+    return;
+  }
+  freePoints(&grid->voxels);
+  free(grid->sums);
+  free(grid->cells);
+  free(grid->table);
+  free(grid);
+}
+
+static bool reserveVoxels(VoxelGrid *grid, uint32_t n){
+  if(n > grid->cellCapacity){
+    uint32_t capacity = roundUpPow2(n);
+    int32_t *cells = malloc(3 * (size_t)capacity * sizeof(int32_t));
+    VoxelSlot *table = calloc(2 * (size_t)capacity, sizeof(VoxelSlot));
+    if(!cells || !table){
+      free(cells);
+      free(table);
+      return false;
+    }
+    free(grid->cells);
+    free(grid->table);
+    grid->cells = cells;
+    grid->table = table;
+    grid->tableMask = 2 * capacity - 1;
+    grid->cellCapacity = capacity;
+    grid->stamp = 0;
+  }
+  uint32_t voxelCapacity = grid->voxels.capacity;
+  if(!reservePoints(&grid->voxels, n)){
+    return false;
+  }
+  if(grid->voxels.capacity != voxelCapacity || !grid->sums){
+    float *sums = realloc(grid->sums, 4 * (size_t)grid->voxels.capacity * sizeof(float));
+    if(!sums){
+      return false;
+    }
+    grid->sums = sums;
+  }
+  return true;
+}
+
+/**
+ * Returns one point per occupied voxel, at the centroid of the points in it.
+ * Returns NULL if the grid's buffers cannot grow to the size of points.
+ */
+const PointSet* DownsamplePoints(VoxelGrid *grid, const PointSet *points){
+  uint32_t n = points->count;
+  if(!reserveVoxels(grid, n)){
+    return NULL;
+  }
+  PointSet *voxels = &grid->voxels;
+  voxels->count = 0;
+  if(n == 0){
+    return voxels;
+  }
+  if(++grid->stamp == 0){
+    memset(grid->table, 0, ((size_t)grid->tableMask + 1) * sizeof(VoxelSlot));
+    grid->stamp = 1;
+  }
+
+  int32_t *cx = grid->cells;
+  int32_t *cy = cx + grid->cellCapacity;
+  int32_t *cz = cy + grid->cellCapacity;
+  quantize(points->x, n, minValue(points->x, n), grid->inverseSize, cx);
+  quantize(points->y, n, minValue(points->y, n), grid->inverseSize, cy);
+  quantize(points->z, n, minValue(points->z, n), grid->inverseSize, cz);
+
+  uint32_t stamp = grid->stamp;
+  for(uint32_t i = 0; i < n; i++){
+    uint32_t h = hashCell(cx[i], cy[i], cz[i]) & grid->tableMask;
+    VoxelSlot *slot = &grid->table[h];
+    while(slot->stamp == stamp && (slot->x != cx[i] || slot->y != cy[i] || slot->z != cz[i])){
+      h = (h + 1) & grid->tableMask;
+      slot = &grid->table[h];
+    }
+    //Keeping a voxel's sums together costs one cache miss per point instead of four
+    float *sum;
+    if(slot->stamp != stamp){
+      uint32_t v = voxels->count++;
+      slot->x = cx[i];
+      slot->y = cy[i];
+      slot->z = cz[i];
+      slot->stamp = stamp;
+      slot->voxel = v;
+      sum = grid->sums + 4 * (size_t)v;
+      sum[0] = sum[1] = sum[2] = sum[3] = 0.0f;
+    } else {
+      sum = grid->sums + 4 * (size_t)slot->voxel;
+    }
+    sum[0] += points->x[i];
+    sum[1] += points->y[i];
+    sum[2] += points->z[i];
+    sum[3] += 1.0f;
+  }
+  centroids(grid->sums, voxels);
+  return voxels;
+}
+
+/* Spatial hash */
+
+/** Queries are fastest with cell_size close to the usual query radius. */
+SpatialHash* CreateSpatialHash(float cell_size){
+  SpatialHash *hash = calloc(1, sizeof(SpatialHash));
+  if(hash){
+    hash->cellSize = cell_size;
+    hash->inverseSize = 1.0f / cell_size;
+  }
+  return hash;
+}
+
+void DestroySpatialHash(SpatialHash *hash){
+  if(!hash){
+    return;
+  }
+  free(hash->start);
+  free(hash->cursor);
+  free(hash->bucket);
+  free(hash->entries);
+  free(hash->ordered);
+  free(hash->cells);
+  free(hash);
+}
+
+static bool reserveHash(SpatialHash *hash, uint32_t n){
+  if(n <= hash->capacity && hash->start){
+    return true;
+  }
+  uint32_t capacity = roundUpPow2(n);
+  uint32_t *start = malloc(((size_t)capacity + 1) * sizeof(uint32_t));
+  uint32_t *cursor = malloc((size_t)capacity * sizeof(uint32_t));
+  uint32_t *bucket = malloc((size_t)capacity * sizeof(uint32_t));
+  uint32_t *entries = malloc((size_t)capacity * sizeof(uint32_t));
+  float *ordered = malloc(3 * (size_t)capacity * sizeof(float));
+  int32_t *cells = malloc(3 * (size_t)capacity * sizeof(int32_t));
+  if(!start || !cursor || !bucket || !entries || !ordered || !cells){
+    free(start);
+    free(cursor);
+    free(bucket);
+    free(entries);
+    free(ordered);
+    free(cells);
+    return false;
+  }
+  free(hash->start);
+  free(hash->cursor);
+  free(hash->bucket);
+  free(hash->entries);
+  free(hash->ordered);
+  free(hash->cells);
+  hash->start = start;
+  hash->cursor = cursor;
+  hash->bucket = bucket;
+  hash->entries = entries;
+  hash->ordered = ordered;
+  hash->cells = cells;
+  hash->capacity = capacity;
+  hash->bucketMask = capacity - 1;
+  return true;
+}
+
+/** Buckets points, which need not outlive the hash: their coordinates are copied. */
+bool BuildSpatialHash(SpatialHash *hash, const PointSet *points){
+  uint32_t n = points->count;
+  if(!reserveHash(hash, n)){
+    return false;
+  }
+  hash->count = n;
+  if(n == 0){
+    return true;
+  }
+  uint32_t capacity = hash->capacity;
+  int32_t *cx = hash->cells;
+  int32_t *cy = cx + capacity;
+  int32_t *cz = cy + capacity;
+  hash->origin[0] = minValue(points->x, n);
+  hash->origin[1] = minValue(points->y, n);
+  hash->origin[2] = minValue(points->z, n);
+  quantize(points->x, n, hash->origin[0], hash->inverseSize, cx);
+  quantize(points->y, n, hash->origin[1], hash->inverseSize, cy);
+  quantize(points->z, n, hash->origin[2], hash->inverseSize, cz);
+
+  //Counting sort of the points by bucket
+  memset(hash->start, 0, ((size_t)hash->bucketMask + 2) * sizeof(uint32_t));
+  for(uint32_t i = 0; i < n; i++){
+    uint32_t b = hashCell(cx[i], cy[i], cz[i]) & hash->bucketMask;
+    hash->bucket[i] = b;
+    hash->start[b + 1]++;
+  }
+  for(uint32_t b = 0; b <= hash->bucketMask; b++){
+    hash->start[b + 1] += hash->start[b];
+    hash->cursor[b] = hash->start[b];
+  }
+  float *ox = hash->ordered;
+  float *oy = ox + capacity;
+  float *oz = oy + capacity;
+  for(uint32_t i = 0; i < n; i++){
+    uint32_t slot = hash->cursor[hash->bucket[i]]++;
+    hash->entries[slot] = i;
+    ox[slot] = points->x[i];
+    oy[slot] = points->y[i];
+    oz[slot] = points->z[i];
+  }
+  return true;
+}
+
+/** Tests entries first to last against the sphere, writing matches while there is room. */
+static uint32_t collectInRange(const SpatialHash *hash, uint32_t first, uint32_t last, LEAP_VECTOR centre,
+                               float radius2, uint32_t *indices, uint32_t max_indices, uint32_t found){
+  const float *ox = hash->ordered;
+  const float *oy = ox + hash->capacity;
+  const float *oz = oy + hash->capacity;
+  for(uint32_t j = first; j < last; j++){
+    float dx = ox[j] - centre.x, dy = oy[j] - centre.y, dz = oz[j] - centre.z;
+    if(dx * dx + dy * dy + dz * dz <= radius2){
+      if(found < max_indices){
+        indices[found] = hash->entries[j];
+      }
+      found++;
+    }
+  }
+  return found;
+}
+
+/**
+ * Finds the points within radius of centre. Writes up to max_indices of them
+ * and returns how many there are in total.
+ */
+uint32_t QueryNeighbours(const SpatialHash *hash, LEAP_VECTOR centre, float radius,
+                         uint32_t *indices, uint32_t max_indices){
+  if(hash->count == 0){
+    return 0;
+  }
+  float radius2 = radius * radius;
+  int32_t lo[3], hi[3];
+  const float c[3] = { centre.x, centre.y, centre.z };
+  for(int a = 0; a < 3; a++){
+    lo[a] = (int32_t)floorf((c[a] - radius - hash->origin[a]) * hash->inverseSize);
+    hi[a] = (int32_t)floorf((c[a] + radius - hash->origin[a]) * hash->inverseSize);
+  }
+  int64_t cellCount = (int64_t)(hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+  if(cellCount > MAX_QUERY_CELLS || cellCount > hash->bucketMask){
+    return collectInRange(hash, 0, hash->count, centre, radius2, indices, max_indices, 0);
+  }
+
+  //Neighbouring cells can share a bucket; each bucket is searched once
+  uint32_t visited[MAX_QUERY_CELLS];
+  uint32_t nVisited = 0;
+  uint32_t found = 0;
+  for(int32_t x = lo[0]; x <= hi[0]; x++){
+    for(int32_t y = lo[1]; y <= hi[1]; y++){
+      for(int32_t z = lo[2]; z <= hi[2]; z++){
+        uint32_t b = hashCell(x, y, z) & hash->bucketMask;
+        uint32_t v = 0;
+        while(v < nVisited && visited[v] != b){
+          v++;
+        }
+        if(v < nVisited){
+          continue;
+        }
+        visited[nVisited++] = b;
+        found = collectInRange(hash, hash->start[b], hash->start[b + 1], centre, radius2,
+                               indices, max_indices, found);
+      }
+    }
+  }
+  return found;
+}
+//End-of-PointCloud.c
@@ -0,0 +1,76 @@
+/* Point cloud built from LEAP_POINT_MAPPING, with voxel downsampling and a
+ * spatial hash for neighbour queries.
+ *
+ * A PointCloud keeps the mapped points between updates, indexed by their
+ * pIDs: each update moves the points it still reports, appends new ones and
+ * removes the ones it no longer reports, so a point keeps its ID and the
+ * buffers are only grown, never reallocated per update. Points are stored as
+ * separate x, y and z arrays so the downsampler and the spatial hash can
+ * process several at a time with SIMD.
+ *
+ * VoxelGrid replaces all points falling in one cube of voxel_size
+ * millimetres by their centroid. SpatialHash buckets points by a cubic cell
+ * and answers radius queries by visiting only the neighbouring cells. Both
+ * keep their buffers between calls, so running them every frame does not
+ * allocate once the cloud has reached its working size.
+ *
+ * Point mapping went away with LeapC 5.0: from then on LeapGetPointMapping()
+ * is kept only for API compatibility, listed under "Not Supported" in
+ * LeapC.h, and eLeapEventType_PointMappingChange is no longer generated.
+ * FetchPointMapping() then fails without touching the cloud.
+ * UpdatePointCloud() accepts a LEAP_POINT_MAPPING filled from any other
+ * source of tracked points.
+ *
+ */
+
+#ifndef PointCloud_h
+#define PointCloud_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Points as three coordinate arrays; x[i], y[i], z[i] is point i. */
+typedef struct _PointSet {
+  uint32_t count;
+  uint32_t capacity;
+  float   *x;
+  float   *y;
+  float   *z;
+} PointSet;
+
+typedef struct _PointCloudStats {
+  uint64_t updates;
+  uint64_t added;
+  uint64_t removed;
+  uint64_t moved;
+  uint32_t grows;                 //Times the buffers had to be enlarged
+} PointCloudStats;
+
+typedef struct _PointCloud PointCloud;
+typedef struct _VoxelGrid VoxelGrid;
+typedef struct _SpatialHash SpatialHash;
+
+/* Point cloud functions */
+PointCloud* CreatePointCloud(uint32_t capacity);
+void DestroyPointCloud(PointCloud *cloud);
+eLeapRS FetchPointMapping(PointCloud *cloud, LEAP_CONNECTION connection);
+bool UpdatePointCloud(PointCloud *cloud, const LEAP_POINT_MAPPING *mapping);
+const PointSet* GetCloudPoints(const PointCloud *cloud);
+const uint32_t* GetCloudPointIds(const PointCloud *cloud);
+int64_t GetCloudTimestamp(const PointCloud *cloud);
+void GetPointCloudStats(const PointCloud *cloud, PointCloudStats *stats);
+
+/* Voxel-grid downsampling; the returned set is owned by the grid and valid until the next call. */
+VoxelGrid* CreateVoxelGrid(float voxel_size);
+void DestroyVoxelGrid(VoxelGrid *grid);
+const PointSet* DownsamplePoints(VoxelGrid *grid, const PointSet *points);
+
+/* Spatial hash; indices returned by queries refer to the set it was built from. */
+SpatialHash* CreateSpatialHash(float cell_size);
+void DestroySpatialHash(SpatialHash *hash);
+bool BuildSpatialHash(SpatialHash *hash, const PointSet *points);
+uint32_t QueryNeighbours(const SpatialHash *hash, LEAP_VECTOR centre, float radius,
+                         uint32_t *indices, uint32_t max_indices);
+
+#endif /* PointCloud_h */
@@ -0,0 +1,144 @@
+/* Times the point-cloud pipeline on a synthetic scene: applying a point
+ * mapping update, voxel downsampling, building the spatial hash and radius
+ * queries, and checks the queries against a brute-force scan.
+ *
+ * The scene is points scattered over a few surfaces in front of the device.
+ * Each update jitters every point slightly and replaces a small share of them
+ * with new IDs, like a tracker that keeps most points between frames. No
+ * device is required.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "PointCloud.h"
+
+#define POINT_COUNT 30000
+#define UPDATES 200
+#define REPLACED_PER_UPDATE 1500
+#define VOXEL_SIZE 5.0f
+#define QUERY_RADIUS 10.0f
+#define QUERY_COUNT 2000
+#define MAX_NEIGHBOURS 4096
+
+static float randomUnit(void){
+  return (float)rand() / (float)RAND_MAX;
+}
+
+/** A point on one of three planes: a table top, a back wall and a side wall, in millimetres. */
+static LEAP_VECTOR randomScenePoint(void){
+  LEAP_VECTOR p;
+  float u = (randomUnit() - 0.5f) * 400.0f, v = randomUnit() * 400.0f;
+  switch(rand() % 3){
+    case 0:  p.x = u;       p.y = 0.0f;   p.z = -v;      break;
+    case 1:  p.x = u;       p.y = v;      p.z = -400.0f; break;
+    default: p.x = -200.0f; p.y = v;      p.z = u;       break;
+  }
+  return p;
+}
+
+static uint32_t bruteForceCount(const PointSet *points, LEAP_VECTOR c, float radius){
+  uint32_t found = 0;
+  for(uint32_t i = 0; i < points->count; i++){
+    float dx = points->x[i] - c.x, dy = points->y[i] - c.y, dz = points->z[i] - c.z;
+    found += dx * dx + dy * dy + dz * dz <= radius * radius;
+  }
+  return found;
+}
+
+int main(int argc, char** argv) {
+  srand(42);
+  LEAP_VECTOR *positions = malloc(POINT_COUNT * sizeof(LEAP_VECTOR));
+  uint32_t *ids = malloc(POINT_COUNT * sizeof(uint32_t));
+  uint32_t *neighbours = malloc(MAX_NEIGHBOURS * sizeof(uint32_t));
+  PointCloud *cloud = CreatePointCloud(POINT_COUNT);
+  VoxelGrid *grid = CreateVoxelGrid(VOXEL_SIZE);
+  SpatialHash *hash = CreateSpatialHash(QUERY_RADIUS);
+  if(!positions || !ids || !neighbours || !cloud || !grid || !hash){
+    printf("Failed to allocate the point cloud.\n");
+    return 1;
+  }
+  uint32_t nextId = 0;
+  for(uint32_t i = 0; i < POINT_COUNT; i++){
+    positions[i] = randomScenePoint();
+    ids[i] = nextId++;
+  }
+
+  LEAP_POINT_MAPPING mapping;
+  memset(&mapping, 0, sizeof(mapping));
+  mapping.nPoints = POINT_COUNT;
+  mapping.pPoints = positions;
+  mapping.pIDs = ids;
+
+  int64_t updateTime = 0, downsampleTime = 0, buildTime = 0;
+  const PointSet *voxels = NULL;
+  for(int u = 0; u < UPDATES; u++){
+    for(uint32_t i = 0; i < POINT_COUNT; i++){
+      positions[i].x += (randomUnit() - 0.5f) * 0.2f;
+    }
+    for(uint32_t r = 0; r < REPLACED_PER_UPDATE; r++){
+      uint32_t i = (uint32_t)rand() % POINT_COUNT;
+      positions[i] = randomScenePoint();
+      ids[i] = nextId++;
+    }
+    mapping.frame_id = u;
+    mapping.timestamp = LeapGetNow();
+
+    int64_t start = LeapGetNow();
+    UpdatePointCloud(cloud, &mapping);
+    int64_t updated = LeapGetNow();
+    voxels = DownsamplePoints(grid, GetCloudPoints(cloud));
+    int64_t downsampled = LeapGetNow();
+    BuildSpatialHash(hash, voxels);
+    int64_t built = LeapGetNow();
+    updateTime += updated - start;
+    downsampleTime += downsampled - updated;
+    buildTime += built - downsampled;
+  }
+
+  uint32_t agree = 0;
+  uint64_t totalFound = 0;
+  int64_t start = LeapGetNow();
+  for(uint32_t q = 0; q < QUERY_COUNT; q++){
+    uint32_t v = (uint32_t)rand() % voxels->count;
+    LEAP_VECTOR centre = { { { voxels->x[v], voxels->y[v], voxels->z[v] } } };
+    totalFound += QueryNeighbours(hash, centre, QUERY_RADIUS, neighbours, MAX_NEIGHBOURS);
+  }
+  int64_t queryTime = LeapGetNow() - start;
+
+  start = LeapGetNow();
+  srand(7);
+  for(uint32_t q = 0; q < QUERY_COUNT; q++){
+    uint32_t v = (uint32_t)rand() % voxels->count;
+    LEAP_VECTOR centre = { { { voxels->x[v], voxels->y[v], voxels->z[v] } } };
+    agree += bruteForceCount(voxels, centre, QUERY_RADIUS) ==
+             QueryNeighbours(hash, centre, QUERY_RADIUS, neighbours, MAX_NEIGHBOURS);
+  }
+  int64_t bruteTime = LeapGetNow() - start;
+
+  PointCloudStats stats;
+  GetPointCloudStats(cloud, &stats);
+  printf("%u points, %u updates replacing %u points each\n", POINT_COUNT, UPDATES, REPLACED_PER_UPDATE);
+  printf("  update      %8.1f us/frame (added %llu, removed %llu, moved %llu, grows %u)\n",
+         (double)updateTime / UPDATES, (unsigned long long)stats.added, (unsigned long long)stats.removed,
+         (unsigned long long)stats.moved, stats.grows);
+  printf("  downsample  %8.1f us/frame to %u voxels of %.0f mm\n",
+         (double)downsampleTime / UPDATES, voxels->count, VOXEL_SIZE);
+  printf("  hash build  %8.1f us/frame\n", (double)buildTime / UPDATES);
+  printf("  query       %8.2f us/query, %.1f neighbours within %.0f mm\n",
+         (double)queryTime / QUERY_COUNT, (double)totalFound / QUERY_COUNT, QUERY_RADIUS);
+  printf("  brute force %8.2f us/query, %.1f%% agree\n",
+         (double)bruteTime / QUERY_COUNT, 100.0 * agree / QUERY_COUNT);
+
+  DestroySpatialHash(hash);
+  DestroyVoxelGrid(grid);
+  DestroyPointCloud(cloud);
+  free(neighbours);
+  free(ids);
+  free(positions);
+  return 0;
+}
+//End-of-Sample
@@ -23,17 +23,16 @@ int64_t lastFrameID = 0; //The last frame received
 
 int main(int argc, char** argv) {
   OpenConnection();
-  while(!IsConnected)
-    millisleep(100); //wait a bit to let the connection complete
+  WaitForConnection(WAIT_INFINITE);
 
   printf("Connected.");
-  LEAP_DEVICE_INFO* deviceProps = GetDeviceProperties();
+  LEAP_DEVICE_INFO* deviceProps = WaitForDevice(1000); //the device event usually follows the connection
   if(deviceProps)
     printf("Using device %s.\n", deviceProps->serial);
 
   for(;;){
-    LEAP_TRACKING_EVENT *frame = GetFrame();
-    if(frame && (frame->tracking_frame_id > lastFrameID)){
+    LEAP_TRACKING_EVENT *frame = WaitForFrame(lastFrameID, 1000); //sleeps until the next frame arrives
+    if(frame){
       lastFrameID = frame->tracking_frame_id;
       printf("Frame %lli with %i hands.\n", (long long int)frame->tracking_frame_id, frame->nHands);
       for(uint32_t h = 0; h < frame->nHands; h++){
@@ -0,0 +1,391 @@
+/* Static hand-pose database and nearest-neighbour index.
+ *
+ * The index is a k-d tree over the feature vectors. Poses are copied into
+ * tree order when the index is built so each leaf is one contiguous block that
+ * the SIMD distance kernel streams through.
+ *
+ */
+
+#include "PoseIndex.h"
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX__)
+  #include <immintrin.h>
+  #define POSE_USE_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define POSE_USE_SSE 1
+#endif
+
+//Number of poses held by a leaf before it is split.
+#define POSE_LEAF_SIZE 16
+//Only the leading dimensions carry joint data; the rest is zero padding.
+#define POSE_ACTIVE_DIM (POSE_JOINT_COUNT * 3)
+
+typedef struct _PoseNode {
+  uint32_t begin;   //First slot in tree order
+  uint32_t count;   //Number of slots covered
+  int32_t  left;    //Child indices, -1 for leaves
+  int32_t  right;
+  uint32_t dim;     //Split dimension
+  float    split;   //Split value
+} PoseNode;
+
+struct _PoseDatabase {
+  uint32_t  capacity;
+  uint32_t  count;
+  float    *features;  //Insertion order, count x POSE_FEATURE_DIM
+  uint32_t *labels;
+  float    *ordered;   //Tree order copy of features
+  uint32_t *order;     //Tree slot -> insertion index
+  PoseNode *nodes;
+  uint32_t  nodeCount;
+  bool      indexed;
+};
+
+typedef struct _PoseBest {
+  PoseMatch *matches;
+  uint32_t   k;
+  uint32_t   n;
+} PoseBest;
+
+static float squaredDistance(const float *a, const float *b){
+#if defined(POSE_USE_AVX)
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  for(int i = 0; i < POSE_FEATURE_DIM; i += 16){
+    __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+    __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+    acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(d0, d0));
+    acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(d1, d1));
+  }
+  acc0 = _mm256_add_ps(acc0, acc1);
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+#elif defined(POSE_USE_SSE)
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  for(int i = 0; i < POSE_FEATURE_DIM; i += 8){
+    __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+    __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+  }
+  acc0 = _mm_add_ps(acc0, acc1);
+  acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+  acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+  return _mm_cvtss_f32(acc0);
+#else
+  float sum = 0.0f;
+  for(int i = 0; i < POSE_FEATURE_DIM; i++){
+    float d = a[i] - b[i];
+    sum += d * d;
+  }
+  return sum;
+#endif
+}
+
+static float worstDistance(const PoseBest *best){
+  return best->n < best->k ? FLT_MAX : best->matches[best->k - 1].distance;
+}
+
+/** Inserts a candidate into the sorted k-best list if it is close enough. */
+static void offerMatch(PoseBest *best, uint32_t index, uint32_t label, float distance){
+  if(distance >= worstDistance(best)){
+    return;
+  }
+  uint32_t i = best->n < best->k ? best->n++ : best->k - 1;
+  while(i > 0 && best->matches[i - 1].distance > distance){
+    best->matches[i] = best->matches[i - 1];
+    i--;
+  }
+  best->matches[i].index = index;
+  best->matches[i].label = label;
+  best->matches[i].distance = distance;
+}
+
+PoseDatabase* CreatePoseDatabase(uint32_t capacity){
+  PoseDatabase *db = calloc(1, sizeof(PoseDatabase));
+  if(!db){
+    return NULL;
+  }
+  db->capacity = capacity;
+  db->features = malloc((size_t)capacity * POSE_FEATURE_DIM * sizeof(float));
+  db->labels = malloc((size_t)capacity * sizeof(uint32_t));
+  if(!db->features || !db->labels){
+    DestroyPoseDatabase(db);
+    return NULL;
+  }
+  return db;
+}
+
+void DestroyPoseDatabase(PoseDatabase *db){
+  if(!db){
+    return;
+  }
+  free(db->features);
+  free(db->labels);
+  free(db->ordered);
+  free(db->order);
+  free(db->nodes);
+  free(db);
+}
+
+/**
+ * Converts a hand into a feature vector: the knuckle and the three distal
+ * joints of each digit, expressed in the palm basis
+ * {normal x direction, -normal, -direction} and divided by the palm width.
+ */
+void NormalizeHandPose(const LEAP_HAND *hand, float feature[POSE_FEATURE_DIM]){
+  const LEAP_VECTOR *n = &hand->palm.normal;
+  const LEAP_VECTOR *d = &hand->palm.direction;
+  float axes[3][3] = {
+    { n->y * d->z - n->z * d->y, n->z * d->x - n->x * d->z, n->x * d->y - n->y * d->x },
+    { -n->x, -n->y, -n->z },
+    { -d->x, -d->y, -d->z }
+  };
+  float scale = hand->palm.width > 0.0f ? 1.0f / hand->palm.width : 1.0f;
+  if(hand->type == eLeapHandType_Left){
+    for(int c = 0; c < 3; c++){
+      axes[0][c] = -axes[0][c];
+    }
+  }
+
+  float *out = feature;
+  for(int f = 0; f < 5; f++){
+    const LEAP_DIGIT *digit = &hand->digits[f];
+    const LEAP_VECTOR *joints[4] = {
+      &digit->proximal.prev_joint,
+      &digit->proximal.next_joint,
+      &digit->intermediate.next_joint,
+      &digit->distal.next_joint
+    };
+    for(int j = 0; j < 4; j++){
+      float rel[3] = {
+        joints[j]->x - hand->palm.position.x,
+        joints[j]->y - hand->palm.position.y,
+        joints[j]->z - hand->palm.position.z
+      };
+      for(int a = 0; a < 3; a++){
+        *out++ = scale * (axes[a][0] * rel[0] + axes[a][1] * rel[1] + axes[a][2] * rel[2]);
+      }
+    }
+  }
+  memset(out, 0, (POSE_FEATURE_DIM - POSE_ACTIVE_DIM) * sizeof(float));
+}
+
+/** Appends a pose. Invalidates the index until BuildPoseIndex() is called again. */
+bool AddPose(PoseDatabase *db, const float feature[POSE_FEATURE_DIM], uint32_t label){
+  if(db->count == db->capacity){
+    return false;
+  }
+  memcpy(db->features + (size_t)db->count * POSE_FEATURE_DIM, feature, POSE_FEATURE_DIM * sizeof(float));
+  db->labels[db->count] = label;
+  db->count++;
+  db->indexed = false;
+  return true;
+}
+
+uint32_t GetPoseCount(const PoseDatabase *db){
+  return db->count;
+}
+
+static float featureValue(const PoseDatabase *db, uint32_t index, uint32_t dim){
+  return db->features[(size_t)index * POSE_FEATURE_DIM + dim];
+}
+
+/**
+ * Partially sorts order[begin, end) so that order[nth] holds its value along
+ * dim. Partitions three ways, so runs of equal values, common in recorded
+ * poses, are settled in one pass rather than one element at a time.
+ */
+static void selectNth(PoseDatabase *db, uint32_t begin, uint32_t end, uint32_t nth, uint32_t dim){
+  uint32_t *order = db->order;
+  while(end - begin > 1){
+    float pivot = featureValue(db, order[begin + (end - begin) / 2], dim);
+    //[begin, less) < pivot, [less, i) == pivot, [greater, end) > pivot
+    uint32_t less = begin, i = begin, greater = end;
+    while(i < greater){
+      float value = featureValue(db, order[i], dim);
+      uint32_t tmp = order[i];
+      if(value < pivot){
+        order[i++] = order[less];
+        order[less++] = tmp;
+      } else if(value > pivot){
+        order[i] = order[--greater];
+        order[greater] = tmp;
+      } else {
+        i++;
+      }
+    }
+    if(nth < less){
+      end = less;
+    } else if(nth >= greater){
+      begin = greater;
+    } else {
+      return;
+    }
+  }
+}
+
+static int32_t buildNode(PoseDatabase *db, uint32_t begin, uint32_t count){
+  int32_t id = (int32_t)db->nodeCount++;
+  PoseNode *node = &db->nodes[id];
+  node->begin = begin;
+  node->count = count;
+  node->left = node->right = -1;
+  if(count <= POSE_LEAF_SIZE){
+    return id;
+  }
+
+  //Split along the dimension with the largest spread
+  float lo[POSE_ACTIVE_DIM], hi[POSE_ACTIVE_DIM];
+  for(uint32_t d = 0; d < POSE_ACTIVE_DIM; d++){
+    lo[d] = FLT_MAX;
+    hi[d] = -FLT_MAX;
+  }
+  for(uint32_t i = begin; i < begin + count; i++){
+    const float *f = db->features + (size_t)db->order[i] * POSE_FEATURE_DIM;
+    for(uint32_t d = 0; d < POSE_ACTIVE_DIM; d++){
+      if(f[d] < lo[d]) lo[d] = f[d];
+      if(f[d] > hi[d]) hi[d] = f[d];
+    }
+  }
+  uint32_t dim = 0;
+  for(uint32_t d = 1; d < POSE_ACTIVE_DIM; d++){
+    if(hi[d] - lo[d] > hi[dim] - lo[dim]){
+      dim = d;
+    }
+  }
+
+  uint32_t half = count / 2;
+  selectNth(db, begin, begin + count, begin + half, dim);
+  float split = featureValue(db, db->order[begin + half], dim);
+
+  int32_t left = buildNode(db, begin, half);
+  int32_t right = buildNode(db, begin + half, count - half);
+  node = &db->nodes[id];
+  node->dim = dim;
+  node->split = split;
+  node->left = left;
+  node->right = right;
+  return id;
+}
+
+/**
+ * Builds the k-d tree over all poses added so far. Queries made while the
+ * index is stale fall back to the brute-force scan.
+ */
+bool BuildPoseIndex(PoseDatabase *db){
+  free(db->ordered);
+  free(db->order);
+  free(db->nodes);
+  db->ordered = NULL;
+  db->order = NULL;
+  db->nodes = NULL;
+  db->nodeCount = 0;
+  db->indexed = false;
+  if(db->count == 0){
+    return false;
+  }
+
+  //Every split leaves at least POSE_LEAF_SIZE / 2 poses on each side
+  uint32_t maxNodes = 2 * (db->count / (POSE_LEAF_SIZE / 2) + 1);
+  db->order = malloc((size_t)db->count * sizeof(uint32_t));
+  db->ordered = malloc((size_t)db->count * POSE_FEATURE_DIM * sizeof(float));
+  db->nodes = malloc((size_t)maxNodes * sizeof(PoseNode));
+  if(!db->order || !db->ordered || !db->nodes){
+    return false;
+  }
+
+  for(uint32_t i = 0; i < db->count; i++){
+    db->order[i] = i;
+  }
+  buildNode(db, 0, db->count);
+  for(uint32_t i = 0; i < db->count; i++){
+    memcpy(db->ordered + (size_t)i * POSE_FEATURE_DIM,
+           db->features + (size_t)db->order[i] * POSE_FEATURE_DIM,
+           POSE_FEATURE_DIM * sizeof(float));
+  }
+  db->indexed = true;
+  return true;
+}
+
+static void searchNode(const PoseDatabase *db, int32_t id, const float *query, PoseBest *best){
+  const PoseNode *node = &db->nodes[id];
+  if(node->left < 0){
+    const float *f = db->ordered + (size_t)node->begin * POSE_FEATURE_DIM;
+    for(uint32_t i = 0; i < node->count; i++, f += POSE_FEATURE_DIM){
+      uint32_t index = db->order[node->begin + i];
+      offerMatch(best, index, db->labels[index], squaredDistance(query, f));
+    }
+    return;
+  }
+
+  float diff = query[node->dim] - node->split;
+  int32_t nearChild = diff < 0.0f ? node->left : node->right;
+  int32_t farChild = diff < 0.0f ? node->right : node->left;
+  searchNode(db, nearChild, query, best);
+  if(diff * diff < worstDistance(best)){
+    searchNode(db, farChild, query, best);
+  }
+}
+
+uint32_t QueryPoseIndex(const PoseDatabase *db, const float feature[POSE_FEATURE_DIM],
+                        uint32_t k, PoseMatch *matches){
+  if(!db->indexed){
+    return QueryPoseBruteForce(db, feature, k, matches);
+  }
+  PoseBest best = { matches, k > POSE_MAX_K ? POSE_MAX_K : k, 0 };
+  if(best.k == 0){
+    return 0;
+  }
+  searchNode(db, 0, feature, &best);
+  return best.n;
+}
+
+uint32_t QueryPoseBruteForce(const PoseDatabase *db, const float feature[POSE_FEATURE_DIM],
+                             uint32_t k, PoseMatch *matches){
+  PoseBest best = { matches, k > POSE_MAX_K ? POSE_MAX_K : k, 0 };
+  if(best.k == 0){
+    return 0;
+  }
+  const float *f = db->features;
+  for(uint32_t i = 0; i < db->count; i++, f += POSE_FEATURE_DIM){
+    offerMatch(&best, i, db->labels[i], squaredDistance(feature, f));
+  }
+  return best.n;
+}
+
+bool ClassifyHandPose(const PoseDatabase *db, const LEAP_HAND *hand, uint32_t k,
+                      uint32_t *label, float *nearestDistance){
+  float feature[POSE_FEATURE_DIM];
+  PoseMatch matches[POSE_MAX_K];
+  NormalizeHandPose(hand, feature);
+  uint32_t n = QueryPoseIndex(db, feature, k, matches);
+  if(n == 0){
+    return false;
+  }
+
+  //Majority vote; ties go to the label whose first vote is nearest
+  uint32_t bestVotes = 0;
+  for(uint32_t i = 0; i < n; i++){
+    uint32_t votes = 0;
+    for(uint32_t j = 0; j < n; j++){
+      votes += matches[j].label == matches[i].label;
+    }
+    if(votes > bestVotes){
+      bestVotes = votes;
+      *label = matches[i].label;
+    }
+  }
+  if(nearestDistance){
+    *nearestDistance = matches[0].distance;
+  }
+  return true;
+}
+//End-of-PoseIndex.c
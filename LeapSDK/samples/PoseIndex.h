@@ -0,0 +1,50 @@
+/* Static hand-pose database and nearest-neighbour index.
+ *
+ * Hands are normalized into the palm frame and scaled by palm width so that
+ * the same pose produces the same feature vector regardless of where the hand
+ * is, how it is oriented or how large it is. Left hands are mirrored so one
+ * database serves both chiralities.
+ *
+ */
+
+#ifndef PoseIndex_h
+#define PoseIndex_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* 5 digits x 4 joints x 3 coordinates, padded to a multiple of the SIMD width. */
+#define POSE_JOINT_COUNT 20
+#define POSE_FEATURE_DIM 64
+
+/** Largest k accepted by the query functions. */
+#define POSE_MAX_K 32
+
+typedef struct _PoseMatch {
+  uint32_t index;    //Insertion index of the pose in the database
+  uint32_t label;    //User label supplied to AddPose()
+  float    distance; //Squared euclidean distance in feature space
+} PoseMatch;
+
+typedef struct _PoseDatabase PoseDatabase;
+
+/* Pose database functions */
+PoseDatabase* CreatePoseDatabase(uint32_t capacity);
+void DestroyPoseDatabase(PoseDatabase *db);
+void NormalizeHandPose(const LEAP_HAND *hand, float feature[POSE_FEATURE_DIM]);
+bool AddPose(PoseDatabase *db, const float feature[POSE_FEATURE_DIM], uint32_t label);
+bool BuildPoseIndex(PoseDatabase *db);
+uint32_t GetPoseCount(const PoseDatabase *db);
+
+/* Queries; both return the number of matches written, sorted nearest first. */
+uint32_t QueryPoseIndex(const PoseDatabase *db, const float feature[POSE_FEATURE_DIM],
+                        uint32_t k, PoseMatch *matches);
+uint32_t QueryPoseBruteForce(const PoseDatabase *db, const float feature[POSE_FEATURE_DIM],
+                             uint32_t k, PoseMatch *matches);
+
+/* Majority vote over the k nearest poses. Returns false if the database is empty. */
+bool ClassifyHandPose(const PoseDatabase *db, const LEAP_HAND *hand, uint32_t k,
+                      uint32_t *label, float *nearestDistance);
+
+#endif /* PoseIndex_h */
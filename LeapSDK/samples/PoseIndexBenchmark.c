@@ -0,0 +1,149 @@
+/* Benchmarks k-d tree queries against the brute-force SIMD scan as the pose
+ * database grows, and reports the size at which the tree starts to win.
+ *
+ * Poses are synthesized from a few curl parameters per finger, placed at a
+ * random position and scale, so the feature vectors lie on a low-dimensional
+ * manifold like real hand data does. No device is required.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "PoseIndex.h"
+
+#define QUERY_COUNT 2000
+#define K 5
+
+static float randomUnit(void){
+  return (float)rand() / (float)RAND_MAX;
+}
+
+/** Builds a right hand with the palm facing down and each finger curled by curl[f] radians per joint. */
+static void synthesizeHand(LEAP_HAND *hand, const float curl[5], float scale){
+  static const float baseX[5] = { -0.45f, -0.3f, -0.1f, 0.1f, 0.3f };
+  static const float length[5][3] = {
+    { 0.45f, 0.35f, 0.3f }, { 0.5f, 0.3f, 0.25f }, { 0.55f, 0.35f, 0.25f },
+    { 0.5f, 0.33f, 0.25f }, { 0.4f, 0.25f, 0.22f }
+  };
+  memset(hand, 0, sizeof(*hand));
+  hand->type = eLeapHandType_Right;
+  hand->palm.width = 80.0f * scale;
+  hand->palm.position.x = (randomUnit() - 0.5f) * 300.0f;
+  hand->palm.position.y = 100.0f + randomUnit() * 300.0f;
+  hand->palm.position.z = (randomUnit() - 0.5f) * 300.0f;
+  hand->palm.normal.y = -1.0f;
+  hand->palm.direction.z = -1.0f;
+
+  for(int f = 0; f < 5; f++){
+    LEAP_DIGIT *digit = &hand->digits[f];
+    float x = baseX[f], y = 0.0f, z = -0.5f, angle = 0.0f;
+    digit->proximal.prev_joint.x = hand->palm.position.x + x * hand->palm.width;
+    digit->proximal.prev_joint.y = hand->palm.position.y;
+    digit->proximal.prev_joint.z = hand->palm.position.z + z * hand->palm.width;
+    for(int b = 0; b < 3; b++){
+      angle += curl[f];
+      y -= length[f][b] * sinf(angle);
+      z -= length[f][b] * cosf(angle);
+      LEAP_VECTOR *joint = &digit->bones[b + 1].next_joint;
+      joint->x = hand->palm.position.x + x * hand->palm.width;
+      joint->y = hand->palm.position.y + y * hand->palm.width;
+      joint->z = hand->palm.position.z + z * hand->palm.width;
+      if(b < 2){
+        digit->bones[b + 2].prev_joint = *joint;
+      }
+    }
+  }
+}
+
+static void randomPose(float feature[POSE_FEATURE_DIM], uint32_t *label){
+  LEAP_HAND hand;
+  float curl[5];
+  *label = 0;
+  for(int f = 0; f < 5; f++){
+    curl[f] = randomUnit() * 1.4f;
+    *label = (*label << 1) | (curl[f] > 0.7f);
+  }
+  synthesizeHand(&hand, curl, 0.8f + 0.4f * randomUnit());
+  NormalizeHandPose(&hand, feature);
+}
+
+int main(int argc, char** argv) {
+  static const uint32_t sizes[] = { 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000 };
+  const uint32_t sizeCount = sizeof(sizes) / sizeof(sizes[0]);
+  const uint32_t maxSize = sizes[sizeCount - 1];
+  srand(42);
+
+  float *queries = malloc((size_t)QUERY_COUNT * POSE_FEATURE_DIM * sizeof(float));
+  for(uint32_t q = 0; q < QUERY_COUNT; q++){
+    uint32_t label;
+    randomPose(queries + (size_t)q * POSE_FEATURE_DIM, &label);
+  }
+
+  PoseDatabase *db = CreatePoseDatabase(maxSize);
+  if(!db || !queries){
+    printf("Failed to allocate pose database.\n");
+    return 1;
+  }
+
+  printf("%8s %12s %12s %12s %8s\n", "poses", "build(ms)", "tree(us/q)", "brute(us/q)", "agree");
+  uint32_t crossover = 0;
+  for(uint32_t s = 0; s < sizeCount; s++){
+    while(GetPoseCount(db) < sizes[s]){
+      float feature[POSE_FEATURE_DIM];
+      uint32_t label;
+      randomPose(feature, &label);
+      AddPose(db, feature, label);
+    }
+
+    int64_t start = LeapGetNow();
+    BuildPoseIndex(db);
+    int64_t buildTime = LeapGetNow() - start;
+
+    PoseMatch treeMatches[K], bruteMatches[K];
+    uint32_t agree = 0;
+    volatile float sink = 0.0f;
+
+    start = LeapGetNow();
+    for(uint32_t q = 0; q < QUERY_COUNT; q++){
+      QueryPoseIndex(db, queries + (size_t)q * POSE_FEATURE_DIM, K, treeMatches);
+      sink += treeMatches[0].distance;
+    }
+    int64_t treeTime = LeapGetNow() - start;
+
+    start = LeapGetNow();
+    for(uint32_t q = 0; q < QUERY_COUNT; q++){
+      QueryPoseBruteForce(db, queries + (size_t)q * POSE_FEATURE_DIM, K, bruteMatches);
+      sink += bruteMatches[0].distance;
+    }
+    int64_t bruteTime = LeapGetNow() - start;
+
+    //Both searches are exact, so the nearest neighbours must match
+    for(uint32_t q = 0; q < QUERY_COUNT; q++){
+      const float *query = queries + (size_t)q * POSE_FEATURE_DIM;
+      QueryPoseIndex(db, query, K, treeMatches);
+      QueryPoseBruteForce(db, query, K, bruteMatches);
+      agree += treeMatches[0].index == bruteMatches[0].index;
+    }
+
+    if(!crossover && treeTime < bruteTime){
+      crossover = sizes[s];
+    }
+    printf("%8u %12.2f %12.2f %12.2f %7.1f%%\n", sizes[s],
+           buildTime / 1000.0, (double)treeTime / QUERY_COUNT, (double)bruteTime / QUERY_COUNT,
+           100.0 * agree / QUERY_COUNT);
+  }
+
+  if(crossover){
+    printf("k-d tree is faster than brute force from %u poses.\n", crossover);
+  } else {
+    printf("Brute force was faster at every size tested.\n");
+  }
+
+  DestroyPoseDatabase(db);
+  free(queries);
+  return 0;
+}
+//End-of-Sample
@@ -25,11 +25,10 @@ int64_t lastFrameID = 0; //The last frame received
 
 int main(int argc, char** argv) {
   OpenConnection();
-  while(!IsConnected)
-    millisleep(100); //wait a bit to let the connection complete
+  WaitForConnection(WAIT_INFINITE);
 
   printf("Connected.\n");
-  LEAP_DEVICE_INFO* deviceProps = GetDeviceProperties();
+  LEAP_DEVICE_INFO* deviceProps = WaitForDevice(1000);
   if(deviceProps)
     printf("Using device %s.\n", deviceProps->serial);
 
@@ -42,8 +41,8 @@ int main(int argc, char** argv) {
   if(LEAP_SUCCEEDED(result)){
     int frameCount = 0;
     while(frameCount < 10){
-      LEAP_TRACKING_EVENT *frame = GetFrame();
-      if(frame && (frame->tracking_frame_id > lastFrameID)){
+      LEAP_TRACKING_EVENT *frame = WaitForFrame(lastFrameID, 1000);
+      if(frame){
         lastFrameID = frame->tracking_frame_id;
         frameCount++;
         uint64_t dataWritten = 0;
@@ -0,0 +1,252 @@
+/* Capture of the Ultraleap service's log messages.
+ *
+ * The ring has one producer (the polling thread) and one consumer (the
+ * writer). The string table is written by the producer only: an interned
+ * string is complete before the entry pointing at it is published, and is
+ * never moved or freed until the log is destroyed, so the writer reads it
+ * without locking.
+ *
+ */
+
+#include "ServiceLog.h"
+#include "LeapThreads.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SERVICE_LOG_STRINGS 1024           //String table slots, power of two
+#define SERVICE_LOG_STRINGS_LOAD (SERVICE_LOG_STRINGS * 3 / 4)
+#define SERVICE_LOG_STRING_BYTES (64 * 1024)
+#define SERVICE_LOG_FLUSH_MS 250
+
+typedef struct _ServiceLogEntry {
+  int64_t          timestamp;
+  int64_t          received;
+  eLeapLogSeverity severity;
+  const char      *message;                //Interned, or NULL to use text
+  char             text[SERVICE_LOG_INLINE_MESSAGE];
+} ServiceLogEntry;
+
+typedef struct _InternedString {
+  uint32_t    hash;
+  const char *text;
+} InternedString;
+
+struct _ServiceLog {
+  FILE            *file;
+  ServiceLogEntry *entries;
+  uint32_t         capacity;
+
+  InternedString   strings[SERVICE_LOG_STRINGS];
+  char            *stringBytes;
+  size_t           stringBytesUsed;
+  atomic_uint      interned;
+
+  atomic_uint_fast64_t head;               //Written by the producer
+  atomic_uint_fast64_t tail;               //Written by the writer
+  atomic_uint_fast64_t dropped;
+  atomic_uint_fast64_t inlined;
+
+  atomic_int       running;
+  atomic_int       waiting;
+  LockType         lock;
+  CondType         wake;
+  ThreadType       thread;
+};
+
+static uint32_t hashString(const char *text, size_t *length){
+  uint32_t hash = 2166136261u;
+  const char *p = text;
+  for(; *p; p++){
+    hash = (hash ^ (uint8_t)*p) * 16777619u;
+  }
+  *length = (size_t)(p - text);
+  return hash;
+}
+
+/** Returns the table's copy of text, adding it if there is room; NULL if the table is full. */
+static const char* internString(ServiceLog *log, const char *text){
+  size_t length;
+  uint32_t hash = hashString(text, &length);
+  uint32_t mask = SERVICE_LOG_STRINGS - 1;
+  //The table is never filled beyond SERVICE_LOG_STRINGS_LOAD, so every probe sequence reaches an empty slot
+  for(uint32_t probe = 0; ; probe++){
+    InternedString *slot = &log->strings[(hash + probe) & mask];
+    if(!slot->text){
+      if(atomic_load_explicit(&log->interned, memory_order_relaxed) >= SERVICE_LOG_STRINGS_LOAD ||
+         log->stringBytesUsed + length + 1 > SERVICE_LOG_STRING_BYTES){
+        return NULL;
+      }
+      char *copy = log->stringBytes + log->stringBytesUsed;
+      memcpy(copy, text, length + 1);
+      log->stringBytesUsed += length + 1;
+      slot->hash = hash;
+      slot->text = copy;
+      atomic_fetch_add_explicit(&log->interned, 1, memory_order_relaxed);
+      return copy;
+    }
+    if(slot->hash == hash && strcmp(slot->text, text) == 0){
+      return slot->text;
+    }
+  }
+}
+
+static const char* severityName(eLeapLogSeverity severity){
+  switch(severity){
+    case eLeapLogSeverity_Critical:    return "critical";
+    case eLeapLogSeverity_Warning:     return "warning";
+    case eLeapLogSeverity_Information: return "information";
+    default:                           return "unknown";
+  }
+}
+
+static void writeJsonString(FILE *file, const char *text){
+  fputc('"', file);
+  for(const unsigned char *p = (const unsigned char *)text; *p; p++){
+    switch(*p){
+      case '"':  fputs("\\\"", file); break;
+      case '\\': fputs("\\\\", file); break;
+      case '\n': fputs("\\n", file); break;
+      case '\r': fputs("\\r", file); break;
+      case '\t': fputs("\\t", file); break;
+      default:
+        if(*p < 0x20){
+          fprintf(file, "\\u%04x", *p);
+        } else {
+          fputc(*p, file);
+        }
+    }
+  }
+  fputc('"', file);
+}
+
+static void writeEntries(ServiceLog *log){
+  uint64_t tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+  uint64_t head = atomic_load_explicit(&log->head, memory_order_acquire);
+  if(tail == head){
+    return;
+  }
+  for(uint64_t i = tail; i < head; i++){
+    const ServiceLogEntry *entry = &log->entries[i & (log->capacity - 1)];
+    fprintf(log->file, "{\"timestamp\":%lld,\"received\":%lld,\"severity\":\"%s\",\"message\":",
+            (long long)entry->timestamp, (long long)entry->received, severityName(entry->severity));
+    writeJsonString(log->file, entry->message ? entry->message : entry->text);
+    fputs("}\n", log->file);
+  }
+  atomic_store_explicit(&log->tail, head, memory_order_release);
+  fflush(log->file);
+}
+
+static ThreadReturnType writerThread(void *arg){
+  ServiceLog *log = arg;
+  while(atomic_load(&log->running)){
+    writeEntries(log);
+    LockMutex(&log->lock);
+    atomic_store(&log->waiting, 1);
+    if(atomic_load(&log->running) &&
+       atomic_load(&log->head) == atomic_load_explicit(&log->tail, memory_order_relaxed)){
+      WaitCond(&log->wake, &log->lock, SERVICE_LOG_FLUSH_MS);
+    }
+    atomic_store(&log->waiting, 0);
+    UnlockMutex(&log->lock);
+  }
+  writeEntries(log);
+  return ThreadReturnValue;
+}
+
+ServiceLog* CreateServiceLog(const char *path, uint32_t capacity){
+  ServiceLog *log = calloc(1, sizeof(ServiceLog));
+  if(!log){
+    return NULL;
+  }
+  log->capacity = 2;
+  while(log->capacity < capacity){
+    log->capacity <<= 1;
+  }
+  log->entries = malloc(log->capacity * sizeof(ServiceLogEntry));
+  log->stringBytes = malloc(SERVICE_LOG_STRING_BYTES);
+  log->file = fopen(path, "a");
+  if(!log->entries || !log->stringBytes || !log->file){
+    DestroyServiceLog(log);
+    return NULL;
+  }
+  InitLock(&log->lock);
+  InitCond(&log->wake);
+  atomic_store(&log->running, 1);
+  if(!StartThread(&log->thread, writerThread, log)){
+    atomic_store(&log->running, 0);
+    DestroyCond(&log->wake);
+    DestroyLock(&log->lock);
+    DestroyServiceLog(log);
+    return NULL;
+  }
+  return log;
+}
+
+/** Writes what is still queued, stops the writer and closes the file. */
+void DestroyServiceLog(ServiceLog *log){
+  if(!log){
+    return;
+  }
+  if(atomic_exchange(&log->running, 0)){
+    LockMutex(&log->lock);
+    SignalCond(&log->wake);
+    UnlockMutex(&log->lock);
+    JoinThread(log->thread);
+    DestroyCond(&log->wake);
+    DestroyLock(&log->lock);
+  }
+  if(log->file){
+    fclose(log->file);
+  }
+  free(log->stringBytes);
+  free(log->entries);
+  free(log);
+}
+
+/** Copies one message into the ring. Never blocks; the message is counted as dropped if the ring is full. */
+void RecordServiceLogEvent(ServiceLog *log, const LEAP_LOG_EVENT *event){
+  uint64_t head = atomic_load_explicit(&log->head, memory_order_relaxed);
+  if(head - atomic_load_explicit(&log->tail, memory_order_acquire) >= log->capacity){
+    atomic_store_explicit(&log->dropped, atomic_load_explicit(&log->dropped, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    return;
+  }
+  ServiceLogEntry *entry = &log->entries[head & (log->capacity - 1)];
+  const char *message = event->message ? event->message : "";
+  entry->timestamp = event->timestamp;
+  entry->received = LeapGetNow();
+  entry->severity = event->severity;
+  entry->message = internString(log, message);
+  if(!entry->message){
+    strncpy(entry->text, message, sizeof(entry->text) - 1);
+    entry->text[sizeof(entry->text) - 1] = '\0';
+    atomic_store_explicit(&log->inlined, atomic_load_explicit(&log->inlined, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+  }
+  atomic_store_explicit(&log->head, head + 1, memory_order_release);
+
+  //Wake the writer early only once half the ring is used; otherwise it flushes on its interval
+  if(head + 1 - atomic_load_explicit(&log->tail, memory_order_relaxed) >= log->capacity / 2 &&
+     atomic_load(&log->waiting)){
+    LockMutex(&log->lock);
+    SignalCond(&log->wake);
+    UnlockMutex(&log->lock);
+  }
+}
+
+void RecordServiceLogEvents(ServiceLog *log, const LEAP_LOG_EVENTS *events){
+  for(uint32_t i = 0; i < events->nEvents; i++){
+    RecordServiceLogEvent(log, &events->events[i]);
+  }
+}
+
+void GetServiceLogStats(ServiceLog *log, ServiceLogStats *stats){
+  stats->recorded = atomic_load_explicit(&log->head, memory_order_relaxed);
+  stats->written = atomic_load_explicit(&log->tail, memory_order_relaxed);
+  stats->dropped = atomic_load_explicit(&log->dropped, memory_order_relaxed);
+  stats->interned = atomic_load_explicit(&log->interned, memory_order_relaxed);
+  stats->inlined = atomic_load_explicit(&log->inlined, memory_order_relaxed);
+}
+//End-of-ServiceLog.c
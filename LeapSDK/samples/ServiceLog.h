@@ -0,0 +1,46 @@
+/* Capture of the Ultraleap service's log messages.
+ *
+ * LeapC delivers service log messages as eLeapEventType_LogEvent and
+ * eLeapEventType_LogEvents on the polling thread, with message strings that
+ * are only valid until the next poll. RecordServiceLogEvent(s) copies them
+ * into a preallocated ring: each distinct message text is interned once into
+ * a fixed string table, so a repeated warning costs a hash lookup and no
+ * allocation. A background thread writes the ring to a file in batches, one
+ * JSON object per line:
+ *
+ *   {"timestamp":123456789,"received":123456912,"severity":"warning","message":"..."}
+ *
+ * timestamp is the service's time for the message and received is when the
+ * poll thread saw it, both in LeapGetNow() microseconds like frame timestamps,
+ * so service warnings can be lined up with tracking latency.
+ *
+ */
+
+#ifndef ServiceLog_h
+#define ServiceLog_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SERVICE_LOG_DEFAULT_CAPACITY 1024
+#define SERVICE_LOG_INLINE_MESSAGE 120    //Kept per entry when the string table is full
+
+typedef struct _ServiceLog ServiceLog;
+
+typedef struct _ServiceLogStats {
+  uint64_t recorded;
+  uint64_t written;
+  uint64_t dropped;      //Ring full
+  uint32_t interned;     //Distinct messages in the string table
+  uint64_t inlined;      //Messages copied into their entry because the table was full
+} ServiceLogStats;
+
+/** Opens (appends to) path and starts the writer. capacity is rounded up to a power of two. */
+ServiceLog* CreateServiceLog(const char *path, uint32_t capacity);
+void DestroyServiceLog(ServiceLog *log);
+void RecordServiceLogEvent(ServiceLog *log, const LEAP_LOG_EVENT *event);
+void RecordServiceLogEvents(ServiceLog *log, const LEAP_LOG_EVENTS *events);
+void GetServiceLogStats(ServiceLog *log, ServiceLogStats *stats);
+
+#endif /* ServiceLog_h */
@@ -0,0 +1,626 @@
+/* Dense depth from the stereo IR image pair.
+ *
+ * Matching runs with the right features stored mirrored, one row of
+ * width + disparities bytes per image row: right[W - 1 - x + d] is the right
+ * pixel at x - d, so the candidates for all disparities of left pixel x are
+ * one contiguous run and a cost kernel covers 16 of them per load.
+ *
+ * Per-pixel costs are summed into column sums of width x disparities
+ * uint16 values, kept per worker and slid down one row at a time; a running
+ * row sum over the columns then gives the window cost of every disparity.
+ * Window costs stay below 32768 for radius 5 and 8-bit SAD, so the SIMD
+ * minimum search can use signed 16-bit compares.
+ *
+ */
+
+#include "StereoDepth.h"
+#include "WorkerPool.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define STEREO_USE_SSE 1
+#endif
+
+#define STEREO_MAX_DISPARITY 256
+#define STEREO_MAX_RADIUS 5
+//The distortion grid covers ray slopes from -4 to 4 in both directions.
+#define STEREO_GRID_SLOPE 4.0f
+#define STEREO_NO_SOURCE UINT32_MAX
+
+typedef struct _RectifyTable {
+  bool      built;
+  uint64_t  version;          //matrix_version the table was built from
+  uint32_t *offset;           //Source pixel of the top-left sample, STEREO_NO_SOURCE outside the image
+  uint16_t *weight;           //Horizontal weight in the low byte, vertical in the high byte, in 1/256
+} RectifyTable;
+
+typedef struct _MatchScratch {
+  uint16_t *columns;          //width x disparities column sums
+  uint16_t *window;           //disparities window sums at the current pixel
+  uint8_t  *row;              //One feature row before mirroring
+} MatchScratch;
+
+struct _StereoDepth {
+  StereoDepthConfig config;
+  uint32_t          disparities;
+  WorkerPool       *pool;
+  uint32_t          workers;
+  uint32_t          width;
+  uint32_t          height;
+  uint32_t          bandRows;
+  uint32_t          bands;
+  uint32_t          rightStride;
+  RectifyTable      tables[2];
+  uint8_t          *rectified[2];
+  uint8_t          *left;       //Left features, width x height
+  uint8_t          *right;      //Mirrored right features, rightStride x height
+  MatchScratch     *scratch;
+  float             depthScale; //Depth in mm times disparity in 1/16 pixel
+  const LEAP_IMAGE_EVENT *event;
+  atomic_uint       valid;
+  DepthMap          map;
+  StereoDepthStats  stats;
+};
+
+void GetDefaultStereoDepthConfig(StereoDepthConfig *config){
+  memset(config, 0, sizeof(StereoDepthConfig));
+  config->cost = eStereoCost_Census;
+  config->max_disparity = 64;
+  config->block_radius = 3;
+  config->uniqueness = 10;
+  config->range_x = 1.5f;
+  config->range_y = 1.5f;
+  config->baseline = 40.0f;
+}
+
+static void freeBuffers(StereoDepth *engine){
+  for(int c = 0; c < 2; c++){
+    free(engine->tables[c].offset);
+    free(engine->tables[c].weight);
+    free(engine->rectified[c]);
+    engine->tables[c].offset = NULL;
+    engine->tables[c].weight = NULL;
+    engine->tables[c].built = false;
+    engine->rectified[c] = NULL;
+  }
+  free(engine->left);
+  free(engine->right);
+  free(engine->map.disparity);
+  free(engine->map.depth);
+  engine->left = NULL;
+  engine->right = NULL;
+  engine->map.disparity = NULL;
+  engine->map.depth = NULL;
+  for(uint32_t w = 0; w < engine->workers; w++){
+    free(engine->scratch[w].columns);
+    free(engine->scratch[w].window);
+    free(engine->scratch[w].row);
+    memset(&engine->scratch[w], 0, sizeof(MatchScratch));
+  }
+  engine->width = 0;
+  engine->height = 0;
+}
+
+/** Sizes every buffer for width x height images; only reallocates when the size changes. */
+static bool ensureSize(StereoDepth *engine, uint32_t width, uint32_t height){
+  if(engine->width == width && engine->height == height){
+    return true;
+  }
+  freeBuffers(engine);
+  size_t pixels = (size_t)width * height;
+  uint32_t D = engine->disparities;
+  engine->rightStride = width + D;
+  bool ok = true;
+  for(int c = 0; c < 2; c++){
+    engine->tables[c].offset = malloc(pixels * sizeof(uint32_t));
+    engine->tables[c].weight = malloc(pixels * sizeof(uint16_t));
+    engine->rectified[c] = malloc(pixels);
+    ok = ok && engine->tables[c].offset && engine->tables[c].weight && engine->rectified[c];
+  }
+  engine->left = malloc(pixels);
+  engine->right = calloc((size_t)engine->rightStride * height, 1);
+  engine->map.disparity = malloc(pixels * sizeof(uint16_t));
+  engine->map.depth = malloc(pixels * sizeof(float));
+  ok = ok && engine->left && engine->right && engine->map.disparity && engine->map.depth;
+  for(uint32_t w = 0; ok && w < engine->workers; w++){
+    MatchScratch *scratch = &engine->scratch[w];
+    scratch->columns = malloc((size_t)width * D * sizeof(uint16_t));
+    scratch->window = malloc(D * sizeof(uint16_t));
+    scratch->row = malloc(width);
+    ok = scratch->columns && scratch->window && scratch->row;
+  }
+  if(!ok){
+    freeBuffers(engine);
+    return false;
+  }
+  engine->width = width;
+  engine->height = height;
+  engine->map.width = width;
+  engine->map.height = height;
+
+  //One band per worker keeps the window start-up rows, which every band
+  //recomputes, a small share of the work.
+  uint32_t minRows = 4 * engine->config.block_radius + 2;
+  engine->bandRows = (height + engine->workers - 1) / engine->workers;
+  if(engine->bandRows < minRows){
+    engine->bandRows = minRows;
+  }
+  engine->bands = (height + engine->bandRows - 1) / engine->bandRows;
+
+  float slopePerPixel = 2.0f * engine->config.range_x / (float)(width - 1);
+  engine->depthScale = 16.0f * engine->config.baseline / slopePerPixel;
+  return true;
+}
+
+StereoDepth* CreateStereoDepth(const StereoDepthConfig *config){
+  StereoDepth *engine = calloc(1, sizeof(StereoDepth));
+  if(!engine){
+    return NULL;
+  }
+  engine->config = *config;
+  if(engine->config.block_radius < 1){
+    engine->config.block_radius = 1;
+  }
+  if(engine->config.block_radius > STEREO_MAX_RADIUS){
+    engine->config.block_radius = STEREO_MAX_RADIUS;
+  }
+  uint32_t D = (config->max_disparity + 15) & ~15u;
+  engine->disparities = D < 16 ? 16 : D > STEREO_MAX_DISPARITY ? STEREO_MAX_DISPARITY : D;
+  engine->pool = CreateWorkerPool(config->threads);
+  if(!engine->pool){
+    free(engine);
+    return NULL;
+  }
+  engine->workers = GetWorkerCount(engine->pool);
+  engine->scratch = calloc(engine->workers, sizeof(MatchScratch));
+  if(!engine->scratch){
+    DestroyWorkerPool(engine->pool);
+    free(engine);
+    return NULL;
+  }
+  return engine;
+}
+
+void DestroyStereoDepth(StereoDepth *engine){
+  if(!engine){
+    return;
+  }
+  freeBuffers(engine);
+  free(engine->scratch);
+  DestroyWorkerPool(engine->pool);
+  free(engine);
+}
+
+/** Bilinear sample of the distortion grid at grid coordinates gx, gy. */
+static void sampleGrid(const LEAP_DISTORTION_MATRIX *matrix, float gx, float gy, float *x, float *y){
+  int ix = (int)gx, iy = (int)gy;
+  if(ix > LEAP_DISTORTION_MATRIX_N - 2) ix = LEAP_DISTORTION_MATRIX_N - 2;
+  if(iy > LEAP_DISTORTION_MATRIX_N - 2) iy = LEAP_DISTORTION_MATRIX_N - 2;
+  float fx = gx - (float)ix, fy = gy - (float)iy;
+  float x0 = matrix->matrix[iy][ix].x * (1.0f - fx) + matrix->matrix[iy][ix + 1].x * fx;
+  float x1 = matrix->matrix[iy + 1][ix].x * (1.0f - fx) + matrix->matrix[iy + 1][ix + 1].x * fx;
+  float y0 = matrix->matrix[iy][ix].y * (1.0f - fx) + matrix->matrix[iy][ix + 1].y * fx;
+  float y1 = matrix->matrix[iy + 1][ix].y * (1.0f - fx) + matrix->matrix[iy + 1][ix + 1].y * fx;
+  *x = x0 * (1.0f - fy) + x1 * fy;
+  *y = y0 * (1.0f - fy) + y1 * fy;
+}
+
+/** Maps every rectified pixel to its source sample through the distortion grid. */
+static void buildTable(StereoDepth *engine, RectifyTable *table, const LEAP_IMAGE *image){
+  const LEAP_DISTORTION_MATRIX *matrix = image->distortion_matrix;
+  uint32_t W = engine->width, H = engine->height;
+  const float last = (float)(LEAP_DISTORTION_MATRIX_N - 1);
+
+  //The grid holds normalised image coordinates, which run past 0..1 beyond the
+  //field of view; accept pixel coordinates too, told apart by the optical centre.
+  const int centre = LEAP_DISTORTION_MATRIX_N / 2;
+  bool pixels = matrix->matrix[centre][centre].x > 2.0f;
+  float scaleX = pixels ? 1.0f : (float)(W - 1);
+  float scaleY = pixels ? 1.0f : (float)(H - 1);
+
+  for(uint32_t v = 0; v < H; v++){
+    float slopeY = engine->config.range_y * (2.0f * (float)v / (float)(H - 1) - 1.0f);
+    float gy = (slopeY + STEREO_GRID_SLOPE) / (2.0f * STEREO_GRID_SLOPE) * last;
+    for(uint32_t u = 0; u < W; u++){
+      size_t i = (size_t)v * W + u;
+      float slopeX = engine->config.range_x * (2.0f * (float)u / (float)(W - 1) - 1.0f);
+      float gx = (slopeX + STEREO_GRID_SLOPE) / (2.0f * STEREO_GRID_SLOPE) * last;
+      table->offset[i] = STEREO_NO_SOURCE;
+      table->weight[i] = 0;
+      if(gx < 0.0f || gy < 0.0f || gx > last || gy > last){
+        continue;
+      }
+      float px, py;
+      sampleGrid(matrix, gx, gy, &px, &py);
+      px *= scaleX;
+      py *= scaleY;
+      if(!(px >= 0.0f && py >= 0.0f && px <= (float)(W - 1) && py <= (float)(H - 1))){
+        continue;
+      }
+      uint32_t x0 = (uint32_t)px, y0 = (uint32_t)py;
+      if(x0 > W - 2) x0 = W - 2;
+      if(y0 > H - 2) y0 = H - 2;
+      int wx = (int)((px - (float)x0) * 256.0f + 0.5f), wy = (int)((py - (float)y0) * 256.0f + 0.5f);
+      if(wx > 255 && x0 < W - 2){
+        x0++;
+        wx = 0;
+      }
+      if(wy > 255 && y0 < H - 2){
+        y0++;
+        wy = 0;
+      }
+      table->offset[i] = y0 * W + x0;
+      table->weight[i] = (uint16_t)((wx > 255 ? 255 : wx) | (wy > 255 ? 255 : wy) << 8);
+    }
+  }
+  table->version = image->matrix_version;
+  table->built = true;
+  engine->stats.tableBuilds++;
+}
+
+static void rectifyRows(const StereoDepth *engine, uint32_t camera, uint32_t begin, uint32_t end){
+  const LEAP_IMAGE *image = &engine->event->image[camera];
+  const uint8_t *source = (const uint8_t*)image->data + image->offset;
+  uint8_t *target = engine->rectified[camera];
+  uint32_t W = engine->width;
+  if(!image->distortion_matrix){
+    memcpy(target + (size_t)begin * W, source + (size_t)begin * W, (size_t)(end - begin) * W);
+    return;
+  }
+  const RectifyTable *table = &engine->tables[camera];
+  for(size_t i = (size_t)begin * W; i < (size_t)end * W; i++){
+    uint32_t offset = table->offset[i];
+    if(offset == STEREO_NO_SOURCE){
+      target[i] = 0;
+      continue;
+    }
+    const uint8_t *p = source + offset;
+    uint32_t wx = table->weight[i] & 0xff, wy = table->weight[i] >> 8;
+    uint32_t top = p[0] * (256 - wx) + p[1] * wx;
+    uint32_t bottom = p[W] * (256 - wx) + p[W + 1] * wx;
+    target[i] = (uint8_t)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+  }
+}
+
+/** 3x3 census: bit k is set when neighbour k is darker than the centre. Border pixels get 0. */
+static void censusRow(const uint8_t *image, uint32_t W, uint32_t H, uint32_t y, uint8_t *out){
+  if(y == 0 || y == H - 1){
+    memset(out, 0, W);
+    return;
+  }
+  const uint8_t *p = image + (size_t)y * W;
+  const int offsets[8] = { -(int)W - 1, -(int)W, -(int)W + 1, -1, 1, (int)W - 1, (int)W, (int)W + 1 };
+  uint32_t x = 1;
+  out[0] = 0;
+#if defined(STEREO_USE_SSE)
+  const __m128i bias = _mm_set1_epi8((char)0x80);
+  for(; x + 16 <= W - 1; x += 16){
+    __m128i centre = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p + x)), bias);
+    __m128i signature = _mm_setzero_si128();
+    for(int k = 0; k < 8; k++){
+      __m128i n = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p + x + offsets[k])), bias);
+      __m128i darker = _mm_cmpgt_epi8(centre, n);
+      signature = _mm_or_si128(signature, _mm_and_si128(darker, _mm_set1_epi8((char)(1 << k))));
+    }
+    _mm_storeu_si128((__m128i*)(out + x), signature);
+  }
+#endif
+  for(; x < W - 1; x++){
+    uint8_t signature = 0;
+    for(int k = 0; k < 8; k++){
+      signature |= (uint8_t)((p[(int)x + offsets[k]] < p[x]) << k);
+    }
+    out[x] = signature;
+  }
+  out[W - 1] = 0;
+}
+
+static void featureRows(StereoDepth *engine, uint32_t begin, uint32_t end, MatchScratch *scratch){
+  uint32_t W = engine->width, H = engine->height;
+  bool census = engine->config.cost == eStereoCost_Census;
+  for(uint32_t y = begin; y < end; y++){
+    uint8_t *left = engine->left + (size_t)y * W;
+    uint8_t *right = engine->right + (size_t)y * engine->rightStride;
+    if(census){
+      censusRow(engine->rectified[0], W, H, y, left);
+      censusRow(engine->rectified[1], W, H, y, scratch->row);
+    } else {
+      memcpy(left, engine->rectified[0] + (size_t)y * W, W);
+      memcpy(scratch->row, engine->rectified[1] + (size_t)y * W, W);
+    }
+    for(uint32_t x = 0; x < W; x++){
+      right[W - 1 - x] = scratch->row[x];
+    }
+  }
+}
+
+#if defined(STEREO_USE_SSE)
+static inline __m128i pixelCosts(__m128i left, __m128i right, bool census){
+  if(!census){
+    return _mm_or_si128(_mm_subs_epu8(left, right), _mm_subs_epu8(right, left));
+  }
+  //Bytewise population count of the differing signature bits
+  __m128i v = _mm_xor_si128(left, right);
+  v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x55)));
+  v = _mm_add_epi8(_mm_and_si128(v, _mm_set1_epi8(0x33)),
+                   _mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi8(0x33)));
+  return _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), _mm_set1_epi8(0x0f));
+}
+#else
+static inline uint16_t pixelCost(uint8_t left, uint8_t right, bool census){
+  if(!census){
+    return left > right ? left - right : right - left;
+  }
+  uint8_t v = left ^ right;
+  v = v - ((v >> 1) & 0x55);
+  v = (v & 0x33) + ((v >> 2) & 0x33);
+  return (v + (v >> 4)) & 0x0f;
+}
+#endif
+
+/** Adds the costs of row add to the column sums and, if sub is not negative, removes those of row sub. */
+static inline void slideColumns(const StereoDepth *engine, uint16_t *columns, uint32_t add, int32_t sub, bool census){
+  uint32_t W = engine->width, D = engine->disparities;
+  const uint8_t *leftAdd = engine->left + (size_t)add * W;
+  const uint8_t *rightAdd = engine->right + (size_t)add * engine->rightStride + W - 1;
+  const uint8_t *leftSub = sub < 0 ? NULL : engine->left + (size_t)sub * W;
+  const uint8_t *rightSub = sub < 0 ? NULL : engine->right + (size_t)sub * engine->rightStride + W - 1;
+  //Columns left of D - 1 only feed pixels without a full disparity range.
+  for(uint32_t x = D - 1; x < W; x++){
+    uint16_t *column = columns + (size_t)x * D;
+#if defined(STEREO_USE_SSE)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i la = _mm_set1_epi8((char)leftAdd[x]);
+    __m128i ls = _mm_set1_epi8((char)(leftSub ? leftSub[x] : 0));
+    for(uint32_t d = 0; d < D; d += 16){
+      __m128i costs = pixelCosts(la, _mm_loadu_si128((const __m128i*)(rightAdd - x + d)), census);
+      __m128i lo = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(column + d)), _mm_unpacklo_epi8(costs, zero));
+      __m128i hi = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(column + d + 8)), _mm_unpackhi_epi8(costs, zero));
+      if(leftSub){
+        costs = pixelCosts(ls, _mm_loadu_si128((const __m128i*)(rightSub - x + d)), census);
+        lo = _mm_sub_epi16(lo, _mm_unpacklo_epi8(costs, zero));
+        hi = _mm_sub_epi16(hi, _mm_unpackhi_epi8(costs, zero));
+      }
+      _mm_storeu_si128((__m128i*)(column + d), lo);
+      _mm_storeu_si128((__m128i*)(column + d + 8), hi);
+    }
+#else
+    for(uint32_t d = 0; d < D; d++){
+      column[d] += pixelCost(leftAdd[x], (rightAdd - x)[d], census);
+      if(leftSub){
+        column[d] -= pixelCost(leftSub[x], (rightSub - x)[d], census);
+      }
+    }
+#endif
+  }
+}
+
+/** Slides the window sums one pixel right and returns the disparity with the lowest cost. */
+static inline uint32_t slideWindow(uint16_t *window, const uint16_t *add, const uint16_t *sub, uint32_t D){
+  uint32_t best = 0;
+#if defined(STEREO_USE_SSE)
+  __m128i lowest = _mm_set1_epi16(0x7fff), bestIndex = _mm_setzero_si128();
+  __m128i index = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m128i step = _mm_set1_epi16(8);
+  for(uint32_t d = 0; d < D; d += 8){
+    __m128i sums = _mm_loadu_si128((const __m128i*)(window + d));
+    if(add){
+      sums = _mm_add_epi16(sums, _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(add + d)),
+                                               _mm_loadu_si128((const __m128i*)(sub + d))));
+      _mm_storeu_si128((__m128i*)(window + d), sums);
+    }
+    __m128i lower = _mm_cmplt_epi16(sums, lowest);
+    bestIndex = _mm_or_si128(_mm_and_si128(lower, index), _mm_andnot_si128(lower, bestIndex));
+    lowest = _mm_min_epi16(sums, lowest);
+    index = _mm_add_epi16(index, step);
+  }
+  uint16_t lanes[8], indices[8];
+  _mm_storeu_si128((__m128i*)lanes, lowest);
+  _mm_storeu_si128((__m128i*)indices, bestIndex);
+  for(int l = 1; l < 8; l++){
+    if(lanes[l] < lanes[best] || (lanes[l] == lanes[best] && indices[l] < indices[best])){
+      best = l;
+    }
+  }
+  best = indices[best];
+#else
+  for(uint32_t d = 0; d < D; d++){
+    if(add){
+      window[d] += add[d] - sub[d];
+    }
+    if(window[d] < window[best]){
+      best = d;
+    }
+  }
+#endif
+  return best;
+}
+
+/** True when no disparity away from best and its neighbours costs within the uniqueness margin. */
+static inline bool isUnique(const uint16_t *window, uint32_t best, uint32_t D, uint32_t uniqueness){
+  uint32_t limit = window[best] + window[best] * uniqueness / 100;
+  if(limit > 0x7ffe){
+    limit = 0x7ffe;
+  }
+#if defined(STEREO_USE_SSE)
+  __m128i threshold = _mm_set1_epi16((short)limit);
+  for(uint32_t d = 0; d < D; d += 8){
+    __m128i above = _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)(window + d)), threshold);
+    uint32_t within = ~(uint32_t)_mm_movemask_epi8(above) & 0xffff;
+    //Two mask bits per disparity; best and its neighbours may be within.
+    for(uint32_t n = best - 1; within && n <= best + 1; n++){
+      if(n >= d && n < d + 8){
+        within &= ~(3u << 2 * (n - d));
+      }
+    }
+    if(within){
+      return false;
+    }
+  }
+#else
+  for(uint32_t d = 0; d < D; d++){
+    if(window[d] <= limit && (d + 1 < best || d > best + 1)){
+      return false;
+    }
+  }
+#endif
+  return true;
+}
+
+/** Selects the cost kernel once per row rather than per disparity block. */
+static void slideRow(const StereoDepth *engine, uint16_t *columns, uint32_t add, int32_t sub, bool census){
+  if(census){
+    slideColumns(engine, columns, add, sub, true);
+  } else {
+    slideColumns(engine, columns, add, sub, false);
+  }
+}
+
+static void matchRows(StereoDepth *engine, uint32_t begin, uint32_t end, MatchScratch *scratch){
+  uint32_t W = engine->width, H = engine->height, D = engine->disparities;
+  int32_t r = (int32_t)engine->config.block_radius;
+  bool census = engine->config.cost == eStereoCost_Census;
+  uint16_t *columns = scratch->columns, *window = scratch->window;
+  uint32_t first = D - 1 + r, last = W - 1 - r, valid = 0;
+
+  memset(engine->map.disparity + (size_t)begin * W, 0, (size_t)(end - begin) * W * sizeof(uint16_t));
+  memset(engine->map.depth + (size_t)begin * W, 0, (size_t)(end - begin) * W * sizeof(float));
+  if(first > last){
+    return;
+  }
+
+  //Rows beyond the image repeat the edge row, so each window holds 2r+1 rows.
+  memset(columns, 0, (size_t)W * D * sizeof(uint16_t));
+  for(int32_t k = -r; k <= r; k++){
+    int32_t y = (int32_t)begin + k;
+    slideRow(engine, columns, y < 0 ? 0 : y >= (int32_t)H ? H - 1 : (uint32_t)y, -1, census);
+  }
+
+  for(uint32_t y = begin; y < end; y++){
+    if(y > begin){
+      int32_t add = (int32_t)y + r, sub = (int32_t)y - r - 1;
+      slideRow(engine, columns, add >= (int32_t)H ? H - 1 : (uint32_t)add, sub < 0 ? 0 : sub, census);
+    }
+
+    memset(window, 0, D * sizeof(uint16_t));
+    for(uint32_t x = first - r; x < first + r; x++){
+      const uint16_t *column = columns + (size_t)x * D;
+      for(uint32_t d = 0; d < D; d++){
+        window[d] += column[d];
+      }
+    }
+
+    uint16_t *disparity = engine->map.disparity + (size_t)y * W;
+    float *depth = engine->map.depth + (size_t)y * W;
+    for(uint32_t x = first; x <= last; x++){
+      const uint16_t *add = columns + (size_t)(x + r) * D;
+      const uint16_t *sub = columns + (size_t)(x - r - 1) * D;
+      if(x == first){
+        //The first window still lacks its right-most column.
+        for(uint32_t d = 0; d < D; d++){
+          window[d] += add[d];
+        }
+        add = sub = NULL;
+      }
+      uint32_t best = slideWindow(window, add, sub, D);
+      if(best == 0 || best == D - 1){
+        continue;
+      }
+      if(engine->config.uniqueness && !isUnique(window, best, D, engine->config.uniqueness)){
+        continue;
+      }
+      int32_t before = window[best - 1], at = window[best], after = window[best + 1];
+      int32_t curvature = before - 2 * at + after;
+      int32_t sixteenths = (int32_t)best * 16;
+      if(curvature > 0){
+        sixteenths += (int32_t)lroundf(8.0f * (float)(before - after) / (float)curvature);
+      }
+      if(sixteenths < 1){
+        continue;
+      }
+      disparity[x] = (uint16_t)sixteenths;
+      depth[x] = engine->depthScale / (float)sixteenths;
+      valid++;
+    }
+  }
+  atomic_fetch_add_explicit(&engine->valid, valid, memory_order_relaxed);
+}
+
+static void rectifyBand(void *context, uint32_t band, uint32_t worker){
+  (void)worker;
+  StereoDepth *engine = context;
+  uint32_t begin = band * engine->bandRows;
+  uint32_t end = begin + engine->bandRows < engine->height ? begin + engine->bandRows : engine->height;
+  rectifyRows(engine, 0, begin, end);
+  rectifyRows(engine, 1, begin, end);
+}
+
+static void featureBand(void *context, uint32_t band, uint32_t worker){
+  StereoDepth *engine = context;
+  uint32_t begin = band * engine->bandRows;
+  uint32_t end = begin + engine->bandRows < engine->height ? begin + engine->bandRows : engine->height;
+  featureRows(engine, begin, end, &engine->scratch[worker]);
+}
+
+static void matchBand(void *context, uint32_t band, uint32_t worker){
+  StereoDepth *engine = context;
+  uint32_t begin = band * engine->bandRows;
+  uint32_t end = begin + engine->bandRows < engine->height ? begin + engine->bandRows : engine->height;
+  matchRows(engine, begin, end, &engine->scratch[worker]);
+}
+
+static bool isMatchable(const StereoDepth *engine, const LEAP_IMAGE_EVENT *event){
+  const LEAP_IMAGE_PROPERTIES *left = &event->image[0].properties, *right = &event->image[1].properties;
+  return event->image[0].data && event->image[1].data &&
+         left->bpp == 1 && right->bpp == 1 &&
+         left->width == right->width && left->height == right->height &&
+         left->width > engine->disparities + 2 * engine->config.block_radius + 2 &&
+         left->height > 2 * engine->config.block_radius + 2;
+}
+
+/** Computes the depth map of one image event, or returns NULL if the images cannot be matched. */
+const DepthMap* ComputeDepth(StereoDepth *engine, const LEAP_IMAGE_EVENT *event){
+  if(!isMatchable(engine, event) ||
+     !ensureSize(engine, event->image[0].properties.width, event->image[0].properties.height)){
+    engine->stats.rejected++;
+    return NULL;
+  }
+  int64_t start = LeapGetNow();
+  engine->event = event;
+  for(int c = 0; c < 2; c++){
+    const LEAP_IMAGE *image = &event->image[c];
+    RectifyTable *table = &engine->tables[c];
+    if(image->distortion_matrix && (!table->built || table->version != image->matrix_version)){
+      buildTable(engine, table, image);
+    }
+  }
+  RunParallel(engine->pool, engine->bands, rectifyBand, engine);
+  RunParallel(engine->pool, engine->bands, featureBand, engine);
+  int64_t rectified = LeapGetNow();
+
+  atomic_store_explicit(&engine->valid, 0, memory_order_relaxed);
+  RunParallel(engine->pool, engine->bands, matchBand, engine);
+  engine->event = NULL;
+
+  engine->map.frame_id = event->info.frame_id;
+  engine->map.timestamp = event->info.timestamp;
+  engine->map.valid = atomic_load_explicit(&engine->valid, memory_order_relaxed);
+  engine->stats.frames++;
+  engine->stats.rectifyTime += rectified - start;
+  engine->stats.matchTime += LeapGetNow() - rectified;
+  return &engine->map;
+}
+
+/** The last rectified image of camera 0 (left) or 1 (right), width x height bytes. */
+const uint8_t* GetRectifiedImage(const StereoDepth *engine, uint32_t camera){
+  return camera < 2 && engine->width ? engine->rectified[camera] : NULL;
+}
+
+void GetStereoDepthStats(const StereoDepth *engine, StereoDepthStats *stats){
+  *stats = engine->stats;
+}
+//End-of-StereoDepth.c
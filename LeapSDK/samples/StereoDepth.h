@@ -0,0 +1,79 @@
+/* Dense depth from the stereo IR image pair.
+ *
+ * Each LEAP_IMAGE_EVENT is processed in three passes spread over a
+ * WorkerPool in bands of rows:
+ *
+ *  1. Both images are resampled into a rectified view through a lookup table
+ *     built from the camera's distortion matrix. The table is only rebuilt
+ *     when the image's matrix_version changes. Images without a distortion
+ *     matrix are taken as already rectified.
+ *  2. The rectified images are turned into matching features: the grey
+ *     values for SAD, or a 3x3 census signature per pixel for census costs,
+ *     which tolerates the exposure differences between the two cameras.
+ *  3. Block matching compares each left pixel with the right pixels up to
+ *     max_disparity to its left. Per-pixel costs are summed over a square
+ *     window with running column and row sums, so the cost of a window does
+ *     not depend on its size, and the best disparity is refined to 1/16 pixel
+ *     with a parabola through its neighbours. The cost kernels process 16
+ *     disparities per instruction with SSE2 when the compiler targets it.
+ *
+ * The rectified view spans ray slopes -range_x..range_x horizontally and
+ * -range_y..range_y vertically at the source image size, so a disparity of d
+ * pixels is a slope difference of d * 2 * range_x / (width - 1) and the depth
+ * is baseline divided by that.
+ *
+ * The returned DepthMap is owned by the engine and valid until the next call.
+ *
+ */
+
+#ifndef StereoDepth_h
+#define StereoDepth_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum _eStereoCost {
+  eStereoCost_SAD,                //Absolute grey-level difference
+  eStereoCost_Census              //Hamming distance of 3x3 census signatures
+} eStereoCost;
+
+typedef struct _StereoDepthConfig {
+  eStereoCost cost;
+  uint32_t    max_disparity;      //Pixels searched; rounded up to a multiple of 16, at most 256
+  uint32_t    block_radius;       //Window is (2r+1)^2 pixels; 1 to 5
+  uint32_t    uniqueness;         //Percent the second-best cost must exceed the best by; 0 disables
+  float       range_x;            //Ray-slope half ranges of the rectified view
+  float       range_y;
+  float       baseline;           //Distance between the cameras in millimetres
+  uint32_t    threads;            //Including the calling thread; 0 for one per CPU
+} StereoDepthConfig;
+
+typedef struct _DepthMap {
+  int64_t   frame_id;
+  int64_t   timestamp;
+  uint32_t  width;
+  uint32_t  height;
+  uint32_t  valid;                //Pixels with a disparity
+  uint16_t *disparity;            //1/16 pixel steps, 0 where there was no reliable match
+  float    *depth;                //Millimetres along the optical axis, 0 where there was no match
+} DepthMap;
+
+typedef struct _StereoDepthStats {
+  uint64_t frames;
+  uint64_t rejected;              //Events whose images could not be matched
+  uint32_t tableBuilds;           //Rectification tables built
+  int64_t  rectifyTime;           //Microseconds summed over all frames
+  int64_t  matchTime;
+} StereoDepthStats;
+
+typedef struct _StereoDepth StereoDepth;
+
+void GetDefaultStereoDepthConfig(StereoDepthConfig *config);
+StereoDepth* CreateStereoDepth(const StereoDepthConfig *config);
+void DestroyStereoDepth(StereoDepth *engine);
+const DepthMap* ComputeDepth(StereoDepth *engine, const LEAP_IMAGE_EVENT *event);
+const uint8_t* GetRectifiedImage(const StereoDepth *engine, uint32_t camera);
+void GetStereoDepthStats(const StereoDepth *engine, StereoDepthStats *stats);
+
+#endif /* StereoDepth_h */
@@ -0,0 +1,206 @@
+/* Times the stereo depth engine on image pairs and checks the disparities.
+ *
+ * Without arguments it renders random-dot pairs at the 640x240 size of the
+ * original Leap Motion Controller: a background plane, a slanted surface and
+ * a near box standing in for a hand, moving between frames. Each pair carries
+ * a distortion grid that maps the rectified view straight onto the image, so
+ * the rectification pass runs at full cost while the true disparity of every
+ * pixel stays known.
+ *
+ * Given a file name, width and height it instead reads a recorded sequence:
+ * raw 8-bit left and right images, one pair after the other. There is no
+ * ground truth for those, so only timing and match density are reported.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "LeapThreads.h"
+#include "StereoDepth.h"
+
+#define SYNTHETIC_WIDTH 640
+#define SYNTHETIC_HEIGHT 240
+#define SYNTHETIC_FRAMES 16
+#define REPEATS 8
+#define MAX_DISPARITY 64
+
+static float trueDisparity(uint32_t x, uint32_t y, uint32_t frame){
+  uint32_t boxLeft = 260 + 8 * frame, boxTop = 60 + 2 * frame;
+  if(x >= boxLeft && x < boxLeft + 140 && y >= boxTop && y < boxTop + 110){
+    return 40.0f;
+  }
+  if(y > 160){
+    return 10.0f + 0.15f * (float)(y - 160);
+  }
+  return 8.0f;
+}
+
+/** Renders a random-dot pair; the right image shows every left pixel shifted by its disparity. */
+static void renderPair(uint8_t *left, uint8_t *right, float *truth, uint32_t W, uint32_t H, uint32_t frame){
+  for(uint32_t y = 0; y < H; y++){
+    for(uint32_t x = 0; x < W; x++){
+      truth[(size_t)y * W + x] = trueDisparity(x, y, frame);
+      left[(size_t)y * W + x] = (uint8_t)(rand() & 0xff);
+    }
+    for(uint32_t x = 0; x < W; x++){
+      //Right pixel x sees the left pixel at x + d; search for it in the left row.
+      float best = 1e9f;
+      uint8_t value = 0;
+      for(uint32_t s = x; s < W && s < x + MAX_DISPARITY; s++){
+        float error = fabsf((float)s - trueDisparity(s, y, frame) - (float)x);
+        if(error < best){
+          best = error;
+          float source = (float)x + trueDisparity(s, y, frame);
+          uint32_t i0 = (uint32_t)source;
+          float f = source - (float)i0;
+          uint32_t i1 = i0 + 1 < W ? i0 + 1 : i0;
+          value = (uint8_t)(left[(size_t)y * W + i0] * (1.0f - f) + left[(size_t)y * W + i1] * f + 0.5f);
+        }
+      }
+      right[(size_t)y * W + x] = (uint8_t)(value + (rand() % 7) - 3);
+    }
+  }
+}
+
+/** A grid whose rectified view covers the image exactly, in normalised coordinates. */
+static void fillLinearGrid(LEAP_DISTORTION_MATRIX *matrix, float range_x, float range_y){
+  for(int i = 0; i < LEAP_DISTORTION_MATRIX_N; i++){
+    for(int j = 0; j < LEAP_DISTORTION_MATRIX_N; j++){
+      float slopeX = -4.0f + 8.0f * (float)j / (LEAP_DISTORTION_MATRIX_N - 1);
+      float slopeY = -4.0f + 8.0f * (float)i / (LEAP_DISTORTION_MATRIX_N - 1);
+      matrix->matrix[i][j].x = (slopeX / range_x + 1.0f) * 0.5f;
+      matrix->matrix[i][j].y = (slopeY / range_y + 1.0f) * 0.5f;
+    }
+  }
+}
+
+static void run(const char *label, eStereoCost cost, uint32_t threads, LEAP_IMAGE_EVENT *events,
+                uint32_t frames, float *const *truths){
+  StereoDepthConfig config;
+  GetDefaultStereoDepthConfig(&config);
+  config.cost = cost;
+  config.max_disparity = MAX_DISPARITY;
+  config.threads = threads;
+  StereoDepth *engine = CreateStereoDepth(&config);
+  if(!engine){
+    printf("Failed to create the stereo engine.\n");
+    return;
+  }
+  uint64_t pixels = 0, valid = 0, good = 0, checked = 0;
+  int64_t start = LeapGetNow();
+  for(uint32_t r = 0; r < REPEATS; r++){
+    for(uint32_t f = 0; f < frames; f++){
+      const DepthMap *map = ComputeDepth(engine, &events[f]);
+      if(!map || r > 0){
+        continue;
+      }
+      pixels += (uint64_t)map->width * map->height;
+      valid += map->valid;
+      if(!truths){
+        continue;
+      }
+      for(size_t i = 0; i < (size_t)map->width * map->height; i++){
+        if(map->disparity[i]){
+          checked++;
+          good += fabsf(map->disparity[i] / 16.0f - truths[f][i]) <= 1.0f;
+        }
+      }
+    }
+  }
+  int64_t elapsed = LeapGetNow() - start;
+  StereoDepthStats stats;
+  GetStereoDepthStats(engine, &stats);
+  double perFrame = (double)elapsed / ((double)REPEATS * frames);
+  printf("  %-6s %u threads %8.2f ms/frame (%6.1f fps; rectify %.2f ms, match %.2f ms), %5.1f%% matched",
+         label, threads, perFrame / 1000.0, 1e6 / perFrame,
+         (double)stats.rectifyTime / stats.frames / 1000.0, (double)stats.matchTime / stats.frames / 1000.0,
+         pixels ? 100.0 * valid / pixels : 0.0);
+  if(truths){
+    printf(", %5.1f%% within 1 px", checked ? 100.0 * good / checked : 0.0);
+  }
+  printf("\n");
+  DestroyStereoDepth(engine);
+}
+
+int main(int argc, char** argv) {
+  uint32_t W = SYNTHETIC_WIDTH, H = SYNTHETIC_HEIGHT, frames = SYNTHETIC_FRAMES;
+  uint8_t *pixels = NULL;
+  float **truths = NULL;
+  LEAP_DISTORTION_MATRIX *grid = NULL;
+  if(argc >= 4){
+    W = (uint32_t)atoi(argv[2]);
+    H = (uint32_t)atoi(argv[3]);
+    FILE *file = fopen(argv[1], "rb");
+    if(!file || W == 0 || H == 0){
+      printf("Usage: %s [<pairs.raw> <width> <height>]\n", argv[0]);
+      return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    frames = (uint32_t)(size / ((long)W * H * 2));
+    pixels = malloc((size_t)frames * W * H * 2);
+    if(!pixels || frames == 0 || fread(pixels, (size_t)W * H * 2, frames, file) != frames){
+      printf("Could not read any %ux%u image pairs from %s.\n", W, H, argv[1]);
+      return 1;
+    }
+    fclose(file);
+    printf("%u recorded %ux%u pairs from %s\n", frames, W, H, argv[1]);
+  } else {
+    srand(42);
+    StereoDepthConfig defaults;
+    GetDefaultStereoDepthConfig(&defaults);
+    pixels = malloc((size_t)frames * W * H * 2);
+    truths = malloc(frames * sizeof(float*));
+    grid = malloc(sizeof(LEAP_DISTORTION_MATRIX));
+    if(!pixels || !truths || !grid){
+      printf("Failed to allocate the images.\n");
+      return 1;
+    }
+    fillLinearGrid(grid, defaults.range_x, defaults.range_y);
+    for(uint32_t f = 0; f < frames; f++){
+      truths[f] = malloc((size_t)W * H * sizeof(float));
+      uint8_t *pair = pixels + (size_t)f * W * H * 2;
+      renderPair(pair, pair + (size_t)W * H, truths[f], W, H, f);
+    }
+    printf("%u synthetic %ux%u pairs, disparities 8 to 40 px\n", frames, W, H);
+  }
+
+  LEAP_IMAGE_EVENT *events = calloc(frames, sizeof(LEAP_IMAGE_EVENT));
+  for(uint32_t f = 0; f < frames; f++){
+    events[f].info.frame_id = f;
+    for(int c = 0; c < 2; c++){
+      LEAP_IMAGE *image = &events[f].image[c];
+      image->properties.type = eLeapImageType_Default;
+      image->properties.format = eLeapImageFormat_IR;
+      image->properties.bpp = 1;
+      image->properties.width = W;
+      image->properties.height = H;
+      image->matrix_version = grid ? 1 + c : 0;
+      image->distortion_matrix = grid;
+      image->data = pixels + ((size_t)f * 2 + c) * W * H;
+    }
+  }
+
+  uint32_t cpus = GetCpuCount();
+  printf("%u CPUs, %u disparities\n", cpus, MAX_DISPARITY);
+  for(uint32_t threads = 1; threads <= 8; threads *= 2){
+    run("SAD", eStereoCost_SAD, threads, events, frames, truths);
+    run("census", eStereoCost_Census, threads, events, frames, truths);
+  }
+
+  if(truths){
+    for(uint32_t f = 0; f < frames; f++){
+      free(truths[f]);
+    }
+  }
+  free(truths);
+  free(grid);
+  free(events);
+  free(pixels);
+  return 0;
+}
+//End-of-Sample
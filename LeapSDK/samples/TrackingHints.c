@@ -0,0 +1,482 @@
+/* Load-adaptive tracking hints, see TrackingHints.h.
+ *
+ * The period accumulators and the hysteresis state belong to the thread that
+ * observes and steps. The level, the rings and the stats are also read by
+ * queries, so they are written under the lock, once per period.
+ *
+ */
+
+#include "TrackingHints.h"
+#include "LeapMath.h"
+#include "LeapThreads.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__APPLE__)
+  #include <mach/mach.h>
+#endif
+
+static const char *levelHints[eTrackingHintsLevel_Count] = {
+  LEAP_HINT_LOW_RESOURCE_USAGE,
+  LEAP_HINT_BALANCED,
+  LEAP_HINT_FAST_HAND_MOTION,
+  LEAP_HINT_HIGH_HAND_FIDELITY
+};
+
+struct _TrackingHints {
+  TrackingHintsConfig    config;
+  LEAP_CONNECTION        connection;
+  LEAP_DEVICE            device;
+  LockType               lock;
+  //Stepping thread only
+  HostCpuLoad            cpu;
+  int64_t                periodStart;
+  uint32_t               frames;
+  uint32_t               misses;
+  uint32_t               maxHands;
+  double                 speedSum;
+  int64_t                lastInput;         //0 before the first
+  int64_t                lastHands;
+  int64_t                holdUntil;         //Dwell after a switch
+  int64_t                retryAt;           //Back-off after a failed switch
+  bool                   overloaded;
+  eTrackingHintsLevel    pending;
+  uint32_t               pendingCount;
+  //Under the lock
+  eTrackingHintsLevel    level;
+  TrackingHintsInput    *inputs;
+  uint64_t               inputCount;
+  TrackingHintsDecision *decisions;
+  uint64_t               decisionCount;
+  TrackingHintsStats     stats;
+};
+
+void GetDefaultTrackingHintsConfig(TrackingHintsConfig *config){
+  memset(config, 0, sizeof(TrackingHintsConfig));
+  config->period_us = 500000;
+  config->cpu_high = 0.85f;
+  config->cpu_recover = 0.70f;
+  config->miss_high = 0.05f;
+  config->miss_recover = 0.01f;
+  config->fast_enter = 600.0f;
+  config->fast_exit = 350.0f;
+  config->idle_after_us = 3000000;
+  config->confirm_periods = 3;
+  config->fast_confirm_periods = 1;
+  config->min_dwell_us = 2000000;
+  config->initial = eTrackingHintsLevel_Balanced;
+  config->level_cost[eTrackingHintsLevel_LowResource] = 0.5f;
+  config->level_cost[eTrackingHintsLevel_Balanced] = 1.0f;
+  config->level_cost[eTrackingHintsLevel_FastMotion] = 1.3f;
+  config->level_cost[eTrackingHintsLevel_HighFidelity] = 1.6f;
+  config->history = 7200;
+  config->log_capacity = 256;
+}
+
+static eLeapRS applyLevel(TrackingHints *hints, eTrackingHintsLevel level){
+  if(!hints->connection || !hints->device){
+    return eLeapRS_Success;
+  }
+  const char *list[TRACKING_HINTS_MAX_BASE + 2];
+  uint32_t count = 0;
+  while(count < TRACKING_HINTS_MAX_BASE && hints->config.base_hints[count]){
+    list[count] = hints->config.base_hints[count];
+    count++;
+  }
+  list[count++] = levelHints[level];
+  list[count] = NULL;
+  return LeapSetDeviceHints(hints->connection, hints->device, list);
+}
+
+TrackingHints* CreateTrackingHints(const TrackingHintsConfig *config, LEAP_CONNECTION connection, LEAP_DEVICE device){
+  TrackingHintsConfig defaults;
+  if(!config){
+    GetDefaultTrackingHintsConfig(&defaults);
+    config = &defaults;
+  }
+  if(config->period_us <= 0 || config->initial >= eTrackingHintsLevel_Count){
+    return NULL;
+  }
+  TrackingHints *hints = calloc(1, sizeof(TrackingHints));
+  if(!hints){
+    return NULL;
+  }
+  hints->config = *config;
+  hints->inputs = config->history ? malloc((size_t)config->history * sizeof(TrackingHintsInput)) : NULL;
+  hints->decisions = config->log_capacity ? malloc((size_t)config->log_capacity * sizeof(TrackingHintsDecision)) : NULL;
+  if((config->history && !hints->inputs) || (config->log_capacity && !hints->decisions)){
+    free(hints->inputs);
+    free(hints->decisions);
+    free(hints);
+    return NULL;
+  }
+  hints->connection = connection;
+  hints->device = device;
+  hints->level = hints->pending = hints->stats.level = config->initial;
+  InitLock(&hints->lock);
+  float load;
+  ReadHostCpuLoad(&hints->cpu, &load);      //Primes the counters
+
+  //Whatever the device was left at, start from the level the controller assumes
+  TrackingHintsDecision decision;
+  memset(&decision, 0, sizeof(decision));
+  decision.from = decision.to = config->initial;
+  decision.reason = eTrackingHintsReason_Default;
+  decision.result = applyLevel(hints, config->initial);
+  decision.input.timestamp = LeapGetNow();
+  if(decision.result != eLeapRS_Success){
+    if(config->log_capacity){
+      hints->decisions[0] = decision;
+    }
+    hints->decisionCount = 1;
+    hints->stats.failures = 1;
+    if(config->callback){
+      config->callback(&decision, config->context);
+    }
+  }
+  return hints;
+}
+
+void DestroyTrackingHints(TrackingHints *hints){
+  if(!hints){
+    return;
+  }
+  DestroyLock(&hints->lock);
+  free(hints->inputs);
+  free(hints->decisions);
+  free(hints);
+}
+
+void ObserveTrackingHintsFrame(TrackingHints *hints, const LEAP_TRACKING_EVENT *frame, bool deadline_missed){
+  float fastest = 0.0f;
+  for(uint32_t h = 0; h < frame->nHands; h++){
+    float speed = VectorLength(frame->pHands[h].palm.velocity);
+    fastest = speed > fastest ? speed : fastest;
+  }
+  hints->frames++;
+  hints->misses += deadline_missed;
+  hints->speedSum += fastest;
+  hints->maxHands = frame->nHands > hints->maxHands ? frame->nHands : hints->maxHands;
+}
+
+bool StepTrackingHints(TrackingHints *hints, int64_t now){
+  if(!hints->periodStart){
+    hints->periodStart = now;
+    return false;
+  }
+  if(now - hints->periodStart < hints->config.period_us){
+    return false;
+  }
+  TrackingHintsInput input;
+  float load;
+  input.timestamp = now;
+  input.cpuLoad = ReadHostCpuLoad(&hints->cpu, &load) ? load : -1.0f;
+  input.missRate = hints->frames ? (float)hints->misses / hints->frames : 0.0f;
+  input.handSpeed = hints->frames ? (float)(hints->speedSum / hints->frames) : 0.0f;
+  input.frames = hints->frames;
+  input.hands = hints->maxHands;
+  hints->periodStart = now;
+  hints->frames = hints->misses = hints->maxHands = 0;
+  hints->speedSum = 0.0;
+  return FeedTrackingHints(hints, &input);
+}
+
+/** The level this input calls for, before confirmation and dwell. */
+static eTrackingHintsLevel decide(TrackingHints *hints, const TrackingHintsInput *input, eTrackingHintsReason *reason){
+  const TrackingHintsConfig *config = &hints->config;
+  eTrackingHintsLevel level = hints->level;
+  float cpu = input->cpuLoad < 0.0f ? 0.0f : input->cpuLoad;
+  if(!hints->overloaded){
+    hints->overloaded = cpu > config->cpu_high || input->missRate > config->miss_high;
+  } else if(cpu < config->cpu_recover && input->missRate < config->miss_recover){
+    hints->overloaded = false;
+  }
+  if(input->hands){
+    hints->lastHands = input->timestamp;
+  }
+
+  if(input->timestamp - hints->lastHands >= config->idle_after_us){
+    *reason = eTrackingHintsReason_Idle;
+    return eTrackingHintsLevel_LowResource;
+  }
+  if(hints->overloaded){
+    *reason = eTrackingHintsReason_Overload;
+    return level > eTrackingHintsLevel_Balanced ? eTrackingHintsLevel_Balanced : eTrackingHintsLevel_LowResource;
+  }
+  if(!input->hands){
+    //Hands lost briefly; wait for them or for idle_after_us
+    *reason = eTrackingHintsReason_Default;
+    return level;
+  }
+  if(input->handSpeed > (level == eTrackingHintsLevel_FastMotion ? config->fast_exit : config->fast_enter)){
+    *reason = eTrackingHintsReason_FastMotion;
+    return eTrackingHintsLevel_FastMotion;
+  }
+  if(config->precise_enter > 0.0f){
+    bool precise = level == eTrackingHintsLevel_HighFidelity ?
+                   input->handSpeed < config->precise_exit :
+                   input->handSpeed < config->precise_enter && cpu < config->cpu_recover &&
+                   input->missRate < config->miss_recover;
+    if(precise){
+      *reason = eTrackingHintsReason_Precision;
+      return eTrackingHintsLevel_HighFidelity;
+    }
+  }
+  *reason = eTrackingHintsReason_Default;
+  return eTrackingHintsLevel_Balanced;
+}
+
+bool FeedTrackingHints(TrackingHints *hints, const TrackingHintsInput *input){
+  const TrackingHintsConfig *config = &hints->config;
+  int64_t elapsed = hints->lastInput ? input->timestamp - hints->lastInput : config->period_us;
+  if(!hints->lastInput){
+    hints->lastHands = input->timestamp;
+  }
+  hints->lastInput = input->timestamp;
+
+  eTrackingHintsLevel level = hints->level;
+  eTrackingHintsReason reason;
+  eTrackingHintsLevel target = decide(hints, input, &reason);
+  bool switching = false;
+  if(target == level){
+    hints->pendingCount = 0;
+  } else {
+    if(target != hints->pending){
+      hints->pending = target;
+      hints->pendingCount = 0;
+    }
+    hints->pendingCount++;
+    //Fast hands, or hands back after idling, are served before the dwell is up
+    bool urgent = target == eTrackingHintsLevel_FastMotion ||
+                  (level == eTrackingHintsLevel_LowResource && reason != eTrackingHintsReason_Overload);
+    switching = hints->pendingCount >= (urgent ? config->fast_confirm_periods : config->confirm_periods) &&
+                input->timestamp >= hints->retryAt && (urgent || input->timestamp >= hints->holdUntil);
+  }
+  TrackingHintsDecision decision;
+  if(switching){
+    decision.from = level;
+    decision.to = target;
+    decision.reason = reason;
+    decision.result = applyLevel(hints, target);
+    decision.input = *input;
+    if(decision.result == eLeapRS_Success){
+      hints->holdUntil = input->timestamp + config->min_dwell_us;
+      hints->pendingCount = 0;
+    } else {
+      hints->retryAt = input->timestamp + config->min_dwell_us;
+    }
+  }
+
+  LockMutex(&hints->lock);
+  if(config->history){
+    hints->inputs[hints->inputCount % config->history] = *input;
+  }
+  hints->inputCount++;
+  hints->stats.periods++;
+  hints->stats.timeAt[level] += elapsed;
+  hints->stats.cpuUnavailable += input->cpuLoad < 0.0f;
+  if(switching){
+    if(config->log_capacity){
+      hints->decisions[hints->decisionCount % config->log_capacity] = decision;
+    }
+    hints->decisionCount++;
+    if(decision.result == eLeapRS_Success){
+      hints->level = hints->stats.level = target;
+      hints->stats.switches++;
+    } else {
+      hints->stats.failures++;
+    }
+  }
+  UnlockMutex(&hints->lock);
+
+  if(switching && config->callback){
+    config->callback(&decision, config->context);
+  }
+  return switching && decision.result == eLeapRS_Success;
+}
+
+eTrackingHintsLevel GetTrackingHintsLevel(TrackingHints *hints){
+  LockMutex(&hints->lock);
+  eTrackingHintsLevel level = hints->level;
+  UnlockMutex(&hints->lock);
+  return level;
+}
+
+uint32_t GetTrackingHintsDecisions(TrackingHints *hints, TrackingHintsDecision *decisions, uint32_t max){
+  LockMutex(&hints->lock);
+  uint32_t capacity = hints->config.log_capacity;
+  uint64_t kept = hints->decisionCount < capacity ? hints->decisionCount : capacity;
+  uint32_t count = 0;
+  for(uint64_t i = hints->decisionCount - (kept < max ? kept : max); i < hints->decisionCount; i++){
+    decisions[count++] = hints->decisions[i % capacity];
+  }
+  UnlockMutex(&hints->lock);
+  return count;
+}
+
+uint32_t GetTrackingHintsInputs(TrackingHints *hints, TrackingHintsInput *inputs, uint32_t max){
+  LockMutex(&hints->lock);
+  uint32_t capacity = hints->config.history;
+  uint64_t kept = hints->inputCount < capacity ? hints->inputCount : capacity;
+  uint32_t count = 0;
+  for(uint64_t i = hints->inputCount - (kept < max ? kept : max); i < hints->inputCount; i++){
+    inputs[count++] = hints->inputs[i % capacity];
+  }
+  UnlockMutex(&hints->lock);
+  return count;
+}
+
+void GetTrackingHintsStats(TrackingHints *hints, TrackingHintsStats *stats){
+  LockMutex(&hints->lock);
+  *stats = hints->stats;
+  UnlockMutex(&hints->lock);
+}
+
+const char* TrackingHintsLevelString(eTrackingHintsLevel level){
+  switch(level){
+    case eTrackingHintsLevel_LowResource:  return "low resource";
+    case eTrackingHintsLevel_Balanced:     return "balanced";
+    case eTrackingHintsLevel_FastMotion:   return "fast motion";
+    case eTrackingHintsLevel_HighFidelity: return "high fidelity";
+    default:                               return "unknown";
+  }
+}
+
+const char* TrackingHintsReasonString(eTrackingHintsReason reason){
+  switch(reason){
+    case eTrackingHintsReason_Idle:       return "no hands";
+    case eTrackingHintsReason_Overload:   return "overload";
+    case eTrackingHintsReason_FastMotion: return "fast hands";
+    case eTrackingHintsReason_Precision:  return "slow hands with headroom";
+    case eTrackingHintsReason_Default:    return "default";
+    default:                              return "unknown";
+  }
+}
+
+#define TRACE_HEADER "timestamp,cpu_load,miss_rate,hand_speed,frames,hands\n"
+
+bool WriteTrackingHintsTrace(FILE *out, const TrackingHintsInput *inputs, uint32_t count){
+  if(fputs(TRACE_HEADER, out) < 0){
+    return false;
+  }
+  for(uint32_t i = 0; i < count; i++){
+    if(fprintf(out, "%lld,%.4f,%.4f,%.1f,%u,%u\n", (long long)inputs[i].timestamp, inputs[i].cpuLoad,
+               inputs[i].missRate, inputs[i].handSpeed, inputs[i].frames, inputs[i].hands) < 0){
+      return false;
+    }
+  }
+  return fflush(out) == 0;
+}
+
+uint32_t ReadTrackingHintsTrace(FILE *in, TrackingHintsInput *inputs, uint32_t max){
+  char line[256];
+  if(!fgets(line, sizeof(line), in) || strcmp(line, TRACE_HEADER) != 0){
+    return 0;
+  }
+  uint32_t count = 0;
+  while(count < max && fgets(line, sizeof(line), in)){
+    if(line[0] == '\n' || line[0] == '\r'){
+      continue;
+    }
+    long long timestamp;
+    TrackingHintsInput *input = &inputs[count];
+    if(sscanf(line, "%lld,%f,%f,%f,%u,%u", &timestamp, &input->cpuLoad, &input->missRate, &input->handSpeed,
+              &input->frames, &input->hands) != 6){
+      return 0;
+    }
+    input->timestamp = timestamp;
+    count++;
+  }
+  return count;
+}
+
+bool EvaluateTrackingHints(const TrackingHintsConfig *config, const TrackingHintsInput *inputs, uint32_t count,
+                           TrackingHintsEvaluation *evaluation){
+  TrackingHintsConfig replay;
+  if(config){
+    replay = *config;
+  } else {
+    GetDefaultTrackingHintsConfig(&replay);
+  }
+  replay.history = 0;
+  TrackingHints *hints = CreateTrackingHints(&replay, NULL, NULL);
+  if(!hints){
+    return false;
+  }
+  memset(evaluation, 0, sizeof(TrackingHintsEvaluation));
+  int64_t last = 0;
+  for(uint32_t i = 0; i < count; i++){
+    const TrackingHintsInput *input = &inputs[i];
+    eTrackingHintsLevel level = hints->level;
+    int64_t elapsed = last ? input->timestamp - last : replay.period_us;
+    double seconds = elapsed / 1e6;
+    last = input->timestamp;
+    evaluation->cost += replay.level_cost[level] * seconds;
+    for(int l = 0; l < eTrackingHintsLevel_Count; l++){
+      evaluation->staticCost[l] += replay.level_cost[l] * seconds;
+    }
+    bool overload = input->cpuLoad > replay.cpu_high || input->missRate > replay.miss_high;
+    if(!overload && input->hands && input->handSpeed > replay.fast_enter && level != eTrackingHintsLevel_FastMotion){
+      evaluation->underserved += elapsed;
+    }
+    if(overload && level >= eTrackingHintsLevel_FastMotion){
+      evaluation->overloaded += elapsed;
+    }
+    FeedTrackingHints(hints, input);
+  }
+  TrackingHintsStats stats;
+  GetTrackingHintsStats(hints, &stats);
+  evaluation->periods = stats.periods;
+  evaluation->switches = stats.switches;
+  memcpy(evaluation->timeAt, stats.timeAt, sizeof(stats.timeAt));
+  DestroyTrackingHints(hints);
+  return true;
+}
+
+bool ReadHostCpuLoad(HostCpuLoad *state, float *load){
+  uint64_t busy, total;
+#if defined(_MSC_VER)
+  FILETIME idle, kernel, user;
+  if(!GetSystemTimes(&idle, &kernel, &user)){
+    return false;
+  }
+  uint64_t idleTime = ((uint64_t)idle.dwHighDateTime << 32) | idle.dwLowDateTime;
+  total = (((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +   //Kernel time includes idle time
+          (((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime);
+  busy = total - idleTime;
+#elif defined(__APPLE__)
+  host_cpu_load_info_data_t info;
+  mach_msg_type_number_t count = HOST_CPU_LOAD_INFO_COUNT;
+  if(host_statistics(mach_host_self(), HOST_CPU_LOAD_INFO, (host_info_t)&info, &count) != KERN_SUCCESS){
+    return false;
+  }
+  busy = (uint64_t)info.cpu_ticks[CPU_STATE_USER] + info.cpu_ticks[CPU_STATE_SYSTEM] + info.cpu_ticks[CPU_STATE_NICE];
+  total = busy + info.cpu_ticks[CPU_STATE_IDLE];
+#elif defined(__linux__)
+  unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+  FILE *stat = fopen("/proc/stat", "r");
+  if(!stat){
+    return false;
+  }
+  int fields = fscanf(stat, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                      &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
+  fclose(stat);
+  if(fields < 4){
+    return false;
+  }
+  busy = user + nice + system + irq + softirq + steal;
+  total = busy + idle + iowait;
+#else
+  return false;
+#endif
+  bool primed = state->total != 0;
+  uint64_t busyDelta = busy - state->busy;
+  uint64_t totalDelta = total - state->total;
+  state->busy = busy;
+  state->total = total;
+  if(!primed || totalDelta == 0){
+    return false;
+  }
+  *load = (float)((double)busyDelta / (double)totalDelta);
+  return true;
+}
+//End-of-TrackingHints.c
@@ -0,0 +1,166 @@
+/* Switches a device's tracking hints as load and hand motion change.
+ *
+ * LeapSetDeviceHints() tells the service what kind of tracking a client
+ * wants, and some hints cost it more CPU than others. The controller picks
+ * one of four levels, each sent as a hint after any base_hints:
+ *
+ *   LowResource   LEAP_HINT_LOW_RESOURCE_USAGE   no hands for idle_after_us,
+ *                                                or still overloaded at Balanced
+ *   Balanced      LEAP_HINT_BALANCED             otherwise
+ *   FastMotion    LEAP_HINT_FAST_HAND_MOTION     hands moving faster than fast_enter
+ *   HighFidelity  LEAP_HINT_HIGH_HAND_FIDELITY   hands slower than precise_enter with
+ *                                                headroom; off unless precise_enter is set
+ *
+ * Overload, host CPU load above cpu_high or more than miss_high of the
+ * frames missing their deadline, takes precedence over hand motion and steps
+ * the level down.
+ *
+ * The polling thread passes every frame of the device to
+ * ObserveTrackingHintsFrame(), with whether the application missed its
+ * deadline for it, and calls StepTrackingHints() after every poll. Every
+ * period_us the frames are summarised with the host CPU load into a
+ * TrackingHintsInput and a level is chosen. Every threshold has separate
+ * enter and exit values, a new level must be wanted for confirm_periods
+ * periods in a row, and it is held for at least min_dwell_us, so the hints do
+ * not flap. Escalating to FastMotion is the exception: it needs
+ * fast_confirm_periods and ignores the dwell, as fast hands cannot wait.
+ *
+ * Each switch, and each failed LeapSetDeviceHints() call, is a
+ * TrackingHintsDecision: it is kept in a ring and passed to the callback on
+ * the polling thread. The inputs are kept too; WriteTrackingHintsTrace()
+ * saves them, and EvaluateTrackingHints() replays a trace through another
+ * configuration without a device, to compare thresholds offline.
+ *
+ * Queries may be called from any thread.
+ *
+ */
+
+#ifndef TrackingHints_h
+#define TrackingHints_h
+
+#include "LeapC.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACKING_HINTS_MAX_BASE 6
+
+typedef enum _eTrackingHintsLevel {
+  eTrackingHintsLevel_LowResource,
+  eTrackingHintsLevel_Balanced,
+  eTrackingHintsLevel_FastMotion,
+  eTrackingHintsLevel_HighFidelity,
+  eTrackingHintsLevel_Count
+} eTrackingHintsLevel;
+
+typedef enum _eTrackingHintsReason {
+  eTrackingHintsReason_Idle,          //No hands for idle_after_us
+  eTrackingHintsReason_Overload,      //CPU load or deadline misses above their limits
+  eTrackingHintsReason_FastMotion,
+  eTrackingHintsReason_Precision,     //Slow hands and headroom to spare
+  eTrackingHintsReason_Default
+} eTrackingHintsReason;
+
+/** One period's summary; the unit a trace records and replays. */
+typedef struct _TrackingHintsInput {
+  int64_t  timestamp;                 //End of the period, LeapGetNow() microseconds
+  float    cpuLoad;                   //Host, 0 to 1; negative when unknown
+  float    missRate;                  //Fraction of the frames that missed their deadline
+  float    handSpeed;                 //Mean over the frames of the fastest palm, mm/s
+  uint32_t frames;
+  uint32_t hands;                     //Most hands in any frame
+} TrackingHintsInput;
+
+typedef struct _TrackingHintsDecision {
+  eTrackingHintsLevel  from;
+  eTrackingHintsLevel  to;
+  eTrackingHintsReason reason;
+  eLeapRS              result;        //Of LeapSetDeviceHints(); Success without a device. The level is kept on failure
+  TrackingHintsInput   input;         //That completed the switch
+} TrackingHintsDecision;
+
+typedef void (*tracking_hints_callback)(const TrackingHintsDecision *decision, void *context);
+
+typedef struct _TrackingHintsConfig {
+  int64_t  period_us;
+  float    cpu_high;                  //Host CPU load, 0 to 1
+  float    cpu_recover;
+  float    miss_high;                 //Fraction of frames
+  float    miss_recover;
+  float    fast_enter;                //Palm speed, mm/s
+  float    fast_exit;
+  float    precise_enter;             //0 to never use HighFidelity
+  float    precise_exit;
+  int64_t  idle_after_us;
+  uint32_t confirm_periods;
+  uint32_t fast_confirm_periods;
+  int64_t  min_dwell_us;
+  eTrackingHintsLevel initial;        //Sent to the device at creation; a failure is logged as a decision
+  const char *base_hints[TRACKING_HINTS_MAX_BASE + 1];  //Sent with every level, NULL-terminated; must outlive the controller
+  float    level_cost[eTrackingHintsLevel_Count];       //Relative service CPU, for EvaluateTrackingHints()
+  uint32_t history;                   //Inputs kept
+  uint32_t log_capacity;              //Decisions kept
+  tracking_hints_callback callback;   //May be NULL
+  void    *context;
+} TrackingHintsConfig;
+
+typedef struct _TrackingHintsStats {
+  uint64_t periods;
+  uint64_t switches;
+  uint64_t failures;                  //LeapSetDeviceHints() errors
+  uint64_t cpuUnavailable;            //Periods without a host CPU reading
+  int64_t  timeAt[eTrackingHintsLevel_Count];  //Microseconds
+  eTrackingHintsLevel level;
+} TrackingHintsStats;
+
+/** What a replayed trace would have cost and missed under one configuration. */
+typedef struct _TrackingHintsEvaluation {
+  uint64_t periods;
+  uint64_t switches;
+  int64_t  timeAt[eTrackingHintsLevel_Count];
+  double   cost;                      //level_cost x seconds
+  double   staticCost[eTrackingHintsLevel_Count];  //Had each level been held throughout
+  int64_t  underserved;               //Fast hands and no overload, not at FastMotion
+  int64_t  overloaded;                //Overload at FastMotion or HighFidelity
+} TrackingHintsEvaluation;
+
+/* Counters of the last host CPU reading */
+typedef struct _HostCpuLoad {
+  uint64_t busy;
+  uint64_t total;
+} HostCpuLoad;
+
+typedef struct _TrackingHints TrackingHints;
+
+void GetDefaultTrackingHintsConfig(TrackingHintsConfig *config);
+/* connection and device may be NULL to decide without sending hints. */
+TrackingHints* CreateTrackingHints(const TrackingHintsConfig *config, LEAP_CONNECTION connection, LEAP_DEVICE device);
+void DestroyTrackingHints(TrackingHints *hints);
+
+/* For the polling thread */
+void ObserveTrackingHintsFrame(TrackingHints *hints, const LEAP_TRACKING_EVENT *frame, bool deadline_missed);
+/* Closes the period once period_us has passed; returns true if the level changed. */
+bool StepTrackingHints(TrackingHints *hints, int64_t now);
+/* Decides on an input from elsewhere, such as a trace; returns true if the level changed. */
+bool FeedTrackingHints(TrackingHints *hints, const TrackingHintsInput *input);
+
+/* For any thread */
+eTrackingHintsLevel GetTrackingHintsLevel(TrackingHints *hints);
+/* Copies the newest decisions or inputs, up to max, oldest first. Return the count. */
+uint32_t GetTrackingHintsDecisions(TrackingHints *hints, TrackingHintsDecision *decisions, uint32_t max);
+uint32_t GetTrackingHintsInputs(TrackingHints *hints, TrackingHintsInput *inputs, uint32_t max);
+void GetTrackingHintsStats(TrackingHints *hints, TrackingHintsStats *stats);
+const char* TrackingHintsLevelString(eTrackingHintsLevel level);
+const char* TrackingHintsReasonString(eTrackingHintsReason reason);
+
+/* Traces are CSV, one input per line after a header. */
+bool WriteTrackingHintsTrace(FILE *out, const TrackingHintsInput *inputs, uint32_t count);
+/* Reads up to max inputs; returns the count, 0 on a malformed trace. */
+uint32_t ReadTrackingHintsTrace(FILE *in, TrackingHintsInput *inputs, uint32_t max);
+bool EvaluateTrackingHints(const TrackingHintsConfig *config, const TrackingHintsInput *inputs, uint32_t count,
+                           TrackingHintsEvaluation *evaluation);
+
+/* Fraction of CPU time busy on the host since the previous call; false on the first call or where unsupported. */
+bool ReadHostCpuLoad(HostCpuLoad *state, float *load);
+
+#endif /* TrackingHints_h */
@@ -0,0 +1,198 @@
+/* Adapts the first device's tracking hints to load and hand motion.
+ *
+ *   TrackingHintsSample [--seconds n] [--deadline ms] [--precise] [--record trace.csv]
+ *   TrackingHintsSample --replay trace.csv
+ *
+ * Live, the sample opens a multi-device aware connection, which
+ * LeapSetDeviceHints() requires, and drives a TrackingHints controller from
+ * its polling loop for n seconds (60 by default). A frame misses its deadline
+ * when it is polled more than ms (15 by default) after its timestamp.
+ * Switches are logged as they happen through AsyncLog, so the polling loop
+ * never waits on the console. --record saves the inputs for replay.
+ *
+ * --replay runs a recorded trace through the default configuration, one
+ * without hysteresis and one that also uses HighFidelity, and prints what
+ * each would have cost the service against holding a single level.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LeapC.h"
+#include "AsyncLog.h"
+#include "DeviceRegistry.h"
+#include "TrackingHints.h"
+
+#define MAX_TRACE 100000
+
+static void onDecision(const TrackingHintsDecision *decision, void *context){
+  (void)context;
+  if(decision->result != eLeapRS_Success){
+    ASYNC_LOG("Could not switch to %s: LeapSetDeviceHints() failed with 0x%x\n",
+              TrackingHintsLevelString(decision->to), (unsigned)decision->result);
+    return;
+  }
+  ASYNC_LOG("%s -> %s (%s): cpu %.2f, %.1f%% deadlines missed, %.0f mm/s, %u hands\n",
+            TrackingHintsLevelString(decision->from), TrackingHintsLevelString(decision->to),
+            TrackingHintsReasonString(decision->reason), (double)decision->input.cpuLoad,
+            decision->input.missRate * 100.0, (double)decision->input.handSpeed, decision->input.hands);
+}
+
+static void printEvaluation(const char *name, const TrackingHintsEvaluation *evaluation){
+  printf("%-16s %4llu switches, cost %7.1f, %5.1f s underserved, %5.1f s overloaded; time at",
+         name, (unsigned long long)evaluation->switches, evaluation->cost, evaluation->underserved / 1e6,
+         evaluation->overloaded / 1e6);
+  for(int l = 0; l < eTrackingHintsLevel_Count; l++){
+    printf(" %s %.0f s", TrackingHintsLevelString((eTrackingHintsLevel)l), evaluation->timeAt[l] / 1e6);
+  }
+  printf("\n");
+}
+
+static int replay(const char *path){
+  FILE *in = fopen(path, "r");
+  TrackingHintsInput *inputs = malloc(MAX_TRACE * sizeof(TrackingHintsInput));
+  uint32_t count = in && inputs ? ReadTrackingHintsTrace(in, inputs, MAX_TRACE) : 0;
+  if(in){
+    fclose(in);
+  }
+  if(!count){
+    printf("No trace in %s.\n", path);
+    free(inputs);
+    return 1;
+  }
+  printf("%u periods from %s\n", count, path);
+
+  TrackingHintsConfig config;
+  TrackingHintsEvaluation evaluation;
+  GetDefaultTrackingHintsConfig(&config);
+  config.callback = onDecision;
+  printf("Default configuration:\n");
+  EvaluateTrackingHints(&config, inputs, count, &evaluation);
+  printEvaluation("default", &evaluation);
+  for(int l = 0; l < eTrackingHintsLevel_Count; l++){
+    printf("%-16s cost %7.1f\n", TrackingHintsLevelString((eTrackingHintsLevel)l), evaluation.staticCost[l]);
+  }
+
+  config.callback = NULL;
+  config.cpu_recover = config.cpu_high;
+  config.miss_recover = config.miss_high;
+  config.fast_exit = config.fast_enter;
+  config.confirm_periods = config.fast_confirm_periods = 1;
+  config.min_dwell_us = 0;
+  EvaluateTrackingHints(&config, inputs, count, &evaluation);
+  printEvaluation("no hysteresis", &evaluation);
+
+  GetDefaultTrackingHintsConfig(&config);
+  config.precise_enter = 80.0f;
+  config.precise_exit = 150.0f;
+  EvaluateTrackingHints(&config, inputs, count, &evaluation);
+  printEvaluation("high fidelity", &evaluation);
+  free(inputs);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  int seconds = 60;
+  int64_t deadline = 15000;
+  const char *recordPath = NULL;
+  TrackingHintsConfig config;
+  GetDefaultTrackingHintsConfig(&config);
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc){
+      return replay(argv[i + 1]);
+    } else if(strcmp(argv[i], "--seconds") == 0 && i + 1 < argc){
+      seconds = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--deadline") == 0 && i + 1 < argc){
+      deadline = atoi(argv[++i]) * 1000LL;
+    } else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc){
+      recordPath = argv[++i];
+    } else if(strcmp(argv[i], "--precise") == 0){
+      config.precise_enter = 80.0f;
+      config.precise_exit = 150.0f;
+    } else {
+      printf("Usage: %s [--seconds n] [--deadline ms] [--precise] [--record trace.csv] | --replay trace.csv\n", argv[0]);
+      return 1;
+    }
+  }
+  config.callback = onDecision;
+  if(seconds * 2 > (int)config.history){
+    config.history = (uint32_t)seconds * 2;
+  }
+
+  LEAP_CONNECTION_CONFIG connectionConfig;
+  memset(&connectionConfig, 0, sizeof(connectionConfig));
+  connectionConfig.size = sizeof(connectionConfig);
+  connectionConfig.flags = eLeapConnectionConfig_MultiDeviceAware;
+  LEAP_CONNECTION connection;
+  if(LeapCreateConnection(&connectionConfig, &connection) != eLeapRS_Success ||
+     LeapOpenConnection(connection) != eLeapRS_Success){
+    printf("Failed to open a connection.\n");
+    return 1;
+  }
+  DeviceRegistry *devices = CreateDeviceRegistry();
+  StartAsyncLog(stdout, NULL);
+
+  TrackingHints *hints = NULL;
+  uint32_t deviceId = 0;
+  int64_t end = LeapGetNow() + seconds * 1000000LL;
+  while(LeapGetNow() < end){
+    LEAP_CONNECTION_MESSAGE msg;
+    eLeapRS result = LeapPollConnection(connection, 100, &msg);
+    int64_t now = LeapGetNow();
+    if(hints){
+      StepTrackingHints(hints, now);
+    }
+    if(result != eLeapRS_Success){
+      continue;
+    }
+    if(msg.type == eLeapEventType_Device && !hints){
+      DeviceSnapshot device;
+      if(RegisterDevice(devices, msg.device_event, &device) != eLeapRS_Success ||
+         LeapSubscribeEvents(connection, device.handle) != eLeapRS_Success){
+        continue;
+      }
+      deviceId = device.id;
+      ASYNC_LOG("Adapting the hints of device %u, starting at %s\n", deviceId,
+                TrackingHintsLevelString(config.initial));
+      hints = CreateTrackingHints(&config, connection, device.handle);
+    } else if(msg.type == eLeapEventType_Tracking && hints && msg.device_id == deviceId){
+      ObserveTrackingHintsFrame(hints, msg.tracking_event, now - msg.tracking_event->info.timestamp > deadline);
+    }
+  }
+  StopAsyncLog();
+
+  if(hints){
+    TrackingHintsStats stats;
+    GetTrackingHintsStats(hints, &stats);
+    printf("%llu periods, %llu switches, %llu failed, now %s;", (unsigned long long)stats.periods,
+           (unsigned long long)stats.switches, (unsigned long long)stats.failures,
+           TrackingHintsLevelString(stats.level));
+    for(int l = 0; l < eTrackingHintsLevel_Count; l++){
+      printf(" %s %.0f s", TrackingHintsLevelString((eTrackingHintsLevel)l), stats.timeAt[l] / 1e6);
+    }
+    printf("\n");
+    if(recordPath){
+      FILE *out = fopen(recordPath, "w");
+      TrackingHintsInput *inputs = malloc(config.history * sizeof(TrackingHintsInput));
+      uint32_t count = inputs ? GetTrackingHintsInputs(hints, inputs, config.history) : 0;
+      if(out && WriteTrackingHintsTrace(out, inputs, count)){
+        printf("Recorded %u periods to %s\n", count, recordPath);
+      } else {
+        printf("Failed to record to %s\n", recordPath);
+      }
+      if(out){
+        fclose(out);
+      }
+      free(inputs);
+    }
+    DestroyTrackingHints(hints);
+  } else {
+    printf("No device was found.\n");
+  }
+  DestroyDeviceRegistry(devices);
+  LeapCloseConnection(connection);
+  LeapDestroyConnection(connection);
+  return 0;
+}
+//End-of-Sample
@@ -0,0 +1,158 @@
+/* Fixed pool of worker threads for data-parallel loops.
+ *
+ * Each RunParallel() call is a generation: the caller publishes the task
+ * under the lock, bumps the generation and wakes every worker. Workers and
+ * caller then take indices from a shared atomic counter without locking; the
+ * last worker to run out of indices signals the caller.
+ *
+ */
+
+#include "WorkerPool.h"
+#include "LeapThreads.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define WORKER_IDLE_WAIT_MS 1000
+
+typedef struct _Worker {
+  WorkerPool *pool;
+  uint32_t    id;
+  ThreadType  thread;
+} Worker;
+
+struct _WorkerPool {
+  uint32_t      nWorkers;          //Threads owned by the pool; the caller makes one more
+  Worker       *workers;
+  LockType      lock;
+  CondType      start;
+  CondType      done;
+  uint64_t      generation;
+  bool          stopping;
+  uint32_t      busy;              //Workers still on the current generation
+  parallel_task task;
+  void         *context;
+  uint32_t      count;
+  atomic_uint   next;
+};
+
+static void runIndices(WorkerPool *pool, parallel_task task, void *context, uint32_t count, uint32_t worker){
+  for(;;){
+    uint32_t index = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed);
+    if(index >= count){
+      return;
+    }
+    task(context, index, worker);
+  }
+}
+
+static ThreadReturnType workerThread(void *arg){
+  Worker *worker = arg;
+  WorkerPool *pool = worker->pool;
+  uint64_t seen = 0;
+  LockMutex(&pool->lock);
+  for(;;){
+    while(pool->generation == seen && !pool->stopping){
+      WaitCond(&pool->start, &pool->lock, WORKER_IDLE_WAIT_MS);
+    }
+    if(pool->stopping){
+      break;
+    }
+    seen = pool->generation;
+    parallel_task task = pool->task;
+    void *context = pool->context;
+    uint32_t count = pool->count;
+    UnlockMutex(&pool->lock);
+
+    runIndices(pool, task, context, count, worker->id);
+
+    LockMutex(&pool->lock);
+    if(--pool->busy == 0){
+      SignalCond(&pool->done);
+    }
+  }
+  UnlockMutex(&pool->lock);
+  return ThreadReturnValue;
+}
+
+/** threads counts the calling thread; 0 uses one thread per CPU. */
+WorkerPool* CreateWorkerPool(uint32_t threads){
+  WorkerPool *pool = calloc(1, sizeof(WorkerPool));
+  if(!pool){
+    return NULL;
+  }
+  if(threads == 0){
+    threads = GetCpuCount();
+  }
+  InitLock(&pool->lock);
+  InitCond(&pool->start);
+  InitCond(&pool->done);
+  pool->workers = calloc(threads, sizeof(Worker));
+  if(!pool->workers){
+    DestroyWorkerPool(pool);
+    return NULL;
+  }
+  for(uint32_t i = 0; i + 1 < threads; i++){
+    Worker *worker = &pool->workers[pool->nWorkers];
+    worker->pool = pool;
+    worker->id = pool->nWorkers + 1;
+    if(!StartThread(&worker->thread, workerThread, worker)){
+      break;
+    }
+    pool->nWorkers++;
+  }
+  return pool;
+}
+
+void DestroyWorkerPool(WorkerPool *pool){
+  if(!pool){
+    return;
+  }
+  LockMutex(&pool->lock);
+  pool->stopping = true;
+  BroadcastCond(&pool->start);
+  UnlockMutex(&pool->lock);
+  for(uint32_t i = 0; i < pool->nWorkers; i++){
+    JoinThread(pool->workers[i].thread);
+  }
+  DestroyCond(&pool->done);
+  DestroyCond(&pool->start);
+  DestroyLock(&pool->lock);
+  free(pool->workers);
+  free(pool);
+}
+
+/** The pool's threads plus the caller; fewer than requested if threads could not be started. */
+uint32_t GetWorkerCount(const WorkerPool *pool){
+  return pool->nWorkers + 1;
+}
+
+/** Not reentrant: one RunParallel() at a time per pool. */
+void RunParallel(WorkerPool *pool, uint32_t count, parallel_task task, void *context){
+  if(count == 0){
+    return;
+  }
+  if(pool->nWorkers == 0 || count == 1){
+    for(uint32_t i = 0; i < count; i++){
+      task(context, i, 0);
+    }
+    return;
+  }
+  LockMutex(&pool->lock);
+  pool->task = task;
+  pool->context = context;
+  pool->count = count;
+  atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+  pool->busy = pool->nWorkers;
+  pool->generation++;
+  BroadcastCond(&pool->start);
+  UnlockMutex(&pool->lock);
+
+  runIndices(pool, task, context, count, 0);
+
+  LockMutex(&pool->lock);
+  while(pool->busy){
+    WaitCond(&pool->done, &pool->lock, WORKER_IDLE_WAIT_MS);
+  }
+  UnlockMutex(&pool->lock);
+}
+//End-of-WorkerPool.c
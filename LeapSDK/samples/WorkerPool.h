@@ -0,0 +1,28 @@
+/* Fixed pool of worker threads for data-parallel loops.
+ *
+ * RunParallel() calls task once for every index below count, spread over
+ * the workers and the calling thread, and returns when all calls have
+ * finished. Indices are handed out one at a time, so a loop split into more
+ * tiles than threads balances itself when some tiles take longer. The worker
+ * number passed to task is stable for the duration of a call and below
+ * GetWorkerCount(), so it can select per-thread scratch memory.
+ *
+ */
+
+#ifndef WorkerPool_h
+#define WorkerPool_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct _WorkerPool WorkerPool;
+
+/** worker is 0 for the calling thread and 1 to GetWorkerCount() - 1 for the pool's threads. */
+typedef void (*parallel_task)(void *context, uint32_t index, uint32_t worker);
+
+WorkerPool* CreateWorkerPool(uint32_t threads);
+void DestroyWorkerPool(WorkerPool *pool);
+uint32_t GetWorkerCount(const WorkerPool *pool);
+void RunParallel(WorkerPool *pool, uint32_t count, parallel_task task, void *context);
+
+#endif /* WorkerPool_h */
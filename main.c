@@ -1,11 +1,363 @@
 #include "LeapC.h"
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <conio.h>      // For _kbhit and _getch
+#include <string.h>
+#include "FrameStreamServer.h"
+#include "FrameTiming.h"
+#include "ServiceLog.h"
+#include "FrameStreamSocket.h"   // Control socket; before LeapThreads.h for winsock2.h
+#include "LeapThreads.h"
 
+#define STREAM_QUEUE_CAPACITY 64
+#define DEFAULT_POLL_TIMEOUT_MS 100
+#define PRINT_EVERY 100
+#define CONTROL_WAIT_MS 200
+#define LATENCY_BUCKET_US 10
+#define LATENCY_BUCKETS 10000    // 100 ms; slower wakes land in the last bucket
+
+/*
+ * The main thread only polls: it stamps the wake latency of each frame, hands
+ * it to the stream server and the frame timing analyzer and, every PRINT_EVERY
+ * frames, copies it for the report thread. Printing and commands run on their
+ * own threads so console output never delays LeapPollConnection(). Ctrl+C /
+ * SIGTERM, "q" on stdin or "quit" on the control socket stop it within one
+ * poll timeout.
+ */
+
+typedef struct _FrameReport {
+    bool pending;
+    uint64_t frame_count;
+    LEAP_TRACKING_EVENT frame;
+    LEAP_HAND hands[2];
+} FrameReport;
+
+static atomic_int running = 1;
+static atomic_uint_fast64_t frame_count;
+static atomic_uint latency_buckets[LATENCY_BUCKETS];
+
+static LockType report_lock;
+static CondType report_cond;
+static FrameReport report;
+
+static FrameStreamServer* server = NULL;
+static FrameTiming* frame_timing = NULL;
+static ServiceLog* service_log = NULL;
+
+static void on_signal(int sig) {
+    (void)sig;
+    atomic_store(&running, 0);
+}
+
+static void record_latency(int64_t latency_us) {
+    size_t bucket = latency_us <= 0 ? 0 : (size_t)(latency_us / LATENCY_BUCKET_US);
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+    // Single writer, so a relaxed load/store pair is enough
+    atomic_store_explicit(&latency_buckets[bucket],
+                          atomic_load_explicit(&latency_buckets[bucket], memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+static uint64_t latency_percentile(const uint32_t* counts, uint64_t total, double fraction) {
+    uint64_t target = (uint64_t)(fraction * (double)(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= target) {
+            return (uint64_t)(i + 1) * LATENCY_BUCKET_US;
+        }
+    }
+    return (uint64_t)LATENCY_BUCKETS * LATENCY_BUCKET_US;
+}
+
+static int format_stats(char* text, size_t size) {
+    uint32_t counts[LATENCY_BUCKETS];
+    uint64_t total = 0;
+    size_t worst = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&latency_buckets[i], memory_order_relaxed);
+        total += counts[i];
+        if (counts[i]) {
+            worst = i;
+        }
+    }
+    int length = snprintf(text, size, "%llu frames",
+                          (unsigned long long)atomic_load(&frame_count));
+    if (total && length >= 0 && (size_t)length < size) {
+        length += snprintf(text + length, size - length,
+                           ", poll wake latency p50 %llu us, p99 %llu us, max %llu us",
+                           (unsigned long long)latency_percentile(counts, total, 0.50),
+                           (unsigned long long)latency_percentile(counts, total, 0.99),
+                           (unsigned long long)(worst + 1) * LATENCY_BUCKET_US);
+    }
+    if (server && length >= 0 && (size_t)length < size) {
+        FrameStreamServerStats stats;
+        GetFrameStreamServerStats(server, &stats);
+        length += snprintf(text + length, size - length,
+                           "; streamed %llu (%llu dropped in queue, %llu refused by socket)",
+                           (unsigned long long)stats.sent, (unsigned long long)stats.dropped,
+                           (unsigned long long)stats.failed);
+    }
+    if (frame_timing) {
+        uint32_t devices[FRAME_TIMING_MAX_DEVICES];
+        uint32_t device_count = GetFrameTimingDevices(frame_timing, devices, FRAME_TIMING_MAX_DEVICES);
+        for (uint32_t d = 0; d < device_count && length >= 0 && (size_t)length < size; d++) {
+            FrameTimingWindow window;
+            if (!GetLatestFrameTimingWindow(frame_timing, devices[d], &window)) {
+                continue;
+            }
+            length += snprintf(text + length, size - length,
+                               "; device %u %.1f fps (%.1f reported), interval p99 %.0f us, jitter rms %.0f us max %.0f us",
+                               devices[d], window.measuredFramerate, window.reportedFramerate,
+                               window.p99Interval, window.jitterRms, window.jitterMax);
+        }
+        FrameTimingStats timing;
+        GetFrameTimingStats(frame_timing, &timing);
+        if (timing.windows && length >= 0 && (size_t)length < size) {
+            length += snprintf(text + length, size - length,
+                               "; %llu frames dropped, %llu timestamps out of order, %llu framerate collapses",
+                               (unsigned long long)timing.dropped, (unsigned long long)timing.nonMonotonic,
+                               (unsigned long long)timing.collapses);
+        }
+    }
+    return length;
+}
+
+// Applies one command line; writes the reply into reply. Shared by stdin and the control socket.
+static void run_command(const char* command, char* reply, size_t size) {
+    while (*command == ' ' || *command == '\t') {
+        command++;
+    }
+    size_t length = strcspn(command, " \t\r\n");
+    if ((length == 1 && command[0] == 'q') || (length == 4 && strncmp(command, "quit", 4) == 0)) {
+        atomic_store(&running, 0);
+        snprintf(reply, size, "stopping");
+    } else if ((length == 1 && command[0] == 's') || (length == 5 && strncmp(command, "stats", 5) == 0)) {
+        format_stats(reply, size);
+    } else if (length == 0) {
+        reply[0] = '\0';
+    } else {
+        snprintf(reply, size, "commands: q[uit], s[tats]");
+    }
+}
+
+static ThreadReturnType stdin_thread(void* arg) {
+    (void)arg;
+    char line[128];
+    char reply[512];
+    // Blocks in fgets() for good, so this thread is never joined. EOF (headless,
+    // stdin redirected from /dev/null) just ends it; only signals remain.
+    while (atomic_load(&running) && fgets(line, sizeof(line), stdin)) {
+        run_command(line, reply, sizeof(reply));
+        if (reply[0]) {
+            printf("%s\n", reply);
+            fflush(stdout);
+        }
+    }
+    return ThreadReturnValue;
+}
+
+static ThreadReturnType control_thread(void* arg) {
+    SocketType s = *(SocketType*)arg;
+    char command[128];
+    char reply[512];
+    while (atomic_load(&running)) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(s, &readable);
+        struct timeval wait = { 0, CONTROL_WAIT_MS * 1000 };
+        if (select((int)s + 1, &readable, NULL, NULL, &wait) <= 0) {
+            continue;
+        }
+        struct sockaddr_storage from;
+        socklen_t from_length = sizeof(from);
+        int received = (int)recvfrom(s, command, sizeof(command) - 1, 0, (struct sockaddr*)&from, &from_length);
+        if (received <= 0) {
+            continue;
+        }
+        command[received] = '\0';
+        run_command(command, reply, sizeof(reply));
+        // Unbound unix datagram senders have no address to answer
+        if (reply[0] && from_length > sizeof(from.ss_family)) {
+            sendto(s, reply, (int)strlen(reply), 0, (struct sockaddr*)&from, from_length);
+        }
+    }
+    return ThreadReturnValue;
+}
+
+static SocketType open_control_socket(const char* text) {
+    StreamAddress address;
+    if (!parseStreamAddress(text, &address) || address.multicast) {
+        return INVALID_SOCKET_VALUE;
+    }
+    SocketType s = socket(address.family, SOCK_DGRAM, 0);
+    if (s == INVALID_SOCKET_VALUE) {
+        return s;
+    }
+#if !defined(_MSC_VER)
+    if (address.family == AF_UNIX) {
+        unlink(((struct sockaddr_un*)&address.addr)->sun_path);
+    }
+#endif
+    if (bind(s, (struct sockaddr*)&address.addr, address.length) != 0) {
+        closeSocket(s);
+        return INVALID_SOCKET_VALUE;
+    }
+    return s;
+}
+
+// Prints the windows that collapsed since the last call; collapses is the count already reported
+static void report_collapses(uint64_t* collapses) {
+    FrameTimingStats stats;
+    GetFrameTimingStats(frame_timing, &stats);
+    if (stats.collapses == *collapses) {
+        return;
+    }
+    *collapses = stats.collapses;
+    uint32_t devices[FRAME_TIMING_MAX_DEVICES];
+    uint32_t device_count = GetFrameTimingDevices(frame_timing, devices, FRAME_TIMING_MAX_DEVICES);
+    for (uint32_t d = 0; d < device_count; d++) {
+        FrameTimingWindow window;
+        if (GetLatestFrameTimingWindow(frame_timing, devices[d], &window) && window.collapsed) {
+            printf("\nDevice %u framerate collapsed: %.1f fps measured, %.1f reported, %.1f usual\n",
+                   devices[d], window.measuredFramerate, window.reportedFramerate, window.baselineFramerate);
+        }
+    }
+    fflush(stdout);
+}
+
+static ThreadReturnType report_thread(void* arg) {
+    (void)arg;
+    FrameReport local;
+    uint64_t collapses = 0;
+    LockMutex(&report_lock);
+    while (atomic_load(&running) || report.pending) {
+        if (!report.pending) {
+            WaitCond(&report_cond, &report_lock, CONTROL_WAIT_MS);
+            UnlockMutex(&report_lock);
+            report_collapses(&collapses);
+            LockMutex(&report_lock);
+            continue;
+        }
+        local = report;
+        report.pending = false;
+        UnlockMutex(&report_lock);
+
+        const LEAP_TRACKING_EVENT* frame = &local.frame;
+        printf("\n[Frame #%llu] Frame ID: %lld, Hands detected: %u\n",
+               (unsigned long long)local.frame_count, (long long)frame->info.frame_id, frame->nHands);
+
+        for (uint32_t i = 0; i < frame->nHands; i++) {
+            const LEAP_HAND* hand = &local.hands[i];
+            printf("Hand %u (ID %u, %s hand)\n",
+                   i, hand->id,
+                   (hand->type == eLeapHandType_Left) ? "Left" : "Right");
+
+            for (int f = 0; f < 5; f++) {
+                const LEAP_DIGIT* finger = &hand->digits[f];
+                printf("  Finger %d: finger_id=%d, is_extended=%s\n",
+                       f,
+                       finger->finger_id,
+                       finger->is_extended ? "true" : "false");
+            }
+        }
+        fflush(stdout);
+        LockMutex(&report_lock);
+    }
+    UnlockMutex(&report_lock);
+    return ThreadReturnValue;
+}
+
+// Poll thread side: a copy under the lock, never any I/O
+static void post_report(const LEAP_TRACKING_EVENT* frame, uint64_t count) {
+    LockMutex(&report_lock);
+    report.frame_count = count;
+    report.frame = *frame;
+    report.frame.nHands = frame->nHands < 2 ? frame->nHands : 2;
+    memcpy(report.hands, frame->pHands, report.frame.nHands * sizeof(LEAP_HAND));
+    report.frame.pHands = report.hands;
+    report.pending = true;
+    SignalCond(&report_cond);
+    UnlockMutex(&report_lock);
+}
+
+static void usage(const char* program) {
+    printf("Usage: %s [--stream [address]] [--control address] [--service-log path] [--poll-timeout ms] [--headless]\n"
+           "  --stream        send every frame to %s or address, see FrameStream.h\n"
+           "  --control       accept q[uit] / s[tats] datagrams on udp://host:port or unix:/path\n"
+           "  --service-log   append the service's log messages to path as JSON lines, see ServiceLog.h\n"
+           "  --poll-timeout  LeapPollConnection() timeout, bounds shutdown time (default %d)\n"
+           "  --headless      ignore stdin; stop with SIGINT / SIGTERM or the control socket\n",
+           program, FRAME_STREAM_DEFAULT_ADDRESS, DEFAULT_POLL_TIMEOUT_MS);
+}
+
+int main(int argc, char** argv) {
+    const char* stream_address = NULL;
+    const char* control_address = NULL;
+    const char* service_log_path = NULL;
+    uint32_t poll_timeout = DEFAULT_POLL_TIMEOUT_MS;
+    bool headless = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stream") == 0) {
+            stream_address = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : FRAME_STREAM_DEFAULT_ADDRESS;
+        } else if (strcmp(argv[i], "--control") == 0 && i + 1 < argc) {
+            control_address = argv[++i];
+        } else if (strcmp(argv[i], "--service-log") == 0 && i + 1 < argc) {
+            service_log_path = argv[++i];
+        } else if (strcmp(argv[i], "--poll-timeout") == 0 && i + 1 < argc) {
+            poll_timeout = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    // --stream [address] sends every frame to receivers, see FrameStream.h
+    if (stream_address) {
+        server = CreateFrameStreamServer(stream_address, NULL, STREAM_QUEUE_CAPACITY);
+        if (!server) {
+            printf("Failed to start streaming to %s\n", stream_address);
+            return -1;
+        }
+        printf("Streaming frames to %s\n", stream_address);
+    }
+
+    if (service_log_path) {
+        service_log = CreateServiceLog(service_log_path, SERVICE_LOG_DEFAULT_CAPACITY);
+        if (!service_log) {
+            printf("Failed to open service log %s\n", service_log_path);
+            return -1;
+        }
+    }
+
+    SocketType control = INVALID_SOCKET_VALUE;
+    ThreadType control_handle;
+    if (control_address) {
+        if (!startSockets() || (control = open_control_socket(control_address)) == INVALID_SOCKET_VALUE) {
+            printf("Failed to open control socket %s\n", control_address);
+            return -1;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+#if defined(SIGBREAK)
+    signal(SIGBREAK, on_signal);
+#endif
+
+    // Always on: a few operations per frame, published once a second
+    frame_timing = CreateFrameTiming(NULL);
+    if (!frame_timing) {
+        printf("Failed to create the frame timing analyzer\n");
+        return -1;
+    }
 
-int main() {
     LEAP_CONNECTION connection;
     if (LeapCreateConnection(NULL, &connection) != eLeapRS_Success) {
         printf("Failed to create connection\n");
@@ -16,57 +368,84 @@ int main() {
         return -1;
     }
 
-    printf("Connection opened. Press 'q' to quit.\n");
-
-    bool running = true;
-    int frame_count = 0;
+    InitLock(&report_lock);
+    InitCond(&report_cond);
+    ThreadType report_handle;
+    ThreadType stdin_handle;
+    if (!StartThread(&report_handle, report_thread, NULL) ||
+        (control != INVALID_SOCKET_VALUE && !StartThread(&control_handle, control_thread, &control)) ||
+        (!headless && !StartThread(&stdin_handle, stdin_thread, NULL))) {
+        printf("Failed to start threads\n");
+        return -1;
+    }
 
-    while (running) {
-        if (_kbhit()) {
-            char key = _getch();
-            if (key == 'q') {
-                running = false;
-                continue;
-            }
-        }
+    printf("Connection opened. %s\n", headless ? "Send SIGINT or SIGTERM to quit." : "Enter 'q' to quit, 's' for stats.");
+    fflush(stdout);
 
+    while (atomic_load(&running)) {
         LEAP_CONNECTION_MESSAGE msg;
-        eLeapRS result = LeapPollConnection(connection, 100, &msg);
+        eLeapRS result = LeapPollConnection(connection, poll_timeout, &msg);
         if (result != eLeapRS_Success) {
+            // Closes the windows of devices that have stopped sending frames
+            UpdateFrameTiming(frame_timing, LeapGetNow());
+            continue;
+        }
+        if (service_log && msg.type == eLeapEventType_LogEvent) {
+            RecordServiceLogEvent(service_log, msg.log_event);
+        } else if (service_log && msg.type == eLeapEventType_LogEvents) {
+            RecordServiceLogEvents(service_log, msg.log_events);
+        }
+        if (msg.type != eLeapEventType_Tracking) {
+            UpdateFrameTiming(frame_timing, LeapGetNow());
             continue;
         }
 
-        if (msg.type == eLeapEventType_Tracking) {
-            frame_count++;
+        // Frame timestamps share LeapGetNow()'s clock
+        record_latency(LeapGetNow() - msg.tracking_event->info.timestamp);
+        RecordFrameTiming(frame_timing, msg.device_id, msg.tracking_event);
+        uint64_t count = atomic_fetch_add_explicit(&frame_count, 1, memory_order_relaxed) + 1;
 
-            // Only print every 1000 frames
-            if (frame_count % 100 != 0) {
-                continue;
-            }
+        // Never blocks; frames are dropped if the sender falls behind
+        if (server) {
+            PushStreamFrame(server, msg.tracking_event);
+        }
+        if (count % PRINT_EVERY == 0) {
+            post_report(msg.tracking_event, count);
+        }
+    }
 
-            const LEAP_TRACKING_EVENT* frame = msg.tracking_event;
-            printf("\n[Frame #%d] Frame ID: %llu, Hands detected: %d\n",
-                   frame_count, frame->info.frame_id, frame->nHands);
-
-            for (int i = 0; i < frame->nHands; i++) {
-                const LEAP_HAND* hand = &frame->pHands[i];
-                printf("Hand %d (ID %llu, %s hand)\n",
-                       i, hand->id,
-                       (hand->type == eLeapHandType_Left) ? "Left" : "Right");
-
-                for (int f = 0; f < 5; f++) {
-                    const LEAP_DIGIT* finger = &hand->digits[f];
-                    printf("  Finger %d: finger_id=%d, is_extended=%s\n",
-                           f,
-                           finger->finger_id,
-                           finger->is_extended ? "true" : "false");
-                }
-            }
+    LockMutex(&report_lock);
+    SignalCond(&report_cond);
+    UnlockMutex(&report_lock);
+    JoinThread(report_handle);
+    if (control != INVALID_SOCKET_VALUE) {
+        JoinThread(control_handle);
+        closeSocket(control);
+#if !defined(_MSC_VER)
+        if (strncmp(control_address, "unix:", 5) == 0) {
+            unlink(control_address + 5);
         }
+#endif
+        stopSockets();
     }
 
     LeapCloseConnection(connection);
     LeapDestroyConnection(connection);
     printf("Connection closed.\n");
+
+    char stats[512];
+    format_stats(stats, sizeof(stats));
+    printf("%s\n", stats);
+    if (server) {
+        DestroyFrameStreamServer(server);
+    }
+    if (service_log) {
+        ServiceLogStats log_stats;
+        GetServiceLogStats(service_log, &log_stats);
+        printf("Service log: %llu messages, %llu dropped\n",
+               (unsigned long long)log_stats.recorded, (unsigned long long)log_stats.dropped);
+        DestroyServiceLog(service_log);
+    }
+    DestroyFrameTiming(frame_timing);
     return 0;
 }